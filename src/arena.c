@@ -0,0 +1,63 @@
+#include "arena.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+
+struct ArenaBlock {
+    ArenaBlock *next;
+    size_t size;
+    unsigned char data[];
+};
+
+static ArenaBlock *block_create(size_t size) {
+    ArenaBlock *block = malloc(sizeof(ArenaBlock) + size);
+    if (block != NULL) {
+        block->next = NULL;
+        block->size = size;
+    }
+    return block;
+}
+
+void *arena_alloc(Arena *arena, size_t size, size_t alignment) {
+    ArenaBlock *block = arena->blocks;
+    if (block != NULL) {
+        uintptr_t start = (uintptr_t)(block->data + arena->used);
+        size_t padding = (alignment - start % alignment) % alignment;
+        if (padding + size <= block->size - arena->used) {
+            arena->used += padding + size;
+            arena->total += padding + size;
+            return (void *)(start + padding);
+        }
+    }
+
+    size_t block_size = size + alignment > ARENA_BLOCK_SIZE ? size + alignment : ARENA_BLOCK_SIZE;
+    ArenaBlock *grown = block_create(block_size);
+    if (grown == NULL) return NULL;
+    grown->next = block;
+    arena->blocks = grown;
+    arena->used = 0;
+    return arena_alloc(arena, size, alignment);
+}
+
+void arena_reset(Arena *arena) {
+    if (arena->blocks != NULL && arena->blocks->next != NULL) {
+        // Some slack, the alignment padding differs from block to block
+        size_t size = arena->total + arena->total / 8;
+        arena_free(arena);
+        arena->blocks = block_create(size);
+    }
+    arena->used = 0;
+    arena->total = 0;
+}
+
+void arena_free(Arena *arena) {
+    ArenaBlock *block = arena->blocks;
+    while (block != NULL) {
+        ArenaBlock *next = block->next;
+        free(block);
+        block = next;
+    }
+    arena->blocks = NULL;
+    arena->used = 0;
+    arena->total = 0;
+}
@@ -0,0 +1,24 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stddef.h>
+
+#define ARENA_BLOCK_SIZE (64 * 1024) // Smallest block, larger requests get a block of their own size
+
+typedef struct ArenaBlock ArenaBlock;
+
+// Bump allocator: allocations are carved out of large blocks and released
+// all at once. After a reset the blocks are merged into one big enough for
+// everything allocated before, so a reused arena settles on one block and
+// stops calling malloc.
+typedef struct {
+    ArenaBlock *blocks; // Newest first
+    size_t used;        // Bytes taken from the newest block
+    size_t total;       // Bytes taken over all blocks since the last reset
+} Arena;
+
+void *arena_alloc(Arena *arena, size_t size, size_t alignment); // alignment a power of two; NULL when out of memory
+void arena_reset(Arena *arena);
+void arena_free(Arena *arena);
+
+#endif
@@ -0,0 +1,543 @@
+// Benchmark for the force model on synthetic graphs. Times each phase of
+// calculate_forces per generator and size and writes the results as JSON.
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <sys/resource.h>
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#include "layout.h"
+#include "graph.h"
+#include "generators.h"
+#include "forces.h"
+#include "threadpool.h"
+#include "placement.h"
+#include "cooling.h"
+#include "reorder.h"
+#include "context.h"
+#include "metrics.h"
+
+#define DEFAULT_ITERATIONS 10
+#define MAX_SIZES 32
+#define DEFAULT_CONVERGENCE_ITERATIONS 2000
+
+static void usage(const char *program) {
+    printf("Usage: %s [options]\n"
+           "  --generators=LIST      Comma separated: erdos-renyi, grid, tree, complete,\n"
+           "                         power-law (default all)\n"
+           "  --sizes=LIST           Comma separated node counts (default 100,1000,...,1000000)\n"
+           "  --iterations=N         Timed iterations per case (default %d)\n"
+           "  --repulsion=MODE       exact, barnes-hut or auto (default auto)\n"
+           "  --theta=F              Barnes-Hut opening angle (default %.1f)\n"
+           "  --kernels=NAME         auto, scalar, sse2 or avx2 (default auto)\n"
+           "  --threads=N            Worker threads, 0 for one per core (default 0)\n"
+           "  --seed=N               Seed for graphs and initial positions (default 1)\n"
+           "  --convergence          Also count iterations to convergence from each placement\n"
+           "  --max-iterations=N     Give up converging after N iterations (default %d)\n"
+           "  --metrics              Also measure edge crossings, sampled stress and edge\n"
+           "                         lengths after the timed iterations and after converging\n"
+           "  --metrics-every=N      With --convergence, also measure every N iterations on a\n"
+           "                         background thread and write quality against time; the\n"
+           "                         thread shares the cores with the layout\n"
+           "  --reorder              Also time the iterations again after each node reordering\n"
+           "  --batch=N              Also lay out N graphs of each case at once through the\n"
+           "                         library batch call, each until it converges or reaches\n"
+           "                         --max-iterations\n"
+           "  --output=FILE          JSON results, default stdout\n",
+           program, DEFAULT_ITERATIONS, BARNES_HUT_THETA, DEFAULT_CONVERGENCE_ITERATIONS);
+}
+
+// Peak resident set size of the process so far
+static long peak_rss_bytes(void) {
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0) return -1;
+#ifdef __APPLE__
+    return usage.ru_maxrss;        // Bytes on macOS
+#else
+    return usage.ru_maxrss * 1024L; // Kilobytes elsewhere
+#endif
+}
+
+static long graph_bytes(const Graph *graph) {
+    return ((long)graph->num_nodes + 1) * (long)sizeof(int)
+         + 2L * graph->num_edges * (long)sizeof(int)
+         + (long)graph->num_edges * (long)sizeof(Edge);
+}
+
+static long node_bytes(int count) {
+    long stride = ((long)count + NODES_PADDING - 1) / NODES_PADDING * NODES_PADDING;
+    return 4 * stride * (long)sizeof(float) + stride;
+}
+
+static int parse_sizes(const char *list, int sizes[]) {
+    int count = 0;
+    while (*list != '\0' && count < MAX_SIZES) {
+        char *end;
+        long size = strtol(list, &end, 10);
+        if (end == list || size < 1 || size > 100000000) return -1;
+        sizes[count++] = (int)size;
+        list = *end == ',' ? end + 1 : end;
+        if (*end != ',' && *end != '\0') return -1;
+    }
+    return count;
+}
+
+static int parse_generators(const char *list, int selected[GENERATOR_COUNT]) {
+    char buffer[256];
+    snprintf(buffer, sizeof(buffer), "%s", list);
+    memset(selected, 0, GENERATOR_COUNT * sizeof(int));
+    for (char *name = strtok(buffer, ","); name != NULL; name = strtok(NULL, ",")) {
+        int kind = generator_from_name(name);
+        if (kind < 0) {
+            printf("Unknown generator \"%s\"\n", name);
+            return -1;
+        }
+        selected[kind] = 1;
+    }
+    return 0;
+}
+
+// Cache misses of the process, counting the threads started after it is
+// opened; -1 where hardware counters are not available (other systems,
+// containers, perf_event_paranoid)
+static int cache_counter_open(void) {
+#ifdef __linux__
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.size = sizeof(attr);
+    attr.config = PERF_COUNT_HW_CACHE_MISSES;
+    attr.inherit = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    return (int)syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+#else
+    return -1;
+#endif
+}
+
+static long long cache_counter_read(int counter) {
+    long long value = -1;
+#ifdef __linux__
+    if (counter >= 0 && read(counter, &value, sizeof(value)) != (ssize_t)sizeof(value)) value = -1;
+#endif
+    return value;
+}
+
+static double ns_per_node_iteration(double seconds, int nodes, int iterations) {
+    return seconds * 1e9 / ((double)nodes * iterations);
+}
+
+static void write_metrics(FILE *out, const LayoutMetrics *metrics) {
+    fprintf(out, "{\"crossings\": %lld, \"crossings_sampled\": %s, \"stress\": %.6f, \"edge_mean\": %.3f, "
+                 "\"edge_cv\": %.6f, \"metrics_seconds\": %.6f}",
+            metrics->crossings, metrics->crossings_sampled ? "true" : "false", metrics->stress, metrics->edge_mean,
+            metrics->edge_cv, metrics->seconds);
+}
+
+// Measure the current layout and write it as a "quality" member
+static void write_quality(FILE *out, const Nodes *nodes, const Graph *graph, uint64_t seed) {
+    LayoutMetrics metrics;
+    metrics_measure(&metrics, graph, nodes->x, nodes->y, NULL, METRICS_STRESS_PIVOTS, seed);
+    fprintf(out, ", \"quality\": ");
+    write_metrics(out, &metrics);
+}
+
+// The measurements of one convergence run, with the layout time at which
+// the positions were handed over
+typedef struct {
+    LayoutMetrics *points;
+    double *submitted; // Per multiple of `every`
+    int count;
+    int seen;          // Measurements the monitor had finished at the last look
+    int every;
+} QualityCurve;
+
+static void curve_collect(QualityCurve *curve, MetricsMonitor *monitor) {
+    LayoutMetrics metrics;
+    int finished = metrics_monitor_latest(monitor, &metrics);
+    if (finished > curve->seen) {
+        curve->points[curve->count++] = metrics;
+        curve->seen = finished;
+    }
+}
+
+// From each placement, run the adaptive schedule with freezing until the
+// layout converges or max_iterations pass, and write the counts as JSON. With
+// a monitor, the positions are also measured every metrics_every iterations.
+static void write_convergence(FILE *out, Nodes *nodes, const Graph *graph, const ForceSettings *timed_settings,
+                              int max_iterations, uint64_t seed, int metrics, int metrics_every) {
+    ForceSettings settings = *timed_settings;
+    settings.timings = NULL;
+    settings.freeze = 1;
+    MetricsMonitor *monitor = NULL;
+    QualityCurve curve = {NULL, NULL, 0, 0, metrics_every};
+    if (metrics_every > 0 && (monitor = metrics_monitor_create(graph, 2, METRICS_STRESS_PIVOTS, seed)) != NULL) {
+        curve.points = malloc(((size_t)max_iterations / metrics_every + 1) * sizeof(LayoutMetrics));
+        curve.submitted = malloc(((size_t)max_iterations / metrics_every + 1) * sizeof(double));
+        if (curve.points == NULL || curve.submitted == NULL) {
+            printf("Out of memory for %d measurements\n", max_iterations / metrics_every + 1);
+            metrics_monitor_destroy(monitor);
+            monitor = NULL;
+        }
+    }
+    fprintf(out, ",\n     \"convergence\": {");
+    for (int kind = 0; kind < PLACEMENT_COUNT; kind++) {
+        double start = layout_seconds();
+        place_nodes(nodes, graph, kind, seed, &settings);
+        double placed = layout_seconds();
+
+        Cooling cooling;
+        cooling_init(&cooling, SCHEDULE_ADAPTIVE, placement_temperature(kind), COOLING_FACTOR);
+        int iterations = 0, converged = 0;
+        curve.count = 0;
+        while (iterations < max_iterations && !converged) {
+            ForceStats stats = calculate_forces(nodes, graph->edges, graph->num_edges, cooling.temperature, iterations, &settings);
+            cooling_update(&cooling, &stats);
+            iterations++;
+            converged = layout_converged(&stats, nodes->count, CONVERGENCE_TOLERANCE);
+            if (monitor != NULL) {
+                curve_collect(&curve, monitor);
+                if (iterations % metrics_every == 0 && metrics_monitor_submit(monitor, iterations, nodes, NULL)) {
+                    curve.submitted[iterations / metrics_every] = layout_seconds() - placed;
+                }
+            }
+        }
+        double elapsed = layout_seconds() - placed;
+        fprintf(out, "%s\"%s\": {\"iterations\": %d, \"converged\": %s, \"placement_seconds\": %.6f, \"layout_seconds\": %.6f",
+                kind == 0 ? "" : ", ", placement_name(kind), iterations, converged ? "true" : "false",
+                placed - start, elapsed);
+        if (metrics) {
+            write_quality(out, nodes, graph, seed);
+        }
+        if (monitor != NULL) {
+            // The last positions handed over are still measured, so every run ends its curve alike
+            metrics_monitor_wait(monitor);
+            curve_collect(&curve, monitor);
+            fprintf(out, ",\n       \"quality_curve\": [");
+            for (int i = 0; i < curve.count; i++) {
+                const LayoutMetrics *point = &curve.points[i];
+                fprintf(out, "%s{\"iteration\": %d, \"layout_seconds\": %.6f, \"crossings\": %lld, \"stress\": %.6f, "
+                             "\"edge_cv\": %.6f}",
+                        i == 0 ? "" : ", ", point->iteration, curve.submitted[point->iteration / metrics_every],
+                        point->crossings, point->stress, point->edge_cv);
+            }
+            fprintf(out, "]");
+        }
+        fprintf(out, "}");
+        fflush(out);
+    }
+    fprintf(out, "}");
+    metrics_monitor_destroy(monitor);
+    free(curve.points);
+    free(curve.submitted);
+}
+
+// From the current layout, renumber the nodes each way and time the same
+// iterations again, and write the phase times, the edge locality and the
+// cache misses against the loaded order as JSON
+static void write_reordering(FILE *out, Nodes *nodes, Graph *graph, ForceSettings *settings, int iterations,
+                             int cache_counter) {
+    int n = nodes->count;
+    float *start_x = malloc((size_t)n * sizeof(float));
+    float *start_y = malloc((size_t)n * sizeof(float));
+    Reordering reordering;
+    if (start_x == NULL || start_y == NULL || reorder_init(&reordering, n) != 0) {
+        fprintf(out, ",\n     \"reorder\": null");
+        free(start_x);
+        free(start_y);
+        return;
+    }
+    memcpy(start_x, nodes->x, (size_t)n * sizeof(float));
+    memcpy(start_y, nodes->y, (size_t)n * sizeof(float));
+    ForceTimings *timings = settings->timings;
+
+    double baseline = 0.0;
+    fprintf(out, ",\n     \"reorder\": {");
+    for (int kind = 0; kind < REORDER_COUNT; kind++) {
+        reorder_restore(&reordering, graph, nodes);
+        memcpy(nodes->x, start_x, (size_t)n * sizeof(float));
+        memcpy(nodes->y, start_y, (size_t)n * sizeof(float));
+        memset(nodes->still, 0, (size_t)n);
+        reordering.seconds = 0.0;
+        if (reorder_apply(&reordering, kind, graph, nodes) != 0) {
+            fprintf(out, "%s\"%s\": null", kind == 0 ? "" : ", ", reorder_name(kind));
+            continue;
+        }
+
+        float temperature = START_TEMPERATURE;
+        settings->timings = NULL;
+        calculate_forces(nodes, graph->edges, graph->num_edges, temperature, 0, settings);
+        settings->timings = timings;
+        memset(timings, 0, sizeof(*timings));
+        long long misses = cache_counter_read(cache_counter);
+        for (int iteration = 1; iteration <= iterations; iteration++) {
+            temperature *= COOLING_FACTOR;
+            calculate_forces(nodes, graph->edges, graph->num_edges, temperature, iteration, settings);
+        }
+        long long misses_after = cache_counter_read(cache_counter);
+        double total = timings->repulsion + timings->attraction + timings->integration;
+        if (kind == REORDER_NONE) baseline = total;
+
+        fprintf(out, "%s\n       \"%s\": {\"reorder_seconds\": %.6f, \"edge_span\": %.1f, "
+                     "\"seconds\": {\"repulsion\": %.6f, \"attraction\": %.6f, \"integration\": %.6f, \"total\": %.6f}, "
+                     "\"speedup\": %.3f, \"cache_misses\": ",
+                kind == 0 ? "" : ",", reorder_name(kind), reordering.seconds, reorder_edge_span(graph),
+                timings->repulsion, timings->attraction, timings->integration, total,
+                total > 0.0 ? baseline / total : 0.0);
+        if (misses >= 0 && misses_after >= 0) {
+            fprintf(out, "%lld}", misses_after - misses);
+        } else {
+            fprintf(out, "null}");
+        }
+        fflush(out);
+    }
+    fprintf(out, "}");
+    reorder_restore(&reordering, graph, nodes);
+    reorder_free(&reordering);
+    free(start_x);
+    free(start_y);
+}
+
+// Generate `count` graphs like the current one (seeds seed + 1, ...), lay
+// them all out with one layout_batch call and write the throughput as JSON
+static void write_batch(FILE *out, GeneratorKind kind, int n, int count, int max_iterations, unsigned int seed,
+                        ThreadPool *pool) {
+    Graph *graphs = calloc((size_t)count, sizeof(Graph));
+    LayoutJob *jobs = calloc((size_t)count, sizeof(LayoutJob));
+    float *positions = malloc((size_t)count * 2 * (size_t)n * sizeof(float));
+    int generated = 0;
+    if (graphs != NULL && jobs != NULL && positions != NULL) {
+        while (generated < count && generate_graph(&graphs[generated], kind, n, seed + 1 + (unsigned int)generated) == 0) {
+            generated++;
+        }
+    }
+    if (generated < count) {
+        fprintf(out, ",\n     \"batch\": null");
+    } else {
+        long nodes = 0;
+        for (int j = 0; j < count; j++) {
+            float *x = positions + (size_t)j * 2 * n;
+            LayoutJob job = {graphs[j].edges, graphs[j].num_edges, graphs[j].num_nodes, x, x + n, NULL, 0, 0};
+            jobs[j] = job;
+            nodes += graphs[j].num_nodes;
+        }
+        LayoutOptions options;
+        layout_options_default(&options);
+        options.seed = seed;
+
+        double start = layout_seconds();
+        int failed = layout_batch(jobs, count, &options, max_iterations, pool);
+        double seconds = layout_seconds() - start;
+        double node_iterations = 0.0, iterations = 0.0;
+        for (int j = 0; j < count; j++) {
+            iterations += jobs[j].iterations;
+            node_iterations += (double)jobs[j].iterations * graphs[j].num_nodes;
+        }
+        fprintf(out, ",\n     \"batch\": {\"graphs\": %d, \"nodes\": %ld, \"failed\": %d, \"seconds\": %.6f, "
+                     "\"graphs_per_second\": %.1f, \"mean_iterations\": %.1f, \"ns_per_node_iteration\": %.3f}",
+                count, nodes, failed, seconds, seconds > 0.0 ? count / seconds : 0.0, iterations / count,
+                node_iterations > 0.0 ? seconds * 1e9 / node_iterations : 0.0);
+    }
+    for (int j = 0; j < generated; j++) {
+        graph_free(&graphs[j]);
+    }
+    free(graphs);
+    free(jobs);
+    free(positions);
+}
+
+int main(int argc, char *argv[]) {
+    const char *output_path = NULL;
+    const char *repulsion = "auto";
+    const char *kernel_name = "auto";
+    int selected[GENERATOR_COUNT] = {1, 1, 1, 1, 1};
+    int sizes[MAX_SIZES] = {100, 1000, 10000, 100000, 1000000};
+    int num_sizes = 5;
+    int iterations = DEFAULT_ITERATIONS;
+    float theta = BARNES_HUT_THETA;
+    int num_threads = 0;
+    unsigned int seed = 1;
+    int convergence = 0;
+    int max_iterations = DEFAULT_CONVERGENCE_ITERATIONS;
+    int reorder = 0;
+    int batch = 0;
+    int metrics = 0;
+    int metrics_every = 0;
+
+    for (int i = 1; i < argc; i++) {
+        const char *arg = argv[i];
+        if (strncmp(arg, "--generators=", 13) == 0) {
+            if (parse_generators(arg + 13, selected) != 0) return 1;
+        } else if (strncmp(arg, "--sizes=", 8) == 0) {
+            if ((num_sizes = parse_sizes(arg + 8, sizes)) <= 0) {
+                printf("Bad size list \"%s\"\n", arg + 8);
+                return 1;
+            }
+        } else if (strncmp(arg, "--iterations=", 13) == 0) {
+            iterations = atoi(arg + 13);
+        } else if (strncmp(arg, "--repulsion=", 12) == 0) {
+            repulsion = arg + 12;
+        } else if (strncmp(arg, "--theta=", 8) == 0) {
+            theta = (float)atof(arg + 8);
+        } else if (strncmp(arg, "--kernels=", 10) == 0) {
+            kernel_name = arg + 10;
+        } else if (strncmp(arg, "--threads=", 10) == 0) {
+            num_threads = atoi(arg + 10);
+        } else if (strncmp(arg, "--seed=", 7) == 0) {
+            seed = (unsigned int)strtoul(arg + 7, NULL, 10);
+        } else if (strcmp(arg, "--convergence") == 0) {
+            convergence = 1;
+        } else if (strncmp(arg, "--max-iterations=", 17) == 0) {
+            max_iterations = atoi(arg + 17);
+        } else if (strcmp(arg, "--metrics") == 0) {
+            metrics = 1;
+        } else if (strncmp(arg, "--metrics-every=", 16) == 0) {
+            metrics_every = atoi(arg + 16);
+        } else if (strncmp(arg, "--batch=", 8) == 0) {
+            batch = atoi(arg + 8);
+        } else if (strcmp(arg, "--reorder") == 0) {
+            reorder = 1;
+        } else if (strncmp(arg, "--output=", 9) == 0) {
+            output_path = arg + 9;
+        } else {
+            usage(argv[0]);
+            return strcmp(arg, "--help") == 0 ? 0 : 1;
+        }
+    }
+    if (iterations < 1) iterations = 1;
+    if (metrics_every > 0 && !convergence) {
+        printf("--metrics-every needs --convergence\n");
+        return 1;
+    }
+    if (strcmp(repulsion, "exact") != 0 && strcmp(repulsion, "barnes-hut") != 0 && strcmp(repulsion, "auto") != 0) {
+        printf("Unknown repulsion mode \"%s\"\n", repulsion);
+        return 1;
+    }
+
+    // The timed iterations never freeze nodes, so every phase covers the whole graph
+    ForceTimings timings;
+    ForceSettings settings = {REPULSION_EXACT, theta, force_kernels_select(kernel_name), NULL, &timings, 0, NULL};
+    if (settings.kernels == NULL) {
+        printf("Force kernels \"%s\" are not available on this CPU\n", kernel_name);
+        return 1;
+    }
+
+    FILE *out = stdout;
+    if (output_path != NULL && (out = fopen(output_path, "w")) == NULL) {
+        printf("Cannot open %s for writing\n", output_path);
+        return 1;
+    }
+
+    // Opened before the pool so the counter follows its workers
+    int cache_counter = reorder ? cache_counter_open() : -1;
+    settings.pool = threadpool_create(num_threads);
+    settings.workspace = force_workspace_create();
+    fprintf(out, "{\n  \"kernels\": \"%s\",\n  \"threads\": %d,\n  \"iterations\": %d,\n  \"seed\": %u,\n  \"results\": [",
+            settings.kernels->name, threadpool_size(settings.pool), iterations, seed);
+
+    int first = 1;
+    for (int kind = 0; kind < GENERATOR_COUNT; kind++) {
+        if (!selected[kind]) continue;
+        double previous_ns = 0;
+        int previous_nodes = 0;
+
+        for (int s = 0; s < num_sizes; s++) {
+            int n = sizes[s];
+            fprintf(out, "%s\n    {\"generator\": \"%s\", \"nodes\": %d", first ? "" : ",", generator_name(kind), n);
+            first = 0;
+
+            Graph graph;
+            if (kind == GENERATOR_COMPLETE && n > GENERATOR_COMPLETE_MAX_NODES) {
+                fprintf(out, ", \"skipped\": \"complete graph limited to %d nodes\"}", GENERATOR_COMPLETE_MAX_NODES);
+                continue;
+            }
+            if (generate_graph(&graph, kind, n, seed) != 0) {
+                fprintf(out, ", \"skipped\": \"generation failed\"}");
+                continue;
+            }
+            Nodes nodes;
+            if (nodes_alloc(&nodes, graph.num_nodes) != 0) {
+                fprintf(out, ", \"skipped\": \"out of memory\"}");
+                graph_free(&graph);
+                continue;
+            }
+            initialize_nodes(&nodes, seed);
+
+            settings.repulsion = REPULSION_EXACT;
+            if (strcmp(repulsion, "barnes-hut") == 0 ||
+                (strcmp(repulsion, "auto") == 0 && n > AUTO_BARNES_HUT_NODES)) {
+                settings.repulsion = REPULSION_BARNES_HUT;
+            }
+
+            // One untimed iteration warms the caches, the tree and the buffers
+            float temperature = START_TEMPERATURE;
+            settings.timings = NULL;
+            calculate_forces(&nodes, graph.edges, graph.num_edges, temperature, 0, &settings);
+            settings.timings = &timings;
+            memset(&timings, 0, sizeof(timings));
+            for (int iteration = 1; iteration <= iterations; iteration++) {
+                temperature *= COOLING_FACTOR;
+                calculate_forces(&nodes, graph.edges, graph.num_edges, temperature, iteration, &settings);
+            }
+
+            double total = timings.repulsion + timings.attraction + timings.integration;
+            double total_ns = ns_per_node_iteration(total, n, iterations);
+            fprintf(out, ", \"edges\": %d, \"repulsion\": \"%s\",\n"
+                         "     \"seconds\": {\"repulsion\": %.6f, \"attraction\": %.6f, \"integration\": %.6f, \"total\": %.6f},\n"
+                         "     \"ns_per_node_iteration\": {\"repulsion\": %.3f, \"attraction\": %.3f, \"integration\": %.3f, \"total\": %.3f},\n"
+                         "     \"memory\": {\"graph_bytes\": %ld, \"node_bytes\": %ld, \"peak_rss_bytes\": %ld},\n"
+                         "     \"scaling_exponent\": ",
+                    graph.num_edges, settings.repulsion == REPULSION_BARNES_HUT ? "barnes-hut" : "exact",
+                    timings.repulsion, timings.attraction, timings.integration, total,
+                    ns_per_node_iteration(timings.repulsion, n, iterations),
+                    ns_per_node_iteration(timings.attraction, n, iterations),
+                    ns_per_node_iteration(timings.integration, n, iterations), total_ns,
+                    graph_bytes(&graph), node_bytes(n), peak_rss_bytes());
+
+            // Slope of log(time per iteration) against log(nodes) from the previous size
+            double per_iteration = total_ns * n;
+            if (previous_nodes > 0 && previous_nodes != n && previous_ns > 0 && per_iteration > 0) {
+                fprintf(out, "%.3f", log(per_iteration / previous_ns) / log((double)n / previous_nodes));
+            } else {
+                fprintf(out, "null");
+            }
+            previous_ns = per_iteration;
+            previous_nodes = n;
+            if (metrics) {
+                write_quality(out, &nodes, &graph, seed);
+            }
+            if (reorder) {
+                write_reordering(out, &nodes, &graph, &settings, iterations, cache_counter);
+            }
+            if (batch > 0) {
+                write_batch(out, kind, n, batch, max_iterations, seed, settings.pool);
+            }
+            if (convergence) {
+                write_convergence(out, &nodes, &graph, &settings, max_iterations, seed, metrics, metrics_every);
+            }
+            fprintf(out, "}");
+
+            nodes_free(&nodes);
+            graph_free(&graph);
+            fflush(out);
+        }
+    }
+    fprintf(out, "\n  ]\n}\n");
+
+    int failed = ferror(out);
+    if (out != stdout) {
+        failed |= fclose(out) != 0;
+    }
+    threadpool_destroy(settings.pool);
+    force_workspace_destroy(settings.workspace);
+#ifdef __linux__
+    if (cache_counter >= 0) close(cache_counter);
+#endif
+    return failed ? 1 : 0;
+}
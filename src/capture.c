@@ -0,0 +1,531 @@
+#include "capture.h"
+#include "profile.h"
+
+#include <errno.h>
+#include <math.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#define PNG_MAX_MATCH 258 // Longest deflate match
+#define PNG_MAX_DISTANCE 32768
+
+static const char *capture_format_names[CAPTURE_FORMAT_COUNT] = {"png", "ppm"};
+
+const char *capture_format_name(CaptureFormat format) {
+    return format >= 0 && format < CAPTURE_FORMAT_COUNT ? capture_format_names[format] : "unknown";
+}
+
+int capture_format_from_name(const char *name) {
+    for (int format = 0; format < CAPTURE_FORMAT_COUNT; format++) {
+        if (strcmp(name, capture_format_names[format]) == 0) return format;
+    }
+    return -1;
+}
+
+// A rendered frame waiting for the encoder. Frames are drawn in grey levels,
+// one byte per pixel, and widened to RGB only for PPM.
+typedef struct {
+    unsigned char *pixels;
+    int iteration;
+} CaptureSlot;
+
+struct Capture {
+    char *directory;
+    CaptureFormat format;
+    int width, height;
+    float scale, offset_x, offset_y; // Box to image
+    int node_radius;
+    int *disc_span;                  // Half width of the node disc per row, 2 * radius + 1 rows
+
+    // Ring of queue_size slots: the encoder owns slots[head], the producer
+    // draws into slots[(head + count) % queue_size] before counting it
+    CaptureSlot *slots;
+    int queue_size;
+    int head, count;
+    int stopping;
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t wake;
+    CaptureStats stats; // Guarded by lock
+
+    // Encoder thread only
+    unsigned char *raw;     // PNG scanlines with filter bytes, or one RGB row for PPM
+    unsigned char *encoded; // zlib stream, room for 9 bits per scanline byte
+    int reported_failure;
+};
+
+// ---- PNG ----
+
+static uint32_t crc_table[256];
+static pthread_once_t tables_once = PTHREAD_ONCE_INIT;
+
+static void init_crc_table(void) {
+    for (uint32_t n = 0; n < 256; n++) {
+        uint32_t c = n;
+        for (int k = 0; k < 8; k++) {
+            c = c & 1 ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+        }
+        crc_table[n] = c;
+    }
+}
+
+static uint32_t crc32_update(uint32_t crc, const unsigned char *data, size_t size) {
+    for (size_t i = 0; i < size; i++) {
+        crc = crc_table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+    }
+    return crc;
+}
+
+static uint32_t adler32(const unsigned char *data, size_t size) {
+    uint32_t a = 1, b = 0;
+    while (size > 0) {
+        size_t block = size < 5552 ? size : 5552; // Largest run without overflow before the modulo
+        size -= block;
+        while (block-- > 0) {
+            a += *data++;
+            b += a;
+        }
+        a %= 65521;
+        b %= 65521;
+    }
+    return b << 16 | a;
+}
+
+static void put_be32(unsigned char *p, uint32_t value) {
+    p[0] = (unsigned char)(value >> 24);
+    p[1] = (unsigned char)(value >> 16);
+    p[2] = (unsigned char)(value >> 8);
+    p[3] = (unsigned char)value;
+}
+
+// Deflate bit stream: values go in least significant bit first, Huffman
+// codes most significant bit first
+typedef struct {
+    unsigned char *out;
+    size_t size;
+    uint64_t bits;
+    int count;
+} BitWriter;
+
+static inline void put_bits(BitWriter *w, uint32_t value, int n) {
+    w->bits |= (uint64_t)value << w->count;
+    w->count += n;
+    while (w->count >= 8) {
+        w->out[w->size++] = (unsigned char)w->bits;
+        w->bits >>= 8;
+        w->count -= 8;
+    }
+}
+
+static uint32_t reverse_bits(uint32_t code, int n) {
+    uint32_t reversed = 0;
+    for (int i = 0; i < n; i++) {
+        reversed = reversed << 1 | (code >> i & 1);
+    }
+    return reversed;
+}
+
+// Fixed Huffman codes of the literal/length symbols (RFC 1951, 3.2.6) and
+// the distance codes, bit-reversed once for put_bits
+static uint16_t symbol_code[288];
+static unsigned char symbol_bits[288];
+static uint16_t distance_code[30];
+
+static void init_fixed_codes(void) {
+    for (int symbol = 0; symbol < 288; symbol++) {
+        uint32_t code;
+        int bits;
+        if (symbol < 144) {
+            code = 0x30 + (uint32_t)symbol, bits = 8;
+        } else if (symbol < 256) {
+            code = 0x190 + (uint32_t)(symbol - 144), bits = 9;
+        } else if (symbol < 280) {
+            code = (uint32_t)(symbol - 256), bits = 7;
+        } else {
+            code = 0xC0 + (uint32_t)(symbol - 280), bits = 8;
+        }
+        symbol_code[symbol] = (uint16_t)reverse_bits(code, bits);
+        symbol_bits[symbol] = (unsigned char)bits;
+    }
+    for (int d = 0; d < 30; d++) {
+        distance_code[d] = (uint16_t)reverse_bits((uint32_t)d, 5);
+    }
+}
+
+static void init_tables(void) {
+    init_crc_table();
+    init_fixed_codes();
+}
+
+static inline void put_symbol(BitWriter *w, int symbol) {
+    put_bits(w, symbol_code[symbol], symbol_bits[symbol]);
+}
+
+static const int length_base[29] = {3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+                                    35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258};
+static const int length_extra[29] = {0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+                                     3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0};
+static const int distance_base[30] = {1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129,
+                                      193, 257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577};
+static const int distance_extra[30] = {0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6,
+                                       6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13};
+
+static void put_match(BitWriter *w, int length, int distance) {
+    int l = 28;
+    while (length_base[l] > length) l--;
+    put_symbol(w, 257 + l);
+    put_bits(w, (uint32_t)(length - length_base[l]), length_extra[l]);
+    int d = 29;
+    while (distance_base[d] > distance) d--;
+    put_bits(w, distance_code[d], 5);
+    put_bits(w, (uint32_t)(distance - distance_base[d]), distance_extra[d]);
+}
+
+static int match_length(const unsigned char *in, size_t i, size_t size, size_t distance) {
+    if (i < distance) return 0;
+    size_t limit = size - i < PNG_MAX_MATCH ? size - i : PNG_MAX_MATCH;
+    size_t n = 0;
+    while (n < limit && in[i + n] == in[i + n - distance]) n++;
+    return (int)n;
+}
+
+// One fixed-Huffman block. Rendered frames are mostly flat background, so
+// the only matches tried are a run of the previous byte and the same
+// columns of the row above; that finds nearly all of the redundancy at a
+// small fraction of the cost of a general LZ77 search. `out` needs room for
+// 9 bits per input byte.
+static size_t deflate_rows(const unsigned char *in, size_t size, size_t stride, unsigned char *out) {
+    BitWriter w = {out, 0, 0, 0};
+    put_bits(&w, 1, 1); // Final block
+    put_bits(&w, 1, 2); // Fixed Huffman codes
+    size_t i = 0;
+    while (i < size) {
+        int run = match_length(in, i, size, 1);
+        int above = stride <= PNG_MAX_DISTANCE ? match_length(in, i, size, stride) : 0;
+        if (above >= 3 && above >= run) {
+            put_match(&w, above, (int)stride);
+            i += (size_t)above;
+        } else if (run >= 3) {
+            put_match(&w, run, 1);
+            i += (size_t)run;
+        } else {
+            put_symbol(&w, in[i++]);
+        }
+    }
+    put_symbol(&w, 256); // End of block
+    put_bits(&w, 0, 7);  // Flush the last partial byte
+    return w.size;
+}
+
+static int write_chunk(FILE *file, const char *type, const unsigned char *data, size_t size) {
+    unsigned char header[8];
+    put_be32(header, (uint32_t)size);
+    memcpy(header + 4, type, 4);
+    uint32_t crc = crc32_update(0xFFFFFFFFu, header + 4, 4);
+    crc = crc32_update(crc, data, size) ^ 0xFFFFFFFFu;
+    unsigned char trailer[4];
+    put_be32(trailer, crc);
+    return fwrite(header, 1, 8, file) == 8 && (size == 0 || fwrite(data, 1, size, file) == size) &&
+           fwrite(trailer, 1, 4, file) == 4;
+}
+
+// 8-bit greyscale PNG
+static int write_png(Capture *capture, FILE *file, const unsigned char *pixels) {
+    int w = capture->width, h = capture->height;
+    size_t stride = (size_t)w + 1;
+    for (int row = 0; row < h; row++) {
+        capture->raw[row * stride] = 0; // Filter type None
+        memcpy(capture->raw + row * stride + 1, pixels + (size_t)row * w, (size_t)w);
+    }
+    size_t size = stride * h;
+
+    unsigned char *z = capture->encoded;
+    z[0] = 0x78; // Deflate, 32K window
+    z[1] = 0x01;
+    size_t length = 2 + deflate_rows(capture->raw, size, stride, z + 2);
+    put_be32(z + length, adler32(capture->raw, size));
+    length += 4;
+
+    static const unsigned char signature[8] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n'};
+    unsigned char ihdr[13];
+    put_be32(ihdr, (uint32_t)w);
+    put_be32(ihdr + 4, (uint32_t)h);
+    ihdr[8] = 8;  // Bit depth
+    ihdr[9] = 0;  // Greyscale
+    ihdr[10] = 0; // Compression, filter and interlace methods
+    ihdr[11] = 0;
+    ihdr[12] = 0;
+    return fwrite(signature, 1, 8, file) == 8 && write_chunk(file, "IHDR", ihdr, sizeof(ihdr)) &&
+           write_chunk(file, "IDAT", z, length) && write_chunk(file, "IEND", NULL, 0);
+}
+
+// Binary PPM, grey widened to RGB
+static int write_ppm(Capture *capture, FILE *file, const unsigned char *pixels) {
+    int w = capture->width;
+    if (fprintf(file, "P6\n%d %d\n255\n", w, capture->height) < 0) return 0;
+    for (int row = 0; row < capture->height; row++) {
+        const unsigned char *grey = pixels + (size_t)row * w;
+        for (int column = 0; column < w; column++) {
+            memset(capture->raw + 3 * column, grey[column], 3);
+        }
+        if (fwrite(capture->raw, 3, (size_t)w, file) != (size_t)w) return 0;
+    }
+    return 1;
+}
+
+// ---- Encoder thread ----
+
+static void encode(Capture *capture, const CaptureSlot *slot) {
+    double start = layout_seconds();
+    char path[4096];
+    snprintf(path, sizeof(path), "%s/frame_%06d.%s", capture->directory, slot->iteration,
+             capture_format_name(capture->format));
+    FILE *file = fopen(path, "wb");
+    int ok = file != NULL;
+    if (ok) {
+        ok = capture->format == CAPTURE_PNG ? write_png(capture, file, slot->pixels) : write_ppm(capture, file, slot->pixels);
+        ok = ok && ftell(file) >= 0;
+    }
+    double bytes = ok ? (double)ftell(file) : 0.0;
+    if (file != NULL && fclose(file) != 0) {
+        ok = 0;
+    }
+    if (!ok && !capture->reported_failure) {
+        printf("capture: cannot write %s\n", path);
+        capture->reported_failure = 1;
+    }
+    double end = layout_seconds();
+    profile_record("encode", start, end);
+
+    pthread_mutex_lock(&capture->lock);
+    if (ok) {
+        capture->stats.written++;
+        capture->stats.bytes += bytes;
+    } else {
+        capture->stats.failed++;
+    }
+    capture->stats.encode_seconds += end - start;
+    pthread_mutex_unlock(&capture->lock);
+}
+
+static void *encoder_main(void *arg) {
+    Capture *capture = arg;
+    profile_thread_name("capture encoder");
+    pthread_mutex_lock(&capture->lock);
+    for (;;) {
+        while (capture->count == 0 && !capture->stopping) {
+            pthread_cond_wait(&capture->wake, &capture->lock);
+        }
+        if (capture->count == 0) break; // Stopping and drained
+        CaptureSlot *slot = &capture->slots[capture->head];
+        pthread_mutex_unlock(&capture->lock);
+
+        encode(capture, slot);
+
+        pthread_mutex_lock(&capture->lock);
+        capture->head = (capture->head + 1) % capture->queue_size;
+        capture->count--;
+    }
+    pthread_mutex_unlock(&capture->lock);
+    return NULL;
+}
+
+// ---- Rendering ----
+
+static inline void shade(unsigned char *pixel) {
+    *pixel = (unsigned char)(*pixel * (int)(CAPTURE_EDGE_SHADE * 256.0f) >> 8);
+}
+
+// One pixel wide line, every pixel darkened once
+static void draw_line(const Capture *capture, unsigned char *pixels, float x0, float y0, float x1, float y1) {
+    float dx = x1 - x0, dy = y1 - y0;
+    int steps = (int)fmaxf(fabsf(dx), fabsf(dy));
+    float sx = steps > 0 ? dx / steps : 0.0f, sy = steps > 0 ? dy / steps : 0.0f;
+    float x = x0 + 0.5f, y = y0 + 0.5f;
+    for (int s = 0; s <= steps; s++, x += sx, y += sy) {
+        int px = (int)x, py = (int)y;
+        if (px >= 0 && py >= 0 && px < capture->width && py < capture->height) {
+            shade(&pixels[(size_t)py * capture->width + px]);
+        }
+    }
+}
+
+static void draw_node(const Capture *capture, unsigned char *pixels, float x, float y) {
+    int cx = (int)(x + 0.5f), cy = (int)(y + 0.5f), r = capture->node_radius;
+    for (int dy = -r; dy <= r; dy++) {
+        int py = cy + dy;
+        if (py < 0 || py >= capture->height) continue;
+        int half = capture->disc_span[dy + r];
+        int begin = cx - half < 0 ? 0 : cx - half;
+        int end = cx + half >= capture->width ? capture->width - 1 : cx + half;
+        if (begin <= end) {
+            memset(pixels + (size_t)py * capture->width + begin, 0, (size_t)(end - begin + 1));
+        }
+    }
+}
+
+static void render(const Capture *capture, unsigned char *pixels, const float *x, const float *y, int num_nodes,
+                   const Edge *edges, int num_edges) {
+    memset(pixels, 0xFF, (size_t)capture->width * capture->height);
+    float scale = capture->scale, ox = capture->offset_x, oy = capture->offset_y;
+    for (int e = 0; e < num_edges; e++) {
+        int a = edges[e].from, b = edges[e].to;
+        draw_line(capture, pixels, x[a] * scale + ox, y[a] * scale + oy, x[b] * scale + ox, y[b] * scale + oy);
+    }
+    for (int i = 0; i < num_nodes; i++) {
+        draw_node(capture, pixels, x[i] * scale + ox, y[i] * scale + oy);
+    }
+}
+
+// Draw a frame into the next free slot and queue it, or drop it if the
+// encoder has fallen queue_size frames behind. Returns 1 if queued.
+int capture_frame(Capture *capture, int iteration, const float *x, const float *y, int num_nodes, const Edge *edges,
+                  int num_edges) {
+    pthread_mutex_lock(&capture->lock);
+    capture->stats.submitted++;
+    if (capture->count == capture->queue_size) {
+        capture->stats.dropped++;
+        pthread_mutex_unlock(&capture->lock);
+        return 0;
+    }
+    CaptureSlot *slot = &capture->slots[(capture->head + capture->count) % capture->queue_size];
+    pthread_mutex_unlock(&capture->lock);
+
+    double start = layout_seconds();
+    render(capture, slot->pixels, x, y, num_nodes, edges, num_edges);
+    slot->iteration = iteration;
+    double end = layout_seconds();
+    profile_record("capture", start, end);
+
+    pthread_mutex_lock(&capture->lock);
+    capture->count++;
+    if (capture->count > capture->stats.queue_peak) {
+        capture->stats.queue_peak = capture->count;
+    }
+    capture->stats.render_seconds += end - start;
+    pthread_cond_signal(&capture->wake);
+    pthread_mutex_unlock(&capture->lock);
+    return 1;
+}
+
+// ---- Lifetime ----
+
+static void capture_free(Capture *capture) {
+    if (capture->slots != NULL) {
+        for (int i = 0; i < capture->queue_size; i++) {
+            free(capture->slots[i].pixels);
+        }
+    }
+    free(capture->slots);
+    free(capture->disc_span);
+    free(capture->raw);
+    free(capture->encoded);
+    free(capture->directory);
+    free(capture);
+}
+
+// Start the encoder thread. The box maps onto the image centred, keeping its
+// aspect ratio. The directory is created if it does not exist.
+Capture *capture_create(const char *directory, CaptureFormat format, int width, int height, int queue_size) {
+    if (width <= 0 || height <= 0 || width > 16384 || height > 16384 || queue_size <= 0) {
+        printf("capture: invalid size %dx%d or queue %d\n", width, height, queue_size);
+        return NULL;
+    }
+    if (mkdir(directory, 0777) != 0 && errno != EEXIST) {
+        printf("capture: cannot create %s\n", directory);
+        return NULL;
+    }
+    pthread_once(&tables_once, init_tables);
+
+    Capture *capture = calloc(1, sizeof(Capture));
+    if (capture == NULL) {
+        printf("capture: out of memory\n");
+        return NULL;
+    }
+    capture->format = format;
+    capture->width = width;
+    capture->height = height;
+    capture->queue_size = queue_size;
+    capture->stats.queue_size = queue_size;
+    float scale_x = (float)width / BOX_WIDTH, scale_y = (float)height / BOX_HEIGHT;
+    capture->scale = fminf(scale_x, scale_y);
+    capture->offset_x = (width - BOX_WIDTH * capture->scale) * 0.5f - BOX_MARGIN * capture->scale;
+    capture->offset_y = (height - BOX_HEIGHT * capture->scale) * 0.5f - BOX_MARGIN * capture->scale;
+    float default_scale = fminf((float)CAPTURE_DEFAULT_WIDTH / BOX_WIDTH, (float)CAPTURE_DEFAULT_HEIGHT / BOX_HEIGHT);
+    int r = (int)lroundf(CAPTURE_NODE_RADIUS * capture->scale / default_scale);
+    capture->node_radius = r > 1 ? r : 1;
+
+    size_t pixels = (size_t)width * height;
+    size_t raw = ((size_t)width + 1) * height;
+    capture->directory = strdup(directory);
+    capture->slots = calloc((size_t)queue_size, sizeof(CaptureSlot));
+    capture->disc_span = malloc((2 * (size_t)capture->node_radius + 1) * sizeof(int));
+    capture->raw = malloc(raw > 3 * (size_t)width ? raw : 3 * (size_t)width);
+    capture->encoded = malloc(raw / 8 * 9 + 64);
+    int ok = capture->directory != NULL && capture->slots != NULL && capture->disc_span != NULL && capture->raw != NULL &&
+             capture->encoded != NULL;
+    for (int i = 0; ok && i < queue_size; i++) {
+        capture->slots[i].pixels = malloc(pixels);
+        ok = capture->slots[i].pixels != NULL;
+    }
+    if (!ok) {
+        printf("capture: out of memory for %d frames of %dx%d\n", queue_size, width, height);
+        capture_free(capture);
+        return NULL;
+    }
+    for (int dy = -capture->node_radius; dy <= capture->node_radius; dy++) {
+        capture->disc_span[dy + capture->node_radius] =
+            (int)sqrtf((float)(capture->node_radius * capture->node_radius - dy * dy) + 0.5f);
+    }
+
+    pthread_mutex_init(&capture->lock, NULL);
+    pthread_cond_init(&capture->wake, NULL);
+    if (pthread_create(&capture->thread, NULL, encoder_main, capture) != 0) {
+        printf("capture: cannot start the encoder thread\n");
+        pthread_mutex_destroy(&capture->lock);
+        pthread_cond_destroy(&capture->wake);
+        capture_free(capture);
+        return NULL;
+    }
+    return capture;
+}
+
+void capture_stats(Capture *capture, CaptureStats *stats) {
+    pthread_mutex_lock(&capture->lock);
+    *stats = capture->stats;
+    pthread_mutex_unlock(&capture->lock);
+}
+
+// Write out the frames still queued, stop the encoder and free everything.
+// Returns -1 if any frame could not be written.
+int capture_finish(Capture *capture, CaptureStats *stats) {
+    pthread_mutex_lock(&capture->lock);
+    capture->stopping = 1;
+    pthread_cond_signal(&capture->wake);
+    pthread_mutex_unlock(&capture->lock);
+    pthread_join(capture->thread, NULL);
+    pthread_mutex_destroy(&capture->lock);
+    pthread_cond_destroy(&capture->wake);
+
+    if (stats != NULL) {
+        *stats = capture->stats;
+    }
+    int failed = capture->stats.failed > 0;
+    capture_free(capture);
+    return failed ? -1 : 0;
+}
+
+void capture_print_stats(const CaptureStats *stats) {
+    long rendered = stats->submitted - stats->dropped;
+    printf("Capture: %ld frames written, %ld dropped, %ld failed; queue peak %d of %d\n",
+           stats->written, stats->dropped, stats->failed, stats->queue_peak, stats->queue_size);
+    if (rendered > 0) {
+        printf("Capture: %.2f ms render, %.2f ms encode per frame, %.1f KB per frame\n",
+               stats->render_seconds * 1000.0 / rendered, stats->encode_seconds * 1000.0 / rendered,
+               stats->written > 0 ? stats->bytes / 1024.0 / stats->written : 0.0);
+    }
+}
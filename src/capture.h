@@ -0,0 +1,47 @@
+#ifndef CAPTURE_H
+#define CAPTURE_H
+
+#include "layout.h"
+
+#define CAPTURE_DEFAULT_WIDTH 1080
+#define CAPTURE_DEFAULT_HEIGHT 860
+#define CAPTURE_DEFAULT_QUEUE 16 // Frames rendered ahead of the encoder before new ones are dropped
+#define CAPTURE_NODE_RADIUS 3    // Pixels at the default size, scaled with the image
+#define CAPTURE_EDGE_SHADE 0.6f  // Fraction of the light an edge pixel keeps, overlaps get darker
+
+typedef enum {
+    CAPTURE_PNG,
+    CAPTURE_PPM,
+    CAPTURE_FORMAT_COUNT
+} CaptureFormat;
+
+typedef struct {
+    long submitted;        // Frames offered to capture_frame
+    long written;
+    long dropped;          // Queue was full, the encoder is behind
+    long failed;           // Could not be written
+    int queue_peak;        // Most frames waiting at once
+    int queue_size;
+    double render_seconds; // Totals, on the producing thread
+    double encode_seconds; // and on the encoder thread, including the writes
+    double bytes;
+} CaptureStats;
+
+// Offscreen frame export. capture_frame draws the layout into a free slot of
+// a bounded queue on the calling thread and returns at once; a background
+// thread encodes the queued frames and writes DIRECTORY/frame_NNNNNN.png (or
+// .ppm), numbered by iteration. When every slot is taken the frame is dropped
+// and counted instead of waiting, so the caller never blocks on the disk.
+typedef struct Capture Capture;
+
+Capture *capture_create(const char *directory, CaptureFormat format, int width, int height, int queue_size);
+int capture_frame(Capture *capture, int iteration, const float *x, const float *y, int num_nodes, const Edge *edges,
+                  int num_edges);
+void capture_stats(Capture *capture, CaptureStats *stats);
+int capture_finish(Capture *capture, CaptureStats *stats);
+void capture_print_stats(const CaptureStats *stats);
+
+int capture_format_from_name(const char *name);
+const char *capture_format_name(CaptureFormat format);
+
+#endif
@@ -0,0 +1,250 @@
+#include "checkpoint.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+_Static_assert(sizeof(CheckpointHeader) == 160, "checkpoint header layout");
+_Static_assert(sizeof(Edge) == 2 * sizeof(int32_t), "edges are stored as int32 pairs");
+
+// The format is little-endian and the sections are used in place, so only
+// little-endian hosts can read or write it
+static int little_endian(void) {
+    const uint16_t probe = 1;
+    return *(const unsigned char *)&probe == 1;
+}
+
+static uint64_t align_up(uint64_t value) {
+    return (value + CHECKPOINT_ALIGNMENT - 1) / CHECKPOINT_ALIGNMENT * CHECKPOINT_ALIGNMENT;
+}
+
+// Length of the names pool: it ends after the name of the last node
+static size_t name_pool_size(const Graph *graph) {
+    if (graph->name_pool == NULL || graph->num_nodes == 0) return 0;
+    const char *last = graph->name_pool + graph->name_offsets[graph->num_nodes - 1];
+    return (size_t)(last - graph->name_pool) + strlen(last) + 1;
+}
+
+// Write to a temporary file next to `path` and rename it over, so a reader
+// or a crash never sees a half-written checkpoint
+int checkpoint_write(const char *path, const Graph *graph, const Nodes *nodes, const Cooling *cooling, int iteration,
+                     uint64_t rng_state) {
+    if (!little_endian()) {
+        printf("checkpoint: only little-endian hosts are supported\n");
+        return -1;
+    }
+    size_t n = (size_t)graph->num_nodes;
+    const void *data[CHECKPOINT_SECTIONS] = {
+        graph->offsets, graph->adjacency, graph->edges, graph->name_offsets, graph->name_pool,
+        nodes->x, nodes->y, nodes->z, nodes->still
+    };
+    size_t pool = name_pool_size(graph);
+    uint64_t lengths[CHECKPOINT_SECTIONS] = {
+        (n + 1) * sizeof(int32_t), (uint64_t)graph->offsets[n] * sizeof(int32_t), (uint64_t)graph->num_edges * sizeof(Edge),
+        pool > 0 ? n * sizeof(int32_t) : 0, pool,
+        n * sizeof(float), n * sizeof(float), nodes->dimensions == 3 ? n * sizeof(float) : 0, n
+    };
+
+    CheckpointHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, CHECKPOINT_MAGIC, sizeof(header.magic));
+    header.version = CHECKPOINT_VERSION;
+    header.header_size = sizeof(header);
+    header.dimensions = (uint32_t)nodes->dimensions;
+    header.num_nodes = (uint32_t)n;
+    header.num_edges = (uint32_t)graph->num_edges;
+    header.iteration = (uint32_t)iteration;
+    header.schedule = (uint32_t)cooling->schedule;
+    header.progress = cooling->progress;
+    header.temperature = cooling->temperature;
+    header.start_temperature = cooling->start_temperature;
+    header.factor = cooling->factor;
+    header.energy = cooling->energy;
+    header.rng_state = rng_state;
+    header.name_pool_size = pool;
+    uint64_t offset = align_up(sizeof(header));
+    for (int s = 0; s < CHECKPOINT_SECTIONS; s++) {
+        if (lengths[s] == 0) continue;
+        header.sections[s] = offset;
+        offset = align_up(offset + lengths[s]);
+    }
+    header.file_size = offset;
+
+    size_t path_length = strlen(path);
+    char *temporary = malloc(path_length + 5);
+    if (temporary == NULL) {
+        printf("checkpoint: out of memory\n");
+        return -1;
+    }
+    memcpy(temporary, path, path_length);
+    memcpy(temporary + path_length, ".tmp", 5);
+    FILE *file = fopen(temporary, "wb");
+    if (file == NULL) {
+        printf("checkpoint: cannot open %s for writing\n", temporary);
+        free(temporary);
+        return -1;
+    }
+
+    static const char zeros[CHECKPOINT_ALIGNMENT];
+    int failed = fwrite(&header, sizeof(header), 1, file) != 1;
+    uint64_t written = sizeof(header);
+    for (int s = 0; s < CHECKPOINT_SECTIONS && !failed; s++) {
+        if (lengths[s] == 0) continue;
+        failed = fwrite(zeros, 1, header.sections[s] - written, file) != header.sections[s] - written ||
+                 fwrite(data[s], 1, lengths[s], file) != lengths[s];
+        written = header.sections[s] + lengths[s];
+    }
+    failed = failed || fwrite(zeros, 1, header.file_size - written, file) != header.file_size - written;
+    failed |= fclose(file) != 0;
+    if (!failed && rename(temporary, path) != 0) {
+        failed = 1;
+    }
+    if (failed) {
+        printf("checkpoint: cannot write %s\n", path);
+        remove(temporary);
+    }
+    free(temporary);
+    return failed ? -1 : 0;
+}
+
+// Section s of the mapping if it lies inside the file and is aligned, else NULL
+static const void *section(const Checkpoint *checkpoint, const CheckpointHeader *header, int s, uint64_t length) {
+    uint64_t offset = header->sections[s];
+    if (offset == 0 || offset % CHECKPOINT_ALIGNMENT != 0 || offset > checkpoint->size ||
+        length > checkpoint->size - offset) {
+        return NULL;
+    }
+    return (const char *)checkpoint->base + offset;
+}
+
+// Structural checks, linear in the graph, so a corrupt file cannot make the
+// layout index out of bounds
+static int valid_graph(const Graph *graph) {
+    int n = graph->num_nodes;
+    if (graph->offsets[0] != 0 || graph->offsets[n] != 2 * graph->num_edges) return 0;
+    for (int v = 0; v < n; v++) {
+        if (graph->offsets[v] > graph->offsets[v + 1]) return 0;
+    }
+    for (int k = 0; k < 2 * graph->num_edges; k++) {
+        if ((unsigned)graph->adjacency[k] >= (unsigned)n) return 0;
+    }
+    for (int e = 0; e < graph->num_edges; e++) {
+        if ((unsigned)graph->edges[e].from >= (unsigned)n || (unsigned)graph->edges[e].to >= (unsigned)n) return 0;
+    }
+    return 1;
+}
+
+// Map a checkpoint and point the graph and positions into it
+int checkpoint_open(Checkpoint *checkpoint, const char *path) {
+    memset(checkpoint, 0, sizeof(*checkpoint));
+    if (!little_endian()) {
+        printf("checkpoint: only little-endian hosts are supported\n");
+        return -1;
+    }
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        printf("checkpoint: cannot open %s\n", path);
+        return -1;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(CheckpointHeader)) {
+        printf("checkpoint: %s is not a checkpoint\n", path);
+        close(fd);
+        return -1;
+    }
+    void *base = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (base == MAP_FAILED) {
+        printf("checkpoint: cannot map %s\n", path);
+        return -1;
+    }
+    checkpoint->base = base;
+    checkpoint->size = (size_t)st.st_size;
+
+    const CheckpointHeader *header = base;
+    if (memcmp(header->magic, CHECKPOINT_MAGIC, sizeof(header->magic)) != 0) {
+        printf("checkpoint: %s is not a checkpoint\n", path);
+        checkpoint_close(checkpoint);
+        return -1;
+    }
+    if (header->version != CHECKPOINT_VERSION || header->header_size != sizeof(CheckpointHeader)) {
+        printf("checkpoint: %s has version %u, expected %d\n", path, header->version, CHECKPOINT_VERSION);
+        checkpoint_close(checkpoint);
+        return -1;
+    }
+
+    uint64_t n = header->num_nodes, m = header->num_edges;
+    int dimensions = (int)header->dimensions;
+    Graph *graph = &checkpoint->graph;
+    int ok = (dimensions == 2 || dimensions == 3) && n <= INT32_MAX - 1 && m <= INT32_MAX / 2 &&
+             header->file_size == checkpoint->size;
+    if (ok) {
+        graph->num_nodes = (int)n;
+        graph->num_edges = (int)m;
+        graph->offsets = (int *)section(checkpoint, header, CHECKPOINT_OFFSETS, (n + 1) * sizeof(int32_t));
+        graph->adjacency = m > 0 ? (int *)section(checkpoint, header, CHECKPOINT_ADJACENCY, 2 * m * sizeof(int32_t)) : NULL;
+        graph->edges = m > 0 ? (Edge *)section(checkpoint, header, CHECKPOINT_EDGES, m * sizeof(Edge)) : NULL;
+        ok = graph->offsets != NULL && (m == 0 || (graph->adjacency != NULL && graph->edges != NULL));
+    }
+    if (ok && header->name_pool_size > 0) {
+        graph->name_offsets = (int *)section(checkpoint, header, CHECKPOINT_NAME_OFFSETS, n * sizeof(int32_t));
+        graph->name_pool = (char *)section(checkpoint, header, CHECKPOINT_NAME_POOL, header->name_pool_size);
+        ok = graph->name_offsets != NULL && graph->name_pool != NULL && graph->name_pool[header->name_pool_size - 1] == '\0';
+        for (uint64_t v = 0; ok && v < n; v++) {
+            ok = (uint64_t)graph->name_offsets[v] < header->name_pool_size;
+        }
+    }
+    if (ok && n > 0) {
+        checkpoint->x = section(checkpoint, header, CHECKPOINT_X, n * sizeof(float));
+        checkpoint->y = section(checkpoint, header, CHECKPOINT_Y, n * sizeof(float));
+        checkpoint->z = dimensions == 3 ? section(checkpoint, header, CHECKPOINT_Z, n * sizeof(float)) : NULL;
+        checkpoint->still = section(checkpoint, header, CHECKPOINT_STILL, n);
+        ok = checkpoint->x != NULL && checkpoint->y != NULL && (dimensions == 2 || checkpoint->z != NULL) &&
+             checkpoint->still != NULL;
+    }
+    if (!ok || !valid_graph(graph)) {
+        printf("checkpoint: %s is damaged\n", path);
+        checkpoint_close(checkpoint);
+        return -1;
+    }
+    graph->borrowed = 1;
+
+    checkpoint->dimensions = dimensions;
+    checkpoint->iteration = (int)header->iteration;
+    checkpoint->rng_state = header->rng_state;
+    Cooling *cooling = &checkpoint->cooling;
+    cooling->schedule = header->schedule == SCHEDULE_FIXED ? SCHEDULE_FIXED : SCHEDULE_ADAPTIVE;
+    cooling->temperature = header->temperature;
+    cooling->start_temperature = header->start_temperature;
+    cooling->factor = header->factor;
+    cooling->energy = header->energy;
+    cooling->progress = header->progress;
+    return 0;
+}
+
+// Working copy of the positions and stillness counters for resuming; the
+// layout moves nodes every iteration, so these cannot stay in the mapping
+int checkpoint_restore(const Checkpoint *checkpoint, Nodes *nodes) {
+    int n = checkpoint->graph.num_nodes;
+    if (nodes_alloc_dimensions(nodes, n, checkpoint->dimensions) != 0) {
+        return -1;
+    }
+    memcpy(nodes->x, checkpoint->x, (size_t)n * sizeof(float));
+    memcpy(nodes->y, checkpoint->y, (size_t)n * sizeof(float));
+    if (checkpoint->z != NULL) {
+        memcpy(nodes->z, checkpoint->z, (size_t)n * sizeof(float));
+    }
+    memcpy(nodes->still, checkpoint->still, (size_t)n);
+    return 0;
+}
+
+void checkpoint_close(Checkpoint *checkpoint) {
+    if (checkpoint->base != NULL) {
+        munmap(checkpoint->base, checkpoint->size);
+    }
+    memset(checkpoint, 0, sizeof(*checkpoint));
+}
@@ -0,0 +1,74 @@
+#ifndef CHECKPOINT_H
+#define CHECKPOINT_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "layout.h"
+#include "graph.h"
+#include "cooling.h"
+
+#define CHECKPOINT_MAGIC "FRLAYOUT"
+#define CHECKPOINT_VERSION 1
+#define CHECKPOINT_ALIGNMENT 64 // Every section starts on a multiple of this many bytes
+
+// Sections of a checkpoint file, in file order
+typedef enum {
+    CHECKPOINT_OFFSETS,      // int32, num_nodes + 1
+    CHECKPOINT_ADJACENCY,    // int32, 2 * num_edges
+    CHECKPOINT_EDGES,        // int32 pairs (from < to), num_edges
+    CHECKPOINT_NAME_OFFSETS, // int32, num_nodes; absent without names
+    CHECKPOINT_NAME_POOL,    // NUL-terminated names, name_pool_size bytes
+    CHECKPOINT_X,            // float32, num_nodes
+    CHECKPOINT_Y,
+    CHECKPOINT_Z,            // 3D only
+    CHECKPOINT_STILL,        // uint8 stillness counters, num_nodes
+    CHECKPOINT_SECTIONS
+} CheckpointSection;
+
+// File header, little-endian, followed by the sections. Offsets are from the
+// start of the file and 0 for absent sections. Readers reject other versions.
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t header_size;
+    uint32_t dimensions;
+    uint32_t num_nodes;
+    uint32_t num_edges;
+    uint32_t iteration;      // Iterations completed
+    uint32_t schedule;       // Cooling state, see cooling.h
+    int32_t progress;
+    float temperature;
+    float start_temperature;
+    float factor;
+    uint32_t reserved;
+    double energy;
+    uint64_t rng_state;
+    uint64_t name_pool_size;
+    uint64_t file_size;
+    uint64_t sections[CHECKPOINT_SECTIONS];
+} CheckpointHeader;
+
+// An open checkpoint. The file is mapped read-only and nothing is copied:
+// the graph and positions point straight into the mapping, so they stay valid
+// until checkpoint_close. The graph is marked borrowed and copied to the heap
+// by the first edit.
+typedef struct {
+    void *base;
+    size_t size;
+    int dimensions;
+    int iteration;
+    Cooling cooling;
+    uint64_t rng_state;
+    Graph graph;
+    const float *x, *y, *z;
+    const unsigned char *still;
+} Checkpoint;
+
+int checkpoint_write(const char *path, const Graph *graph, const Nodes *nodes, const Cooling *cooling, int iteration,
+                     uint64_t rng_state);
+int checkpoint_open(Checkpoint *checkpoint, const char *path);
+int checkpoint_restore(const Checkpoint *checkpoint, Nodes *nodes);
+void checkpoint_close(Checkpoint *checkpoint);
+
+#endif
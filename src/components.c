@@ -0,0 +1,374 @@
+#include "components.h"
+#include "forces.h"
+#include "layout_dim.h"
+#include "threadpool.h"
+#include "rng.h"
+
+#include <math.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Union-find root with path halving
+static int find_root(int *parent, int v) {
+    while (parent[v] != v) {
+        parent[v] = parent[parent[v]];
+        v = parent[v];
+    }
+    return v;
+}
+
+typedef struct {
+    int size;
+    int first; // Smallest node id, breaks ties so the numbering is stable
+    int root;
+} ComponentKey;
+
+static int compare_components(const void *a, const void *b) {
+    const ComponentKey *p = a, *q = b;
+    if (p->size != q->size) return p->size > q->size ? -1 : 1;
+    return (p->first > q->first) - (p->first < q->first);
+}
+
+// Union by size over the edge list, then a counting sort of the nodes by component
+int components_find(Components *components, const Graph *graph) {
+    memset(components, 0, sizeof(*components));
+    int n = graph->num_nodes;
+    int *parent = malloc((size_t)(n > 0 ? n : 1) * sizeof(int));
+    int *size = malloc((size_t)(n > 0 ? n : 1) * sizeof(int));
+    components->component = malloc((size_t)(n > 0 ? n : 1) * sizeof(int));
+    components->order = malloc((size_t)(n > 0 ? n : 1) * sizeof(int));
+    ComponentKey *keys = NULL;
+    int ok = parent != NULL && size != NULL && components->component != NULL && components->order != NULL;
+    if (ok) {
+        for (int v = 0; v < n; v++) {
+            parent[v] = v;
+            size[v] = 1;
+        }
+        for (int e = 0; e < graph->num_edges; e++) {
+            int a = find_root(parent, graph->edges[e].from), b = find_root(parent, graph->edges[e].to);
+            if (a == b) continue;
+            if (size[a] < size[b]) {
+                int t = a;
+                a = b;
+                b = t;
+            }
+            parent[b] = a;
+            size[a] += size[b];
+        }
+
+        // Roots are visited at their smallest member first, so `first` is that member
+        int count = 0;
+        for (int v = 0; v < n; v++) {
+            if (find_root(parent, v) == v) count++;
+        }
+        keys = malloc((size_t)(count > 0 ? count : 1) * sizeof(ComponentKey));
+        components->offsets = malloc(((size_t)count + 1) * sizeof(int));
+        ok = keys != NULL && components->offsets != NULL;
+        if (ok) {
+            int *first = components->order; // Scratch: smallest member of each root
+            for (int v = 0; v < n; v++) first[v] = -1;
+            count = 0;
+            for (int v = 0; v < n; v++) {
+                int root = find_root(parent, v);
+                if (first[root] < 0) {
+                    first[root] = v;
+                    keys[count++] = (ComponentKey){size[root], v, root};
+                }
+            }
+            qsort(keys, (size_t)count, sizeof(ComponentKey), compare_components);
+            components->count = count;
+
+            // size[] becomes root -> component id
+            components->offsets[0] = 0;
+            for (int c = 0; c < count; c++) {
+                components->offsets[c + 1] = components->offsets[c] + keys[c].size;
+                size[keys[c].root] = c;
+            }
+            int *cursor = parent; // Roots are resolved first, then parent is reused for cursors
+            for (int v = 0; v < n; v++) {
+                components->component[v] = size[find_root(parent, v)];
+            }
+            memcpy(cursor, components->offsets, (size_t)count * sizeof(int));
+            for (int v = 0; v < n; v++) {
+                components->order[cursor[components->component[v]]++] = v;
+            }
+        }
+    }
+    free(parent);
+    free(size);
+    free(keys);
+    if (!ok) {
+        printf("components: out of memory (%d nodes)\n", n);
+        components_free(components);
+        return -1;
+    }
+    return 0;
+}
+
+void components_free(Components *components) {
+    free(components->component);
+    free(components->order);
+    free(components->offsets);
+    memset(components, 0, sizeof(*components));
+}
+
+// Shared by the workers; component c works on slots offsets[c] .. offsets[c + 1]
+// of `scratch` and on edges[edge_offsets[c] .. edge_offsets[c + 1])
+typedef struct {
+    const Components *components;
+    const int *edge_offsets;
+    const Edge *edges; // Grouped by component, node ids local to it
+    Nodes *scratch;
+    const ForceSettings *settings;
+    const ForceKernels *kernels;
+    const Cooling *cooling;
+    int max_iterations;
+    float tolerance;
+    int *iterations;   // Per component
+    atomic_int next;   // Next component to take
+} ComponentPass;
+
+// Random start in a square sized for the component's natural extent, centred in the box
+static void scatter(float *x, float *y, int count, Rng *rng) {
+    float side = fminf(fminf(BOX_WIDTH, BOX_HEIGHT), COMPONENTS_SPACING * sqrtf((float)count));
+    float left = BOX_MARGIN + (BOX_WIDTH - side) * 0.5f, top = BOX_MARGIN + (BOX_HEIGHT - side) * 0.5f;
+    for (int i = 0; i < count; i++) {
+        x[i] = left + rng_float(rng) * side;
+        y[i] = top + rng_float(rng) * side;
+    }
+}
+
+// One small component with the exact kernel on the calling thread; the same
+// three phases as calculate_forces, without its shared buffers
+static int relax_small(const ComponentPass *pass, int c) {
+    int begin = pass->components->offsets[c];
+    int count = pass->components->offsets[c + 1] - begin;
+    const Edge *edges = pass->edges + pass->edge_offsets[c];
+    int num_edges = pass->edge_offsets[c + 1] - pass->edge_offsets[c];
+    Nodes *scratch = pass->scratch;
+    float *position[2] = {scratch->x + begin, scratch->y + begin};
+    float *displacement[2] = {scratch->dx + begin, scratch->dy + begin};
+    unsigned char *still = scratch->still + begin;
+
+    Cooling cooling = *pass->cooling;
+    int done = 0;
+    while (done < pass->max_iterations) {
+        memset(displacement[0], 0, (size_t)count * sizeof(float));
+        memset(displacement[1], 0, (size_t)count * sizeof(float));
+        pass->kernels->repulsion(position[0], position[1], count, 0, count, displacement[0], displacement[1]);
+        pass->kernels->attraction(position[0], position[1], edges, num_edges, displacement[0], displacement[1]);
+        int skip_frozen = pass->settings->freeze && done % FREEZE_RECHECK != 0;
+        ForceStats stats = integrate_2d(position, (const float *const *)displacement, still, 0, count,
+                                        cooling.temperature, skip_frozen);
+        cooling_update(&cooling, &stats);
+        done++;
+        if (pass->tolerance > 0.0f && layout_converged(&stats, count, pass->tolerance)) break;
+    }
+    return done;
+}
+
+// A large component with calculate_forces and the whole pool, on a copy of its slots
+static int relax_large(const ComponentPass *pass, int c) {
+    int begin = pass->components->offsets[c];
+    int count = pass->components->offsets[c + 1] - begin;
+    const Edge *edges = pass->edges + pass->edge_offsets[c];
+    int num_edges = pass->edge_offsets[c + 1] - pass->edge_offsets[c];
+    Nodes local;
+    if (nodes_alloc(&local, count) != 0) {
+        return -1;
+    }
+    memcpy(local.x, pass->scratch->x + begin, (size_t)count * sizeof(float));
+    memcpy(local.y, pass->scratch->y + begin, (size_t)count * sizeof(float));
+
+    Cooling cooling = *pass->cooling;
+    int done = 0;
+    while (done < pass->max_iterations) {
+        ForceStats stats = calculate_forces(&local, edges, num_edges, cooling.temperature, done, pass->settings);
+        cooling_update(&cooling, &stats);
+        done++;
+        if (pass->tolerance > 0.0f && layout_converged(&stats, count, pass->tolerance)) break;
+    }
+    memcpy(pass->scratch->x + begin, local.x, (size_t)count * sizeof(float));
+    memcpy(pass->scratch->y + begin, local.y, (size_t)count * sizeof(float));
+    nodes_free(&local);
+    return done;
+}
+
+// Workers take the small components largest first, which keeps the tail short
+static void component_task(void *context, int thread, int num_threads) {
+    (void)thread;
+    (void)num_threads;
+    ComponentPass *pass = context;
+    for (;;) {
+        int c = atomic_fetch_add_explicit(&pass->next, 1, memory_order_relaxed);
+        if (c >= pass->components->count) break;
+        pass->iterations[c] = relax_small(pass, c);
+    }
+}
+
+typedef struct {
+    float min_x, min_y;
+    float width, height; // Padding included
+    float x, y;          // Packed position of the top left corner
+    int component;
+} PackedRect;
+
+static int compare_heights(const void *a, const void *b) {
+    const PackedRect *p = a, *q = b;
+    if (p->height != q->height) return p->height > q->height ? -1 : 1;
+    return (p->component > q->component) - (p->component < q->component);
+}
+
+// Shelf packing: tallest first, left to right in rows about as wide as a box
+// shaped region of the same total area would be. Returns the scale that
+// makes the packing fit the box, at most 1, and the packed extent.
+static float pack(PackedRect *rects, int count, float *used_width, float *used_height) {
+    float area = 0.0f, widest = 0.0f;
+    for (int r = 0; r < count; r++) {
+        area += rects[r].width * rects[r].height;
+        widest = fmaxf(widest, rects[r].width);
+    }
+    qsort(rects, (size_t)count, sizeof(PackedRect), compare_heights);
+    float row_width = fmaxf(widest, sqrtf(area * BOX_WIDTH / BOX_HEIGHT));
+    float cursor_x = 0.0f, cursor_y = 0.0f, shelf = 0.0f;
+    *used_width = 0.0f;
+    for (int r = 0; r < count; r++) {
+        if (cursor_x > 0.0f && cursor_x + rects[r].width > row_width) {
+            cursor_y += shelf;
+            cursor_x = 0.0f;
+            shelf = 0.0f;
+        }
+        rects[r].x = cursor_x;
+        rects[r].y = cursor_y;
+        cursor_x += rects[r].width;
+        shelf = fmaxf(shelf, rects[r].height);
+        *used_width = fmaxf(*used_width, cursor_x);
+    }
+    *used_height = cursor_y + shelf;
+    return fminf(1.0f, fminf(BOX_WIDTH / *used_width, BOX_HEIGHT / *used_height));
+}
+
+int components_layout(Nodes *nodes, const Graph *graph, const ForceSettings *settings, const Cooling *cooling,
+                      int max_iterations, float tolerance, uint64_t seed, ComponentStats *stats) {
+    ComponentStats local_stats;
+    if (stats == NULL) stats = &local_stats;
+    memset(stats, 0, sizeof(*stats));
+    if (nodes->dimensions != 2) {
+        printf("components: only 2D layouts are supported\n");
+        return -1;
+    }
+    double start = layout_seconds();
+
+    Components components;
+    if (components_find(&components, graph) != 0) {
+        return -1;
+    }
+    int n = graph->num_nodes, m = graph->num_edges, count = components.count;
+    int *local = malloc((size_t)(n > 0 ? n : 1) * sizeof(int));
+    int *edge_offsets = calloc((size_t)count + 1, sizeof(int));
+    Edge *edges = malloc((size_t)(m > 0 ? m : 1) * sizeof(Edge));
+    int *iterations = calloc((size_t)(count > 0 ? count : 1), sizeof(int));
+    PackedRect *rects = malloc((size_t)(count > 0 ? count : 1) * sizeof(PackedRect));
+    Nodes scratch = {0};
+    int failed = local == NULL || edge_offsets == NULL || edges == NULL || iterations == NULL || rects == NULL;
+    failed = failed || nodes_alloc(&scratch, n) != 0;
+    if (failed) {
+        printf("components: out of memory (%d nodes)\n", n);
+    }
+
+    if (!failed) {
+        // Local ids, and the edges of each component together
+        for (int c = 0; c < count; c++) {
+            for (int k = components.offsets[c]; k < components.offsets[c + 1]; k++) {
+                local[components.order[k]] = k - components.offsets[c];
+            }
+        }
+        for (int e = 0; e < m; e++) {
+            edge_offsets[components.component[graph->edges[e].from] + 1]++;
+        }
+        for (int c = 0; c < count; c++) {
+            edge_offsets[c + 1] += edge_offsets[c];
+        }
+        int *cursor = iterations; // Still zero, borrowed as fill cursors
+        for (int e = 0; e < m; e++) {
+            int c = components.component[graph->edges[e].from];
+            Edge *edge = &edges[edge_offsets[c] + cursor[c]++];
+            edge->from = local[graph->edges[e].from];
+            edge->to = local[graph->edges[e].to];
+        }
+        memset(iterations, 0, (size_t)count * sizeof(int));
+
+        for (int c = 0; c < count; c++) {
+            Rng rng;
+            rng_seed(&rng, seed + (uint64_t)c);
+            int begin = components.offsets[c];
+            scatter(scratch.x + begin, scratch.y + begin, components.offsets[c + 1] - begin, &rng);
+        }
+
+        ComponentPass pass = {&components, edge_offsets, edges, &scratch, settings,
+                              settings->kernels ? settings->kernels : &force_kernels_scalar, cooling, max_iterations,
+                              tolerance, iterations, 0};
+        int first_small = 0;
+        while (first_small < count && components.offsets[first_small + 1] - components.offsets[first_small] > AUTO_BARNES_HUT_NODES) {
+            iterations[first_small] = relax_large(&pass, first_small);
+            failed |= iterations[first_small] < 0;
+            first_small++;
+        }
+        atomic_init(&pass.next, first_small);
+        if (!failed) {
+            threadpool_run(settings->pool, component_task, &pass);
+        }
+    }
+    double laid_out = layout_seconds();
+
+    if (!failed) {
+        // Bounding boxes, packed and mapped back to the node ids
+        for (int c = 0; c < count; c++) {
+            int begin = components.offsets[c];
+            const float *position[2] = {scratch.x + begin, scratch.y + begin};
+            float min[2], max[2];
+            bounds_2d(position, components.offsets[c + 1] - begin, min, max);
+            rects[c] = (PackedRect){min[0], min[1], max[0] - min[0] + COMPONENTS_PADDING,
+                                    max[1] - min[1] + COMPONENTS_PADDING, 0.0f, 0.0f, c};
+        }
+        float used_width, used_height;
+        float scale = count > 0 ? pack(rects, count, &used_width, &used_height) : 1.0f;
+        float left = BOX_MARGIN + (BOX_WIDTH - used_width * scale) * 0.5f;
+        float top = BOX_MARGIN + (BOX_HEIGHT - used_height * scale) * 0.5f;
+        for (int r = 0; r < count; r++) {
+            const PackedRect *rect = &rects[r];
+            float ox = rect->x + COMPONENTS_PADDING * 0.5f - rect->min_x;
+            float oy = rect->y + COMPONENTS_PADDING * 0.5f - rect->min_y;
+            for (int k = components.offsets[rect->component]; k < components.offsets[rect->component + 1]; k++) {
+                int v = components.order[k];
+                nodes->x[v] = left + (scratch.x[k] + ox) * scale;
+                nodes->y[v] = top + (scratch.y[k] + oy) * scale;
+                nodes->dx[v] = nodes->dy[v] = 0.0f;
+                nodes->still[v] = 0;
+            }
+        }
+
+        double pairs = 0.0;
+        for (int c = 0; c < count; c++) {
+            double size = components.offsets[c + 1] - components.offsets[c];
+            pairs += size * size;
+            if (iterations[c] > stats->iterations) stats->iterations = iterations[c];
+        }
+        stats->components = count;
+        stats->largest = count > 0 ? components.offsets[1] : 0;
+        stats->pair_fraction = n > 0 ? pairs / ((double)n * n) : 0.0;
+        stats->layout_seconds = laid_out - start;
+        stats->pack_seconds = layout_seconds() - laid_out;
+    }
+
+    nodes_free(&scratch);
+    free(local);
+    free(edge_offsets);
+    free(edges);
+    free(iterations);
+    free(rects);
+    components_free(&components);
+    return failed ? -1 : 0;
+}
@@ -0,0 +1,47 @@
+#ifndef COMPONENTS_H
+#define COMPONENTS_H
+
+#include <stdint.h>
+
+#include "layout.h"
+#include "graph.h"
+#include "cooling.h"
+
+#define COMPONENTS_SPACING 100.0f // Natural edge length of the force model, sizes the starting square
+#define COMPONENTS_PADDING 20.0f  // Gap between packed components, in pixels
+
+// Connected components. Component c holds the nodes
+// order[offsets[c] .. offsets[c + 1]), in ascending id order; components are
+// numbered largest first.
+typedef struct {
+    int count;
+    int *component; // Of each node
+    int *order;
+    int *offsets;   // count + 1 entries
+} Components;
+
+// Detail of the last components_layout call
+typedef struct {
+    int components;
+    int largest;
+    int iterations;       // Most iterations any component ran
+    double pair_fraction; // Pairs the repulsion visits, relative to laying out the whole graph at once
+    double layout_seconds;
+    double pack_seconds;
+} ComponentStats;
+
+int components_find(Components *components, const Graph *graph);
+void components_free(Components *components);
+
+// Lay out every component on its own and pack the results into the box.
+// Components larger than AUTO_BARNES_HUT_NODES run one after another with
+// `settings` (pool and repulsion mode included); the rest are spread over the
+// pool, one component per thread at a time, with the exact kernel. Each
+// starts from random positions with a copy of `cooling` and runs until it
+// converges within `tolerance` (0 never stops early) or after
+// `max_iterations`. Then the bounding boxes are shelf-packed, and shrunk to
+// fit if they do not. 2D only; returns -1 on failure.
+int components_layout(Nodes *nodes, const Graph *graph, const ForceSettings *settings, const Cooling *cooling,
+                      int max_iterations, float tolerance, uint64_t seed, ComponentStats *stats);
+
+#endif
@@ -0,0 +1,220 @@
+#include "context.h"
+#include "arena.h"
+#include "graph.h"
+#include "forces.h"
+#include "threadpool.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdatomic.h>
+
+struct LayoutContext {
+    LayoutOptions options;
+    ForceSettings settings; // From the options, with the context's own workspace
+    Arena arena;            // Graph arrays and node block of the loaded graph
+    Graph graph;            // Borrows from the arena
+    Nodes nodes;            // Attached to the arena
+    Cooling cooling;
+    int loaded;
+    int iteration;
+    int converged;
+};
+
+void layout_options_default(LayoutOptions *options) {
+    options->dimensions = 2;
+    options->placement = PLACEMENT_RANDOM;
+    options->seed = 1;
+    options->schedule = SCHEDULE_ADAPTIVE;
+    options->temperature = -1.0f;
+    options->cooling = COOLING_FACTOR;
+    options->tolerance = CONVERGENCE_TOLERANCE;
+    options->barnes_hut_nodes = AUTO_BARNES_HUT_NODES;
+    options->theta = BARNES_HUT_THETA;
+    options->kernels = NULL;
+    options->freeze = 1;
+    options->pool = NULL;
+}
+
+LayoutContext *layout_context_create(const LayoutOptions *options) {
+    LayoutContext *context = calloc(1, sizeof(*context));
+    if (context == NULL) {
+        printf("Out of memory for a layout context\n");
+        return NULL;
+    }
+    if (options != NULL) {
+        context->options = *options;
+    } else {
+        layout_options_default(&context->options);
+    }
+    if (context->options.dimensions != 2 && context->options.dimensions != 3) {
+        printf("Dimensions must be 2 or 3\n");
+        free(context);
+        return NULL;
+    }
+    const ForceKernels *kernels = context->options.kernels != NULL ? context->options.kernels : force_kernels_select(NULL);
+    ForceSettings settings = {REPULSION_EXACT, context->options.theta, kernels, context->options.pool, NULL,
+                              context->options.freeze, force_workspace_create()};
+    if (settings.workspace == NULL) {
+        free(context);
+        return NULL;
+    }
+    context->settings = settings;
+    return context;
+}
+
+void layout_context_destroy(LayoutContext *context) {
+    if (context == NULL) return;
+    force_workspace_destroy(context->settings.workspace);
+    arena_free(&context->arena);
+    free(context);
+}
+
+int layout_context_load(LayoutContext *context, const Edge *edges, int num_edges, int num_nodes) {
+    context->loaded = 0;
+    if (num_nodes < 0 || num_edges < 0) {
+        printf("Bad graph size: %d nodes, %d edges\n", num_nodes, num_edges);
+        return -1;
+    }
+    for (int e = 0; e < num_edges; e++) {
+        if (edges[e].from < 0 || edges[e].to < 0 || edges[e].from >= num_nodes || edges[e].to >= num_nodes) {
+            printf("Edge %d-%d is out of range for %d nodes\n", edges[e].from, edges[e].to, num_nodes);
+            return -1;
+        }
+    }
+
+    arena_reset(&context->arena);
+    int dimensions = context->options.dimensions;
+    int *offsets = arena_alloc(&context->arena, ((size_t)num_nodes + 1) * sizeof(int), sizeof(int));
+    int *adjacency = arena_alloc(&context->arena, 2 * (size_t)num_edges * sizeof(int) + 1, sizeof(int));
+    Edge *graph_edges = arena_alloc(&context->arena, (size_t)num_edges * sizeof(Edge) + 1, sizeof(int));
+    void *block = arena_alloc(&context->arena, nodes_block_size(num_nodes, dimensions), NODES_ALIGNMENT);
+    if (offsets == NULL || adjacency == NULL || graph_edges == NULL || block == NULL) {
+        printf("Out of memory for %d nodes\n", num_nodes);
+        return -1;
+    }
+    if (graph_build_arrays(&context->graph, edges, num_edges, num_nodes, offsets, adjacency, graph_edges) != 0) {
+        return -1;
+    }
+    nodes_attach(&context->nodes, block, num_nodes, dimensions);
+
+    ForceSettings *settings = &context->settings;
+    settings->repulsion = num_nodes > context->options.barnes_hut_nodes ? REPULSION_BARNES_HUT : REPULSION_EXACT;
+    PlacementKind placement = dimensions == 2 ? context->options.placement : PLACEMENT_RANDOM;
+    place_nodes(&context->nodes, &context->graph, placement, context->options.seed, settings);
+    float temperature = context->options.temperature >= 0.0f ? context->options.temperature
+                                                             : placement_temperature(placement);
+    cooling_init(&context->cooling, context->options.schedule, temperature, context->options.cooling);
+    context->iteration = 0;
+    context->converged = num_nodes == 0;
+    context->loaded = 1;
+    return 0;
+}
+
+int layout_context_load_file(LayoutContext *context, const char *path) {
+    Graph graph;
+    if (graph_load(&graph, path) != 0) {
+        context->loaded = 0;
+        return -1;
+    }
+    int result = layout_context_load(context, graph.edges, graph.num_edges, graph.num_nodes);
+    graph_free(&graph);
+    return result;
+}
+
+int layout_context_step(LayoutContext *context, int iterations) {
+    if (!context->loaded) return -1;
+    float tolerance = context->options.tolerance;
+    int done = 0;
+    while (done < iterations && !context->converged) {
+        ForceStats stats = calculate_forces(&context->nodes, context->graph.edges, context->graph.num_edges,
+                                            context->cooling.temperature, context->iteration, &context->settings);
+        cooling_update(&context->cooling, &stats);
+        context->iteration++;
+        done++;
+        context->converged = tolerance > 0.0f && layout_converged(&stats, context->nodes.count, tolerance);
+    }
+    return done;
+}
+
+int layout_context_converged(const LayoutContext *context) {
+    return context->converged;
+}
+
+int layout_context_iteration(const LayoutContext *context) {
+    return context->iteration;
+}
+
+int layout_context_num_nodes(const LayoutContext *context) {
+    return context->loaded ? context->nodes.count : 0;
+}
+
+int layout_context_positions(const LayoutContext *context, float *x, float *y, float *z) {
+    if (!context->loaded) return 0;
+    const Nodes *nodes = &context->nodes;
+    size_t size = (size_t)nodes->count * sizeof(float);
+    memcpy(x, nodes->x, size);
+    memcpy(y, nodes->y, size);
+    if (z != NULL && nodes->z != NULL) {
+        memcpy(z, nodes->z, size);
+    }
+    return nodes->count;
+}
+
+// One layout_batch call, shared by the pool threads
+typedef struct {
+    LayoutJob *jobs;
+    int num_jobs;
+    int max_iterations;
+    LayoutContext **contexts; // One per thread
+    atomic_int next;          // Next job to hand out
+} BatchPass;
+
+static void batch_task(void *context, int thread, int num_threads) {
+    (void)num_threads;
+    BatchPass *pass = context;
+    LayoutContext *layout = pass->contexts[thread];
+    for (int j = atomic_fetch_add(&pass->next, 1); j < pass->num_jobs; j = atomic_fetch_add(&pass->next, 1)) {
+        LayoutJob *job = &pass->jobs[j];
+        job->iterations = 0;
+        job->status = -1;
+        if (layout == NULL || layout_context_load(layout, job->edges, job->num_edges, job->num_nodes) != 0) {
+            continue;
+        }
+        job->iterations = layout_context_step(layout, pass->max_iterations);
+        layout_context_positions(layout, job->x, job->y, job->z);
+        job->status = 0;
+    }
+}
+
+int layout_batch(LayoutJob *jobs, int num_jobs, const LayoutOptions *options, int max_iterations, ThreadPool *pool) {
+    int num_threads = threadpool_size(pool);
+    LayoutOptions job_options;
+    if (options != NULL) {
+        job_options = *options;
+    } else {
+        layout_options_default(&job_options);
+    }
+    job_options.pool = NULL;
+
+    BatchPass pass = {jobs, num_jobs, max_iterations, calloc((size_t)num_threads, sizeof(LayoutContext *)), 0};
+    if (pass.contexts == NULL) {
+        printf("Out of memory for %d layout contexts\n", num_threads);
+        return num_jobs;
+    }
+    for (int t = 0; t < num_threads; t++) {
+        pass.contexts[t] = layout_context_create(&job_options);
+    }
+    atomic_init(&pass.next, 0);
+    threadpool_run(pool, batch_task, &pass);
+
+    int failed = 0;
+    for (int j = 0; j < num_jobs; j++) {
+        failed += jobs[j].status != 0;
+    }
+    for (int t = 0; t < num_threads; t++) {
+        layout_context_destroy(pass.contexts[t]);
+    }
+    free(pass.contexts);
+    return failed;
+}
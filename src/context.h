@@ -0,0 +1,69 @@
+#ifndef CONTEXT_H
+#define CONTEXT_H
+
+#include <stdint.h>
+
+#include "layout.h"
+#include "cooling.h"
+#include "placement.h"
+
+// Library interface to the engine. Every layout lives in its own context, so
+// any number of them can run at once on different threads; nothing is shared
+// but the read-only kernel tables and the optional profiler. A context keeps
+// its graph and positions in an arena that is reused by the next load.
+typedef struct LayoutContext LayoutContext;
+
+typedef struct {
+    int dimensions;            // 2 or 3
+    PlacementKind placement;   // Structured placements are 2D only, 3D always starts random
+    uint64_t seed;
+    CoolingSchedule schedule;
+    float temperature;         // Start temperature, negative for the placement's
+    float cooling;             // Factor of the schedule
+    float tolerance;           // Mean movement that counts as converged, 0 never stops early
+    int barnes_hut_nodes;      // Barnes-Hut repulsion above this many nodes, exact below
+    float theta;               // Barnes-Hut opening angle
+    const ForceKernels *kernels; // NULL for the fastest the CPU has
+    int freeze;                // Leave out nodes that have stopped moving
+    ThreadPool *pool;          // Workers for the force passes, NULL for the calling thread only
+} LayoutOptions;
+
+void layout_options_default(LayoutOptions *options);
+
+LayoutContext *layout_context_create(const LayoutOptions *options); // NULL options for the defaults
+void layout_context_destroy(LayoutContext *context);
+
+// Replace the graph and place its nodes. Edges are pairs of ids below
+// num_nodes, loops and duplicates are dropped; returns -1 on bad input.
+int layout_context_load(LayoutContext *context, const Edge *edges, int num_edges, int num_nodes);
+int layout_context_load_file(LayoutContext *context, const char *path); // Any format graph_load reads, names are dropped
+
+// Run up to `iterations` more iterations, fewer once the layout converges.
+// Returns the number run, -1 without a graph.
+int layout_context_step(LayoutContext *context, int iterations);
+int layout_context_converged(const LayoutContext *context);
+int layout_context_iteration(const LayoutContext *context);
+int layout_context_num_nodes(const LayoutContext *context);
+
+// Copy the positions out, z may be NULL; returns the node count
+int layout_context_positions(const LayoutContext *context, float *x, float *y, float *z);
+
+// One graph of a batch. x, y (and z in 3D) receive num_nodes positions each.
+typedef struct {
+    const Edge *edges;
+    int num_edges;
+    int num_nodes;
+    float *x, *y, *z;
+    int iterations; // Set to the iterations run
+    int status;     // Set to 0, or -1 if the graph could not be laid out
+} LayoutJob;
+
+// Lay out many independent graphs until each converges or reaches
+// max_iterations. Every thread of the pool keeps one context and takes the
+// next job whenever it finishes one, so small graphs run one per thread and
+// no storage is allocated once the arenas have grown; options->pool is not
+// used. A job's result does not depend on the pool or the job order.
+// Returns the number of failed jobs.
+int layout_batch(LayoutJob *jobs, int num_jobs, const LayoutOptions *options, int max_iterations, ThreadPool *pool);
+
+#endif
@@ -0,0 +1,42 @@
+#include "cooling.h"
+
+void cooling_init(Cooling *cooling, CoolingSchedule schedule, float temperature, float factor) {
+    cooling->schedule = schedule;
+    cooling->temperature = temperature;
+    cooling->start_temperature = temperature;
+    cooling->factor = factor;
+    cooling->energy = -1.0;
+    cooling->progress = 0;
+}
+
+// Pick the temperature for the next iteration from the one just finished
+void cooling_update(Cooling *cooling, const ForceStats *stats) {
+    if (cooling->schedule == SCHEDULE_FIXED) {
+        cooling->temperature *= cooling->factor;
+        return;
+    }
+
+    // Per moving node, so freezing nodes does not look like progress
+    double energy = stats->moving > 0 ? stats->energy / stats->moving : 0.0;
+    if (cooling->energy >= 0.0 && energy < cooling->energy) {
+        if (++cooling->progress >= COOLING_PROGRESS_STEPS) {
+            cooling->progress = 0;
+            cooling->temperature /= cooling->factor;
+            if (cooling->temperature > cooling->start_temperature) {
+                cooling->temperature = cooling->start_temperature;
+            }
+        }
+    } else {
+        cooling->progress = 0;
+        cooling->temperature *= cooling->factor;
+    }
+    cooling->energy = energy;
+}
+
+// Settled: the nodes moved less than `tolerance` pixels on average, or all are frozen
+int layout_converged(const ForceStats *stats, int num_nodes, float tolerance) {
+    if (stats->moving == 0) {
+        return 1;
+    }
+    return num_nodes > 0 && stats->displacement / num_nodes < tolerance;
+}
@@ -0,0 +1,31 @@
+#ifndef COOLING_H
+#define COOLING_H
+
+#include "layout.h"
+
+#define COOLING_PROGRESS_STEPS 5     // Improving iterations in a row before the step grows again
+#define CONVERGENCE_TOLERANCE 0.01f  // Mean movement per node, in pixels, that counts as settled
+
+typedef enum {
+    SCHEDULE_FIXED,    // temperature *= factor every iteration
+    SCHEDULE_ADAPTIVE  // Step length follows the energy
+} CoolingSchedule;
+
+// Temperature scheduler. The adaptive schedule is Hu's: while the mean energy
+// keeps falling the step is kept, and after COOLING_PROGRESS_STEPS improving
+// iterations it grows by 1 / factor (up to the start temperature); whenever the
+// energy rises the step shrinks by factor.
+typedef struct {
+    CoolingSchedule schedule;
+    float temperature;
+    float start_temperature;
+    float factor;
+    double energy; // Mean energy of the last iteration, negative before the first
+    int progress;
+} Cooling;
+
+void cooling_init(Cooling *cooling, CoolingSchedule schedule, float temperature, float factor);
+void cooling_update(Cooling *cooling, const ForceStats *stats);
+int layout_converged(const ForceStats *stats, int num_nodes, float tolerance);
+
+#endif
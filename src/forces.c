@@ -0,0 +1,62 @@
+#include "forces.h"
+#include "layout_dim.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+// The scalar kernels are the 2D instances of the dimension-generic ones
+static void repulsion_scalar(const float *x, const float *y, int num_nodes, int row_begin, int row_end, float *dx, float *dy) {
+    const float *position[2] = {x, y};
+    float *displacement[2] = {dx, dy};
+    repulsion_pairs_2d(position, num_nodes, row_begin, row_end, displacement);
+}
+
+static void attraction_scalar(const float *x, const float *y, const Edge *edges, int num_edges, float *dx, float *dy) {
+    const float *position[2] = {x, y};
+    float *displacement[2] = {dx, dy};
+    attraction_edges_2d(position, edges, num_edges, displacement);
+}
+
+const ForceKernels force_kernels_scalar = {"scalar", repulsion_scalar, attraction_scalar};
+
+// Pick kernels by name ("scalar", "sse2", "avx2"), or the widest the CPU
+// supports for NULL/"auto". Returns NULL if the named set is unavailable.
+const ForceKernels *force_kernels_select(const char *name) {
+    if (name == NULL || strcmp(name, "auto") == 0) {
+        const ForceKernels *kernels = force_kernels_avx2();
+        if (kernels == NULL) kernels = force_kernels_sse2();
+        return kernels != NULL ? kernels : &force_kernels_scalar;
+    }
+    if (strcmp(name, "scalar") == 0) return &force_kernels_scalar;
+    if (strcmp(name, "sse2") == 0) return force_kernels_sse2();
+    if (strcmp(name, "avx2") == 0) return force_kernels_avx2();
+    return NULL;
+}
+
+// Relative RMS deviation of a kernel set from the scalar kernels on the same
+// positions, sqrt(sum |f - f_scalar|^2 / sum |f_scalar|^2)
+float force_kernels_error(const ForceKernels *kernels, const Nodes *nodes, const Edge *edges, int num_edges) {
+    int n = nodes->count;
+    float *buffer = calloc((size_t)(n > 0 ? n : 1) * 4, sizeof(float));
+    if (buffer == NULL) {
+        return -1.0f;
+    }
+    float *ref_x = buffer, *ref_y = buffer + n, *out_x = buffer + 2 * n, *out_y = buffer + 3 * n;
+
+    force_kernels_scalar.repulsion(nodes->x, nodes->y, n, 0, n, ref_x, ref_y);
+    force_kernels_scalar.attraction(nodes->x, nodes->y, edges, num_edges, ref_x, ref_y);
+    kernels->repulsion(nodes->x, nodes->y, n, 0, n, out_x, out_y);
+    kernels->attraction(nodes->x, nodes->y, edges, num_edges, out_x, out_y);
+
+    double err = 0, ref = 0;
+    for (int i = 0; i < n; i++) {
+        double ex = out_x[i] - ref_x[i];
+        double ey = out_y[i] - ref_y[i];
+        err += ex * ex + ey * ey;
+        ref += (double)ref_x[i] * ref_x[i] + (double)ref_y[i] * ref_y[i];
+    }
+    free(buffer);
+    return ref > 0 ? (float)sqrt(err / ref) : 0.0f;
+}
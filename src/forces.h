@@ -0,0 +1,27 @@
+#ifndef FORCES_H
+#define FORCES_H
+
+#include "layout.h"
+
+#define FORCE_KERNEL_TOLERANCE 1e-4f // Max relative RMS deviation of a vector kernel from scalar
+
+// Force kernels; both add into dx/dy. Repulsion visits the pairs (i, j > i)
+// for rows i in [row_begin, row_end) and updates both ends, attraction does
+// the same per edge. Splitting rows or edges across threads with separate
+// dx/dy buffers keeps the updates race free.
+struct ForceKernels {
+    const char *name;
+    void (*repulsion)(const float *x, const float *y, int num_nodes, int row_begin, int row_end, float *dx, float *dy);
+    void (*attraction)(const float *x, const float *y, const Edge *edges, int num_edges, float *dx, float *dy);
+};
+
+extern const ForceKernels force_kernels_scalar;
+
+// x86 vector kernels (forces_simd.c), NULL when the build or the CPU lacks them
+const ForceKernels *force_kernels_avx2(void);
+const ForceKernels *force_kernels_sse2(void);
+
+const ForceKernels *force_kernels_select(const char *name);
+float force_kernels_error(const ForceKernels *kernels, const Nodes *nodes, const Edge *edges, int num_edges);
+
+#endif
@@ -0,0 +1,220 @@
+#include "forces.h"
+
+#include <math.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+
+#include <immintrin.h>
+
+// Functions are compiled for their instruction set with target attributes so the
+// rest of the build keeps baseline flags; force_kernels_select dispatches at runtime.
+#define TARGET_AVX2 __attribute__((target("avx2")))
+#define TARGET_SSE2 __attribute__((target("sse2")))
+
+TARGET_SSE2 static float hsum_sse2(__m128 v) {
+    __m128 shuf = _mm_shuffle_ps(v, v, _MM_SHUFFLE(2, 3, 0, 1));
+    __m128 sums = _mm_add_ps(v, shuf);
+    shuf = _mm_movehl_ps(shuf, sums);
+    sums = _mm_add_ss(sums, shuf);
+    return _mm_cvtss_f32(sums);
+}
+
+TARGET_AVX2 static float hsum_avx2(__m256 v) {
+    __m128 sums = _mm_add_ps(_mm256_castps256_ps128(v), _mm256_extractf128_ps(v, 1));
+    __m128 shuf = _mm_shuffle_ps(sums, sums, _MM_SHUFFLE(2, 3, 0, 1));
+    sums = _mm_add_ps(sums, shuf);
+    shuf = _mm_movehl_ps(shuf, sums);
+    sums = _mm_add_ss(sums, shuf);
+    return _mm_cvtss_f32(sums);
+}
+
+// Row i against j > i: the row sum stays in registers, the j side is a
+// contiguous vector subtract into dx/dy
+TARGET_AVX2 static void repulsion_avx2(const float *x, const float *y, int num_nodes, int row_begin, int row_end, float *dx, float *dy) {
+    const __m256 k = _mm256_set1_ps(1000.0f);
+    const __m256 zero = _mm256_setzero_ps();
+
+    for (int i = row_begin; i < row_end; i++) {
+        __m256 xi = _mm256_set1_ps(x[i]);
+        __m256 yi = _mm256_set1_ps(y[i]);
+        __m256 sum_x = zero, sum_y = zero;
+
+        int j = i + 1;
+        for (; j + 8 <= num_nodes; j += 8) {
+            __m256 rx = _mm256_sub_ps(xi, _mm256_loadu_ps(x + j));
+            __m256 ry = _mm256_sub_ps(yi, _mm256_loadu_ps(y + j));
+            __m256 d2 = _mm256_add_ps(_mm256_mul_ps(rx, rx), _mm256_mul_ps(ry, ry));
+            __m256 force = _mm256_and_ps(_mm256_cmp_ps(d2, zero, _CMP_GT_OQ), _mm256_div_ps(k, d2));
+            __m256 fx = _mm256_mul_ps(rx, force);
+            __m256 fy = _mm256_mul_ps(ry, force);
+
+            sum_x = _mm256_add_ps(sum_x, fx);
+            sum_y = _mm256_add_ps(sum_y, fy);
+            _mm256_storeu_ps(dx + j, _mm256_sub_ps(_mm256_loadu_ps(dx + j), fx));
+            _mm256_storeu_ps(dy + j, _mm256_sub_ps(_mm256_loadu_ps(dy + j), fy));
+        }
+
+        float row_x = hsum_avx2(sum_x);
+        float row_y = hsum_avx2(sum_y);
+        for (; j < num_nodes; j++) {
+            float rx = x[i] - x[j];
+            float ry = y[i] - y[j];
+            float d2 = rx * rx + ry * ry;
+            if (d2 > 0) {
+                float force = 1000.0f / d2;
+                row_x += rx * force;
+                row_y += ry * force;
+                dx[j] -= rx * force;
+                dy[j] -= ry * force;
+            }
+        }
+        dx[i] += row_x;
+        dy[i] += row_y;
+    }
+}
+
+// Eight edges at a time: endpoints and positions are gathered, the forces are
+// computed in vector lanes and scattered back with scalar adds
+TARGET_AVX2 static void attraction_avx2(const float *x, const float *y, const Edge *edges, int num_edges, float *dx, float *dy) {
+    const __m256i stride = _mm256_setr_epi32(0, 2, 4, 6, 8, 10, 12, 14);
+    const __m256 k = _mm256_set1_ps(1000.0f);
+    float lane_x[8], lane_y[8];
+
+    int e = 0;
+    for (; e + 8 <= num_edges; e += 8) {
+        const int *base = &edges[e].from;
+        __m256i from = _mm256_i32gather_epi32(base, stride, 4);
+        __m256i to = _mm256_i32gather_epi32(base + 1, stride, 4);
+        __m256 rx = _mm256_sub_ps(_mm256_i32gather_ps(x, from, 4), _mm256_i32gather_ps(x, to, 4));
+        __m256 ry = _mm256_sub_ps(_mm256_i32gather_ps(y, from, 4), _mm256_i32gather_ps(y, to, 4));
+        __m256 d = _mm256_sqrt_ps(_mm256_add_ps(_mm256_mul_ps(rx, rx), _mm256_mul_ps(ry, ry)));
+        __m256 force = _mm256_div_ps(d, k);
+        _mm256_storeu_ps(lane_x, _mm256_mul_ps(rx, force));
+        _mm256_storeu_ps(lane_y, _mm256_mul_ps(ry, force));
+
+        for (int l = 0; l < 8; l++) {
+            int a = edges[e + l].from;
+            int b = edges[e + l].to;
+            dx[a] -= lane_x[l];
+            dy[a] -= lane_y[l];
+            dx[b] += lane_x[l];
+            dy[b] += lane_y[l];
+        }
+    }
+    for (; e < num_edges; e++) {
+        int a = edges[e].from;
+        int b = edges[e].to;
+        float rx = x[a] - x[b];
+        float ry = y[a] - y[b];
+        float force = sqrtf(rx * rx + ry * ry) / 1000.0f;
+        dx[a] -= rx * force;
+        dy[a] -= ry * force;
+        dx[b] += rx * force;
+        dy[b] += ry * force;
+    }
+}
+
+TARGET_SSE2 static void repulsion_sse2(const float *x, const float *y, int num_nodes, int row_begin, int row_end, float *dx, float *dy) {
+    const __m128 k = _mm_set1_ps(1000.0f);
+    const __m128 zero = _mm_setzero_ps();
+
+    for (int i = row_begin; i < row_end; i++) {
+        __m128 xi = _mm_set1_ps(x[i]);
+        __m128 yi = _mm_set1_ps(y[i]);
+        __m128 sum_x = zero, sum_y = zero;
+
+        int j = i + 1;
+        for (; j + 4 <= num_nodes; j += 4) {
+            __m128 rx = _mm_sub_ps(xi, _mm_loadu_ps(x + j));
+            __m128 ry = _mm_sub_ps(yi, _mm_loadu_ps(y + j));
+            __m128 d2 = _mm_add_ps(_mm_mul_ps(rx, rx), _mm_mul_ps(ry, ry));
+            __m128 force = _mm_and_ps(_mm_cmpgt_ps(d2, zero), _mm_div_ps(k, d2));
+            __m128 fx = _mm_mul_ps(rx, force);
+            __m128 fy = _mm_mul_ps(ry, force);
+
+            sum_x = _mm_add_ps(sum_x, fx);
+            sum_y = _mm_add_ps(sum_y, fy);
+            _mm_storeu_ps(dx + j, _mm_sub_ps(_mm_loadu_ps(dx + j), fx));
+            _mm_storeu_ps(dy + j, _mm_sub_ps(_mm_loadu_ps(dy + j), fy));
+        }
+
+        float row_x = hsum_sse2(sum_x);
+        float row_y = hsum_sse2(sum_y);
+        for (; j < num_nodes; j++) {
+            float rx = x[i] - x[j];
+            float ry = y[i] - y[j];
+            float d2 = rx * rx + ry * ry;
+            if (d2 > 0) {
+                float force = 1000.0f / d2;
+                row_x += rx * force;
+                row_y += ry * force;
+                dx[j] -= rx * force;
+                dy[j] -= ry * force;
+            }
+        }
+        dx[i] += row_x;
+        dy[i] += row_y;
+    }
+}
+
+// SSE2 has no gather, lanes are filled from scalar loads
+TARGET_SSE2 static void attraction_sse2(const float *x, const float *y, const Edge *edges, int num_edges, float *dx, float *dy) {
+    const __m128 k = _mm_set1_ps(1000.0f);
+    float lane_x[4], lane_y[4];
+
+    int e = 0;
+    for (; e + 4 <= num_edges; e += 4) {
+        const Edge *q = edges + e;
+        __m128 rx = _mm_sub_ps(_mm_setr_ps(x[q[0].from], x[q[1].from], x[q[2].from], x[q[3].from]),
+                               _mm_setr_ps(x[q[0].to], x[q[1].to], x[q[2].to], x[q[3].to]));
+        __m128 ry = _mm_sub_ps(_mm_setr_ps(y[q[0].from], y[q[1].from], y[q[2].from], y[q[3].from]),
+                               _mm_setr_ps(y[q[0].to], y[q[1].to], y[q[2].to], y[q[3].to]));
+        __m128 d = _mm_sqrt_ps(_mm_add_ps(_mm_mul_ps(rx, rx), _mm_mul_ps(ry, ry)));
+        __m128 force = _mm_div_ps(d, k);
+        _mm_storeu_ps(lane_x, _mm_mul_ps(rx, force));
+        _mm_storeu_ps(lane_y, _mm_mul_ps(ry, force));
+
+        for (int l = 0; l < 4; l++) {
+            dx[q[l].from] -= lane_x[l];
+            dy[q[l].from] -= lane_y[l];
+            dx[q[l].to] += lane_x[l];
+            dy[q[l].to] += lane_y[l];
+        }
+    }
+    for (; e < num_edges; e++) {
+        int a = edges[e].from;
+        int b = edges[e].to;
+        float rx = x[a] - x[b];
+        float ry = y[a] - y[b];
+        float force = sqrtf(rx * rx + ry * ry) / 1000.0f;
+        dx[a] -= rx * force;
+        dy[a] -= ry * force;
+        dx[b] += rx * force;
+        dy[b] += ry * force;
+    }
+}
+
+static const ForceKernels kernels_avx2 = {"avx2", repulsion_avx2, attraction_avx2};
+static const ForceKernels kernels_sse2 = {"sse2", repulsion_sse2, attraction_sse2};
+
+const ForceKernels *force_kernels_avx2(void) {
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2") ? &kernels_avx2 : NULL;
+}
+
+const ForceKernels *force_kernels_sse2(void) {
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("sse2") ? &kernels_sse2 : NULL;
+}
+
+#else
+
+const ForceKernels *force_kernels_avx2(void) {
+    return NULL;
+}
+
+const ForceKernels *force_kernels_sse2(void) {
+    return NULL;
+}
+
+#endif
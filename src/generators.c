@@ -0,0 +1,124 @@
+#include "generators.h"
+#include "rng.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+static const char *generator_names[GENERATOR_COUNT] = {
+    "erdos-renyi", "grid", "tree", "complete", "power-law"
+};
+
+const char *generator_name(GeneratorKind kind) {
+    return kind >= 0 && kind < GENERATOR_COUNT ? generator_names[kind] : "unknown";
+}
+
+int generator_from_name(const char *name) {
+    for (int kind = 0; kind < GENERATOR_COUNT; kind++) {
+        if (strcmp(name, generator_names[kind]) == 0) return kind;
+    }
+    return -1;
+}
+
+// m distinct-ish random pairs; graph_build drops the rare duplicate or loop
+static long erdos_renyi(Edge *edges, int n, Rng *rng) {
+    long m = 2L * n;
+    for (long e = 0; e < m; e++) {
+        edges[e].from = (int)rng_below(rng, (uint64_t)n);
+        edges[e].to = (int)rng_below(rng, (uint64_t)n);
+    }
+    return m;
+}
+
+// side x side lattice, the last row may be partial
+static long grid(Edge *edges, int n, int side) {
+    long m = 0;
+    for (int v = 0; v < n; v++) {
+        if ((v + 1) % side != 0 && v + 1 < n) {
+            edges[m++] = (Edge){v, v + 1};
+        }
+        if (v + side < n) {
+            edges[m++] = (Edge){v, v + side};
+        }
+    }
+    return m;
+}
+
+static long binary_tree(Edge *edges, int n) {
+    for (int v = 1; v < n; v++) {
+        edges[v - 1] = (Edge){(v - 1) / 2, v};
+    }
+    return n > 0 ? n - 1 : 0;
+}
+
+static long complete(Edge *edges, int n) {
+    long m = 0;
+    for (int u = 0; u < n; u++) {
+        for (int v = u + 1; v < n; v++) {
+            edges[m++] = (Edge){u, v};
+        }
+    }
+    return m;
+}
+
+// Each new node attaches to 2 earlier nodes picked proportionally to degree.
+// Every edge endpoint so far is kept in the edge list itself, so picking a
+// random endpoint is picking by degree.
+static long power_law(Edge *edges, int n, Rng *rng) {
+    long m = 0;
+    if (n >= 2) edges[m++] = (Edge){0, 1};
+    for (int v = 2; v < n; v++) {
+        long existing = m;
+        for (int k = 0; k < 2; k++) {
+            long pick = (long)rng_below(rng, (uint64_t)(2 * existing));
+            int target = pick & 1 ? edges[pick / 2].to : edges[pick / 2].from;
+            edges[m++] = (Edge){target, v};
+        }
+    }
+    return m;
+}
+
+int generate_graph(Graph *graph, GeneratorKind kind, int num_nodes, uint64_t seed) {
+    memset(graph, 0, sizeof(*graph));
+    if (num_nodes < 1) {
+        printf("generators: need at least one node\n");
+        return -1;
+    }
+    if (kind == GENERATOR_COMPLETE && num_nodes > GENERATOR_COMPLETE_MAX_NODES) {
+        printf("generators: complete graph limited to %d nodes\n", GENERATOR_COMPLETE_MAX_NODES);
+        return -1;
+    }
+
+    int side = (int)ceil(sqrt((double)num_nodes));
+    long capacity;
+    switch (kind) {
+        case GENERATOR_ERDOS_RENYI: capacity = 2L * num_nodes; break;
+        case GENERATOR_GRID:        capacity = 2L * num_nodes; break;
+        case GENERATOR_TREE:        capacity = num_nodes; break;
+        case GENERATOR_COMPLETE:    capacity = (long)num_nodes * (num_nodes - 1) / 2; break;
+        case GENERATOR_POWER_LAW:   capacity = 2L * num_nodes; break;
+        default:
+            printf("generators: unknown kind %d\n", (int)kind);
+            return -1;
+    }
+
+    Edge *edges = malloc((size_t)(capacity > 0 ? capacity : 1) * sizeof(Edge));
+    if (edges == NULL) {
+        printf("generators: out of memory (%ld edges)\n", capacity);
+        return -1;
+    }
+
+    Rng rng;
+    rng_seed(&rng, seed);
+    long count = 0;
+    switch (kind) {
+        case GENERATOR_ERDOS_RENYI: count = erdos_renyi(edges, num_nodes, &rng); break;
+        case GENERATOR_GRID:        count = grid(edges, num_nodes, side); break;
+        case GENERATOR_TREE:        count = binary_tree(edges, num_nodes); break;
+        case GENERATOR_COMPLETE:    count = complete(edges, num_nodes); break;
+        case GENERATOR_POWER_LAW:   count = power_law(edges, num_nodes, &rng); break;
+        default: break;
+    }
+    return graph_build(graph, edges, count, num_nodes);
+}
@@ -0,0 +1,25 @@
+#ifndef GENERATORS_H
+#define GENERATORS_H
+
+#include <stdint.h>
+
+#include "graph.h"
+
+// Synthetic graph families for benchmarking
+typedef enum {
+    GENERATOR_ERDOS_RENYI, // G(n, m) with m = 2n random edges
+    GENERATOR_GRID,        // sqrt(n) x sqrt(n) lattice
+    GENERATOR_TREE,        // Complete binary tree
+    GENERATOR_COMPLETE,    // K_n
+    GENERATOR_POWER_LAW,   // Barabasi-Albert preferential attachment, 2 edges per node
+    GENERATOR_COUNT
+} GeneratorKind;
+
+// K_n has n(n-1)/2 edges, refuse anything bigger than this many nodes
+#define GENERATOR_COMPLETE_MAX_NODES 4000
+
+const char *generator_name(GeneratorKind kind);
+int generator_from_name(const char *name); // -1 if unknown
+int generate_graph(Graph *graph, GeneratorKind kind, int num_nodes, uint64_t seed);
+
+#endif
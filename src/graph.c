@@ -0,0 +1,939 @@
+#include "graph.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <limits.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Read-only view of a whole file
+typedef struct {
+    const char *data;
+    size_t size;
+} MappedFile;
+
+static int map_file(const char *path, MappedFile *file) {
+    file->data = NULL;
+    file->size = 0;
+
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        printf("graph: cannot open %s\n", path);
+        return -1;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        printf("graph: cannot stat %s\n", path);
+        close(fd);
+        return -1;
+    }
+    if (st.st_size > 0) {
+        void *data = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (data == MAP_FAILED) {
+            printf("graph: cannot map %s\n", path);
+            close(fd);
+            return -1;
+        }
+        madvise(data, (size_t)st.st_size, MADV_SEQUENTIAL);
+        file->data = data;
+        file->size = (size_t)st.st_size;
+    }
+    close(fd);
+    return 0;
+}
+
+static void unmap_file(MappedFile *file) {
+    if (file->data != NULL) {
+        munmap((void *)file->data, file->size);
+    }
+    file->data = NULL;
+    file->size = 0;
+}
+
+static const char *skip_blanks(const char *p, const char *end) {
+    while (p < end && (*p == ' ' || *p == '\t' || *p == '\r')) p++;
+    return p;
+}
+
+static const char *skip_line(const char *p, const char *end) {
+    const char *nl = memchr(p, '\n', (size_t)(end - p));
+    return nl ? nl + 1 : end;
+}
+
+// Parse an unsigned decimal, returns NULL if there is none or it overflows int
+static const char *parse_uint(const char *p, const char *end, long *value) {
+    const char *start = p;
+    long v = 0;
+    while (p < end && *p >= '0' && *p <= '9') {
+        v = v * 10 + (*p - '0');
+        if (v > INT_MAX) return NULL;
+        p++;
+    }
+    if (p == start) return NULL;
+    *value = v;
+    return p;
+}
+
+static long count_char(const char *p, const char *end, char c) {
+    long count = 0;
+    while (p < end && (p = memchr(p, c, (size_t)(end - p))) != NULL) {
+        count++;
+        p++;
+    }
+    return count;
+}
+
+static Edge *allocate_edges(long capacity) {
+    Edge *edges = malloc((size_t)(capacity > 0 ? capacity : 1) * sizeof(Edge));
+    if (edges == NULL) {
+        printf("graph: out of memory (%ld edges)\n", capacity);
+    }
+    return edges;
+}
+
+// "u v [anything]" per line, 0-based ids, '#' and '%' start comments
+static int parse_edge_list(Graph *graph, const char *p, const char *end, const char *path) {
+    long capacity = count_char(p, end, '\n') + 1; // Upper bound, one edge per line
+    Edge *edges = allocate_edges(capacity);
+    if (edges == NULL) return -1;
+
+    long count = 0;
+    long max_id = -1;
+    int line = 1;
+    while (p < end) {
+        p = skip_blanks(p, end);
+        if (p == end) break;
+        if (*p == '\n' || *p == '#' || *p == '%') {
+            p = skip_line(p, end);
+            line++;
+            continue;
+        }
+
+        long from, to;
+        const char *q = parse_uint(p, end, &from);
+        if (q != NULL) q = parse_uint(skip_blanks(q, end), end, &to);
+        if (q == NULL) {
+            printf("graph: %s:%d: expected two node ids\n", path, line);
+            free(edges);
+            return -1;
+        }
+        if (from >= INT_MAX || to >= INT_MAX) { // The node count must fit in an int too
+            printf("graph: %s:%d: node id %ld is too large\n", path, line, from > to ? from : to);
+            free(edges);
+            return -1;
+        }
+        edges[count].from = (int)from;
+        edges[count].to = (int)to;
+        count++;
+        if (from > max_id) max_id = from;
+        if (to > max_id) max_id = to;
+
+        p = skip_line(q, end);
+        line++;
+    }
+
+    return graph_build(graph, edges, count, (int)(max_id + 1));
+}
+
+// Matrix Market coordinate format, 1-based indices, the header gives the entry count
+static int parse_matrix_market(Graph *graph, const char *p, const char *end, const char *path) {
+    const char *header_end = skip_line(p, end);
+    const char *coordinate = "coordinate";
+    int is_coordinate = 0;
+    for (const char *s = p; s + 10 <= header_end; s++) {
+        if (strncasecmp(s, coordinate, 10) == 0) {
+            is_coordinate = 1;
+            break;
+        }
+    }
+    if (!is_coordinate) {
+        printf("graph: %s: only coordinate Matrix Market files are supported\n", path);
+        return -1;
+    }
+    p = header_end;
+    int line = 2;
+    while (p < end && (*p == '%' || *skip_blanks(p, end) == '\n')) {
+        p = skip_line(p, end);
+        line++;
+    }
+
+    long rows, cols, entries;
+    const char *q = parse_uint(skip_blanks(p, end), end, &rows);
+    if (q != NULL) q = parse_uint(skip_blanks(q, end), end, &cols);
+    if (q != NULL) q = parse_uint(skip_blanks(q, end), end, &entries);
+    if (q == NULL) {
+        printf("graph: %s:%d: expected \"rows cols entries\"\n", path, line);
+        return -1;
+    }
+    p = skip_line(q, end);
+    line++;
+
+    Edge *edges = allocate_edges(entries);
+    if (edges == NULL) return -1;
+
+    long count = 0;
+    while (p < end && count < entries) {
+        p = skip_blanks(p, end);
+        if (p < end && (*p == '\n' || *p == '%')) {
+            p = skip_line(p, end);
+            line++;
+            continue;
+        }
+
+        long i, j;
+        q = parse_uint(p, end, &i);
+        if (q != NULL) q = parse_uint(skip_blanks(q, end), end, &j);
+        if (q == NULL || i < 1 || j < 1 || i > rows || j > cols) {
+            printf("graph: %s:%d: bad matrix entry\n", path, line);
+            free(edges);
+            return -1;
+        }
+        edges[count].from = (int)(i - 1);
+        edges[count].to = (int)(j - 1);
+        count++;
+
+        p = skip_line(q, end);
+        line++;
+    }
+
+    return graph_build(graph, edges, count, (int)(rows > cols ? rows : cols));
+}
+
+// DOT tokens
+typedef enum {
+    TOKEN_END,
+    TOKEN_ID,
+    TOKEN_EDGE_OP, // "--" or "->"
+    TOKEN_PUNCT    // Single character in token.text[0]
+} TokenType;
+
+typedef struct {
+    TokenType type;
+    const char *text;
+    int length;
+} Token;
+
+static int is_id_char(char c) {
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') ||
+           c == '_' || c == '.' || (unsigned char)c >= 0x80;
+}
+
+static const char *next_token(const char *p, const char *end, Token *token) {
+    for (;;) {
+        while (p < end && (*p == ' ' || *p == '\t' || *p == '\r' || *p == '\n')) p++;
+        if (p + 1 < end && p[0] == '/' && p[1] == '/') {
+            p = skip_line(p, end);
+        } else if (p < end && p[0] == '#') {
+            p = skip_line(p, end);
+        } else if (p + 1 < end && p[0] == '/' && p[1] == '*') {
+            p += 2;
+            while (p + 1 < end && !(p[0] == '*' && p[1] == '/')) p++;
+            p = p + 2 < end ? p + 2 : end;
+        } else {
+            break;
+        }
+    }
+
+    token->text = p;
+    token->length = 0;
+    if (p == end) {
+        token->type = TOKEN_END;
+        return p;
+    }
+    if (p + 1 < end && p[0] == '-' && (p[1] == '-' || p[1] == '>')) {
+        token->type = TOKEN_EDGE_OP;
+        token->length = 2;
+        return p + 2;
+    }
+    if (*p == '"') {
+        const char *s = ++p;
+        while (p < end && *p != '"') {
+            if (*p == '\\' && p + 1 < end) p++;
+            p++;
+        }
+        token->type = TOKEN_ID;
+        token->text = s;
+        token->length = (int)(p - s);
+        return p < end ? p + 1 : end;
+    }
+    if (is_id_char(*p) || (*p == '-' && p + 1 < end && (is_id_char(p[1])))) {
+        const char *s = p++;
+        while (p < end && is_id_char(*p)) p++;
+        token->type = TOKEN_ID;
+        token->length = (int)(p - s);
+        return p;
+    }
+    token->type = TOKEN_PUNCT;
+    token->length = 1;
+    return p + 1;
+}
+
+static int token_is(const Token *token, const char *keyword) {
+    return token->type == TOKEN_ID && (int)strlen(keyword) == token->length &&
+           strncasecmp(token->text, keyword, (size_t)token->length) == 0;
+}
+
+// Name -> node id table, names live in one growing pool
+typedef struct {
+    int *slots;       // Node id + 1, 0 for empty
+    int num_slots;
+    int num_names;
+    char *pool;
+    size_t pool_size;
+    size_t pool_capacity;
+    int *offsets;
+    int offsets_capacity;
+} NameTable;
+
+static unsigned int hash_name(const char *s, int length) {
+    unsigned int h = 2166136261u; // FNV-1a
+    for (int i = 0; i < length; i++) {
+        h = (h ^ (unsigned char)s[i]) * 16777619u;
+    }
+    return h;
+}
+
+static int grow_names(NameTable *table) {
+    int num_slots = table->num_slots ? table->num_slots * 2 : 1024;
+    int *slots = calloc((size_t)num_slots, sizeof(int));
+    if (slots == NULL) return -1;
+    for (int i = 0; i < table->num_names; i++) {
+        const char *name = table->pool + table->offsets[i];
+        unsigned int h = hash_name(name, (int)strlen(name)) & (unsigned int)(num_slots - 1);
+        while (slots[h]) h = (h + 1) & (unsigned int)(num_slots - 1);
+        slots[h] = i + 1;
+    }
+    free(table->slots);
+    table->slots = slots;
+    table->num_slots = num_slots;
+    return 0;
+}
+
+static int intern_name(NameTable *table, const char *s, int length) {
+    if (2 * (table->num_names + 1) > table->num_slots && grow_names(table) != 0) return -1;
+
+    unsigned int mask = (unsigned int)(table->num_slots - 1);
+    unsigned int h = hash_name(s, length) & mask;
+    while (table->slots[h]) {
+        const char *name = table->pool + table->offsets[table->slots[h] - 1];
+        if (strncmp(name, s, (size_t)length) == 0 && name[length] == '\0') {
+            return table->slots[h] - 1;
+        }
+        h = (h + 1) & mask;
+    }
+
+    if (table->pool_size + (size_t)length + 1 > table->pool_capacity) {
+        size_t capacity = table->pool_capacity ? table->pool_capacity * 2 : 4096;
+        while (capacity < table->pool_size + (size_t)length + 1) capacity *= 2;
+        char *pool = realloc(table->pool, capacity);
+        if (pool == NULL) return -1;
+        table->pool = pool;
+        table->pool_capacity = capacity;
+    }
+    if (table->num_names == table->offsets_capacity) {
+        int capacity = table->offsets_capacity ? table->offsets_capacity * 2 : 1024;
+        int *offsets = realloc(table->offsets, (size_t)capacity * sizeof(int));
+        if (offsets == NULL) return -1;
+        table->offsets = offsets;
+        table->offsets_capacity = capacity;
+    }
+
+    int id = table->num_names++;
+    table->offsets[id] = (int)table->pool_size;
+    memcpy(table->pool + table->pool_size, s, (size_t)length);
+    table->pool[table->pool_size + (size_t)length] = '\0';
+    table->pool_size += (size_t)length + 1;
+    table->slots[h] = id + 1;
+    return id;
+}
+
+// Graphviz DOT: node and edge statements, edge chains, attribute lists are skipped.
+// Directed edges are treated as undirected, subgraph edge operands are not supported.
+static int parse_dot(Graph *graph, const char *p, const char *end, const char *path) {
+    // Every edge comes from one operator, so counting them bounds the edge count
+    long capacity = 0;
+    for (const char *s = p; s + 1 < end; s++) {
+        if (s[0] == '-' && (s[1] == '-' || s[1] == '>')) {
+            capacity++;
+            s++;
+        }
+    }
+    Edge *edges = allocate_edges(capacity);
+    if (edges == NULL) return -1;
+
+    NameTable names = {0};
+    long count = 0;
+    int prev = -1;        // Left operand of a pending edge
+    int pending_edge = 0; // Saw an edge operator after prev
+    int skip_id = 0;      // Next id is a graph name or a port, not a node
+    Token token, lookahead;
+    int have_lookahead = 0;
+    int failed = 0;
+
+    for (;;) {
+        if (have_lookahead) {
+            token = lookahead;
+            have_lookahead = 0;
+        } else {
+            p = next_token(p, end, &token);
+        }
+        if (token.type == TOKEN_END) break;
+
+        if (token.type == TOKEN_EDGE_OP) {
+            pending_edge = prev >= 0;
+            continue;
+        }
+        if (token.type == TOKEN_PUNCT) {
+            char c = token.text[0];
+            if (c == '[') { // Attribute list
+                int depth = 1;
+                while (depth > 0) {
+                    p = next_token(p, end, &token);
+                    if (token.type == TOKEN_END) break;
+                    if (token.type == TOKEN_PUNCT && token.text[0] == '[') depth++;
+                    if (token.type == TOKEN_PUNCT && token.text[0] == ']') depth--;
+                }
+            } else if (c == ':') { // Port
+                skip_id = 1;
+            } else {
+                prev = -1;
+                pending_edge = 0;
+                skip_id = 0;
+            }
+            continue;
+        }
+
+        // Identifier
+        if (token_is(&token, "strict") || token_is(&token, "node") || token_is(&token, "edge")) {
+            prev = -1;
+            pending_edge = 0;
+            continue;
+        }
+        if (token_is(&token, "graph") || token_is(&token, "digraph") || token_is(&token, "subgraph")) {
+            prev = -1;
+            pending_edge = 0;
+            skip_id = 1;
+            continue;
+        }
+        if (skip_id) {
+            skip_id = 0;
+            continue;
+        }
+
+        p = next_token(p, end, &lookahead);
+        if (lookahead.type == TOKEN_PUNCT && lookahead.text[0] == '=') { // id = id
+            p = next_token(p, end, &lookahead);
+            prev = -1;
+            pending_edge = 0;
+            continue;
+        }
+        have_lookahead = 1;
+
+        int id = intern_name(&names, token.text, token.length);
+        if (id < 0) {
+            printf("graph: out of memory reading %s\n", path);
+            failed = 1;
+            break;
+        }
+        if (pending_edge && count < capacity) {
+            edges[count].from = prev;
+            edges[count].to = id;
+            count++;
+        }
+        prev = id;
+        pending_edge = 0;
+    }
+
+    free(names.slots);
+    if (failed || graph_build(graph, edges, count, names.num_names) != 0) {
+        free(names.pool);
+        free(names.offsets);
+        return -1;
+    }
+    graph->name_pool = names.pool;
+    graph->name_offsets = names.offsets;
+    return 0;
+}
+
+static int has_extension(const char *path, const char *extension) {
+    size_t n = strlen(path);
+    size_t m = strlen(extension);
+    return n >= m && strcasecmp(path + n - m, extension) == 0;
+}
+
+// Load an edge list, DOT or Matrix Market file, picked by header or extension
+int graph_load(Graph *graph, const char *path) {
+    memset(graph, 0, sizeof(*graph));
+
+    MappedFile file;
+    if (map_file(path, &file) != 0) {
+        return -1;
+    }
+    const char *p = file.data;
+    const char *end = file.data + file.size;
+
+    Token first;
+    next_token(p, end, &first);
+    int result;
+    if (file.size >= 14 && strncmp(p, "%%MatrixMarket", 14) == 0) {
+        result = parse_matrix_market(graph, p, end, path);
+    } else if (has_extension(path, ".dot") || has_extension(path, ".gv") ||
+               token_is(&first, "graph") || token_is(&first, "digraph") || token_is(&first, "strict")) {
+        result = parse_dot(graph, p, end, path);
+    } else {
+        result = parse_edge_list(graph, p, end, path);
+    }
+    unmap_file(&file);
+
+    if (result == 0 && graph->num_nodes == 0) {
+        printf("graph: %s has no nodes\n", path);
+        graph_free(graph);
+        result = -1;
+    }
+    return result;
+}
+
+static int compare_ints(const void *a, const void *b) {
+    int x = *(const int *)a;
+    int y = *(const int *)b;
+    return (x > y) - (x < y);
+}
+
+static void sort_ints(int *a, int n) {
+    if (n > 16) {
+        qsort(a, (size_t)n, sizeof(int), compare_ints);
+        return;
+    }
+    for (int i = 1; i < n; i++) {
+        int v = a[i];
+        int j = i - 1;
+        while (j >= 0 && a[j] > v) {
+            a[j + 1] = a[j];
+            j--;
+        }
+        a[j + 1] = v;
+    }
+}
+
+// Build the CSR arrays from a raw edge list with a counting sort. Self loops
+// and duplicate or reversed edges are dropped.
+int graph_build_arrays(Graph *graph, const Edge *edges, long num_edges, int num_nodes, int *offsets, int *adjacency,
+                       Edge *edges_out) {
+    if (num_edges > INT_MAX / 2) {
+        printf("graph: too many edges (%ld)\n", num_edges);
+        return -1;
+    }
+
+    memset(offsets, 0, ((size_t)num_nodes + 1) * sizeof(int));
+    for (long e = 0; e < num_edges; e++) {
+        if (edges[e].from != edges[e].to) {
+            offsets[edges[e].from + 1]++;
+            offsets[edges[e].to + 1]++;
+        }
+    }
+    for (int v = 0; v < num_nodes; v++) {
+        offsets[v + 1] += offsets[v];
+    }
+
+    // Filling advances offsets[v] to the end of row v, shifting back restores the starts
+    for (long e = 0; e < num_edges; e++) {
+        int from = edges[e].from;
+        int to = edges[e].to;
+        if (from != to) {
+            adjacency[offsets[from]++] = to;
+            adjacency[offsets[to]++] = from;
+        }
+    }
+    for (int v = num_nodes; v > 0; v--) {
+        offsets[v] = offsets[v - 1];
+    }
+    offsets[0] = 0;
+
+    // Sort and deduplicate each row, compacting in place
+    int write = 0;
+    for (int v = 0; v < num_nodes; v++) {
+        int begin = offsets[v];
+        int row_end = offsets[v + 1];
+        offsets[v] = write;
+        sort_ints(adjacency + begin, row_end - begin);
+        for (int k = begin; k < row_end; k++) {
+            if (k == begin || adjacency[k] != adjacency[k - 1]) {
+                adjacency[write++] = adjacency[k];
+            }
+        }
+    }
+    offsets[num_nodes] = write;
+
+    // Each undirected edge once, from < to
+    int m = 0;
+    for (int v = 0; v < num_nodes; v++) {
+        for (int k = offsets[v]; k < offsets[v + 1]; k++) {
+            if (adjacency[k] > v) {
+                edges_out[m].from = v;
+                edges_out[m].to = adjacency[k];
+                m++;
+            }
+        }
+    }
+
+    memset(graph, 0, sizeof(*graph));
+    graph->num_nodes = num_nodes;
+    graph->num_edges = m;
+    graph->edges = edges_out;
+    graph->offsets = offsets;
+    graph->adjacency = adjacency;
+    graph->borrowed = 1;
+    return 0;
+}
+
+// Takes ownership of `edges`, which is reused for the deduplicated edge list
+int graph_build(Graph *graph, Edge *edges, long num_edges, int num_nodes) {
+    int *offsets = malloc(((size_t)num_nodes + 1) * sizeof(int));
+    int *adjacency = malloc((size_t)(num_edges > 0 ? 2 * num_edges : 1) * sizeof(int));
+    if (offsets == NULL || adjacency == NULL) {
+        printf("graph: out of memory (%d nodes, %ld edges)\n", num_nodes, num_edges);
+        free(offsets);
+        free(adjacency);
+        free(edges);
+        return -1;
+    }
+    if (graph_build_arrays(graph, edges, num_edges, num_nodes, offsets, adjacency, edges) != 0) {
+        free(offsets);
+        free(adjacency);
+        free(edges);
+        return -1;
+    }
+    graph->borrowed = 0;
+
+    int total = offsets[num_nodes];
+    if (total > 0) {
+        int *shrunk = realloc(adjacency, (size_t)total * sizeof(int));
+        if (shrunk != NULL) graph->adjacency = shrunk;
+    }
+    if (graph->num_edges > 0) {
+        Edge *shrunk = realloc(edges, (size_t)graph->num_edges * sizeof(Edge));
+        if (shrunk != NULL) graph->edges = shrunk;
+    }
+    return 0;
+}
+
+void graph_init_default(Graph *graph) {
+    static const Edge demo[] = {
+        {0, 1},   {0, 2},   {0, 3},   {1, 2},   {1, 4},   {2, 4},   // a-b a-c a-d b-c b-e c-e
+        {2, 5},   {3, 5},   {3, 6},   {4, 7},   {5, 7},   {5, 8},   // c-f d-f d-g e-h f-h f-i
+        {5, 9},   {5, 6},   {6, 10},  {7, 14},  {7, 11},  {8, 11},  // f-j f-g g-k h-o h-l i-l
+        {8, 12},  {8, 9},   {9, 12},  {9, 13},  {9, 10},  {10, 13}, // i-m i-j j-m j-n j-k k-n
+        {10, 17}, {11, 14}, {11, 12}, {12, 14}, {12, 15}, {12, 13}, // k-r l-o l-m m-o m-p m-n
+        {13, 16}, {13, 17}, {14, 18}, {14, 15}, {15, 18}, {15, 19}, // n-q n-r o-s o-p p-s p-t
+        {15, 16}, {16, 19}, {16, 17}, {17, 19}, {18, 20}, {19, 20}  // p-q q-t q-r r-t s-z t-z
+    };
+    int num_edges = (int)(sizeof(demo) / sizeof(demo[0]));
+
+    memset(graph, 0, sizeof(*graph));
+    Edge *edges = malloc(sizeof(demo));
+    if (edges == NULL) {
+        printf("graph: out of memory\n");
+        exit(1);
+    }
+    memcpy(edges, demo, sizeof(demo));
+    if (graph_build(graph, edges, num_edges, 21) != 0) {
+        exit(1);
+    }
+}
+
+const char *graph_node_name(const Graph *graph, int node, char *buffer, int size) {
+    if (graph->name_pool != NULL) {
+        return graph->name_pool + graph->name_offsets[node];
+    }
+    snprintf(buffer, (size_t)size, "%d", node);
+    return buffer;
+}
+
+// Position of `value` in the sorted row, or where it would be inserted
+static int row_search(const Graph *graph, int row, int value) {
+    int lo = graph->offsets[row], hi = graph->offsets[row + 1];
+    while (lo < hi) {
+        int mid = lo + (hi - lo) / 2;
+        if (graph->adjacency[mid] < value) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+int graph_has_edge(const Graph *graph, int u, int v) {
+    if (u < 0 || v < 0 || u >= graph->num_nodes || v >= graph->num_nodes) return 0;
+    int k = row_search(graph, u, v);
+    return k < graph->offsets[u + 1] && graph->adjacency[k] == v;
+}
+
+// Insert into / erase from a row, shifting everything after it. Insertion
+// needs room for one more entry past offsets[num_nodes].
+static void row_insert(Graph *graph, int row, int value) {
+    int k = row_search(graph, row, value);
+    int total = graph->offsets[graph->num_nodes];
+    memmove(graph->adjacency + k + 1, graph->adjacency + k, (size_t)(total - k) * sizeof(int));
+    graph->adjacency[k] = value;
+    for (int v = row + 1; v <= graph->num_nodes; v++) {
+        graph->offsets[v]++;
+    }
+}
+
+static void row_erase(Graph *graph, int row, int value) {
+    int k = row_search(graph, row, value);
+    int total = graph->offsets[graph->num_nodes];
+    memmove(graph->adjacency + k, graph->adjacency + k + 1, (size_t)(total - k - 1) * sizeof(int));
+    for (int v = row + 1; v <= graph->num_nodes; v++) {
+        graph->offsets[v]--;
+    }
+}
+
+static void *copy_array(const void *data, size_t size) {
+    void *copy = malloc(size > 0 ? size : 1);
+    if (copy != NULL && size > 0) {
+        memcpy(copy, data, size);
+    }
+    return copy;
+}
+
+// Heap copies of borrowed arrays, so the edits below can realloc them
+static int graph_own(Graph *graph) {
+    if (!graph->borrowed) return 0;
+    int n = graph->num_nodes;
+    Edge *edges = copy_array(graph->edges, (size_t)graph->num_edges * sizeof(Edge));
+    int *offsets = copy_array(graph->offsets, ((size_t)n + 1) * sizeof(int));
+    int *adjacency = copy_array(graph->adjacency, (size_t)graph->offsets[n] * sizeof(int));
+    char *name_pool = NULL;
+    int *name_offsets = NULL;
+    int names_failed = 0;
+    if (graph->name_pool != NULL && n > 0) {
+        const char *last = graph->name_pool + graph->name_offsets[n - 1];
+        name_pool = copy_array(graph->name_pool, (size_t)(last - graph->name_pool) + strlen(last) + 1);
+        name_offsets = copy_array(graph->name_offsets, (size_t)n * sizeof(int));
+        names_failed = name_pool == NULL || name_offsets == NULL;
+    }
+    if (edges == NULL || offsets == NULL || adjacency == NULL || names_failed) {
+        printf("graph: out of memory (%d nodes)\n", n);
+        free(edges);
+        free(offsets);
+        free(adjacency);
+        free(name_pool);
+        free(name_offsets);
+        return -1;
+    }
+    graph->edges = edges;
+    graph->offsets = offsets;
+    graph->adjacency = adjacency;
+    graph->name_pool = name_pool;
+    graph->name_offsets = name_offsets;
+    graph->borrowed = 0;
+    graph->edge_capacity = 0;
+    return 0;
+}
+
+static int name_taken(const Graph *graph, const char *name) {
+    for (int v = 0; v < graph->num_nodes; v++) {
+        if (strcmp(graph->name_pool + graph->name_offsets[v], name) == 0) return 1;
+    }
+    return 0;
+}
+
+// New isolated node, returns its id or -1. Named graphs name it after its
+// number, or the next number no other node is named after.
+int graph_add_node(Graph *graph) {
+    if (graph_own(graph) != 0) return -1;
+    int id = graph->num_nodes;
+    int *offsets = realloc(graph->offsets, ((size_t)id + 2) * sizeof(int));
+    if (offsets == NULL) {
+        printf("graph: out of memory (%d nodes)\n", id + 1);
+        return -1;
+    }
+    graph->offsets = offsets;
+    offsets[id + 1] = offsets[id];
+
+    if (graph->name_pool != NULL) {
+        // Names are interned in id order, so the pool ends after the last one
+        size_t used = id > 0 ? (size_t)graph->name_offsets[id - 1] + strlen(graph->name_pool + graph->name_offsets[id - 1]) + 1 : 0;
+        char name[16];
+        long number = id;
+        int length = snprintf(name, sizeof(name), "%ld", number);
+        while (name_taken(graph, name)) { // A DOT file may use numbers as names
+            length = snprintf(name, sizeof(name), "%ld", ++number);
+        }
+        char *pool = realloc(graph->name_pool, used + (size_t)length + 1);
+        int *name_offsets = realloc(graph->name_offsets, ((size_t)id + 1) * sizeof(int));
+        if (pool != NULL) graph->name_pool = pool;
+        if (name_offsets != NULL) graph->name_offsets = name_offsets;
+        if (pool == NULL || name_offsets == NULL) {
+            printf("graph: out of memory (%d names)\n", id + 1);
+            return -1;
+        }
+        memcpy(pool + used, name, (size_t)length + 1);
+        name_offsets[id] = (int)used;
+    }
+    graph->num_nodes++;
+    return id;
+}
+
+// Returns 1 if the edge was added, 0 for a loop or an existing edge, -1 on failure
+int graph_add_edge(Graph *graph, int u, int v) {
+    if (u < 0 || v < 0 || u >= graph->num_nodes || v >= graph->num_nodes) {
+        printf("graph: no edge %d-%d, the graph has %d nodes\n", u, v, graph->num_nodes);
+        return -1;
+    }
+    if (u == v || graph_has_edge(graph, u, v)) return 0;
+    if (graph_own(graph) != 0) return -1;
+
+    // Room doubles, so a run of additions costs amortized O(1) reallocations each
+    int capacity = graph->edge_capacity > graph->num_edges ? graph->edge_capacity : graph->num_edges;
+    if (graph->num_edges == capacity) {
+        capacity = capacity >= 8 ? 2 * capacity : 16;
+        int *adjacency = realloc(graph->adjacency, 2 * (size_t)capacity * sizeof(int));
+        if (adjacency != NULL) graph->adjacency = adjacency;
+        Edge *edges = realloc(graph->edges, (size_t)capacity * sizeof(Edge));
+        if (edges != NULL) graph->edges = edges;
+        if (adjacency == NULL || edges == NULL) {
+            printf("graph: out of memory (%d edges)\n", graph->num_edges + 1);
+            return -1;
+        }
+        graph->edge_capacity = capacity;
+    }
+    row_insert(graph, u, v);
+    row_insert(graph, v, u);
+    graph->edges[graph->num_edges].from = u < v ? u : v;
+    graph->edges[graph->num_edges].to = u < v ? v : u;
+    graph->num_edges++;
+    return 1;
+}
+
+// Returns 1 if the edge was removed, 0 if there was none, -1 on failure. The
+// last edge of the list takes the place of the removed one.
+int graph_remove_edge(Graph *graph, int u, int v) {
+    if (!graph_has_edge(graph, u, v)) return 0;
+    if (graph_own(graph) != 0) return -1;
+    row_erase(graph, u, v);
+    row_erase(graph, v, u);
+    int from = u < v ? u : v, to = u < v ? v : u;
+    for (int e = 0; e < graph->num_edges; e++) {
+        if (graph->edges[e].from == from && graph->edges[e].to == to) {
+            graph->edges[e] = graph->edges[--graph->num_edges];
+            break;
+        }
+    }
+    return 1;
+}
+
+// Remove a node and its edges in one compacting pass; ids above v move down by one
+int graph_remove_node(Graph *graph, int v) {
+    if (v < 0 || v >= graph->num_nodes) {
+        printf("graph: no node %d, the graph has %d nodes\n", v, graph->num_nodes);
+        return -1;
+    }
+    if (graph_own(graph) != 0) return -1;
+    int n = graph->num_nodes;
+    int write = 0;
+    for (int w = 0, row = 0; w < n; w++) {
+        int begin = graph->offsets[w], end = graph->offsets[w + 1];
+        if (w == v) continue;
+        graph->offsets[row++] = write;
+        for (int k = begin; k < end; k++) {
+            int neighbour = graph->adjacency[k];
+            if (neighbour != v) {
+                graph->adjacency[write++] = neighbour > v ? neighbour - 1 : neighbour;
+            }
+        }
+    }
+    graph->offsets[n - 1] = write;
+
+    int m = 0;
+    for (int e = 0; e < graph->num_edges; e++) {
+        Edge edge = graph->edges[e];
+        if (edge.from == v || edge.to == v) continue;
+        edge.from -= edge.from > v;
+        edge.to -= edge.to > v;
+        graph->edges[m++] = edge;
+    }
+    graph->num_edges = m;
+
+    if (graph->name_offsets != NULL) {
+        memmove(graph->name_offsets + v, graph->name_offsets + v + 1, (size_t)(n - v - 1) * sizeof(int));
+    }
+    graph->num_nodes--;
+    return 0;
+}
+
+// Give node order[i] the id i, for every i. Rows and the edge list are rebuilt
+// in the new numbering, so edges are sorted by their lower end; names move with
+// their nodes. Borrowed arrays are replaced by heap ones.
+int graph_renumber(Graph *graph, const int *order) {
+    int n = graph->num_nodes, m = graph->num_edges;
+    int *rank = malloc((size_t)(n > 0 ? n : 1) * sizeof(int));
+    Edge *edges = malloc((size_t)(m > 0 ? m : 1) * sizeof(Edge));
+    char *name_pool = NULL;
+    int *name_offsets = NULL;
+    size_t pool_size = 0;
+    if (graph->name_pool != NULL) {
+        for (int v = 0; v < n; v++) {
+            pool_size += strlen(graph->name_pool + graph->name_offsets[v]) + 1;
+        }
+        name_pool = malloc(pool_size > 0 ? pool_size : 1);
+        name_offsets = malloc((size_t)(n > 0 ? n : 1) * sizeof(int));
+    }
+    if (rank == NULL || edges == NULL || (graph->name_pool != NULL && (name_pool == NULL || name_offsets == NULL))) {
+        printf("graph: out of memory (%d nodes)\n", n);
+        free(rank);
+        free(edges);
+        free(name_pool);
+        free(name_offsets);
+        return -1;
+    }
+
+    for (int i = 0; i < n; i++) {
+        rank[order[i]] = i;
+    }
+    for (int e = 0; e < m; e++) {
+        int a = rank[graph->edges[e].from], b = rank[graph->edges[e].to];
+        edges[e].from = a < b ? a : b;
+        edges[e].to = a < b ? b : a;
+    }
+    free(rank);
+    if (name_pool != NULL) {
+        size_t used = 0;
+        for (int i = 0; i < n; i++) {
+            const char *name = graph->name_pool + graph->name_offsets[order[i]];
+            size_t length = strlen(name) + 1;
+            memcpy(name_pool + used, name, length);
+            name_offsets[i] = (int)used;
+            used += length;
+        }
+    }
+
+    Graph renumbered;
+    if (graph_build(&renumbered, edges, m, n) != 0) {
+        free(name_pool);
+        free(name_offsets);
+        return -1;
+    }
+    renumbered.name_pool = name_pool;
+    renumbered.name_offsets = name_offsets;
+    graph_free(graph);
+    *graph = renumbered;
+    return 0;
+}
+
+void graph_free(Graph *graph) {
+    if (!graph->borrowed) {
+        free(graph->edges);
+        free(graph->offsets);
+        free(graph->adjacency);
+        free(graph->name_pool);
+        free(graph->name_offsets);
+    }
+    memset(graph, 0, sizeof(*graph));
+}
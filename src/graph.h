@@ -0,0 +1,49 @@
+#ifndef GRAPH_H
+#define GRAPH_H
+
+#include "layout.h"
+
+// Undirected simple graph in compressed sparse row form. Neighbours of node v
+// are adjacency[offsets[v] .. offsets[v + 1]), sorted ascending. The edge list
+// holds every edge once with from < to and drives the attraction pass.
+typedef struct {
+    int num_nodes;
+    int num_edges;
+    Edge *edges;
+    int *offsets;    // num_nodes + 1 entries
+    int *adjacency;  // 2 * num_edges entries
+
+    // Node names for formats that have them (DOT), NULL otherwise
+    char *name_pool;
+    int *name_offsets;
+
+    // Arrays point into memory the graph does not own (a mapped checkpoint);
+    // edits copy them to the heap first and graph_free leaves them alone
+    int borrowed;
+
+    // Edges the edge list has room for (the adjacency twice as many), grown
+    // geometrically by graph_add_edge; 0 when the arrays hold num_edges exactly
+    int edge_capacity;
+} Graph;
+
+int graph_load(Graph *graph, const char *path);
+void graph_init_default(Graph *graph);
+int graph_build(Graph *graph, Edge *edges, long num_edges, int num_nodes);
+// graph_build into caller-owned arrays, which the graph then borrows: offsets
+// takes num_nodes + 1 entries, adjacency 2 * num_edges and edges_out
+// num_edges (it may be `edges`). No names.
+int graph_build_arrays(Graph *graph, const Edge *edges, long num_edges, int num_nodes, int *offsets, int *adjacency,
+                       Edge *edges_out);
+const char *graph_node_name(const Graph *graph, int node, char *buffer, int size);
+
+// In-place edits for live graphs, each O(n + m) memory moves at worst. Removing
+// a node shifts the ids above it down by one, so rows stay sorted.
+int graph_has_edge(const Graph *graph, int u, int v);
+int graph_add_node(Graph *graph);
+int graph_add_edge(Graph *graph, int u, int v);
+int graph_remove_edge(Graph *graph, int u, int v);
+int graph_remove_node(Graph *graph, int v);
+int graph_renumber(Graph *graph, const int *order); // Node order[i] becomes node i
+void graph_free(Graph *graph);
+
+#endif
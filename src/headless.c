@@ -0,0 +1,763 @@
+// Command-line layout tool: no window, no fonts, no SDL. Runs the force model
+// at full speed and writes node positions as tab separated text.
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <errno.h>
+#include <limits.h>
+#include <math.h>
+
+#include "layout.h"
+#include "graph.h"
+#include "forces.h"
+#include "threadpool.h"
+#include "profile.h"
+#include "cooling.h"
+#include "incremental.h"
+#include "placement.h"
+#include "checkpoint.h"
+#include "capture.h"
+#include "components.h"
+#include "reorder.h"
+#include "stream.h"
+#include "metrics.h"
+
+#define DEFAULT_ITERATIONS 200
+#define OUTPUT_BUFFER_SIZE (1 << 20)
+#define MAX_EDIT_NODES 64 // Ids on one line of an edit script
+
+static void usage(const char *program) {
+    printf("Usage: %s [options] graph-file\n"
+           "       %s [options] --resume=FILE\n"
+           "  --output=FILE          Positions file, default stdout\n"
+           "  --dimensions=N         2 or 3 (default 2); 3D uses random placement and the\n"
+           "                         exact repulsion kernel\n"
+           "  --iterations=N         Iterations to run (default %d)\n"
+           "  --temperature=T        Initial maximum displacement (default %.0f, %.0f after a\n"
+           "                         structured placement)\n"
+           "  --cooling=F            Temperature multiplier when cooling (default %.2f)\n"
+           "  --schedule=NAME        adaptive (energy driven) or fixed (default adaptive)\n"
+           "  --tolerance=F          Stop once nodes move less than F pixels on average,\n"
+           "                         0 runs every iteration (default %.2f)\n"
+           "  --no-freeze            Keep integrating nodes that have stopped moving\n"
+           "  --placement=NAME       Initial positions: random, bfs, pivot-mds or multilevel\n"
+           "                         (default random)\n"
+           "  --seed=N               Seed for the initial positions (default 1)\n"
+           "  --every=N              Also write positions every N iterations (default 0, final only)\n"
+           "  --repulsion=MODE       exact, barnes-hut or auto (default auto)\n"
+           "  --theta=F              Barnes-Hut opening angle (default %.1f)\n"
+           "  --kernels=NAME         auto, scalar, sse2 or avx2 (default auto)\n"
+           "  --threads=N            Worker threads, 0 for one per core (default 0)\n"
+           "  --components           Lay out each connected component on its own, in\n"
+           "                         parallel, and pack them into the box\n"
+           "  --reorder=NAME         Renumber the nodes for memory locality before the first\n"
+           "                         iteration: none, rcm or hilbert (default none); output\n"
+           "                         keeps the original ids\n"
+           "  --resort-every=N       Re-sort a reordered layout along a Hilbert curve every N\n"
+           "                         iterations, 0 never (default %d)\n"
+           "  --edits=FILE           After the layout, apply the edits in FILE with local\n"
+           "                         relaxation, one per line: add-node [neighbours...],\n"
+           "                         remove-node V, add-edge U V, remove-edge U V\n"
+           "  --trace=FILE           Write per-iteration phase timings as Chrome trace JSON\n"
+           "  --checkpoint=FILE      Save the graph and layout state to FILE at the end\n"
+           "  --checkpoint-every=N   Also save it every N iterations (default 0, end only)\n"
+           "  --capture=DIR          Render every iteration offscreen and write the frames\n"
+           "                         to DIR/frame_NNNNNN.png on a background thread\n"
+           "  --capture-format=NAME  png or ppm (default png)\n"
+           "  --capture-size=WxH     Frame size in pixels (default %dx%d)\n"
+           "  --capture-queue=N      Frames buffered for the encoder; when it falls further\n"
+           "                         behind frames are dropped (default %d)\n"
+           "  --resume=FILE          Continue from a checkpoint instead of a graph file; the\n"
+           "                         cooling state comes from the file and --iterations\n"
+           "                         counts from the start of the original run\n"
+           "  --serve=ADDRESS        Stream the layout to clients on unix:PATH or [HOST:]PORT\n"
+           "                         and take play, pause, step, temperature and edit\n"
+           "                         requests from them; runs until a client asks it to\n"
+           "                         quit or it is interrupted\n"
+           "  --stream-threshold=F   Pixels a node must move before it is streamed again\n"
+           "                         (default %.2f)\n"
+           "  --stream-log=FILE      Write per-iteration stream statistics to FILE\n"
+           "  --metrics-every=N      Measure edge crossings, sampled stress and edge lengths\n"
+           "                         every N iterations on a background thread, and once\n"
+           "                         more at the end (default 0, off)\n"
+           "  --metrics-log=FILE     Write every measurement to FILE\n"
+           "  --quality-tolerance=F  Also stop once a measurement improves neither crossings\n"
+           "                         nor stress by more than the fraction F of the one before\n"
+           "                         (default 0, never; %.2f is a reasonable value)\n"
+           "Output lines are: iteration, node, x, y (and z in 3D)\n",
+           program, program, DEFAULT_ITERATIONS, START_TEMPERATURE, PLACEMENT_REFINE_TEMPERATURE, COOLING_FACTOR, CONVERGENCE_TOLERANCE, BARNES_HUT_THETA,
+           REORDER_RESORT_EVERY, CAPTURE_DEFAULT_WIDTH, CAPTURE_DEFAULT_HEIGHT, CAPTURE_DEFAULT_QUEUE,
+           STREAM_DEFAULT_THRESHOLD, METRICS_QUALITY_TOLERANCE);
+}
+
+// Rows follow the loaded ids; `current` gives the index of each in a reordered
+// layout, NULL if there is none. Names have moved along with their nodes.
+static void write_positions(FILE *out, const Graph *graph, const Nodes *nodes, const int *current, int iteration) {
+    char name[32];
+    for (int id = 0; id < nodes->count; id++) {
+        int i = current != NULL ? current[id] : id;
+        const char *node = graph_node_name(graph, graph->name_pool != NULL ? i : id, name, sizeof(name));
+        if (nodes->dimensions == 3) {
+            fprintf(out, "%d\t%s\t%.3f\t%.3f\t%.3f\n", iteration, node, nodes->x[i], nodes->y[i], nodes->z[i]);
+        } else {
+            fprintf(out, "%d\t%s\t%.3f\t%.3f\n", iteration, node, nodes->x[i], nodes->y[i]);
+        }
+    }
+}
+
+// Apply an edit script to the finished layout. Node ids refer to the graph as
+// it is when the line is reached. Returns the number of edits, -1 on error.
+static int apply_edits(const char *path, Graph *graph, Nodes *nodes, Rng *rng, double *seconds, double *slowest) {
+    FILE *file = fopen(path, "r");
+    if (file == NULL) {
+        printf("Cannot open %s\n", path);
+        return -1;
+    }
+    IncrementalLayout il = {0};
+    char line[1024];
+    int count = 0, line_number = 0, failed = 0;
+    *seconds = *slowest = 0.0;
+    while (!failed && fgets(line, sizeof(line), file) != NULL) {
+        line_number++;
+        char *command = strtok(line, " \t\r\n");
+        if (command == NULL || command[0] == '#') continue;
+        int ids[MAX_EDIT_NODES];
+        int num_ids = 0;
+        for (char *token = strtok(NULL, " \t\r\n"); token != NULL && !failed; token = strtok(NULL, " \t\r\n")) {
+            char *end;
+            errno = 0;
+            long id = strtol(token, &end, 10);
+            if (end == token || *end != '\0' || errno != 0 || id < 0 || id >= graph->num_nodes) {
+                printf("%s:%d: bad id \"%s\", the graph has %d nodes\n", path, line_number, token, graph->num_nodes);
+                failed = 1;
+            } else if (num_ids == MAX_EDIT_NODES) {
+                printf("%s:%d: more than %d ids\n", path, line_number, MAX_EDIT_NODES);
+                failed = 1;
+            } else {
+                ids[num_ids++] = (int)id;
+            }
+        }
+        if (failed) break;
+
+        // Timed as a whole: the CSR update of an edit can cost more than its relaxation
+        IncrementalStats stats = {0, 0, 0, 0.0};
+        double start = layout_seconds();
+        int result;
+        if (strcmp(command, "add-node") == 0) {
+            result = incremental_add_node(&il, graph, nodes, ids, num_ids, rng, &stats) >= 0 ? 1 : -1;
+        } else if (strcmp(command, "remove-node") == 0 && num_ids == 1) {
+            result = incremental_remove_node(&il, graph, nodes, ids[0], &stats);
+        } else if (strcmp(command, "add-edge") == 0 && num_ids == 2) {
+            result = incremental_add_edge(&il, graph, nodes, ids[0], ids[1], &stats);
+        } else if (strcmp(command, "remove-edge") == 0 && num_ids == 2) {
+            result = incremental_remove_edge(&il, graph, nodes, ids[0], ids[1], &stats);
+        } else {
+            printf("%s:%d: unknown edit \"%s\"\n", path, line_number, command);
+            result = -1;
+        }
+        double elapsed = layout_seconds() - start;
+        failed = result < 0;
+        if (result == 0) {
+            // An edge that is already there, or already gone: not an edit
+            printf("%s:%d: %s changes nothing\n", path, line_number, command);
+            continue;
+        }
+        count++;
+        *seconds += elapsed;
+        if (elapsed > *slowest) *slowest = elapsed;
+    }
+    incremental_free(&il);
+    fclose(file);
+    return failed ? -1 : count;
+}
+
+static volatile sig_atomic_t interrupted = 0;
+
+static void interrupt_handler(int signal_number) {
+    (void)signal_number;
+    interrupted = 1;
+}
+
+// One edit requested over the stream, relaxed locally like a scripted one.
+// Returns 1 if the graph changed.
+static int apply_stream_edit(const StreamControl *control, IncrementalLayout *il, Graph *graph, Nodes *nodes, Rng *rng) {
+    if (nodes->dimensions == 3) {
+        printf("Graph edits are only supported in 2D\n");
+        return 0;
+    }
+    IncrementalStats stats = {0, 0, 0, 0.0};
+    int u = control->node, v = control->other;
+    int result;
+    switch (control->edit) {
+        case STREAM_ADD_NODE:
+            result = incremental_add_node(il, graph, nodes, &u, u >= 0 && u < graph->num_nodes, rng, &stats) >= 0;
+            break;
+        case STREAM_REMOVE_NODE:
+            result = incremental_remove_node(il, graph, nodes, u, &stats);
+            break;
+        case STREAM_ADD_EDGE:
+            result = incremental_add_edge(il, graph, nodes, u, v, &stats);
+            break;
+        case STREAM_REMOVE_EDGE:
+            result = incremental_remove_edge(il, graph, nodes, u, v, &stats);
+            break;
+        default:
+            result = graph_has_edge(graph, u, v) ? incremental_remove_edge(il, graph, nodes, u, v, &stats)
+                                                 : incremental_add_edge(il, graph, nodes, u, v, &stats);
+            break;
+    }
+    if (result < 0) {
+        printf("Edit %d of %d-%d failed\n", control->edit, u, v);
+    }
+    return result > 0;
+}
+
+// Run the layout as a stream server: iterate while playing, or for requested
+// steps, and block in the server while there is nothing to do. Every
+// iteration and edit is published to the clients.
+static int serve_layout(StreamServer *server, Graph *graph, Nodes *nodes, ForceSettings *settings, Cooling *cooling,
+                        int *completed, int iterations, float tolerance, Rng *rng, Capture *capture, FILE *log) {
+    IncrementalLayout il = {0};
+    unsigned int graph_version = 1;
+    int playing = 1, converged = 0, steps = 0, quit = 0, failed = 0;
+    StreamControl controls[STREAM_MAX_CONTROLS];
+    if (log != NULL) {
+        fprintf(log, "iteration\tclients\tbytes\tnodes\tkeyframes\tencode_ms\titeration_ms\n");
+    }
+    int changed = 1;
+    double iteration_seconds = 0.0; // Of the iteration being published, 0 after an edit
+    while (!quit && !failed && !interrupted) {
+        int running = steps > 0 || (playing && !converged && *completed < iterations);
+        if (changed || stream_wants_frame(server)) {
+            unsigned int flags = (running ? STREAM_PLAYING : 0) | (converged ? STREAM_CONVERGED : 0);
+            StreamFrameStats frame;
+            failed |= stream_publish(server, graph, graph_version, nodes, *completed, flags, cooling->temperature, &frame) != 0;
+            if (log != NULL && changed) {
+                fprintf(log, "%d\t%d\t%zu\t%d\t%d\t%.3f\t%.3f\n", *completed, frame.clients, frame.bytes, frame.nodes,
+                        frame.keyframes, frame.seconds * 1000.0, iteration_seconds * 1000.0);
+            }
+        }
+
+        int num_controls = stream_poll(server, running ? 0 : -1, controls, STREAM_MAX_CONTROLS);
+        failed |= num_controls < 0;
+        changed = 0;
+        for (int c = 0; c < num_controls; c++) {
+            const StreamControl *control = &controls[c];
+            switch (control->type) {
+                case STREAM_PLAY:
+                    playing = 1;
+                    converged = 0; // Play on past convergence, until it converges again
+                    break;
+                case STREAM_PAUSE:
+                    playing = 0;
+                    steps = 0;
+                    break;
+                case STREAM_STEP:
+                    // Clients are untrusted: keep the iteration count from overflowing
+                    if (control->iterations > 0) {
+                        int room = INT_MAX - *completed - steps;
+                        steps += control->iterations < room ? control->iterations : room;
+                    }
+                    break;
+                case STREAM_TEMPERATURE:
+                    if (isfinite(control->temperature)) {
+                        cooling->temperature = control->temperature > 0.0f ? control->temperature : 0.0f;
+                    } else {
+                        printf("Ignored a temperature of %f from a client\n", control->temperature);
+                    }
+                    break;
+                case STREAM_EDIT:
+                    if (apply_stream_edit(control, &il, graph, nodes, rng)) {
+                        graph_version++;
+                        changed = 1;
+                        iteration_seconds = 0.0;
+                    }
+                    break;
+                default:
+                    quit = 1;
+                    break;
+            }
+        }
+
+        running = steps > 0 || (playing && !converged && *completed < iterations);
+        if (running && !quit) {
+            double start = layout_seconds();
+            ForceStats stats = calculate_forces(nodes, graph->edges, graph->num_edges, cooling->temperature, *completed, settings);
+            cooling_update(cooling, &stats);
+            (*completed)++;
+            steps -= steps > 0;
+            converged = tolerance > 0.0f && layout_converged(&stats, nodes->count, tolerance);
+            if (capture != NULL) {
+                capture_frame(capture, *completed, nodes->x, nodes->y, nodes->count, graph->edges, graph->num_edges);
+            }
+            iteration_seconds = layout_seconds() - start;
+            changed = 1;
+        }
+    }
+    incremental_free(&il);
+    return failed ? -1 : 0;
+}
+
+static void log_metrics(FILE *log, const LayoutMetrics *metrics) {
+    fprintf(log, "%d\t%lld\t%.6f\t%.3f\t%.6f\t%.3f\n", metrics->iteration, metrics->crossings, metrics->stress,
+            metrics->edge_mean, metrics->edge_cv, metrics->seconds * 1000.0);
+}
+
+// Log the newest background measurement if it has not been seen yet. Returns
+// 1 once it settled against the one before, with a tolerance above 0.
+static int poll_metrics(MetricsMonitor *monitor, int *seen, LayoutMetrics *previous, float tolerance, FILE *log) {
+    LayoutMetrics metrics;
+    int finished = metrics_monitor_latest(monitor, &metrics);
+    if (finished == *seen) return 0;
+    if (log != NULL) log_metrics(log, &metrics);
+    int settled = tolerance > 0.0f && *seen > 0 && metrics_settled(previous, &metrics, tolerance);
+    *seen = finished;
+    *previous = metrics;
+    return settled;
+}
+
+int main(int argc, char *argv[]) {
+    const char *graph_path = NULL;
+    const char *output_path = NULL;
+    const char *repulsion = "auto";
+    const char *kernel_name = "auto";
+    int iterations = DEFAULT_ITERATIONS;
+    float temperature = -1.0f; // Picked by the placement unless given
+    float cooling = COOLING_FACTOR;
+    unsigned int seed = 1;
+    int every = 0;
+    float theta = BARNES_HUT_THETA;
+    int num_threads = 0;
+    const char *trace_path = NULL;
+    const char *edits_path = NULL;
+    PlacementKind placement = PLACEMENT_RANDOM;
+    CoolingSchedule schedule = SCHEDULE_ADAPTIVE;
+    float tolerance = CONVERGENCE_TOLERANCE;
+    int freeze = 1;
+    int use_components = 0;
+    ReorderKind reorder = REORDER_NONE;
+    int resort_every = REORDER_RESORT_EVERY;
+    int dimensions = 2;
+    const char *checkpoint_path = NULL;
+    int checkpoint_every = 0;
+    const char *resume_path = NULL;
+    const char *capture_path = NULL;
+    CaptureFormat capture_format = CAPTURE_PNG;
+    int capture_width = CAPTURE_DEFAULT_WIDTH, capture_height = CAPTURE_DEFAULT_HEIGHT;
+    int capture_queue = CAPTURE_DEFAULT_QUEUE;
+    const char *serve_address = NULL;
+    float stream_threshold = STREAM_DEFAULT_THRESHOLD;
+    const char *stream_log_path = NULL;
+    int metrics_every = 0;
+    const char *metrics_log_path = NULL;
+    float quality_tolerance = 0.0f;
+
+    for (int i = 1; i < argc; i++) {
+        const char *arg = argv[i];
+        if (strncmp(arg, "--output=", 9) == 0) {
+            output_path = arg + 9;
+        } else if (strncmp(arg, "--dimensions=", 13) == 0) {
+            dimensions = atoi(arg + 13);
+            if (dimensions != 2 && dimensions != 3) {
+                printf("Dimensions must be 2 or 3\n");
+                return 1;
+            }
+        } else if (strncmp(arg, "--iterations=", 13) == 0) {
+            iterations = atoi(arg + 13);
+        } else if (strncmp(arg, "--temperature=", 14) == 0) {
+            temperature = (float)atof(arg + 14);
+        } else if (strncmp(arg, "--cooling=", 10) == 0) {
+            cooling = (float)atof(arg + 10);
+        } else if (strncmp(arg, "--seed=", 7) == 0) {
+            seed = (unsigned int)strtoul(arg + 7, NULL, 10);
+        } else if (strncmp(arg, "--every=", 8) == 0) {
+            every = atoi(arg + 8);
+        } else if (strncmp(arg, "--repulsion=", 12) == 0) {
+            repulsion = arg + 12;
+        } else if (strncmp(arg, "--theta=", 8) == 0) {
+            theta = (float)atof(arg + 8);
+        } else if (strncmp(arg, "--kernels=", 10) == 0) {
+            kernel_name = arg + 10;
+        } else if (strncmp(arg, "--threads=", 10) == 0) {
+            num_threads = atoi(arg + 10);
+        } else if (strncmp(arg, "--schedule=", 11) == 0) {
+            if (strcmp(arg + 11, "fixed") == 0) {
+                schedule = SCHEDULE_FIXED;
+            } else if (strcmp(arg + 11, "adaptive") == 0) {
+                schedule = SCHEDULE_ADAPTIVE;
+            } else {
+                printf("Unknown schedule \"%s\"\n", arg + 11);
+                return 1;
+            }
+        } else if (strncmp(arg, "--tolerance=", 12) == 0) {
+            tolerance = (float)atof(arg + 12);
+        } else if (strcmp(arg, "--components") == 0) {
+            use_components = 1;
+        } else if (strncmp(arg, "--reorder=", 10) == 0) {
+            int kind = reorder_from_name(arg + 10);
+            if (kind < 0) {
+                printf("Unknown reordering \"%s\"\n", arg + 10);
+                return 1;
+            }
+            reorder = kind;
+        } else if (strncmp(arg, "--resort-every=", 15) == 0) {
+            resort_every = atoi(arg + 15);
+        } else if (strcmp(arg, "--no-freeze") == 0) {
+            freeze = 0;
+        } else if (strncmp(arg, "--placement=", 12) == 0) {
+            int kind = placement_from_name(arg + 12);
+            if (kind < 0) {
+                printf("Unknown placement \"%s\"\n", arg + 12);
+                return 1;
+            }
+            placement = kind;
+        } else if (strncmp(arg, "--edits=", 8) == 0) {
+            edits_path = arg + 8;
+        } else if (strncmp(arg, "--trace=", 8) == 0) {
+            trace_path = arg + 8;
+        } else if (strncmp(arg, "--checkpoint=", 13) == 0) {
+            checkpoint_path = arg + 13;
+        } else if (strncmp(arg, "--checkpoint-every=", 19) == 0) {
+            checkpoint_every = atoi(arg + 19);
+        } else if (strncmp(arg, "--capture=", 10) == 0) {
+            capture_path = arg + 10;
+        } else if (strncmp(arg, "--capture-format=", 17) == 0) {
+            int format = capture_format_from_name(arg + 17);
+            if (format < 0) {
+                printf("Unknown capture format \"%s\"\n", arg + 17);
+                return 1;
+            }
+            capture_format = format;
+        } else if (strncmp(arg, "--capture-size=", 15) == 0) {
+            if (sscanf(arg + 15, "%dx%d", &capture_width, &capture_height) != 2) {
+                printf("Capture size must be WIDTHxHEIGHT\n");
+                return 1;
+            }
+        } else if (strncmp(arg, "--capture-queue=", 16) == 0) {
+            capture_queue = atoi(arg + 16);
+        } else if (strncmp(arg, "--resume=", 9) == 0) {
+            resume_path = arg + 9;
+        } else if (strncmp(arg, "--serve=", 8) == 0) {
+            serve_address = arg + 8;
+        } else if (strncmp(arg, "--stream-threshold=", 19) == 0) {
+            stream_threshold = (float)atof(arg + 19);
+        } else if (strncmp(arg, "--stream-log=", 13) == 0) {
+            stream_log_path = arg + 13;
+        } else if (strncmp(arg, "--metrics-every=", 16) == 0) {
+            metrics_every = atoi(arg + 16);
+        } else if (strncmp(arg, "--metrics-log=", 14) == 0) {
+            metrics_log_path = arg + 14;
+        } else if (strncmp(arg, "--quality-tolerance=", 20) == 0) {
+            quality_tolerance = (float)atof(arg + 20);
+        } else if (strcmp(arg, "--help") == 0 || arg[0] == '-') {
+            usage(argv[0]);
+            return strcmp(arg, "--help") == 0 ? 0 : 1;
+        } else {
+            graph_path = arg;
+        }
+    }
+    if ((graph_path == NULL) == (resume_path == NULL)) {
+        usage(argv[0]);
+        return 1;
+    }
+    if (use_components && (resume_path != NULL || dimensions == 3 || placement != PLACEMENT_RANDOM)) {
+        printf("--components starts every component from random positions in 2D, without --resume or --placement\n");
+        return 1;
+    }
+    if (use_components && reorder != REORDER_NONE) {
+        printf("--components lays out each component in its own numbering, without --reorder\n");
+        return 1;
+    }
+    if (checkpoint_every > 0 && checkpoint_path == NULL) {
+        printf("--checkpoint-every needs --checkpoint\n");
+        return 1;
+    }
+    if (serve_address != NULL &&
+        (use_components || reorder != REORDER_NONE || every > 0 || checkpoint_every > 0 || metrics_every > 0)) {
+        printf("--serve runs its own loop, without --components, --reorder, --every, --checkpoint-every or "
+               "--metrics-every\n");
+        return 1;
+    }
+    if ((metrics_log_path != NULL || quality_tolerance > 0.0f) && metrics_every <= 0) {
+        printf("--metrics-log and --quality-tolerance need --metrics-every\n");
+        return 1;
+    }
+
+    // A resumed run borrows the graph from the mapped checkpoint, nothing is parsed
+    Checkpoint resume;
+    Graph graph;
+    double load_start = layout_seconds();
+    if (resume_path != NULL) {
+        if (checkpoint_open(&resume, resume_path) != 0) {
+            return 1;
+        }
+        graph = resume.graph;
+        dimensions = resume.dimensions;
+    } else if (graph_load(&graph, graph_path) != 0) {
+        return 1;
+    }
+    double load_seconds = layout_seconds() - load_start;
+    if (dimensions == 3 && ((placement != PLACEMENT_RANDOM && resume_path == NULL) || edits_path != NULL)) {
+        printf("Structured placements and edits are only supported in 2D\n");
+        graph_free(&graph);
+        if (resume_path != NULL) checkpoint_close(&resume);
+        return 1;
+    }
+
+    ForceSettings settings = {REPULSION_EXACT, theta, force_kernels_select(kernel_name), NULL, NULL, freeze, NULL};
+    if (settings.kernels == NULL) {
+        printf("Force kernels \"%s\" are not available on this CPU\n", kernel_name);
+        graph_free(&graph);
+        if (resume_path != NULL) checkpoint_close(&resume);
+        return 1;
+    }
+    if (strcmp(repulsion, "barnes-hut") == 0 ||
+        (strcmp(repulsion, "auto") == 0 && graph.num_nodes > AUTO_BARNES_HUT_NODES)) {
+        settings.repulsion = REPULSION_BARNES_HUT;
+    } else if (strcmp(repulsion, "exact") != 0 && strcmp(repulsion, "auto") != 0) {
+        printf("Unknown repulsion mode \"%s\"\n", repulsion);
+        graph_free(&graph);
+        if (resume_path != NULL) checkpoint_close(&resume);
+        return 1;
+    }
+
+    FILE *out = stdout;
+    if (output_path != NULL && (out = fopen(output_path, "w")) == NULL) {
+        printf("Cannot open %s for writing\n", output_path);
+        graph_free(&graph);
+        if (resume_path != NULL) checkpoint_close(&resume);
+        return 1;
+    }
+    setvbuf(out, NULL, _IOFBF, OUTPUT_BUFFER_SIZE);
+
+    Capture *capture = NULL;
+    if (capture_path != NULL &&
+        (capture = capture_create(capture_path, capture_format, capture_width, capture_height, capture_queue)) == NULL) {
+        graph_free(&graph);
+        if (resume_path != NULL) checkpoint_close(&resume);
+        return 1;
+    }
+
+    Nodes nodes;
+    Cooling schedule_state;
+    int completed = 0;
+    int allocated = resume_path != NULL ? checkpoint_restore(&resume, &nodes)
+                                        : nodes_alloc_dimensions(&nodes, graph.num_nodes, dimensions);
+    if (allocated != 0) {
+        if (capture != NULL) capture_finish(capture, NULL);
+        graph_free(&graph);
+        if (resume_path != NULL) checkpoint_close(&resume);
+        return 1;
+    }
+    settings.pool = threadpool_create(num_threads);
+    settings.workspace = force_workspace_create();
+    // Placement draws from the seed; edits draw from this, carried across checkpoints
+    Rng rng;
+    rng_seed(&rng, seed);
+    if (resume_path != NULL) {
+        schedule_state = resume.cooling;
+        completed = resume.iteration;
+        rng.state = resume.rng_state;
+        if (out != stdout) {
+            printf("Resumed %s at iteration %d, %.1f ms\n", resume_path, completed, load_seconds * 1000.0);
+        }
+    } else if (use_components) {
+        cooling_init(&schedule_state, schedule, temperature < 0.0f ? START_TEMPERATURE : temperature, cooling);
+    } else {
+        double placement_start = layout_seconds();
+        place_nodes(&nodes, &graph, placement, seed, &settings);
+        if (temperature < 0.0f) {
+            temperature = placement_temperature(placement);
+        }
+        cooling_init(&schedule_state, schedule, temperature, cooling);
+        if (out != stdout) {
+            printf("Placement: %s, %.1f ms\n", placement_name(placement), (layout_seconds() - placement_start) * 1000.0);
+        }
+    }
+    if (trace_path != NULL) {
+        profile_enable(1);
+        profile_thread_name("layout");
+    }
+
+    // Measured in the loaded numbering, before any reordering
+    int failed = 0;
+    MetricsMonitor *monitor = NULL;
+    FILE *metrics_log = NULL;
+    if (metrics_every > 0) {
+        failed = (monitor = metrics_monitor_create(&graph, dimensions, METRICS_STRESS_PIVOTS, seed)) == NULL;
+        if (!failed && metrics_log_path != NULL && (metrics_log = fopen(metrics_log_path, "w")) == NULL) {
+            printf("Cannot open %s for writing\n", metrics_log_path);
+            failed = 1;
+        }
+        if (metrics_log != NULL) {
+            fprintf(metrics_log, "iteration\tcrossings\tstress\tedge_mean\tedge_cv\tmetrics_ms\n");
+        }
+    }
+
+    // Per-component layouts replace the iterations over the whole graph
+    if (!failed && use_components) {
+        ComponentStats component_stats;
+        failed = components_layout(&nodes, &graph, &settings, &schedule_state, iterations, tolerance, seed,
+                                   &component_stats) != 0;
+        completed = component_stats.iterations;
+        if (!failed && out != stdout) {
+            printf("Components: %d, largest %d nodes, %.2f%% of the pairwise repulsion work\n",
+                   component_stats.components, component_stats.largest, component_stats.pair_fraction * 100.0);
+            printf("Components: layout %.1f ms, at most %d iterations, packing %.1f ms\n",
+                   component_stats.layout_seconds * 1000.0, component_stats.iterations,
+                   component_stats.pack_seconds * 1000.0);
+        }
+    }
+
+    // The force loop runs renumbered, everything after it sees the loaded ids again
+    Reordering reordering = {0};
+    if (reorder != REORDER_NONE) {
+        double span = reorder_edge_span(&graph);
+        failed |= reorder_init(&reordering, nodes.count) != 0 ||
+                  reorder_apply(&reordering, reorder, &graph, &nodes) != 0;
+        if (!failed && out != stdout) {
+            printf("Reorder: %s, mean edge span %.1f -> %.1f ids, %.1f ms\n", reorder_name(reorder), span,
+                   reorder_edge_span(&graph), reordering.seconds * 1000.0);
+        }
+    }
+
+    if (every > 0) {
+        write_positions(out, &graph, &nodes, reorder_current(&reordering), completed);
+    }
+    if (capture != NULL) {
+        capture_frame(capture, completed, nodes.x, nodes.y, nodes.count, graph.edges, graph.num_edges);
+    }
+    if (!failed && serve_address != NULL) {
+        StreamServer server;
+        FILE *log = NULL;
+        failed = stream_listen(&server, serve_address, stream_threshold) != 0;
+        if (!failed && stream_log_path != NULL && (log = fopen(stream_log_path, "w")) == NULL) {
+            printf("Cannot open %s for writing\n", stream_log_path);
+            failed = 1;
+        }
+        if (!failed) {
+            // Interrupting the server still writes the positions and the checkpoint
+            struct sigaction action;
+            memset(&action, 0, sizeof(action));
+            action.sa_handler = interrupt_handler;
+            sigaction(SIGINT, &action, NULL);
+            sigaction(SIGTERM, &action, NULL);
+            if (out != stdout) printf("Serving on %s\n", serve_address);
+            failed = serve_layout(&server, &graph, &nodes, &settings, &schedule_state, &completed, iterations, tolerance,
+                                  &rng, capture, log) != 0;
+            if (out != stdout) stream_print_stats(&server.stats, nodes.count);
+        }
+        if (log != NULL && (ferror(log) | (fclose(log) != 0))) {
+            printf("Error writing %s\n", stream_log_path);
+            failed = 1;
+        }
+        stream_close(&server);
+    }
+    int metrics_seen = 0;
+    LayoutMetrics previous_metrics;
+    while (!failed && !use_components && serve_address == NULL && completed < iterations) {
+        ForceStats stats = calculate_forces(&nodes, graph.edges, graph.num_edges, schedule_state.temperature,
+                                            completed, &settings);
+        cooling_update(&schedule_state, &stats);
+        completed++;
+        if (capture != NULL) {
+            capture_frame(capture, completed, nodes.x, nodes.y, nodes.count, graph.edges, graph.num_edges);
+        }
+        if (tolerance > 0.0f && layout_converged(&stats, nodes.count, tolerance)) {
+            if (out != stdout) printf("Converged after %d iterations\n", completed);
+            break;
+        }
+        if (monitor != NULL) {
+            if (poll_metrics(monitor, &metrics_seen, &previous_metrics, quality_tolerance, metrics_log)) {
+                if (out != stdout) printf("Quality settled after %d iterations\n", completed);
+                break;
+            }
+            if (completed % metrics_every == 0) {
+                metrics_monitor_submit(monitor, completed, &nodes, reorder_current(&reordering));
+            }
+        }
+        if (every > 0 && completed % every == 0 && completed < iterations) {
+            write_positions(out, &graph, &nodes, reorder_current(&reordering), completed);
+        }
+        if (checkpoint_every > 0 && completed % checkpoint_every == 0 && completed < iterations) {
+            failed |= reorder_restore(&reordering, &graph, &nodes) != 0;
+            failed |= checkpoint_write(checkpoint_path, &graph, &nodes, &schedule_state, completed, rng.state) != 0;
+            if (reorder != REORDER_NONE) {
+                failed |= reorder_apply(&reordering, REORDER_HILBERT, &graph, &nodes) != 0;
+            }
+        } else if (reorder != REORDER_NONE && resort_every > 0 && completed % resort_every == 0) {
+            failed |= reorder_apply(&reordering, REORDER_HILBERT, &graph, &nodes) != 0;
+        }
+    }
+    if (reorder != REORDER_NONE) {
+        int applied = reordering.applied;
+        failed |= reorder_restore(&reordering, &graph, &nodes) != 0;
+        if (out != stdout) {
+            printf("Reorder: %d renumberings, %.1f ms in total\n", applied, reordering.seconds * 1000.0);
+        }
+        reorder_free(&reordering);
+    }
+    if (edits_path != NULL) {
+        double seconds, slowest;
+        int edits = apply_edits(edits_path, &graph, &nodes, &rng, &seconds, &slowest);
+        failed |= edits < 0;
+        if (edits > 0 && out != stdout) {
+            printf("Applied %d edits, %.3f ms each on average, %.3f ms at most\n",
+                   edits, seconds * 1000.0 / edits, slowest * 1000.0);
+        }
+    }
+    if (monitor != NULL) {
+        metrics_monitor_destroy(monitor);
+        LayoutMetrics metrics;
+        failed |= metrics_measure(&metrics, &graph, nodes.x, nodes.y, nodes.z, METRICS_STRESS_PIVOTS, seed) != 0;
+        metrics.iteration = completed;
+        if (metrics_log != NULL) {
+            log_metrics(metrics_log, &metrics);
+            if (ferror(metrics_log) | (fclose(metrics_log) != 0)) {
+                printf("Error writing %s\n", metrics_log_path);
+                failed = 1;
+            }
+        }
+        if (out != stdout) metrics_print(&metrics);
+    }
+    write_positions(out, &graph, &nodes, NULL, completed);
+    if (checkpoint_path != NULL) {
+        double checkpoint_start = layout_seconds();
+        failed |= checkpoint_write(checkpoint_path, &graph, &nodes, &schedule_state, completed, rng.state) != 0;
+        if (out != stdout) {
+            printf("Checkpoint: %s, %.1f ms\n", checkpoint_path, (layout_seconds() - checkpoint_start) * 1000.0);
+        }
+    }
+    if (capture != NULL) {
+        CaptureStats capture_stats;
+        failed |= capture_finish(capture, &capture_stats) != 0;
+        if (out != stdout) {
+            capture_print_stats(&capture_stats);
+        }
+    }
+
+    // Edits, metrics and checkpoints have reported their own errors
+    int write_failed = ferror(out);
+    if (out != stdout) {
+        write_failed |= fclose(out) != 0;
+    } else {
+        write_failed |= fflush(out) != 0;
+    }
+    if (write_failed) {
+        printf("Error writing positions\n");
+        failed = 1;
+    }
+    if (trace_path != NULL && profile_write_trace(trace_path) < 0) {
+        failed = 1;
+    }
+
+    threadpool_destroy(settings.pool);
+    force_workspace_destroy(settings.workspace);
+    nodes_free(&nodes);
+    graph_free(&graph);
+    if (resume_path != NULL) {
+        checkpoint_close(&resume);
+    }
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,250 @@
+#include "history.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#define DELTA_LIMIT (32767.0f * HISTORY_QUANTUM)
+
+static size_t frame_floats(const History *history) {
+    return (size_t)history->num_nodes * history->dimensions;
+}
+
+static size_t keyframe_bytes(const History *history) {
+    return frame_floats(history) * sizeof(float);
+}
+
+static size_t deltas_bytes(const History *history) {
+    return (HISTORY_KEYFRAME_INTERVAL - 1) * frame_floats(history) * sizeof(int16_t);
+}
+
+int history_init(History *history, int num_nodes, int dimensions, size_t budget) {
+    memset(history, 0, sizeof(*history));
+    history->num_nodes = num_nodes;
+    history->dimensions = dimensions;
+    history->budget = budget;
+    history->last_iteration = -1;
+    history->last = malloc((frame_floats(history) > 0 ? frame_floats(history) : 1) * sizeof(float));
+    if (history->last == NULL) {
+        printf("history: out of memory (%d nodes)\n", num_nodes);
+        return -1;
+    }
+    return 0;
+}
+
+static void drop_deltas(History *history, HistorySegment *segment) {
+    if (segment->deltas != NULL) {
+        free(segment->deltas);
+        segment->deltas = NULL;
+        history->bytes -= deltas_bytes(history);
+    }
+    segment->num_deltas = 0;
+}
+
+static void remove_segment(History *history, int index) {
+    HistorySegment *segment = &history->segments[index];
+    drop_deltas(history, segment);
+    free(segment->keyframe);
+    history->bytes -= keyframe_bytes(history);
+    memmove(segment, segment + 1, (size_t)(history->num_segments - index - 1) * sizeof(*segment));
+    history->num_segments--;
+}
+
+// Newest segment whose keyframe is at or before `iteration`, -1 if none
+static int find_segment(const History *history, int iteration) {
+    int low = 0, high = history->num_segments - 1, found = -1;
+    while (low <= high) {
+        int mid = (low + high) / 2;
+        if (history->segments[mid].first <= iteration) {
+            found = mid;
+            low = mid + 1;
+        } else {
+            high = mid - 1;
+        }
+    }
+    return found;
+}
+
+// Keyframe plus the first `count` deltas of a segment, one array per axis
+static void decode(const History *history, const HistorySegment *segment, int count, float *const *axes) {
+    size_t n = (size_t)history->num_nodes;
+    for (int a = 0; a < history->dimensions; a++) {
+        float *axis = axes[a];
+        memcpy(axis, segment->keyframe + a * n, n * sizeof(float));
+        for (int frame = 0; frame < count; frame++) {
+            const int16_t *delta = segment->deltas + frame * frame_floats(history) + a * n;
+            for (size_t i = 0; i < n; i++) {
+                axis[i] += (float)delta[i] * HISTORY_QUANTUM;
+            }
+        }
+    }
+}
+
+static void last_axes(History *history, float **axes) {
+    for (int a = 0; a < history->dimensions; a++) {
+        axes[a] = history->last + (size_t)a * history->num_nodes;
+    }
+}
+
+// Forget every frame from `iteration` on
+static void truncate_from(History *history, int iteration) {
+    while (history->num_segments > 0) {
+        HistorySegment *segment = &history->segments[history->num_segments - 1];
+        if (segment->first >= iteration) {
+            remove_segment(history, history->num_segments - 1);
+        } else {
+            if (segment->first + segment->num_deltas >= iteration) {
+                segment->num_deltas = iteration - segment->first - 1;
+            }
+            break;
+        }
+    }
+    if (history->last_iteration >= iteration) {
+        history->last_iteration = -1;
+    }
+}
+
+// Quantize the frame against `last` into `delta`, updating `last` to the decoded
+// result. Returns -1 if a node moved too far for 16 bits; `last` is then stale.
+static int encode(float *last, const float *current, int16_t *delta, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        float diff = current[i] - last[i];
+        if (!(fabsf(diff) <= DELTA_LIMIT)) {
+            return -1;
+        }
+        delta[i] = (int16_t)lrintf(diff / HISTORY_QUANTUM);
+        last[i] += (float)delta[i] * HISTORY_QUANTUM;
+    }
+    return 0;
+}
+
+static int append_delta(History *history, HistorySegment *segment, int iteration, const float *const *axes) {
+    size_t n = (size_t)history->num_nodes;
+    if (history->last_iteration != iteration - 1) {
+        float *last[3];
+        last_axes(history, last);
+        decode(history, segment, segment->num_deltas, last);
+        history->last_iteration = iteration - 1;
+    }
+    if (segment->deltas == NULL) {
+        if ((segment->deltas = malloc(deltas_bytes(history))) == NULL) {
+            return -1;
+        }
+        history->bytes += deltas_bytes(history);
+    }
+
+    int16_t *delta = segment->deltas + (size_t)segment->num_deltas * frame_floats(history);
+    history->last_iteration = -1;
+    for (int a = 0; a < history->dimensions; a++) {
+        if (encode(history->last + a * n, axes[a], delta + a * n, n) != 0) {
+            return -1;
+        }
+    }
+    segment->num_deltas++;
+    history->last_iteration = iteration;
+    return 0;
+}
+
+static int append_keyframe(History *history, int iteration, const float *const *axes) {
+    size_t n = (size_t)history->num_nodes;
+    if (history->num_segments == history->segment_capacity) {
+        int capacity = history->segment_capacity > 0 ? history->segment_capacity * 2 : 16;
+        HistorySegment *segments = realloc(history->segments, (size_t)capacity * sizeof(*segments));
+        if (segments == NULL) {
+            return -1;
+        }
+        history->segments = segments;
+        history->segment_capacity = capacity;
+    }
+    float *keyframe = malloc(keyframe_bytes(history));
+    if (keyframe == NULL) {
+        return -1;
+    }
+    for (int a = 0; a < history->dimensions; a++) {
+        memcpy(keyframe + a * n, axes[a], n * sizeof(float));
+    }
+    history->segments[history->num_segments++] = (HistorySegment){iteration, 0, keyframe, NULL};
+    history->bytes += keyframe_bytes(history);
+
+    memcpy(history->last, keyframe, keyframe_bytes(history));
+    history->last_iteration = iteration;
+    return 0;
+}
+
+// Drop the oldest deltas, then thin out the keyframes, until within the budget
+static void enforce_budget(History *history) {
+    while (history->budget > 0 && history->bytes > history->budget) {
+        int oldest = -1;
+        for (int s = 0; s < history->num_segments - 1; s++) {
+            if (history->segments[s].deltas != NULL) {
+                oldest = s;
+                break;
+            }
+        }
+        if (oldest >= 0) {
+            drop_deltas(history, &history->segments[oldest]);
+        } else if (history->num_segments > 2) {
+            for (int s = history->num_segments - 2; s >= 1; s -= 2) {
+                remove_segment(history, s);
+            }
+        } else {
+            break;
+        }
+    }
+}
+
+// Save the positions after `iteration`, replacing that frame and any later ones.
+// z is only read for three dimensions.
+int history_record(History *history, int iteration, const float *x, const float *y, const float *z) {
+    const float *axes[3] = {x, y, z};
+    truncate_from(history, iteration);
+
+    int status = -1;
+    if (history->num_segments > 0) {
+        HistorySegment *segment = &history->segments[history->num_segments - 1];
+        if (segment->first + segment->num_deltas == iteration - 1 &&
+            segment->num_deltas < HISTORY_KEYFRAME_INTERVAL - 1) {
+            status = append_delta(history, segment, iteration, axes);
+        }
+    }
+    if (status != 0) {
+        status = append_keyframe(history, iteration, axes);
+    }
+    if (status != 0) {
+        printf("history: out of memory, iteration %d not saved\n", iteration);
+    }
+    enforce_budget(history);
+    return status;
+}
+
+// Decode the newest saved frame at or before `iteration` into x/y(/z) and return
+// its iteration, or -1 if there is none. Frames in between must be recomputed.
+int history_restore(History *history, int iteration, float *x, float *y, float *z) {
+    float *axes[3] = {x, y, z};
+    int index = find_segment(history, iteration);
+    if (index < 0) {
+        return -1;
+    }
+    const HistorySegment *segment = &history->segments[index];
+    int count = segment->num_deltas;
+    if (segment->first + count > iteration) {
+        count = iteration - segment->first;
+    }
+    decode(history, segment, count, axes);
+    return segment->first + count;
+}
+
+void history_clear(History *history) {
+    while (history->num_segments > 0) {
+        remove_segment(history, history->num_segments - 1);
+    }
+    history->last_iteration = -1;
+}
+
+void history_free(History *history) {
+    history_clear(history);
+    free(history->segments);
+    free(history->last);
+    memset(history, 0, sizeof(*history));
+}
@@ -0,0 +1,45 @@
+#ifndef HISTORY_H
+#define HISTORY_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define HISTORY_KEYFRAME_INTERVAL 32     // Frames per segment: one keyframe, then deltas
+#define HISTORY_QUANTUM (1.0f / 64.0f)   // Delta resolution in pixels, int16 covers +-512
+#define HISTORY_DEFAULT_BUDGET (512u << 20)
+
+// A keyframe (exact x, y and for 3D z, one axis after the other) followed by
+// quantized deltas for the next frames in the same order.
+// Each delta is against the decoded previous frame, so errors never accumulate.
+typedef struct {
+    int first;          // Iteration of the keyframe
+    int num_deltas;     // Frames first + 1 .. first + num_deltas follow as deltas
+    float *keyframe;
+    int16_t *deltas;    // HISTORY_KEYFRAME_INTERVAL - 1 frames, NULL once evicted
+} HistorySegment;
+
+// Saved layout states for stepping back. Segments are sorted by iteration and
+// may leave gaps; frames that are not stored are recomputed by the caller from
+// the nearest earlier one. Over the budget, the oldest deltas are evicted first,
+// then every other keyframe. The first and newest keyframes are always kept.
+typedef struct {
+    int num_nodes;
+    int dimensions;     // 2 or 3 axes per frame
+    size_t budget;      // Bytes, 0 for unlimited
+    size_t bytes;
+    HistorySegment *segments;
+    int num_segments;
+    int segment_capacity;
+
+    // Decoded newest frame, the base for the next delta
+    float *last;
+    int last_iteration; // -1 when `last` is not valid
+} History;
+
+int history_init(History *history, int num_nodes, int dimensions, size_t budget);
+int history_record(History *history, int iteration, const float *x, const float *y, const float *z);
+int history_restore(History *history, int iteration, float *x, float *y, float *z);
+void history_clear(History *history);
+void history_free(History *history);
+
+#endif
@@ -0,0 +1,86 @@
+#include "hud.h"
+#include "layout.h"
+#include "profile.h"
+
+#include <stdio.h>
+#include <string.h>
+
+int hud_init(Hud *hud, const char *font_path, int point_size) {
+    memset(hud, 0, sizeof(*hud));
+    hud->font = TTF_OpenFont(font_path, point_size);
+    if (hud->font == NULL) {
+        printf("TTF_OpenFont Error: %s\n", TTF_GetError());
+        return -1;
+    }
+    return 0;
+}
+
+static void clear_lines(Hud *hud) {
+    for (int i = 0; i < hud->num_lines; i++) {
+        if (hud->lines[i] != NULL) SDL_DestroyTexture(hud->lines[i]);
+        hud->lines[i] = NULL;
+    }
+    hud->num_lines = 0;
+}
+
+static void add_line(Hud *hud, SDL_Renderer *renderer, const char *text) {
+    if (hud->num_lines == HUD_MAX_LINES) return;
+    SDL_Color color = {0x40, 0x40, 0x40, 0xFF};
+    SDL_Surface *surface = TTF_RenderText_Blended(hud->font, text, color);
+    if (surface == NULL) return;
+    int line = hud->num_lines++;
+    hud->lines[line] = SDL_CreateTextureFromSurface(renderer, surface);
+    hud->sizes[line] = (SDL_Rect){0, 0, surface->w, surface->h};
+    SDL_FreeSurface(surface);
+}
+
+static const ProfileStat *find_stat(const ProfileStat stats[], int num_stats, const char *name) {
+    for (int s = 0; s < num_stats; s++) {
+        if (strcmp(stats[s].name, name) == 0) return &stats[s];
+    }
+    return NULL;
+}
+
+static void refresh(Hud *hud, SDL_Renderer *renderer) {
+    ProfileStat stats[HUD_MAX_LINES];
+    int num_stats = profile_summarize(HUD_WINDOW, stats, HUD_MAX_LINES);
+    char text[64];
+    clear_lines(hud);
+
+    const ProfileStat *frame = find_stat(stats, num_stats, "frame");
+    const ProfileStat *iteration = find_stat(stats, num_stats, "iteration");
+    snprintf(text, sizeof(text), "ms/frame    %7.2f", frame ? frame->seconds * 1e3 / frame->count : 0.0);
+    add_line(hud, renderer, text);
+    snprintf(text, sizeof(text), "frames/s    %7.1f", frame ? frame->count / HUD_WINDOW : 0.0);
+    add_line(hud, renderer, text);
+    snprintf(text, sizeof(text), "iters/s     %7.1f", iteration ? iteration->count / HUD_WINDOW : 0.0);
+    add_line(hud, renderer, text);
+
+    // Everything else as mean ms per occurrence
+    for (int s = 0; s < num_stats; s++) {
+        if (&stats[s] == frame || &stats[s] == iteration) continue;
+        snprintf(text, sizeof(text), " %-11.11s%7.2f", stats[s].name, stats[s].seconds * 1e3 / stats[s].count);
+        add_line(hud, renderer, text);
+    }
+}
+
+// Draw the overlay with its top left corner at x, y
+void hud_draw(Hud *hud, SDL_Renderer *renderer, int x, int y) {
+    double now = layout_seconds();
+    if (now >= hud->next_refresh) {
+        refresh(hud, renderer);
+        hud->next_refresh = now + HUD_REFRESH;
+    }
+    for (int i = 0; i < hud->num_lines; i++) {
+        if (hud->lines[i] == NULL) continue;
+        SDL_Rect rect = {x, y, hud->sizes[i].w, hud->sizes[i].h};
+        SDL_RenderCopy(renderer, hud->lines[i], NULL, &rect);
+        y += hud->sizes[i].h;
+    }
+}
+
+void hud_free(Hud *hud) {
+    clear_lines(hud);
+    if (hud->font != NULL) TTF_CloseFont(hud->font);
+    memset(hud, 0, sizeof(*hud));
+}
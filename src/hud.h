@@ -0,0 +1,25 @@
+#ifndef HUD_H
+#define HUD_H
+
+#include <SDL2/SDL.h>
+#include <SDL2/SDL_ttf.h>
+
+#define HUD_MAX_LINES 16
+#define HUD_WINDOW 1.0f   // Seconds of profile events averaged per refresh
+#define HUD_REFRESH 0.25f // Seconds between re-rasterizing the text
+
+// Timing overlay built from the profile ring. Text is rasterized a few times
+// a second and the textures reused in between.
+typedef struct {
+    TTF_Font *font;
+    SDL_Texture *lines[HUD_MAX_LINES];
+    SDL_Rect sizes[HUD_MAX_LINES];
+    int num_lines;
+    double next_refresh;
+} Hud;
+
+int hud_init(Hud *hud, const char *font_path, int point_size);
+void hud_draw(Hud *hud, SDL_Renderer *renderer, int x, int y);
+void hud_free(Hud *hud);
+
+#endif
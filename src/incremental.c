@@ -0,0 +1,342 @@
+#include "incremental.h"
+#include "profile.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#define INCREMENTAL_NEIGHBOURS 64 // Nodes a cutoff circle holds on average in a dense layout
+#define DIAGONAL 1.41421356f      // Longest step for a given temperature, both axes are clamped to it
+
+static int grow(void **array, int count, size_t size) {
+    void *grown = realloc(*array, (size_t)(count > 0 ? count : 1) * size);
+    if (grown == NULL) return -1;
+    *array = grown;
+    return 0;
+}
+
+static int reserve(IncrementalLayout *il, int num_nodes) {
+    if (num_nodes > il->node_capacity) {
+        if (grow((void **)&il->mark, num_nodes, sizeof(unsigned int)) != 0) return -1;
+        memset(il->mark + il->node_capacity, 0, (size_t)(num_nodes - il->node_capacity) * sizeof(unsigned int));
+        il->node_capacity = num_nodes;
+    }
+    return 0;
+}
+
+static int reserve_active(IncrementalLayout *il, int count) {
+    if (count > il->active_capacity) {
+        int capacity = count > 2 * il->active_capacity ? count : 2 * il->active_capacity;
+        if (grow((void **)&il->active, capacity, sizeof(int)) != 0 ||
+            grow((void **)&il->depth, capacity, sizeof(int)) != 0 ||
+            grow((void **)&il->fx, capacity, sizeof(float)) != 0 ||
+            grow((void **)&il->fy, capacity, sizeof(float)) != 0 ||
+            grow((void **)&il->ax, capacity, sizeof(float)) != 0 ||
+            grow((void **)&il->ay, capacity, sizeof(float)) != 0) return -1;
+        il->active_capacity = capacity;
+    }
+    return 0;
+}
+
+static int reserve_candidates(IncrementalLayout *il, int count) {
+    if (count > il->candidate_capacity) {
+        int capacity = count > 2 * il->candidate_capacity ? count : 2 * il->candidate_capacity;
+        if (grow((void **)&il->cx, capacity, sizeof(float)) != 0 ||
+            grow((void **)&il->cy, capacity, sizeof(float)) != 0) return -1;
+        il->candidate_capacity = capacity;
+    }
+    return 0;
+}
+
+// Start a node off at the centre of its neighbours, spread a little so nodes
+// added together do not coincide. Without neighbours it keeps its position.
+void incremental_place(Nodes *nodes, const Graph *graph, int node, Rng *rng) {
+    float sum_x = 0, sum_y = 0;
+    int count = 0;
+    for (int k = graph->offsets[node]; k < graph->offsets[node + 1]; k++) {
+        int neighbour = graph->adjacency[k];
+        sum_x += nodes->x[neighbour];
+        sum_y += nodes->y[neighbour];
+        count++;
+    }
+    if (count > 0) {
+        nodes->x[node] = sum_x / count + (rng_float(rng) * 2.0f - 1.0f) * INCREMENTAL_JITTER;
+        nodes->y[node] = sum_y / count + (rng_float(rng) * 2.0f - 1.0f) * INCREMENTAL_JITTER;
+    }
+    nodes->x[node] = clamp(nodes->x[node], BOX_MARGIN, BOX_MARGIN + BOX_WIDTH);
+    nodes->y[node] = clamp(nodes->y[node], BOX_MARGIN, BOX_MARGIN + BOX_HEIGHT);
+    nodes->dx[node] = nodes->dy[node] = 0.0f;
+    nodes->still[node] = 0;
+}
+
+static int is_hub(const Graph *graph, int v) {
+    return graph->offsets[v + 1] - graph->offsets[v] > INCREMENTAL_HUB_DEGREE;
+}
+
+// Breadth-first search from the seeds up to `hops` edges away, stopping at
+// INCREMENTAL_MAX_ACTIVE nodes so the nearest are kept. Hubs among the seeds
+// move but are not expanded; other hubs are left out and stay pinned.
+static int collect_neighbourhood(IncrementalLayout *il, const Graph *graph, const int *seeds, int num_seeds, int hops) {
+    if (++il->stamp == 0) { // Wrapped, forget every old mark
+        memset(il->mark, 0, (size_t)il->node_capacity * sizeof(unsigned int));
+        il->stamp = 1;
+    }
+    il->num_active = 0;
+    for (int s = 0; s < num_seeds && il->num_active < INCREMENTAL_MAX_ACTIVE; s++) {
+        int v = seeds[s];
+        if (v < 0 || v >= graph->num_nodes || il->mark[v] == il->stamp) continue;
+        if (reserve_active(il, il->num_active + 1) != 0) return -1;
+        il->mark[v] = il->stamp;
+        il->depth[il->num_active] = 0;
+        il->active[il->num_active++] = v;
+    }
+    for (int head = 0; head < il->num_active && il->num_active < INCREMENTAL_MAX_ACTIVE; head++) {
+        int v = il->active[head];
+        if (il->depth[head] >= hops || is_hub(graph, v)) continue;
+        for (int k = graph->offsets[v]; k < graph->offsets[v + 1] && il->num_active < INCREMENTAL_MAX_ACTIVE; k++) {
+            int w = graph->adjacency[k];
+            if (il->mark[w] == il->stamp || is_hub(graph, w)) continue;
+            if (reserve_active(il, il->num_active + 1) != 0) return -1;
+            il->mark[w] = il->stamp;
+            il->depth[il->num_active] = il->depth[head] + 1;
+            il->active[il->num_active++] = w;
+        }
+    }
+    return 0;
+}
+
+// Every other node inside the neighbourhood's bounding box grown by `margin`.
+// They stay put while the neighbourhood relaxes.
+static int collect_candidates(IncrementalLayout *il, const Nodes *nodes, float margin) {
+    float min_x = INFINITY, min_y = INFINITY, max_x = -INFINITY, max_y = -INFINITY;
+    for (int k = 0; k < il->num_active; k++) {
+        int v = il->active[k];
+        min_x = fminf(min_x, nodes->x[v]);
+        max_x = fmaxf(max_x, nodes->x[v]);
+        min_y = fminf(min_y, nodes->y[v]);
+        max_y = fmaxf(max_y, nodes->y[v]);
+    }
+    min_x -= margin;
+    max_x += margin;
+    min_y -= margin;
+    max_y += margin;
+
+    il->num_candidates = 0;
+    for (int i = 0; i < nodes->count; i++) {
+        float x = nodes->x[i], y = nodes->y[i];
+        if (x < min_x || x > max_x || y < min_y || y > max_y || il->mark[i] == il->stamp) continue;
+        if (reserve_candidates(il, il->num_candidates + 1) != 0) return -1;
+        il->cx[il->num_candidates] = x;
+        il->cy[il->num_candidates] = y;
+        il->num_candidates++;
+    }
+    return 0;
+}
+
+// Move the nodes within `hops` of the seeds for up to `iterations` iterations,
+// starting at `temperature` and cooling by COOLING_FACTOR; stops early once no
+// node moves FREEZE_EPSILON. The moved nodes are unfrozen for the global layout.
+int incremental_relax(IncrementalLayout *il, Nodes *nodes, const Graph *graph, const int *seeds, int num_seeds,
+                      int hops, int iterations, float temperature, IncrementalStats *stats) {
+    double start = layout_seconds();
+    IncrementalStats result = {0, 0, 0, 0.0};
+    if (reserve(il, graph->num_nodes) != 0 || collect_neighbourhood(il, graph, seeds, num_seeds, hops) != 0) {
+        printf("incremental: out of memory (%d nodes)\n", graph->num_nodes);
+        return -1;
+    }
+
+    // Cutoff: INCREMENTAL_RADIUS, or less when the box is so crowded that the
+    // circle would hold more than INCREMENTAL_NEIGHBOURS nodes. Steps stay
+    // well inside it, which also bounds how far any node can travel.
+    float area = (float)BOX_WIDTH * BOX_HEIGHT;
+    float radius = sqrtf(INCREMENTAL_NEIGHBOURS * area / (3.14159265f * (graph->num_nodes > 0 ? graph->num_nodes : 1)));
+    radius = clamp(radius, 2.0f, INCREMENTAL_RADIUS);
+    temperature = fminf(temperature, radius * 0.25f);
+    float travel = DIAGONAL * temperature * (1.0f - powf((float)COOLING_FACTOR, (float)iterations)) / (1.0f - (float)COOLING_FACTOR);
+
+    if (il->num_active > 0 && collect_candidates(il, nodes, radius + travel) != 0) {
+        printf("incremental: out of memory (%d candidates)\n", il->num_candidates);
+        return -1;
+    }
+    if (il->num_active > 0 && spatial_build(&il->grid, il->cx, il->cy, il->num_candidates, NULL, 0) != 0) {
+        return -1;
+    }
+
+    float *x = nodes->x, *y = nodes->y;
+    float radius2 = radius * radius;
+    int iteration = 0;
+    while (iteration < iterations && il->num_active > 0) {
+        // The moving nodes get a grid of their own, rebuilt every iteration
+        for (int k = 0; k < il->num_active; k++) {
+            il->ax[k] = x[il->active[k]];
+            il->ay[k] = y[il->active[k]];
+        }
+        if (spatial_build(&il->active_grid, il->ax, il->ay, il->num_active, NULL, 0) != 0) {
+            return -1;
+        }
+
+        // Forces from the positions at the start of the iteration
+        for (int k = 0; k < il->num_active; k++) {
+            int v = il->active[k];
+            float px = il->ax[k], py = il->ay[k];
+            float fx = 0, fy = 0;
+
+            spatial_query(&il->grid, il->cx, il->cy, NULL, px - radius, py - radius, px + radius, py + radius);
+            for (int q = 0; q < il->grid.num_visible_nodes; q++) {
+                int c = il->grid.visible_nodes[q];
+                float rx = px - il->cx[c], ry = py - il->cy[c];
+                float d2 = rx * rx + ry * ry;
+                if (d2 > 0 && d2 < radius2) {
+                    float force = 1000.0f / d2;
+                    fx += rx * force;
+                    fy += ry * force;
+                }
+            }
+            spatial_query(&il->active_grid, il->ax, il->ay, NULL, px - radius, py - radius, px + radius, py + radius);
+            for (int q = 0; q < il->active_grid.num_visible_nodes; q++) {
+                int a = il->active_grid.visible_nodes[q];
+                float rx = px - il->ax[a], ry = py - il->ay[a];
+                float d2 = rx * rx + ry * ry;
+                if (a != k && d2 > 0 && d2 < radius2) {
+                    float force = 1000.0f / d2;
+                    fx += rx * force;
+                    fy += ry * force;
+                }
+            }
+
+            for (int e = graph->offsets[v]; e < graph->offsets[v + 1]; e++) {
+                int u = graph->adjacency[e];
+                float rx = x[v] - x[u], ry = y[v] - y[u];
+                float force = sqrtf(rx * rx + ry * ry) / 1000.0f;
+                fx -= rx * force;
+                fy -= ry * force;
+            }
+            il->fx[k] = fx;
+            il->fy[k] = fy;
+        }
+
+        float largest = 0;
+        for (int k = 0; k < il->num_active; k++) {
+            int v = il->active[k];
+            float old_x = x[v], old_y = y[v];
+            x[v] = clamp(x[v] + clamp(il->fx[k], -temperature, temperature), BOX_MARGIN, BOX_MARGIN + BOX_WIDTH);
+            y[v] = clamp(y[v] + clamp(il->fy[k], -temperature, temperature), BOX_MARGIN, BOX_MARGIN + BOX_HEIGHT);
+            largest = fmaxf(largest, fmaxf(fabsf(x[v] - old_x), fabsf(y[v] - old_y)));
+        }
+        temperature *= (float)COOLING_FACTOR;
+        iteration++;
+        if (largest < FREEZE_EPSILON) break;
+    }
+
+    for (int k = 0; k < il->num_active; k++) {
+        int v = il->active[k];
+        nodes->dx[v] = nodes->dy[v] = 0.0f;
+        nodes->still[v] = 0;
+    }
+
+    result.active = il->num_active;
+    result.candidates = il->num_candidates;
+    result.iterations = iteration;
+    result.seconds = layout_seconds() - start;
+    profile_record("incremental", start, start + result.seconds);
+    if (stats != NULL) {
+        *stats = result;
+    }
+    return 0;
+}
+
+// The edit itself has happened by now; if relaxing fails the nodes just stay where they are
+static void relax_around(IncrementalLayout *il, Nodes *nodes, const Graph *graph, const int *seeds, int num_seeds,
+                         IncrementalStats *stats) {
+    if (stats != NULL) {
+        memset(stats, 0, sizeof(*stats));
+    }
+    incremental_relax(il, nodes, graph, seeds, num_seeds, INCREMENTAL_HOPS, INCREMENTAL_ITERATIONS,
+                      INCREMENTAL_TEMPERATURE, stats);
+}
+
+// New node linked to the given ones, placed among them; without neighbours it
+// starts at a random spot in the box. Either every edge is added or the graph
+// is left as it was.
+int incremental_add_node(IncrementalLayout *il, Graph *graph, Nodes *nodes, const int *neighbours, int num_neighbours,
+                         Rng *rng, IncrementalStats *stats) {
+    for (int k = 0; k < num_neighbours; k++) {
+        if (neighbours[k] < 0 || neighbours[k] >= graph->num_nodes) {
+            printf("incremental: no node %d, the graph has %d nodes\n", neighbours[k], graph->num_nodes);
+            return -1;
+        }
+    }
+    if (nodes_resize(nodes, graph->num_nodes + 1) != 0) return -1;
+    int node = graph_add_node(graph);
+    if (node < 0) {
+        nodes_resize(nodes, graph->num_nodes);
+        return -1;
+    }
+    for (int k = 0; k < num_neighbours; k++) {
+        if (graph_add_edge(graph, node, neighbours[k]) < 0) {
+            graph_remove_node(graph, node);
+            nodes_resize(nodes, graph->num_nodes);
+            return -1;
+        }
+    }
+    nodes->x[node] = BOX_MARGIN + rng_float(rng) * BOX_WIDTH;
+    nodes->y[node] = BOX_MARGIN + rng_float(rng) * BOX_HEIGHT;
+    incremental_place(nodes, graph, node, rng);
+    relax_around(il, nodes, graph, &node, 1, stats);
+    return node;
+}
+
+// The node's neighbours take up the slack; ids above it shift down by one
+int incremental_remove_node(IncrementalLayout *il, Graph *graph, Nodes *nodes, int node, IncrementalStats *stats) {
+    if (node < 0 || node >= graph->num_nodes) return 0;
+    int degree = graph->offsets[node + 1] - graph->offsets[node];
+    int *seeds = malloc((size_t)(degree > 0 ? degree : 1) * sizeof(int));
+    if (seeds == NULL) {
+        printf("incremental: out of memory (%d neighbours)\n", degree);
+        return -1;
+    }
+    for (int k = 0; k < degree; k++) {
+        int neighbour = graph->adjacency[graph->offsets[node] + k];
+        seeds[k] = neighbour > node ? neighbour - 1 : neighbour;
+    }
+    int result = -1;
+    if (graph_remove_node(graph, node) == 0) {
+        nodes_remove(nodes, node);
+        relax_around(il, nodes, graph, seeds, degree, stats);
+        result = 1;
+    }
+    free(seeds);
+    return result;
+}
+
+int incremental_add_edge(IncrementalLayout *il, Graph *graph, Nodes *nodes, int u, int v, IncrementalStats *stats) {
+    int added = graph_add_edge(graph, u, v);
+    if (added <= 0) return added;
+    int seeds[2] = {u, v};
+    relax_around(il, nodes, graph, seeds, 2, stats);
+    return 1;
+}
+
+int incremental_remove_edge(IncrementalLayout *il, Graph *graph, Nodes *nodes, int u, int v, IncrementalStats *stats) {
+    int removed = graph_remove_edge(graph, u, v);
+    if (removed <= 0) return removed;
+    int seeds[2] = {u, v};
+    relax_around(il, nodes, graph, seeds, 2, stats);
+    return 1;
+}
+
+void incremental_free(IncrementalLayout *il) {
+    free(il->mark);
+    free(il->active);
+    free(il->depth);
+    free(il->fx);
+    free(il->fy);
+    free(il->cx);
+    free(il->cy);
+    free(il->ax);
+    free(il->ay);
+    spatial_free(&il->grid);
+    spatial_free(&il->active_grid);
+    memset(il, 0, sizeof(*il));
+}
@@ -0,0 +1,68 @@
+#ifndef INCREMENTAL_H
+#define INCREMENTAL_H
+
+#include "layout.h"
+#include "graph.h"
+#include "spatial.h"
+#include "rng.h"
+
+#define INCREMENTAL_HOPS 2             // Neighbourhood around an edit that may move
+#define INCREMENTAL_ITERATIONS 60      // Relaxation iterations per edit, fewer once settled
+#define INCREMENTAL_TEMPERATURE 6.0f   // Low start temperature, the rest of the layout is settled
+#define INCREMENTAL_RADIUS 120.0f      // Repulsion cutoff; 1000 / d is under 10 beyond it
+#define INCREMENTAL_MAX_ACTIVE 1000    // The neighbourhood stops growing at this many nodes
+#define INCREMENTAL_HUB_DEGREE 64      // Nodes of higher degree stay pinned unless edited themselves
+#define INCREMENTAL_JITTER 10.0f       // Spread of new nodes around their neighbours' centre
+
+// Local relaxation after a graph edit. Only the nodes within `hops` of the
+// edited ones move, at most INCREMENTAL_MAX_ACTIVE of them nearest first, and
+// the search does not pass through hubs, which on power-law graphs would reach
+// most of the graph in two hops. Everything else stays pinned and still repels
+// and attracts them. Repulsion is cut off at INCREMENTAL_RADIUS and found through
+// two grids, one over the pinned nodes near the neighbourhood built once and
+// one over the moving nodes rebuilt every iteration, so apart from one linear
+// scan for the first grid the cost depends on the neighbourhood, not the graph.
+// Scratch arrays are kept between edits.
+typedef struct {
+    unsigned int *mark;   // Per node, equal to `stamp` when in the neighbourhood
+    int node_capacity;
+    unsigned int stamp;
+
+    int *active;          // Breadth-first order, also the queue
+    int *depth;
+    float *fx, *fy;
+    float *ax, *ay;       // Positions at the start of the current iteration
+    int active_capacity;
+    int num_active;
+
+    SpatialGrid active_grid;
+
+    // Pinned nodes near the neighbourhood, positions copied for the grid
+    float *cx, *cy;
+    int candidate_capacity;
+    int num_candidates;
+    SpatialGrid grid;
+} IncrementalLayout;
+
+typedef struct {
+    int active;      // Nodes that were free to move
+    int candidates;  // Nodes considered for repulsion
+    int iterations;
+    double seconds;
+} IncrementalStats;
+
+// Edits that keep `nodes` in step with `graph` and relax around the change
+// with the defaults above. They return -1 on failure; adding a node returns
+// its id, the others 1 if the graph changed and 0 if there was nothing to do.
+int incremental_add_node(IncrementalLayout *il, Graph *graph, Nodes *nodes, const int *neighbours, int num_neighbours,
+                         Rng *rng, IncrementalStats *stats);
+int incremental_remove_node(IncrementalLayout *il, Graph *graph, Nodes *nodes, int node, IncrementalStats *stats);
+int incremental_add_edge(IncrementalLayout *il, Graph *graph, Nodes *nodes, int u, int v, IncrementalStats *stats);
+int incremental_remove_edge(IncrementalLayout *il, Graph *graph, Nodes *nodes, int u, int v, IncrementalStats *stats);
+
+void incremental_place(Nodes *nodes, const Graph *graph, int node, Rng *rng);
+int incremental_relax(IncrementalLayout *il, Nodes *nodes, const Graph *graph, const int *seeds, int num_seeds,
+                      int hops, int iterations, float temperature, IncrementalStats *stats);
+void incremental_free(IncrementalLayout *il);
+
+#endif
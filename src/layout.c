@@ -0,0 +1,439 @@
+#include "layout.h"
+#include "forces.h"
+#include "layout_dim.h"
+#include "quadtree.h"
+#include "threadpool.h"
+#include "profile.h"
+#include "rng.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+
+// Scratch of calculate_forces, kept between calls so iterations do not allocate
+struct ForceWorkspace {
+    QuadTree tree; // Rebuilt every Barnes-Hut iteration
+
+    // Per-thread displacement buffers for threads 1..n-1; thread 0 writes straight
+    // into the node arrays. One array of `buffer_stride` floats per axis and thread.
+    float *thread_buffers;
+    size_t thread_buffers_size;
+    size_t buffer_stride;
+
+    // Per-thread share of the ForceStats, summed in thread order
+    ForceStats *thread_stats;
+    int thread_stats_size;
+};
+
+ForceWorkspace *force_workspace_create(void) {
+    ForceWorkspace *workspace = calloc(1, sizeof(*workspace));
+    if (workspace == NULL) {
+        printf("Out of memory for a force workspace\n");
+    }
+    return workspace;
+}
+
+void force_workspace_destroy(ForceWorkspace *workspace) {
+    if (workspace == NULL) return;
+    quadtree_free(&workspace->tree);
+    free(workspace->thread_buffers);
+    free(workspace->thread_stats);
+    free(workspace);
+}
+
+static size_t nodes_stride(int count) {
+    size_t stride = ((size_t)count + NODES_PADDING - 1) / NODES_PADDING * NODES_PADDING;
+    return stride > 0 ? stride : NODES_PADDING;
+}
+
+size_t nodes_block_size(int count, int dimensions) {
+    size_t stride = nodes_stride(count);
+    return 2 * (size_t)dimensions * stride * sizeof(float) + stride;
+}
+
+// Lay the node arrays out in one block, everything zeroed
+void nodes_attach(Nodes *nodes, void *block, int count, int dimensions) {
+    size_t stride = nodes_stride(count);
+    memset(block, 0, nodes_block_size(count, dimensions));
+
+    float *arrays = block;
+    nodes->count = count;
+    nodes->capacity = (int)stride;
+    nodes->dimensions = dimensions;
+    nodes->x = arrays;
+    nodes->y = arrays + stride;
+    nodes->z = dimensions == 3 ? arrays + 2 * stride : NULL;
+    arrays += (size_t)dimensions * stride;
+    nodes->dx = arrays;
+    nodes->dy = arrays + stride;
+    nodes->dz = dimensions == 3 ? arrays + 2 * stride : NULL;
+    nodes->still = (unsigned char *)(arrays + (size_t)dimensions * stride);
+}
+
+// Allocate the node arrays in one aligned block, displacements zeroed
+int nodes_alloc_dimensions(Nodes *nodes, int count, int dimensions) {
+    void *block = NULL;
+    if (posix_memalign(&block, NODES_ALIGNMENT, nodes_block_size(count, dimensions)) != 0) {
+        printf("Out of memory for %d nodes\n", count);
+        return -1;
+    }
+    nodes_attach(nodes, block, count, dimensions);
+    return 0;
+}
+
+int nodes_alloc(Nodes *nodes, int count) {
+    return nodes_alloc_dimensions(nodes, count, 2);
+}
+
+// Change the node count keeping the existing nodes; new nodes start zeroed.
+// Grows the block by half again when the capacity runs out.
+int nodes_resize(Nodes *nodes, int count) {
+    if (count <= nodes->capacity) {
+        for (int i = nodes->count; i < count; i++) {
+            nodes->x[i] = nodes->y[i] = nodes->dx[i] = nodes->dy[i] = 0.0f;
+            if (nodes->z != NULL) nodes->z[i] = nodes->dz[i] = 0.0f;
+            nodes->still[i] = 0;
+        }
+        nodes->count = count;
+        return 0;
+    }
+    Nodes grown;
+    if (nodes_alloc_dimensions(&grown, count + count / 2, nodes->dimensions) != 0) {
+        return -1;
+    }
+    size_t size = (size_t)nodes->count * sizeof(float);
+    memcpy(grown.x, nodes->x, size);
+    memcpy(grown.y, nodes->y, size);
+    memcpy(grown.dx, nodes->dx, size);
+    memcpy(grown.dy, nodes->dy, size);
+    if (nodes->z != NULL) {
+        memcpy(grown.z, nodes->z, size);
+        memcpy(grown.dz, nodes->dz, size);
+    }
+    memcpy(grown.still, nodes->still, (size_t)nodes->count);
+    grown.count = count;
+    nodes_free(nodes);
+    *nodes = grown;
+    return 0;
+}
+
+// Drop one node, the ones after it move down by one like graph_remove_node
+void nodes_remove(Nodes *nodes, int node) {
+    size_t tail = (size_t)(nodes->count - node - 1);
+    memmove(nodes->x + node, nodes->x + node + 1, tail * sizeof(float));
+    memmove(nodes->y + node, nodes->y + node + 1, tail * sizeof(float));
+    memmove(nodes->dx + node, nodes->dx + node + 1, tail * sizeof(float));
+    memmove(nodes->dy + node, nodes->dy + node + 1, tail * sizeof(float));
+    if (nodes->z != NULL) {
+        memmove(nodes->z + node, nodes->z + node + 1, tail * sizeof(float));
+        memmove(nodes->dz + node, nodes->dz + node + 1, tail * sizeof(float));
+    }
+    memmove(nodes->still + node, nodes->still + node + 1, tail);
+    nodes->count--;
+}
+
+// Move node order[i] to index i, for every i, like graph_renumber
+int nodes_permute(Nodes *nodes, const int *order) {
+    Nodes permuted;
+    if (nodes_alloc_dimensions(&permuted, nodes->count, nodes->dimensions) != 0) {
+        return -1;
+    }
+    for (int i = 0; i < nodes->count; i++) {
+        int from = order[i];
+        permuted.x[i] = nodes->x[from];
+        permuted.y[i] = nodes->y[from];
+        permuted.dx[i] = nodes->dx[from];
+        permuted.dy[i] = nodes->dy[from];
+        permuted.still[i] = nodes->still[from];
+    }
+    if (nodes->z != NULL) {
+        for (int i = 0; i < nodes->count; i++) {
+            permuted.z[i] = nodes->z[order[i]];
+            permuted.dz[i] = nodes->dz[order[i]];
+        }
+    }
+    nodes_free(nodes);
+    *nodes = permuted;
+    return 0;
+}
+
+void nodes_free(Nodes *nodes) {
+    free(nodes->x);
+    memset(nodes, 0, sizeof(*nodes));
+}
+
+// Initialize nodes with random positions within the bounding box, the same
+// ones for the same seed on every platform. Depths are drawn after all the
+// x/y pairs, so a 3D layout has the same footprint as the 2D one.
+void initialize_nodes(Nodes *nodes, unsigned int seed) {
+    Rng rng;
+    rng_seed(&rng, seed);
+
+    for (int i = 0; i < nodes->count; i++) {
+        nodes->x[i] = (float)(rng_below(&rng, BOX_WIDTH) + BOX_MARGIN);
+        nodes->y[i] = (float)(rng_below(&rng, BOX_HEIGHT) + BOX_MARGIN);
+        nodes->dx[i] = 0;
+        nodes->dy[i] = 0;
+        nodes->still[i] = 0;
+    }
+    if (nodes->z != NULL) {
+        for (int i = 0; i < nodes->count; i++) {
+            nodes->z[i] = (float)(rng_below(&rng, BOX_DEPTH) + BOX_MARGIN);
+            nodes->dz[i] = 0;
+        }
+    }
+}
+
+// Barnes-Hut repulsion for nodes [begin, end) against a built tree, adds into dx/dy.
+// If `still` is given, frozen nodes are left out; they still repel the others through the tree.
+static void repulsion_barnes_hut(const QuadTree *tree, const float *x, const float *y, int begin, int end, float theta,
+                                 float *dx, float *dy, const unsigned char *still) {
+    for (int i = begin; i < end; i++) {
+        if (still != NULL && still[i] >= FREEZE_ITERATIONS) continue;
+        float fx, fy;
+        quadtree_repulsion(tree, x, y, i, theta, &fx, &fy);
+        dx[i] += fx;
+        dy[i] += fy;
+    }
+}
+
+// One call to calculate_forces, shared by every thread of the pool
+typedef struct {
+    Nodes *nodes;
+    const Edge *edges;
+    int num_edges;
+    float temperature;
+    int skip_frozen; // Freezing is on and this is not a recheck iteration
+    const ForceSettings *settings;
+    const ForceKernels *kernels;
+    ForceWorkspace *workspace;
+} ForcePass;
+
+// Displacement arrays of one thread, one per axis
+static void thread_displacements(const ForcePass *pass, int thread, float **displacement) {
+    const Nodes *nodes = pass->nodes;
+    if (thread == 0) {
+        displacement[0] = nodes->dx;
+        displacement[1] = nodes->dy;
+        displacement[2] = nodes->dz;
+    } else {
+        size_t stride = pass->workspace->buffer_stride;
+        float *buffer = pass->workspace->thread_buffers + (size_t)(thread - 1) * nodes->dimensions * stride;
+        displacement[0] = buffer;
+        displacement[1] = buffer + stride;
+        displacement[2] = nodes->dimensions == 3 ? buffer + 2 * stride : NULL;
+    }
+}
+
+// Even split of [0, count) into num_threads ranges
+static void split_range(int count, int thread, int num_threads, int *begin, int *end) {
+    *begin = (int)((long long)count * thread / num_threads);
+    *end = (int)((long long)count * (thread + 1) / num_threads);
+}
+
+// Row i of the pairwise kernel has n - 1 - i pairs, so rows are split where the
+// remaining triangle has shrunk by 1 / num_threads of the total work
+static int triangle_split(int n, int thread, int num_threads) {
+    if (thread >= num_threads) return n;
+    double remaining = sqrt(1.0 - (double)thread / num_threads);
+    int row = n - (int)(n * remaining + 0.5);
+    return row < 0 ? 0 : (row > n ? n : row);
+}
+
+// Phase 1: every thread clears its buffer and adds repulsion for its rows
+// (or nodes, for Barnes-Hut). 3D layouts always take the exact kernel.
+static void repulsion_task(void *context, int thread, int num_threads) {
+    const ForcePass *pass = context;
+    const Nodes *nodes = pass->nodes;
+    int num_nodes = nodes->count;
+    float *displacement[3];
+    thread_displacements(pass, thread, displacement);
+    float *dx = displacement[0], *dy = displacement[1];
+
+    // Reset displacements
+    for (int a = 0; a < nodes->dimensions; a++) {
+        memset(displacement[a], 0, (size_t)num_nodes * sizeof(float));
+    }
+
+    // Calculate repulsive forces
+    int begin, end;
+    if (nodes->dimensions == 3) {
+        const float *position[3] = {nodes->x, nodes->y, nodes->z};
+        begin = triangle_split(num_nodes, thread, num_threads);
+        end = triangle_split(num_nodes, thread + 1, num_threads);
+        repulsion_pairs_3d(position, num_nodes, begin, end, displacement);
+    } else if (pass->settings->repulsion == REPULSION_BARNES_HUT) {
+        split_range(num_nodes, thread, num_threads, &begin, &end);
+        repulsion_barnes_hut(&pass->workspace->tree, nodes->x, nodes->y, begin, end, pass->settings->theta, dx, dy,
+                             pass->skip_frozen ? nodes->still : NULL);
+    } else {
+        begin = triangle_split(num_nodes, thread, num_threads);
+        end = triangle_split(num_nodes, thread + 1, num_threads);
+        pass->kernels->repulsion(nodes->x, nodes->y, num_nodes, begin, end, dx, dy);
+    }
+}
+
+// Phase 2: attraction for each thread's slice of the edges, same buffers
+static void attraction_task(void *context, int thread, int num_threads) {
+    const ForcePass *pass = context;
+    const Nodes *nodes = pass->nodes;
+    float *displacement[3];
+    thread_displacements(pass, thread, displacement);
+
+    // Calculate attractive forces
+    int begin, end;
+    split_range(pass->num_edges, thread, num_threads, &begin, &end);
+    if (nodes->dimensions == 3) {
+        const float *position[3] = {nodes->x, nodes->y, nodes->z};
+        attraction_edges_3d(position, pass->edges + begin, end - begin, displacement);
+    } else {
+        pass->kernels->attraction(nodes->x, nodes->y, pass->edges + begin, end - begin, displacement[0], displacement[1]);
+    }
+}
+
+// Phase 3: reduce the buffers in thread order, then move the nodes. The fixed
+// partition and summation order make the result reproducible for a thread count.
+static void integrate_task(void *context, int thread, int num_threads) {
+    const ForcePass *pass = context;
+    Nodes *nodes = pass->nodes;
+    int dimensions = nodes->dimensions;
+    float *displacement[3];
+    thread_displacements(pass, 0, displacement);
+    int begin, end;
+    split_range(nodes->count, thread, num_threads, &begin, &end);
+
+    for (int t = 1; t < num_threads; t++) {
+        float *other[3];
+        thread_displacements(pass, t, other);
+        for (int a = 0; a < dimensions; a++) {
+            float *d = displacement[a];
+            const float *o = other[a];
+            for (int i = begin; i < end; i++) {
+                d[i] += o[i];
+            }
+        }
+    }
+
+    // Update positions based on forces
+    float *position[3] = {nodes->x, nodes->y, nodes->z};
+    const float *const *forces = (const float *const *)displacement;
+    pass->workspace->thread_stats[thread] = dimensions == 3
+        ? integrate_3d(position, forces, nodes->still, begin, end, pass->temperature, pass->skip_frozen)
+        : integrate_2d(position, forces, nodes->still, begin, end, pass->temperature, pass->skip_frozen);
+}
+
+// Function to calculate forces and update node positions
+ForceStats calculate_forces(Nodes *nodes, const Edge edges[], int num_edges, float temperature, int iteration, const ForceSettings *settings) {
+    int num_threads = threadpool_size(settings->pool);
+    int skip_frozen = settings->freeze && iteration % FREEZE_RECHECK != 0;
+    // Without a workspace the buffers only live for this call
+    ForceWorkspace local = {0};
+    ForceWorkspace *workspace = settings->workspace != NULL ? settings->workspace : &local;
+    ForcePass pass = {nodes, edges, num_edges, temperature, skip_frozen, settings,
+                      settings->kernels ? settings->kernels : &force_kernels_scalar, workspace};
+
+    size_t size = (size_t)(num_threads - 1) * nodes->dimensions * (size_t)nodes->count;
+    if (size > workspace->thread_buffers_size) {
+        float *buffers = realloc(workspace->thread_buffers, size * sizeof(float));
+        if (buffers == NULL) {
+            printf("Out of memory for %d thread buffers\n", num_threads - 1);
+            exit(1);
+        }
+        workspace->thread_buffers = buffers;
+        workspace->thread_buffers_size = size;
+    }
+    workspace->buffer_stride = (size_t)nodes->count;
+    if (num_threads > workspace->thread_stats_size) {
+        ForceStats *stats = realloc(workspace->thread_stats, (size_t)num_threads * sizeof(ForceStats));
+        if (stats == NULL) {
+            printf("Out of memory for %d thread buffers\n", num_threads);
+            exit(1);
+        }
+        workspace->thread_stats = stats;
+        workspace->thread_stats_size = num_threads;
+    }
+
+    ForceTimings *timings = settings->timings;
+    int timed = timings != NULL || profile_enabled();
+    double start = timed ? layout_seconds() : 0;
+
+    if (settings->repulsion == REPULSION_BARNES_HUT && nodes->dimensions == 2) {
+        quadtree_build(&workspace->tree, nodes->x, nodes->y, nodes->count);
+    }
+    threadpool_run(settings->pool, repulsion_task, &pass);
+    double repulsion_end = timed ? layout_seconds() : 0;
+
+    threadpool_run(settings->pool, attraction_task, &pass);
+    double attraction_end = timed ? layout_seconds() : 0;
+
+    threadpool_run(settings->pool, integrate_task, &pass);
+
+    if (timed) {
+        double end = layout_seconds();
+        if (timings) {
+            timings->repulsion += repulsion_end - start;
+            timings->attraction += attraction_end - repulsion_end;
+            timings->integration += end - attraction_end;
+        }
+        profile_record("repulsion", start, repulsion_end);
+        profile_record("attraction", repulsion_end, attraction_end);
+        profile_record("integration", attraction_end, end);
+    }
+
+    ForceStats stats = {0.0, 0.0, 0};
+    for (int t = 0; t < num_threads; t++) {
+        stats.energy += workspace->thread_stats[t].energy;
+        stats.displacement += workspace->thread_stats[t].displacement;
+        stats.moving += workspace->thread_stats[t].moving;
+    }
+    if (workspace == &local) {
+        quadtree_free(&local.tree);
+        free(local.thread_buffers);
+        free(local.thread_stats);
+    }
+    return stats;
+}
+
+// Monotonic wall clock in seconds
+double layout_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+// Relative RMS error of the Barnes-Hut repulsion against the exact kernel:
+// sqrt(sum |f_bh - f_exact|^2 / sum |f_exact|^2) over all nodes
+float barnes_hut_force_error(const Nodes *nodes, float theta) {
+    int n = nodes->count;
+    float *buffer = calloc((size_t)(n > 0 ? n : 1) * 4, sizeof(float));
+    if (buffer == NULL) {
+        return -1.0f;
+    }
+    float *exact_x = buffer, *exact_y = buffer + n, *approx_x = buffer + 2 * n, *approx_y = buffer + 3 * n;
+
+    force_kernels_scalar.repulsion(nodes->x, nodes->y, n, 0, n, exact_x, exact_y);
+    QuadTree tree = {0};
+    quadtree_build(&tree, nodes->x, nodes->y, n);
+    repulsion_barnes_hut(&tree, nodes->x, nodes->y, 0, n, theta, approx_x, approx_y, NULL);
+    quadtree_free(&tree);
+
+    double err = 0, ref = 0;
+    for (int i = 0; i < n; i++) {
+        double ex = approx_x[i] - exact_x[i];
+        double ey = approx_y[i] - exact_y[i];
+        err += ex * ex + ey * ey;
+        ref += (double)exact_x[i] * exact_x[i] + (double)exact_y[i] * exact_y[i];
+    }
+
+    free(buffer);
+    return ref > 0 ? (float)sqrt(err / ref) : 0.0f;
+}
+
+// Clamp function to limit values
+float clamp(float value, float min, float max) {
+    if (value < min) return min;
+    if (value > max) return max;
+    return value;
+}
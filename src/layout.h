@@ -0,0 +1,102 @@
+#ifndef LAYOUT_H
+#define LAYOUT_H
+
+#include <stddef.h>
+
+#define WINDOW_WIDTH 1280
+#define WINDOW_HEIGHT 960
+
+#define BOX_MARGIN 50 // Margin for the bounding box
+
+#define ADJUSTMENTS_COLUMN_WIDTH 200 // Width for the button column
+
+#define BOX_WIDTH (WINDOW_WIDTH - 2 * BOX_MARGIN - ADJUSTMENTS_COLUMN_WIDTH)
+#define BOX_HEIGHT (WINDOW_HEIGHT - 2 * BOX_MARGIN)
+#define BOX_DEPTH BOX_HEIGHT // Third axis of the box in 3D layouts
+
+#define START_TEMPERATURE 40.0f // Initial temperature: og 50.0f
+#define COOLING_FACTOR 0.95 // Cooling factor for reducing temperature: og .95
+
+#define BARNES_HUT_THETA 0.5f // Default opening angle, 0 degenerates to the exact kernel
+#define AUTO_BARNES_HUT_NODES 2000 // Automatic repulsion mode switches to Barnes-Hut above this size
+
+#define FREEZE_EPSILON 0.05f // A node moving less than this many pixels counts as still
+#define FREEZE_ITERATIONS 8  // Consecutive still iterations before a node is frozen
+#define FREEZE_RECHECK 16    // Frozen nodes are evaluated again every this many iterations
+
+// Node storage, structure of arrays. Each array is NODES_ALIGNMENT-aligned and
+// padded to a multiple of NODES_PADDING floats so vector kernels can stream it.
+#define NODES_ALIGNMENT 32
+#define NODES_PADDING 8
+
+typedef struct {
+    int count;
+    int capacity;   // Floats per array, count can grow up to it in place
+    int dimensions; // 2, or 3 with z and dz allocated
+    float *x, *y, *z;    // Position, z NULL in 2D
+    float *dx, *dy, *dz; // Displacement
+    unsigned char *still; // Consecutive iterations without moving, saturating
+} Nodes;
+
+// Edge structure
+typedef struct {
+    int from;
+    int to;
+} Edge;
+
+// Repulsion kernels
+typedef enum {
+    REPULSION_EXACT,      // All pairs, O(n^2); the reference path
+    REPULSION_BARNES_HUT  // Quadtree far-field approximation, O(n log n)
+} RepulsionMode;
+
+typedef struct ForceKernels ForceKernels; // forces.h
+typedef struct ThreadPool ThreadPool;     // threadpool.h
+
+// Buffers calculate_forces keeps between calls: the Barnes-Hut tree and the
+// per-thread displacements. Layouts that run at the same time need one each.
+typedef struct ForceWorkspace ForceWorkspace;
+
+// Wall time spent in each phase of calculate_forces, in seconds
+typedef struct {
+    double repulsion;   // Includes the Barnes-Hut tree build
+    double attraction;
+    double integration; // Buffer reduction and position update
+} ForceTimings;
+
+typedef struct {
+    RepulsionMode repulsion;
+    float theta;                 // Barnes-Hut opening angle
+    const ForceKernels *kernels; // Pairwise and edge kernels, see force_kernels_select
+    ThreadPool *pool;            // Workers for the force passes, NULL for one thread
+    ForceTimings *timings;       // Accumulates phase times when not NULL
+    int freeze;                  // Leave out nodes that have stopped moving
+    ForceWorkspace *workspace;   // Reused scratch, NULL allocates it for each call
+} ForceSettings;
+
+// Progress of one calculate_forces call, summed over the nodes that moved
+typedef struct {
+    double energy;       // Squared force magnitudes before the temperature clamp
+    double displacement; // Distance moved
+    int moving;          // Nodes integrated, the rest were frozen
+} ForceStats;
+
+int nodes_alloc(Nodes *nodes, int count); // 2D
+int nodes_alloc_dimensions(Nodes *nodes, int count, int dimensions);
+// Node arrays in caller-owned memory, NODES_ALIGNMENT-aligned and
+// nodes_block_size bytes; such nodes are never resized or freed
+size_t nodes_block_size(int count, int dimensions);
+void nodes_attach(Nodes *nodes, void *block, int count, int dimensions);
+int nodes_resize(Nodes *nodes, int count);
+void nodes_remove(Nodes *nodes, int node);
+int nodes_permute(Nodes *nodes, const int *order); // Node order[i] moves to index i
+void nodes_free(Nodes *nodes);
+void initialize_nodes(Nodes *nodes, unsigned int seed);
+ForceWorkspace *force_workspace_create(void);
+void force_workspace_destroy(ForceWorkspace *workspace);
+ForceStats calculate_forces(Nodes *nodes, const Edge edges[], int num_edges, float temperature, int iteration, const ForceSettings *settings);
+float barnes_hut_force_error(const Nodes *nodes, float theta);
+float clamp(float value, float min, float max);
+double layout_seconds(void);
+
+#endif
@@ -0,0 +1,18 @@
+#include "layout_dim.h"
+
+#include <math.h>
+
+// Same as clamp(), visible to the compiler so the loops stay inlined
+static inline float dim_clamp(float value, float min, float max) {
+    if (value < min) return min;
+    if (value > max) return max;
+    return value;
+}
+
+#define LAYOUT_DIM 2
+#include "layout_dim_template.h"
+#undef LAYOUT_DIM
+
+#define LAYOUT_DIM 3
+#include "layout_dim_template.h"
+#undef LAYOUT_DIM
@@ -0,0 +1,32 @@
+#ifndef LAYOUT_DIM_H
+#define LAYOUT_DIM_H
+
+#include "layout.h"
+
+// Force, integration and bounding-box code shared by 2D and 3D layouts. It is
+// written once in layout_dim_template.h and compiled twice by layout_dim.c,
+// once per dimension, so every loop over the axes has a constant trip count
+// and unrolls away. Positions and displacements are passed as one array per
+// axis (x, y and for 3D z).
+
+// All pairs (i, j > i) for rows i in [row_begin, row_end), both ends updated,
+// like ForceKernels.repulsion
+void repulsion_pairs_2d(const float *const *position, int num_nodes, int row_begin, int row_end, float *const *displacement);
+void repulsion_pairs_3d(const float *const *position, int num_nodes, int row_begin, int row_end, float *const *displacement);
+
+void attraction_edges_2d(const float *const *position, const Edge *edges, int num_edges, float *const *displacement);
+void attraction_edges_3d(const float *const *position, const Edge *edges, int num_edges, float *const *displacement);
+
+// Move nodes [begin, end) by their displacement limited to `temperature` per
+// axis, keep them in the box and update the stillness counters. Frozen nodes
+// are skipped when skip_frozen is set.
+ForceStats integrate_2d(float *const *position, const float *const *displacement, unsigned char *still, int begin, int end,
+                        float temperature, int skip_frozen);
+ForceStats integrate_3d(float *const *position, const float *const *displacement, unsigned char *still, int begin, int end,
+                        float temperature, int skip_frozen);
+
+// Per-axis minimum and maximum over the first `count` nodes; min > max when count is 0
+void bounds_2d(const float *const *position, int count, float *min, float *max);
+void bounds_3d(const float *const *position, int count, float *min, float *max);
+
+#endif
@@ -0,0 +1,106 @@
+// Dimension-generic layout code, see layout_dim.h. Included by layout_dim.c
+// with LAYOUT_DIM set to 2 or 3; DIM_NAME(integrate) becomes integrate_2d or
+// integrate_3d. No include guard on purpose.
+
+#ifndef LAYOUT_DIM
+#error "define LAYOUT_DIM before including layout_dim_template.h"
+#endif
+
+#define DIM_PASTE(name, dim) name##_##dim##d
+#define DIM_EXPAND(name, dim) DIM_PASTE(name, dim)
+#define DIM_NAME(name) DIM_EXPAND(name, LAYOUT_DIM)
+
+// Repulsion 1000 / d along the unit vector (r / d), folded into r * (1000 / d^2)
+void DIM_NAME(repulsion_pairs)(const float *const *position, int num_nodes, int row_begin, int row_end,
+                               float *const *displacement) {
+    for (int i = row_begin; i < row_end; i++) {
+        float sum[LAYOUT_DIM] = {0};
+        for (int j = i + 1; j < num_nodes; j++) {
+            float r[LAYOUT_DIM];
+            float d2 = 0;
+            for (int a = 0; a < LAYOUT_DIM; a++) {
+                r[a] = position[a][i] - position[a][j];
+                d2 += r[a] * r[a];
+            }
+
+            if (d2 > 0) {
+                float force = 1000.0f / d2;
+                for (int a = 0; a < LAYOUT_DIM; a++) {
+                    sum[a] += r[a] * force;
+                    displacement[a][j] -= r[a] * force;
+                }
+            }
+        }
+        for (int a = 0; a < LAYOUT_DIM; a++) {
+            displacement[a][i] += sum[a];
+        }
+    }
+}
+
+// Attraction d^2 / 1000 along the unit vector (r / d), folded into r * (d / 1000)
+void DIM_NAME(attraction_edges)(const float *const *position, const Edge *edges, int num_edges,
+                                float *const *displacement) {
+    for (int e = 0; e < num_edges; e++) {
+        int from = edges[e].from;
+        int to = edges[e].to;
+        float r[LAYOUT_DIM];
+        float d2 = 0;
+        for (int a = 0; a < LAYOUT_DIM; a++) {
+            r[a] = position[a][from] - position[a][to];
+            d2 += r[a] * r[a];
+        }
+        float force = sqrtf(d2) / 1000.0f;
+        for (int a = 0; a < LAYOUT_DIM; a++) {
+            displacement[a][from] -= r[a] * force;
+            displacement[a][to] += r[a] * force;
+        }
+    }
+}
+
+ForceStats DIM_NAME(integrate)(float *const *position, const float *const *displacement, unsigned char *still, int begin,
+                               int end, float temperature, int skip_frozen) {
+    static const float box_min[3] = {BOX_MARGIN, BOX_MARGIN, BOX_MARGIN};
+    static const float box_max[3] = {BOX_MARGIN + BOX_WIDTH, BOX_MARGIN + BOX_HEIGHT, BOX_MARGIN + BOX_DEPTH};
+    ForceStats stats = {0.0, 0.0, 0};
+    for (int i = begin; i < end; i++) {
+        if (skip_frozen && still[i] >= FREEZE_ITERATIONS) continue;
+        float moved2 = 0;
+        double energy = 0;
+        for (int a = 0; a < LAYOUT_DIM; a++) {
+            float old = position[a][i];
+            float d = displacement[a][i];
+            float p = old + dim_clamp(d, -temperature, temperature);
+            p = dim_clamp(p, box_min[a], box_max[a]); // Keep nodes within the bounding box
+            position[a][i] = p;
+            moved2 += (p - old) * (p - old);
+            energy += (double)d * d;
+        }
+
+        float moved = sqrtf(moved2);
+        stats.energy += energy;
+        stats.displacement += moved;
+        stats.moving++;
+        if (moved >= FREEZE_EPSILON) {
+            still[i] = 0;
+        } else if (still[i] < 255) {
+            still[i]++;
+        }
+    }
+    return stats;
+}
+
+void DIM_NAME(bounds)(const float *const *position, int count, float *min, float *max) {
+    for (int a = 0; a < LAYOUT_DIM; a++) {
+        float low = INFINITY, high = -INFINITY;
+        for (int i = 0; i < count; i++) {
+            low = fminf(low, position[a][i]);
+            high = fmaxf(high, position[a][i]);
+        }
+        min[a] = low;
+        max[a] = high;
+    }
+}
+
+#undef DIM_NAME
+#undef DIM_EXPAND
+#undef DIM_PASTE
@@ -2,27 +2,27 @@
 #include <SDL2/SDL_ttf.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <math.h>
 #include <time.h>
+#include <stdatomic.h>
+
+#include "layout.h"
+#include "graph.h"
+#include "forces.h"
+#include "threadpool.h"
+#include "simulation.h"
+#include "render.h"
+#include "hud.h"
+#include "profile.h"
+#include "checkpoint.h"
 
-#define WINDOW_WIDTH 1280
-#define WINDOW_HEIGHT 960
-
-#define BOX_MARGIN 50 // Margin for the bounding box
 #define BOX_THICKNESS 5 // Thickness of the bounding box
 
-#define ADJUSTMENTS_COLUMN_WIDTH 200 // Width for the button column
-
-#define BOX_WIDTH (WINDOW_WIDTH - 2 * BOX_MARGIN - ADJUSTMENTS_COLUMN_WIDTH)
-#define BOX_HEIGHT (WINDOW_HEIGHT - 2 * BOX_MARGIN)
-
-#define NUM_NODES 21
 #define NODE_RADIUS 7 // Node radius
 
 #define ITERATIONS 201 // Max frames before end: og 1000
-#define COOLING_FACTOR 0.95 // Cooling factor for reducing temperature: og .95
 #define FRAME_STEP_SIZE 3 // Smaller step size for smoother movement: og 5
-#define FRAME_DELAY 16 // Approx 60 FPS (1000ms / 60 frames = ~16ms per frame)
 
 #define BUTTON_WIDTH 150
 #define BUTTON_HEIGHT 50
@@ -30,48 +30,157 @@
 #define MIN_CELL_SIZE 20
 #define MAX_CELL_SIZE 200
 
+#define PICK_RADIUS (NODE_RADIUS + 3) // Clicks this close to a node, in pixels, select it
+#define ROTATE_STEP 0.08f // Radians per key press when turning a 3D layout
+#define TEMPERATURE_STEP 1.25f // Factor per key press when heating or cooling the layout
+#define DEFAULT_CHECKPOINT "checkpoint.frl" // Written by C unless --checkpoint names another file
+#define HUD_SETTLE (HUD_WINDOW + HUD_REFRESH) // Seconds the HUD keeps refreshing after the last change
 
-// Constants for the clipping region codes
-#define INSIDE 0 // 0000
-#define LEFT   1 // 0001
-#define RIGHT  2 // 0010
-#define BOTTOM 4 // 0100
-#define TOP    8 // 1000
-
-// Node structure
-typedef struct {
-    float x, y;   // Position
-    float dx, dy; // Displacement
-} Node;
-
-// Edge structure
+// Wakes the render loop from SDL_WaitEvent when the simulation publishes a
+// snapshot. Only one wake event is queued at a time.
 typedef struct {
-    int from;
-    int to;
-} Edge;
-
-// Global variables to store the initial state
-Node initial_node_states[NUM_NODES];
-Node node_states[ITERATIONS][NUM_NODES];
-int initial_state_saved = 0;
+    Uint32 type; // Registered user event, (Uint32)-1 if none was left
+    atomic_int pending;
+} Wakeup;
 
 // Function prototypes
-void initialize_nodes(Node nodes[], int num_nodes);
-void initialize_edges(Edge edges[], int num_edges);
-void draw_circle(SDL_Renderer *renderer, int x, int y, int radius);
-void calculate_forces(Node nodes[], Edge edges[], int num_nodes, int num_edges, float temperature, int iteration);
-void save_node_state(Node nodes[], int iteration);
-void restore_node_state(Node nodes[], int iteration);
-void save_initial_state(Node nodes[]);
-void restore_initial_state(Node nodes[]);
-float clamp(float value, float min, float max);
 int is_point_in_rect(int x, int y, SDL_Rect* rect);
+int pick_node(const float *node_x, const float *node_y, int num_nodes, const ViewTransform *view, int x, int y);
 void draw_grid(SDL_Renderer *renderer, int cell_size, float grid_offset_x, float grid_offset_y); 
-void draw_circle_clipped(SDL_Renderer *renderer, int x, int y, int radius, int left, int top, int right, int bottom);
-void draw_line_clipped(SDL_Renderer *renderer, int x1, int y1, int x2, int y2, int left, int top, int right, int bottom);
-int compute_code(int x, int y, int left, int top, int right, int bottom);
+void wake_renderer(void *context);
 
 int main(int argc, char *argv[]) {
+    // Command line: [--kernels=auto|scalar|sse2|avx2] [--threads=N] [--ips=N] [--history-mb=N] [--trace=FILE]
+    //               [--placement=random|bfs|pivot-mds|multilevel] [--seed=N] [--dimensions=2|3]
+    //               [--checkpoint=FILE] [--checkpoint-every=N] [--resume=FILE]
+    //               [--capture=DIR] [--capture-format=png|ppm] [--capture-size=WxH] [--capture-queue=N]
+    //               [--connect=ADDRESS] [--verify-kernels] [graph file]
+    const char *graph_path = NULL;
+    const char *kernel_name = "auto";
+    int num_threads = 0; // One per core
+    int iterations_per_second = 0; // Simulation pacing, 0 for as fast as possible
+    size_t history_budget = HISTORY_DEFAULT_BUDGET; // Bytes kept for stepping back
+    const char *trace_path = NULL; // Chrome trace written on exit and on T
+    PlacementKind placement = PLACEMENT_RANDOM;
+    uint64_t seed = (uint64_t)time(NULL); // Fixed with --seed for reproducible runs
+    int dimensions = 2; // 3 lays out in a cube, shown turned with J/L and I/K
+    int verify_kernels = 0;
+    const char *checkpoint_path = DEFAULT_CHECKPOINT; // Saved with C
+    int checkpoint_every = 0;
+    const char *resume_path = NULL; // Checkpoint to continue from instead of a graph file
+    const char *connect_address = NULL; // Stream server to follow instead of laying out locally
+    const char *capture_path = NULL; // Directory every iteration is rendered into
+    CaptureFormat capture_format = CAPTURE_PNG;
+    int capture_width = CAPTURE_DEFAULT_WIDTH, capture_height = CAPTURE_DEFAULT_HEIGHT;
+    int capture_queue = CAPTURE_DEFAULT_QUEUE;
+    for (int i = 1; i < argc; i++) {
+        if (strncmp(argv[i], "--kernels=", 10) == 0) {
+            kernel_name = argv[i] + 10;
+        } else if (strncmp(argv[i], "--threads=", 10) == 0) {
+            num_threads = atoi(argv[i] + 10);
+        } else if (strncmp(argv[i], "--ips=", 6) == 0) {
+            iterations_per_second = atoi(argv[i] + 6);
+        } else if (strncmp(argv[i], "--history-mb=", 13) == 0) {
+            history_budget = (size_t)strtoul(argv[i] + 13, NULL, 10) << 20;
+        } else if (strncmp(argv[i], "--trace=", 8) == 0) {
+            trace_path = argv[i] + 8;
+        } else if (strncmp(argv[i], "--placement=", 12) == 0) {
+            int kind = placement_from_name(argv[i] + 12);
+            if (kind < 0) {
+                printf("Unknown placement \"%s\"\n", argv[i] + 12);
+                return 1;
+            }
+            placement = kind;
+        } else if (strncmp(argv[i], "--seed=", 7) == 0) {
+            seed = strtoull(argv[i] + 7, NULL, 10);
+        } else if (strncmp(argv[i], "--dimensions=", 13) == 0) {
+            dimensions = atoi(argv[i] + 13);
+            if (dimensions != 2 && dimensions != 3) {
+                printf("Dimensions must be 2 or 3\n");
+                return 1;
+            }
+        } else if (strncmp(argv[i], "--checkpoint=", 13) == 0) {
+            checkpoint_path = argv[i] + 13;
+        } else if (strncmp(argv[i], "--checkpoint-every=", 19) == 0) {
+            checkpoint_every = atoi(argv[i] + 19);
+        } else if (strncmp(argv[i], "--capture=", 10) == 0) {
+            capture_path = argv[i] + 10;
+        } else if (strncmp(argv[i], "--capture-format=", 17) == 0) {
+            int format = capture_format_from_name(argv[i] + 17);
+            if (format < 0) {
+                printf("Unknown capture format \"%s\"\n", argv[i] + 17);
+                return 1;
+            }
+            capture_format = format;
+        } else if (strncmp(argv[i], "--capture-size=", 15) == 0) {
+            if (sscanf(argv[i] + 15, "%dx%d", &capture_width, &capture_height) != 2) {
+                printf("Capture size must be WIDTHxHEIGHT\n");
+                return 1;
+            }
+        } else if (strncmp(argv[i], "--capture-queue=", 16) == 0) {
+            capture_queue = atoi(argv[i] + 16);
+        } else if (strncmp(argv[i], "--resume=", 9) == 0) {
+            resume_path = argv[i] + 9;
+        } else if (strncmp(argv[i], "--connect=", 10) == 0) {
+            connect_address = argv[i] + 10;
+        } else if (strcmp(argv[i], "--verify-kernels") == 0) {
+            verify_kernels = 1;
+        } else {
+            graph_path = argv[i];
+        }
+    }
+
+    ForceSettings force_settings = {REPULSION_EXACT, BARNES_HUT_THETA, force_kernels_select(kernel_name), NULL, NULL, 1, NULL};
+    if (force_settings.kernels == NULL) {
+        printf("Force kernels \"%s\" are not available on this CPU\n", kernel_name);
+        return 1;
+    }
+
+    // Load the graph given on the command line, or fall back to the demo graph.
+    // A checkpoint is mapped and its graph used in place, and a stream brings
+    // its own graph.
+    Checkpoint resume;
+    Graph graph;
+    if (connect_address != NULL) {
+        memset(&graph, 0, sizeof(graph));
+    } else if (resume_path != NULL) {
+        if (checkpoint_open(&resume, resume_path) != 0) {
+            return 1;
+        }
+        graph = resume.graph;
+        printf("Resuming %s at iteration %d\n", resume_path, resume.iteration);
+    } else if (graph_path != NULL) {
+        if (graph_load(&graph, graph_path) != 0) {
+            return 1;
+        }
+    } else {
+        graph_init_default(&graph);
+    }
+    int num_nodes = graph.num_nodes;
+    int num_edges = graph.num_edges;
+    if (connect_address == NULL) {
+        printf("Loaded %d nodes, %d edges\n", num_nodes, num_edges);
+    }
+
+    Edge *edges = graph.edges;
+
+    // Compare the selected kernels against the scalar path on random positions and quit
+    if (verify_kernels) {
+        Nodes nodes;
+        if (nodes_alloc(&nodes, num_nodes) != 0) {
+            return 1;
+        }
+        initialize_nodes(&nodes, (unsigned int)time(NULL));
+        float error = force_kernels_error(force_settings.kernels, &nodes, edges, num_edges);
+        int ok = error >= 0 && error <= FORCE_KERNEL_TOLERANCE;
+        printf("Force kernels: %s, deviation from scalar = %g (%s)\n", force_settings.kernels->name, error, ok ? "ok" : "FAILED");
+        nodes_free(&nodes);
+        graph_free(&graph);
+        return ok ? 0 : 1;
+    }
+    force_settings.pool = threadpool_create(num_threads);
+    printf("Force kernels: %s, %d threads\n", force_settings.kernels->name, threadpool_size(force_settings.pool));
+
     if (SDL_Init(SDL_INIT_VIDEO) != 0) {
         printf("SDL_Init Error: %s\n", SDL_GetError());
         return 1;
@@ -92,37 +201,72 @@ int main(int argc, char *argv[]) {
         return 1;
     }
 
-    // Initialize nodes and edges
-    Node nodes[NUM_NODES];
-    Edge edges[42];
+    // Separate workers for density rendering, the force pool belongs to the simulation thread
+    ThreadPool *render_pool = threadpool_create(num_threads);
+    GraphRenderer graph_renderer;
+    if (graph_renderer_init(&graph_renderer, renderer, NODE_RADIUS, render_pool) != 0) {
+        SDL_DestroyRenderer(renderer);
+        SDL_DestroyWindow(win);
+        SDL_Quit();
+        return 1;
+    }
 
-    initialize_nodes(nodes, NUM_NODES);
-    initialize_edges(edges, 42);
-    save_initial_state(nodes); // Save the initial state
+    // Frames for --capture are drawn offscreen by the simulation thread and
+    // written by the capture's own encoder thread
+    Capture *capture = NULL;
+    if (capture_path != NULL &&
+        (capture = capture_create(capture_path, capture_format, capture_width, capture_height, capture_queue)) == NULL) {
+        graph_renderer_free(&graph_renderer);
+        SDL_DestroyRenderer(renderer);
+        SDL_DestroyWindow(win);
+        SDL_Quit();
+        return 1;
+    }
+
+    // The layout runs on its own thread and publishes position snapshots,
+    // each followed by a wake event for the render loop
+    Wakeup wakeup = {SDL_RegisterEvents(1), 0};
+    int on_demand = wakeup.type != (Uint32)-1; // Otherwise every loop redraws
+    Simulation sim;
+    SimulationOptions options = {ITERATIONS, iterations_per_second, history_budget, placement, seed, dimensions,
+                                 resume_path != NULL ? &resume : NULL, checkpoint_path, checkpoint_every, capture,
+                                 on_demand ? wake_renderer : NULL, &wakeup};
+    int started = connect_address != NULL ? simulation_connect(&sim, connect_address, &graph, &options)
+                                          : simulation_start(&sim, &graph, &force_settings, &options);
+    if (started != 0) {
+        if (capture != NULL) capture_finish(capture, NULL);
+        graph_renderer_free(&graph_renderer);
+        SDL_DestroyRenderer(renderer);
+        SDL_DestroyWindow(win);
+        SDL_Quit();
+        return 1;
+    }
 
-    float temperature = 40.0f; // Initial temperature: og 50.0f 
     int cell_size = 30;
     float grid_offset_x = 0.0f; // Horizontal offset for panning
     float grid_offset_y = 0.0f; // Vertical offset for panning
 
     // Main loop flag
     int running = 1;
-    int auto_play = 0;  // Flag for automatic play/pause
-    int iteration_updated_manually = 0; // Flag for manual frame updates
 
     // Event handler
     SDL_Event e;
 
-    int iteration = 0;
-    int max_iterations = ITERATIONS;
+    // Node picked for editing, -1 for none, and the snapshot on screen to pick from
+    int selected = -1;
+    const Snapshot *shown = simulation_snapshot(&sim, NULL);
+
+    // 3D layouts are drawn through an orthographic projection, redone when
+    // the layout or the angles change
+    Projection projection = {0.35f, 0.35f, NULL, NULL, 0};
+    int rotated = 1;
+    const float *shown_x = shown->x, *shown_y = shown->y;
 
     // "Generate Nodes" button
     SDL_Rect buttonRect = {WINDOW_WIDTH - BUTTON_WIDTH - 50, WINDOW_HEIGHT - BUTTON_HEIGHT - 37, BUTTON_WIDTH, BUTTON_HEIGHT};
 
-    int left_bound = BOX_MARGIN;
-    int top_bound = BOX_MARGIN;
-    int right_bound = BOX_MARGIN + BOX_WIDTH;
-    int bottom_bound = BOX_MARGIN + BOX_HEIGHT;
+    // Nodes and edges are drawn inside the bounding box only
+    SDL_Rect graph_bounds = {BOX_MARGIN, BOX_MARGIN, BOX_WIDTH + 1, BOX_HEIGHT + 1};
 
     // Initialization (ttf)
     if (TTF_Init() == -1) {
@@ -149,11 +293,10 @@ int main(int argc, char *argv[]) {
         return 1;
     }
 
-    // Frames text
+    // Frames text, rasterized again only when the iteration changes
     SDL_Color textColor = {0, 0, 0, 255};
-    SDL_Surface *textSurface = TTF_RenderText_Solid(font, "Frame: 0", textColor);
-    SDL_Texture *textTexture = SDL_CreateTextureFromSurface(renderer, textSurface);
-    SDL_FreeSurface(textSurface);
+    SDL_Texture *textTexture = NULL;
+    int textIteration = -1;
 
     // Algorithm name text
     const char *algorithmName = "Fruchterman-Reingold";
@@ -169,20 +312,92 @@ int main(int argc, char *argv[]) {
     SDL_Texture *buttonTextTexture = SDL_CreateTextureFromSurface(renderer, buttonTextSurface);
     SDL_FreeSurface(buttonTextSurface);
 
+    int button_text_width = 0;
+    int button_text_height = 0;
+    TTF_SizeText(font, "Generate New", &button_text_width, &button_text_height);
+
+    // Make sure the text fits within the button
+    if (button_text_width > buttonRect.w || button_text_height > buttonRect.h) {
+        buttonRect.w = button_text_width + 10;  // Padding
+        buttonRect.h = button_text_height + 10;
+    }
+
+    // Button text (keeping it centered)
+    SDL_Rect buttonTextRect = {
+        buttonRect.x + (buttonRect.w - button_text_width) / 2,
+        buttonRect.y + (buttonRect.h - button_text_height) / 2,
+        button_text_width,
+        button_text_height
+    };
+
+    // Position the algorithm name centered above the bounding box
+    SDL_Rect algorithmTextRect = {
+        BOX_MARGIN + (BOX_WIDTH - text_width) / 2,
+        BOX_MARGIN - text_height - 10,
+        text_width,
+        text_height
+    };
+
+    // Grid, bounding box, title and button are drawn once into a texture and
+    // copied every frame, and drawn again only after a pan or zoom. Without
+    // render targets they are drawn straight to the window every frame.
+    SDL_Texture *background = NULL;
+    if (SDL_RenderTargetSupported(renderer)) {
+        background = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_TARGET, WINDOW_WIDTH, WINDOW_HEIGHT);
+    }
+    int background_cell_size = 0; // View the background was drawn for, 0 for none
+    float background_offset_x = 0.0f, background_offset_y = 0.0f;
+
+    // Redraw only when the view, the selection or the layout changed
+    int dirty = 1;
+    double settle_until = 0.0; // HUD refreshes stop after this time
+
+    // Timing overlay in the adjustments column
+    profile_enable(1);
+    profile_thread_name("render");
+    Hud hud;
+    if (hud_init(&hud, "fonts/RobotoMono-VariableFont_wght.ttf", 14) != 0) {
+        running = 0;
+    }
+
     while (running) {
-        while (SDL_PollEvent(&e) != 0) {
+        // Sleep until there is input, a new snapshot, or a HUD refresh due
+        // while the rates it shows settle after the last change
+        int timeout = -1;
+        double now = layout_seconds();
+        if (now < settle_until) {
+            timeout = hud.next_refresh > now ? (int)((hud.next_refresh - now) * 1000.0) + 1 : 0;
+        }
+        int have_event = dirty ? SDL_PollEvent(&e) : SDL_WaitEventTimeout(&e, timeout);
+
+        double frame_start = profile_begin();
+        double phase_start = frame_start;
+        for (; have_event; have_event = SDL_PollEvent(&e)) {
             if (e.type == SDL_QUIT) {
                 running = 0;
+            } else if (e.type == SDL_WINDOWEVENT) {
+                dirty = 1;
+            } else if (e.type == SDL_RENDER_TARGETS_RESET) {
+                background_cell_size = 0; // Texture contents were lost
+                dirty = 1;
             } else if (e.type == SDL_MOUSEBUTTONDOWN) {
+                dirty = 1;
                 // Check if the "Generate Nodes" button is clicked
                 if (is_point_in_rect(e.button.x, e.button.y, &buttonRect)) {
-                    initialize_nodes(nodes, NUM_NODES); // Generate new nodes
-                    iteration = 0; // Reset
-                    temperature = 50.0f; // Reset
-                    auto_play = 0; // Stop auto-play if active
-                    save_initial_state(nodes); // Save the initial state
+                    simulation_send(&sim, SIM_REGENERATE, 0); // Generate new nodes
+                    selected = -1;
+                } else if (is_point_in_rect(e.button.x, e.button.y, &graph_bounds)) {
+                    // Click selects a node, shift-click toggles an edge from the selected one
+                    ViewTransform view = view_transform(cell_size, grid_offset_x, grid_offset_y);
+                    int hit = pick_node(shown_x, shown_y, shown->num_nodes, &view, e.button.x, e.button.y);
+                    if (hit >= 0 && selected >= 0 && hit != selected && (SDL_GetModState() & KMOD_SHIFT)) {
+                        simulation_send_edit(&sim, SIM_TOGGLE_EDGE, selected, hit);
+                    } else {
+                        selected = hit;
+                    }
                 }
             } else if (e.type == SDL_MOUSEWHEEL) {
+                dirty = 1;
                 // Check if the mouse is within the grid box area
                 int mouse_x, mouse_y;
                 SDL_GetMouseState(&mouse_x, &mouse_y);
@@ -212,28 +427,16 @@ int main(int argc, char *argv[]) {
                     grid_offset_y = mouse_y - scale_ratio * (mouse_y - grid_offset_y);
                 }
             } else if (e.type == SDL_KEYDOWN) {
+                dirty = 1;
                 // Arrow keys for panning the grid
                 switch (e.key.keysym.sym) {
 
                     case SDLK_RIGHT: // Step forward
-                    if (!auto_play && iteration < max_iterations - 1) {
-                        iteration += 1;  // Increment iteration by 1
-                        calculate_forces(nodes, edges, NUM_NODES, 42, temperature, iteration);
-                        save_node_state(nodes, iteration); // Save the node state after each calculation
-                        iteration_updated_manually = 1;
-                    }
-                    break;
-                case SDLK_LEFT: // Step backward
-                    if (!auto_play && iteration > 0) { // Ensure it doesn't go <0
-                        iteration -= 1;  // Decrement iteration by 1
-                        if (iteration == 0) {
-                            restore_initial_state(nodes); // Restore initial positions
-                        } else {
-                            restore_node_state(nodes, iteration);
-                        }
-                        iteration_updated_manually = 1;
-                    }
-                    break;
+                        simulation_send(&sim, SIM_STEP_FORWARD, 1);
+                        break;
+                    case SDLK_LEFT: // Step backward
+                        simulation_send(&sim, SIM_STEP_BACK, 1);
+                        break;
                     case SDLK_w:
                         grid_offset_y += 10;
                         break;
@@ -247,285 +450,235 @@ int main(int argc, char *argv[]) {
                         grid_offset_x -= 10;
                         break;
                     case SDLK_SPACE: // Play/Pause
-                        auto_play = !auto_play;
+                        simulation_send(&sim, SIM_TOGGLE_PLAY, 0);
                         break;
+                    case SDLK_b: // Toggle Barnes-Hut repulsion
+                        simulation_send(&sim, SIM_TOGGLE_BARNES_HUT, 0);
+                        break;
+                    case SDLK_LEFTBRACKET: // Tighter opening angle
+                        simulation_send(&sim, SIM_ADJUST_THETA, -0.1f);
+                        break;
+                    case SDLK_RIGHTBRACKET: // Looser opening angle
+                        simulation_send(&sim, SIM_ADJUST_THETA, 0.1f);
+                        break;
+                    case SDLK_n: // New node, linked to the selected one
+                        simulation_send_edit(&sim, SIM_ADD_NODE, selected, -1);
+                        break;
+                    case SDLK_DELETE:
+                    case SDLK_BACKSPACE: // Remove the selected node
+                        if (selected >= 0) {
+                            simulation_send_edit(&sim, SIM_REMOVE_NODE, selected, -1);
+                            selected = -1;
+                        }
+                        break;
+                    case SDLK_j: // Turn a 3D layout
+                    case SDLK_l:
+                        projection.yaw += e.key.keysym.sym == SDLK_l ? ROTATE_STEP : -ROTATE_STEP;
+                        rotated = 1;
+                        break;
+                    case SDLK_i:
+                    case SDLK_k:
+                        projection.pitch += e.key.keysym.sym == SDLK_i ? ROTATE_STEP : -ROTATE_STEP;
+                        rotated = 1;
+                        break;
+                    case SDLK_MINUS: // Cool or heat the layout
+                    case SDLK_EQUALS:
+                        simulation_send(&sim, SIM_SCALE_TEMPERATURE,
+                                        e.key.keysym.sym == SDLK_EQUALS ? TEMPERATURE_STEP : 1.0f / TEMPERATURE_STEP);
+                        break;
+                    case SDLK_c: // Save a checkpoint to resume from later
+                        simulation_send(&sim, SIM_CHECKPOINT, 0);
+                        break;
+                    case SDLK_t: // Dump the profile as a Chrome trace
+                    {
+                        const char *path = trace_path != NULL ? trace_path : "trace.json";
+                        int written = profile_write_trace(path);
+                        if (written >= 0) {
+                            printf("Wrote %d trace events to %s\n", written, path);
+                        }
+                        break;
+                    }
                 }
             }
         }
 
-        // Clear the renderer with white background
-        SDL_SetRenderDrawColor(renderer, 0xFF, 0xFF, 0xFF, 0xFF);
-        SDL_RenderClear(renderer);
+        // The newest finished iteration; publishes after this point queue another wake event
+        atomic_store(&wakeup.pending, 0);
+        int fresh;
+        const Snapshot *snapshot = simulation_snapshot(&sim, &fresh);
+        shown = snapshot;
+        if (selected >= snapshot->num_nodes) {
+            selected = -1;
+        }
+        profile_end("events", phase_start);
+
+        now = layout_seconds();
+        int changed = dirty || fresh || rotated;
+        if (changed) {
+            settle_until = now + HUD_SETTLE;
+        } else if (now < hud.next_refresh || now >= settle_until) {
+            continue;
+        }
+        phase_start = profile_begin();
 
-        // Draw the background grid
-        draw_grid(renderer, cell_size, grid_offset_x, grid_offset_y);
+        if (background == NULL || cell_size != background_cell_size ||
+            grid_offset_x != background_offset_x || grid_offset_y != background_offset_y) {
+            SDL_SetRenderTarget(renderer, background);
 
-        // Draw thicker bounding box (black outline)
-        SDL_SetRenderDrawColor(renderer, 0x00, 0x00, 0x00, 0xFF); // Black color
-        for (int i = 0; i < BOX_THICKNESS; i++) {
-            SDL_Rect boundingBox = {BOX_MARGIN - i, BOX_MARGIN - i, BOX_WIDTH + 2 * i, BOX_HEIGHT + 2 * i};
-            SDL_RenderDrawRect(renderer, &boundingBox);
-        }
+            // Clear the renderer with white background
+            SDL_SetRenderDrawColor(renderer, 0xFF, 0xFF, 0xFF, 0xFF);
+            SDL_RenderClear(renderer);
 
-        // Calculate forces and update node positions only if auto_play is true
-        if (auto_play || iteration_updated_manually) {
-            if (iteration < ITERATIONS) {
-                calculate_forces(nodes, edges, NUM_NODES, 42, temperature, iteration);
-                save_node_state(nodes, iteration); // Save the node state after each calculation
-                
-                if (auto_play) {
-                    iteration += 1;  // Increment by 1 for frame-by-frame animation
-                    if (iteration >= max_iterations) {
-                        iteration = max_iterations - 1;
-                        auto_play = 0;
-                    }
-                }
+            // Draw the background grid
+            draw_grid(renderer, cell_size, grid_offset_x, grid_offset_y);
 
-                // Reset the manual step flag after updating
-                iteration_updated_manually = 0;
+            // Draw thicker bounding box (black outline)
+            SDL_SetRenderDrawColor(renderer, 0x00, 0x00, 0x00, 0xFF); // Black color
+            for (int i = 0; i < BOX_THICKNESS; i++) {
+                SDL_Rect boundingBox = {BOX_MARGIN - i, BOX_MARGIN - i, BOX_WIDTH + 2 * i, BOX_HEIGHT + 2 * i};
+                SDL_RenderDrawRect(renderer, &boundingBox);
             }
-        }
 
-        // Render nodes (keeping size constant, but adjusting position and clipping)
-        for (int i = 0; i < NUM_NODES; i++) {
-            int adjusted_x = grid_offset_x + (nodes[i].x - grid_offset_x) * ((float)cell_size / 50.0f);
-            int adjusted_y = grid_offset_y + (nodes[i].y - grid_offset_y) * ((float)cell_size / 50.0f);
-            draw_circle_clipped(renderer, adjusted_x, adjusted_y, NODE_RADIUS, left_bound, top_bound, right_bound, bottom_bound);
+            // Render "Generate Nodes" button and the titles
+            SDL_RenderDrawRect(renderer, &buttonRect);
+            SDL_RenderCopy(renderer, buttonTextTexture, NULL, &buttonTextRect);
+            SDL_RenderCopy(renderer, algorithmTextTexture, NULL, &algorithmTextRect);
+
+            SDL_SetRenderTarget(renderer, NULL);
+            background_cell_size = cell_size;
+            background_offset_x = grid_offset_x;
+            background_offset_y = grid_offset_y;
+        }
+        if (background != NULL) {
+            SDL_RenderCopy(renderer, background, NULL, NULL);
         }
-        // Render edges in the same manner as nodes
-        SDL_SetRenderDrawColor(renderer, 0x00, 0x00, 0x00, 0xFF); // Black
-        for (int i = 0; i < 42; i++) {
-            int from_x = grid_offset_x + (nodes[edges[i].from].x - grid_offset_x) * ((float)cell_size / 50.0f);
-            int from_y = grid_offset_y + (nodes[edges[i].from].y - grid_offset_y) * ((float)cell_size / 50.0f);
-            int to_x = grid_offset_x + (nodes[edges[i].to].x - grid_offset_x) * ((float)cell_size / 50.0f);
-            int to_y = grid_offset_y + (nodes[edges[i].to].y - grid_offset_y) * ((float)cell_size / 50.0f);
-            draw_line_clipped(renderer, from_x, from_y, to_x, to_y, left_bound, top_bound, right_bound, bottom_bound);
+        profile_end("grid", phase_start);
+
+        phase_start = profile_begin();
+        shown_x = snapshot->x;
+        shown_y = snapshot->y;
+        if (snapshot->z != NULL) {
+            if ((fresh || rotated) &&
+                projection_update(&projection, snapshot->x, snapshot->y, snapshot->z, snapshot->num_nodes) != 0) {
+                running = 0;
+                break;
+            }
+            fresh |= rotated;
+            rotated = 0;
+            shown_x = projection.x;
+            shown_y = projection.y;
         }
 
-        // Render "Generate Nodes" button
-        SDL_SetRenderDrawColor(renderer, 0x00, 0x00, 0x00, 0xFF); 
-        SDL_RenderDrawRect(renderer, &buttonRect);
+        // Render nodes (keeping size constant, but adjusting position and clipping), then edges
+        ViewTransform view = view_transform(cell_size, grid_offset_x, grid_offset_y);
+        graph_renderer_draw(&graph_renderer, renderer, shown_x, shown_y, snapshot->num_nodes,
+                            snapshot->edges, snapshot->num_edges, fresh, &view, &graph_bounds);
+        if (selected >= 0) {
+            SDL_Rect mark = {(int)(shown_x[selected] * view.scale + view.translate_x) - PICK_RADIUS,
+                             (int)(shown_y[selected] * view.scale + view.translate_y) - PICK_RADIUS,
+                             2 * PICK_RADIUS, 2 * PICK_RADIUS};
+            SDL_RenderSetClipRect(renderer, &graph_bounds);
+            SDL_SetRenderDrawColor(renderer, 0xFF, 0x80, 0x00, 0xFF);
+            SDL_RenderDrawRect(renderer, &mark);
+            SDL_RenderSetClipRect(renderer, NULL);
+        }
+        profile_end("graph", phase_start);
+        phase_start = profile_begin();
 
-        
         // Update frame text
-        char frameText[50];
-        sprintf(frameText, "Frame: %d", iteration);
-        textSurface = TTF_RenderText_Solid(font, frameText, textColor);
-        textTexture = SDL_CreateTextureFromSurface(renderer, textSurface);
-        SDL_FreeSurface(textSurface);
+        if (snapshot->iteration != textIteration) {
+            char frameText[50];
+            sprintf(frameText, "Frame: %d", snapshot->iteration);
+            SDL_Surface *textSurface = TTF_RenderText_Solid(font, frameText, textColor);
+            if (textTexture != NULL) {
+                SDL_DestroyTexture(textTexture);
+            }
+            textTexture = SDL_CreateTextureFromSurface(renderer, textSurface);
+            SDL_FreeSurface(textSurface);
+            textIteration = snapshot->iteration;
+        }
 
         SDL_Rect textRect = {10, 10, 100, 30}; 
         SDL_RenderCopy(renderer, textTexture, NULL, &textRect);
 
-        // Position the algorithm name centered above the bounding box
-        SDL_Rect algorithmTextRect = {
-            BOX_MARGIN + (BOX_WIDTH - text_width) / 2,
-            BOX_MARGIN - text_height - 10,
-            text_width,
-            text_height
-        };
-        SDL_RenderCopy(renderer, algorithmTextTexture, NULL, &algorithmTextRect);
-
-        int text_width = 0;
-        int text_height = 0;
-        TTF_SizeText(font, "Generate New", &text_width, &text_height);
-
-        // Make sure the text fits within the button
-        if (text_width > buttonRect.w || text_height > buttonRect.h) {
-            buttonRect.w = text_width + 10;  // Padding
-            buttonRect.h = text_height + 10;  
-        }
-
-        // Render button text (keeping it centered)
-        SDL_Rect buttonTextRect = {
-            buttonRect.x + (buttonRect.w - text_width) / 2,  
-            buttonRect.y + (buttonRect.h - text_height) / 2,  
-            text_width,
-            text_height
-        };
-
-        SDL_RenderCopy(renderer, buttonTextTexture, NULL, &buttonTextRect);
+        hud_draw(&hud, renderer, BOX_MARGIN + BOX_WIDTH + BOX_THICKNESS + 10, BOX_MARGIN);
+        profile_end("text", phase_start);
 
-        // Update display
+        // Update display, paced by vsync
+        phase_start = profile_begin();
         SDL_RenderPresent(renderer);
-        SDL_DestroyTexture(textTexture);
-
-        // Ensure delay only happens when auto_play is true
-        if (auto_play) {
-            SDL_Delay(FRAME_DELAY);
+        profile_end("present", phase_start);
+        if (changed) { // HUD-only refreshes are not counted, so an idle window reads 0 frames/s
+            profile_end("frame", frame_start);
         }
+        dirty = !on_demand;
     }
 
-    SDL_DestroyTexture(textTexture);  
-    SDL_DestroyTexture(algorithmTextTexture);
-    SDL_DestroyRenderer(renderer);
-    SDL_DestroyWindow(win);
-    SDL_Quit();
-
-    return 0;
-}
-
-// Initialize nodes with random positions within the bounding box
-void initialize_nodes(Node nodes[], int num_nodes) {
-    srand(time(NULL)); 
-
-    for (int i = 0; i < num_nodes; i++) {
-        nodes[i].x = (float)(rand() % BOX_WIDTH + BOX_MARGIN);
-        nodes[i].y = (float)(rand() % BOX_HEIGHT + BOX_MARGIN);
-        nodes[i].dx = 0;
-        nodes[i].dy = 0;
-    }
-}
-
-void initialize_edges(Edge edges[], int num_edges) { //currently hardcoded
-    edges[0] = (Edge){0, 1};  // a -- b
-    edges[1] = (Edge){0, 2};  // a -- c
-    edges[2] = (Edge){0, 3};  // a -- d
-    edges[3] = (Edge){1, 2};  // b -- c
-    edges[4] = (Edge){1, 4};  // b -- e
-    edges[5] = (Edge){2, 4};  // c -- e
-    edges[6] = (Edge){2, 5};  // c -- f
-    edges[7] = (Edge){3, 5};  // d -- f
-    edges[8] = (Edge){3, 6};  // d -- g
-    edges[9] = (Edge){4, 7};  // e -- h
-    edges[10] = (Edge){5, 7}; // f -- h
-    edges[11] = (Edge){5, 8}; // f -- i
-    edges[12] = (Edge){5, 9}; // f -- j
-    edges[13] = (Edge){5, 6}; // f -- g
-    edges[14] = (Edge){6, 10}; // g -- k
-    edges[15] = (Edge){7, 14}; // h -- o
-    edges[16] = (Edge){7, 11}; // h -- l
-    edges[17] = (Edge){8, 11}; // i -- l
-    edges[18] = (Edge){8, 12}; // i -- m
-    edges[19] = (Edge){8, 9};  // i -- j
-    edges[20] = (Edge){9, 12}; // j -- m
-    edges[21] = (Edge){9, 13}; // j -- n
-    edges[22] = (Edge){9, 10}; // j -- k
-    edges[23] = (Edge){10, 13}; // k -- n
-    edges[24] = (Edge){10, 17}; // k -- r
-    edges[25] = (Edge){11, 14}; // l -- o
-    edges[26] = (Edge){11, 12}; // l -- m
-    edges[27] = (Edge){12, 14}; // m -- o
-    edges[28] = (Edge){12, 15}; // m -- p
-    edges[29] = (Edge){12, 13}; // m -- n
-    edges[30] = (Edge){13, 16}; // n -- q
-    edges[31] = (Edge){13, 17}; // n -- r
-    edges[32] = (Edge){14, 18}; // o -- s
-    edges[33] = (Edge){14, 15}; // o -- p
-    edges[34] = (Edge){15, 18}; // p -- s
-    edges[35] = (Edge){15, 19}; // p -- t
-    edges[36] = (Edge){15, 16}; // p -- q
-    edges[37] = (Edge){16, 19}; // q -- t
-    edges[38] = (Edge){16, 17}; // q -- r
-    edges[39] = (Edge){17, 19}; // r -- t
-    edges[40] = (Edge){18, 20}; // s -- z
-    edges[41] = (Edge){19, 20}; // t -- z
-}
-
-// Function to save the current node state
-void save_node_state(Node nodes[], int iteration) {
-    for (int i = 0; i < NUM_NODES; i++) {
-        node_states[iteration][i] = nodes[i];
-    }
-}
-
-// Function to restore the node state from a specific iteration
-void restore_node_state(Node nodes[], int iteration) {
-    for (int i = 0; i < NUM_NODES; i++) {
-        nodes[i] = node_states[iteration][i];
+    simulation_stop(&sim);
+    if (capture != NULL) {
+        CaptureStats capture_stats;
+        capture_finish(capture, &capture_stats);
+        capture_print_stats(&capture_stats);
     }
-}
-
-// Function to calculate forces and update node positions
-void calculate_forces(Node nodes[], Edge edges[], int num_nodes, int num_edges, float temperature, int iteration) {
-    // Reset displacements
-    for (int i = 0; i < num_nodes; i++) {
-        nodes[i].dx = 0;
-        nodes[i].dy = 0;
+    projection_free(&projection);
+    if (trace_path != NULL) {
+        profile_write_trace(trace_path);
     }
 
-    // Calculate repulsive forces
-    for (int i = 0; i < num_nodes; i++) {
-        for (int j = i + 1; j < num_nodes; j++) {
-            float dx = nodes[i].x - nodes[j].x;
-            float dy = nodes[i].y - nodes[j].y;
-            float distance = sqrtf(dx * dx + dy * dy);
-
-            if (distance > 0) {
-                float force = 1000.0f / distance; // Repulsive force
-                nodes[i].dx += (dx / distance) * force;
-                nodes[i].dy += (dy / distance) * force;
-                nodes[j].dx -= (dx / distance) * force;
-                nodes[j].dy -= (dy / distance) * force;
-            }
-        }
+    hud_free(&hud);
+    if (background != NULL) {
+        SDL_DestroyTexture(background);
     }
-
-    // Calculate attractive forces
-    for (int i = 0; i < num_edges; i++) {
-        int from = edges[i].from;
-        int to = edges[i].to;
-        float dx = nodes[from].x - nodes[to].x;
-        float dy = nodes[from].y - nodes[to].y;
-        float distance = sqrtf(dx * dx + dy * dy);
-
-        if (distance > 0) {
-            float force = (distance * distance) / 1000.0f; // Attractive force
-            nodes[from].dx -= (dx / distance) * force;
-            nodes[from].dy -= (dy / distance) * force;
-            nodes[to].dx += (dx / distance) * force;
-            nodes[to].dy += (dy / distance) * force;
-        }
+    if (textTexture != NULL) {
+        SDL_DestroyTexture(textTexture);
     }
+    SDL_DestroyTexture(buttonTextTexture);
+    SDL_DestroyTexture(algorithmTextTexture);
+    graph_renderer_free(&graph_renderer);
+    SDL_DestroyRenderer(renderer);
+    SDL_DestroyWindow(win);
+    SDL_Quit();
 
-    // Update positions based on forces
-    for (int i = 0; i < num_nodes; i++) {
-        nodes[i].x += clamp(nodes[i].dx, -temperature, temperature);
-        nodes[i].y += clamp(nodes[i].dy, -temperature, temperature);
-
-        // Keep nodes within the bounding box
-        nodes[i].x = clamp(nodes[i].x, BOX_MARGIN, BOX_MARGIN + BOX_WIDTH);
-        nodes[i].y = clamp(nodes[i].y, BOX_MARGIN, BOX_MARGIN + BOX_HEIGHT);
+    threadpool_destroy(render_pool);
+    threadpool_destroy(force_settings.pool);
+    graph_free(&graph);
+    if (resume_path != NULL) {
+        checkpoint_close(&resume);
     }
-    
+    return 0;
 }
 
-// Function to draw a filled circle
-void draw_circle(SDL_Renderer *renderer, int x, int y, int radius) {
-    for (int w = 0; w < radius * 2; w++) {
-        for (int h = 0; h < radius * 2; h++) {
-            int dx = radius - w; 
-            int dy = radius - h; 
-            if ((dx * dx + dy * dy) <= (radius * radius)) {
-                SDL_RenderDrawPoint(renderer, x + dx, y + dy);
-            }
-        }
+// Queue one wake event for the render loop, called on the simulation thread
+void wake_renderer(void *context) {
+    Wakeup *wakeup = context;
+    if (atomic_exchange(&wakeup->pending, 1) == 0) {
+        SDL_Event event;
+        SDL_zero(event);
+        event.type = wakeup->type;
+        SDL_PushEvent(&event);
     }
 }
 
-// Clamp function to limit values
-float clamp(float value, float min, float max) {
-    if (value < min) return min;
-    if (value > max) return max;
-    return value;
-}
-
 // Function to check if a point is inside a rectangle
 int is_point_in_rect(int x, int y, SDL_Rect* rect) {
     return (x >= rect->x && x <= rect->x + rect->w &&
             y >= rect->y && y <= rect->y + rect->h);
 }
 
-void restore_initial_state(Node nodes[]) {
-    for (int i = 0; i < NUM_NODES; i++) {
-        nodes[i] = initial_node_states[i];
-    }
-}
-
-void save_initial_state(Node nodes[]) {
-    for (int i = 0; i < NUM_NODES; i++) {
-        initial_node_states[i] = nodes[i];
+// Nearest node within PICK_RADIUS of a screen position, or -1
+int pick_node(const float *node_x, const float *node_y, int num_nodes, const ViewTransform *view, int x, int y) {
+    int best = -1;
+    float best_d2 = (float)(PICK_RADIUS * PICK_RADIUS);
+    for (int i = 0; i < num_nodes; i++) {
+        float rx = node_x[i] * view->scale + view->translate_x - (float)x;
+        float ry = node_y[i] * view->scale + view->translate_y - (float)y;
+        float d2 = rx * rx + ry * ry;
+        if (d2 <= best_d2) {
+            best_d2 = d2;
+            best = i;
+        }
     }
+    return best;
 }
 
 void draw_grid(SDL_Renderer *renderer, int cell_size, float grid_offset_x, float grid_offset_y) {
@@ -553,81 +706,4 @@ void draw_grid(SDL_Renderer *renderer, int cell_size, float grid_offset_x, float
             SDL_RenderDrawLine(renderer, left, y, right, y);
         }
     }
-}
-
-void draw_circle_clipped(SDL_Renderer *renderer, int x, int y, int radius, int left, int top, int right, int bottom) {
-    if (x - radius < left || x + radius > right || y - radius < top || y + radius > bottom) {
-        return; // Skip drawing the circle if it's outside the bounding box
-    }
-    draw_circle(renderer, x, y, radius);
-}
-
-void draw_line_clipped(SDL_Renderer *renderer, int x1, int y1, int x2, int y2, int left, int top, int right, int bottom) {
-    int code1 = compute_code(x1, y1, left, top, right, bottom);
-    int code2 = compute_code(x2, y2, left, top, right, bottom);
-    int accept = 0;
-    while (1) {
-        if ((code1 == 0) && (code2 == 0)) {
-            // Both endpoints are inside the bounding box
-            accept = 1;
-            break;
-        } else if (code1 & code2) {
-            // Both endpoints are outside the bounding box in the same region
-            break;
-        } else {
-            // Some portion of the line is inside the bounding box
-            int code_out;
-            int x, y;
-
-            // At least one endpoint is outside the bounding box, pick it
-            if (code1 != 0) code_out = code1;
-            else code_out = code2;
-
-            // Find the intersection point
-            if (code_out & TOP) {
-                // Up
-                x = x1 + (x2 - x1) * (top - y1) / (y2 - y1);
-                y = top;
-            } else if (code_out & BOTTOM) {
-                // Down
-                x = x1 + (x2 - x1) * (bottom - y1) / (y2 - y1);
-                y = bottom;
-            } else if (code_out & RIGHT) {
-                // Right
-                y = y1 + (y2 - y1) * (right - x1) / (x2 - x1);
-                x = right;
-            } else if (code_out & LEFT) {
-                // Left
-                y = y1 + (y2 - y1) * (left - x1) / (x2 - x1);
-                x = left;
-            }
-            // Replace outside point with intersection point and update the code
-            if (code_out == code1) {
-                x1 = x;
-                y1 = y;
-                code1 = compute_code(x1, y1, left, top, right, bottom);
-            } else {
-                x2 = x;
-                y2 = y;
-                code2 = compute_code(x2, y2, left, top, right, bottom);
-            }
-        }
-    }
-
-    if (accept) {
-        // Draw the line
-        SDL_RenderDrawLine(renderer, x1, y1, x2, y2);
-    }
-}
-
-// Compute the region code for a point (x, y)
-int compute_code(int x, int y, int left, int top, int right, int bottom) {
-    int code = INSIDE;
-
-    if (x < left)       code |= LEFT;
-    else if (x > right) code |= RIGHT;
-    if (y < top)        code |= BOTTOM;
-    else if (y > bottom) code |= TOP;
-
-    return code;
 }
\ No newline at end of file
@@ -0,0 +1,509 @@
+#include "metrics.h"
+#include "profile.h"
+#include "rng.h"
+
+#include <math.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// ---- Crossings ----
+
+#define CROSSING_SLACK 1e-3   // Of a cell, far above the rounding of the positions
+#define CROSSING_SPLIT 4      // Cells are at least 1/CROSSING_SPLIT of the mean edge length
+
+typedef struct {
+    double min_x, min_y;
+    double cell, inverse_cell;
+    int columns, rows;
+} CrossingGrid;
+
+static inline int grid_column(const CrossingGrid *grid, double x) {
+    double c = floor((x - grid->min_x) * grid->inverse_cell);
+    return c < 0 ? 0 : c >= grid->columns ? grid->columns - 1 : (int)c;
+}
+
+static inline int grid_row(const CrossingGrid *grid, double y) {
+    double r = floor((y - grid->min_y) * grid->inverse_cell);
+    return r < 0 ? 0 : r >= grid->rows ? grid->rows - 1 : (int)r;
+}
+
+// Visit the cells segment a-b passes through, row by row: in each row the
+// columns its part in that row spans, widened by CROSSING_SLACK of a cell so
+// that rounding never leaves out the cell an intersection point is assigned to.
+// Without `entries` the cells are counted in `fill`; with them, the edge is
+// written at fill[cell]++ keyed by its node in the cell, `num_nodes` for none.
+static size_t cover_edge(const CrossingGrid *grid, const float *x, const float *y, const int *cell_of, int num_nodes,
+                         const Edge *edge, int e, int *fill, uint64_t *entries) {
+    double ax = x[edge->from], ay = y[edge->from], bx = x[edge->to], by = y[edge->to];
+    double low_x = fmin(ax, bx), high_x = fmax(ax, bx);
+    double low_y = fmin(ay, by), high_y = fmax(ay, by);
+    double slope = ay != by ? (bx - ax) / (by - ay) : 0.0;
+    int first_row = grid_row(grid, low_y), last_row = grid_row(grid, high_y);
+    size_t covered = 0;
+    for (int r = first_row; r <= last_row; r++) {
+        double x0 = low_x, x1 = high_x;
+        if (ay != by) {
+            double y0 = fmax(low_y, grid->min_y + r * grid->cell);
+            double y1 = fmin(high_y, grid->min_y + (r + 1) * grid->cell);
+            double xa = ax + (y0 - ay) * slope, xb = ax + (y1 - ay) * slope;
+            x0 = fmax(low_x, fmin(xa, xb));
+            x1 = fmin(high_x, fmax(xa, xb));
+        }
+        double slack = CROSSING_SLACK * grid->cell;
+        int c0 = grid_column(grid, x0 - slack), c1 = grid_column(grid, x1 + slack);
+        for (int c = c0; c <= c1; c++) {
+            int cell = r * grid->columns + c;
+            if (entries == NULL) {
+                fill[cell]++;
+            } else {
+                uint32_t key = cell_of[edge->from] == cell ? (uint32_t)edge->from
+                             : cell_of[edge->to] == cell   ? (uint32_t)edge->to
+                                                           : (uint32_t)num_nodes;
+                entries[fill[cell]++] = (uint64_t)key << 32 | (uint32_t)e;
+            }
+        }
+        covered += (size_t)(c1 - c0 + 1);
+    }
+    return covered;
+}
+
+static int compare_entries(const void *a, const void *b) {
+    uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+    return x < y ? -1 : x > y;
+}
+
+static inline double orient(double ax, double ay, double bx, double by, double cx, double cy) {
+    return (bx - ax) * (cy - ay) - (by - ay) * (cx - ax);
+}
+
+// An edge copied out next to the others in its cell, so that testing the
+// pairs reads contiguous memory
+typedef struct {
+    double ax, ay, bx, by;
+    int from, to;
+} CrossingSegment;
+
+// 1 if segments e and f cross at a point inside `cell`. Touching, collinear
+// and adjacent edges do not count.
+static int crosses_in_cell(const CrossingGrid *grid, const CrossingSegment *e, const CrossingSegment *f, int cell) {
+    if (e->from == f->from || e->from == f->to || e->to == f->from || e->to == f->to) return 0;
+    double ax = e->ax, ay = e->ay, bx = e->bx, by = e->by;
+    double cx = f->ax, cy = f->ay, dx = f->bx, dy = f->by;
+    double low_x = fmax(fmin(ax, bx), fmin(cx, dx)), high_x = fmin(fmax(ax, bx), fmax(cx, dx));
+    double low_y = fmax(fmin(ay, by), fmin(cy, dy)), high_y = fmin(fmax(ay, by), fmax(cy, dy));
+    if (low_x > high_x || low_y > high_y) return 0;
+
+    double c_side = orient(ax, ay, bx, by, cx, cy), d_side = orient(ax, ay, bx, by, dx, dy);
+    if (!((c_side > 0 && d_side < 0) || (c_side < 0 && d_side > 0))) return 0;
+    double a_side = orient(cx, cy, dx, dy, ax, ay), b_side = orient(cx, cy, dx, dy, bx, by);
+    if (!((a_side > 0 && b_side < 0) || (a_side < 0 && b_side > 0))) return 0;
+
+    double t = a_side / (a_side - b_side);
+    double px = fmin(fmax(ax + t * (bx - ax), low_x), high_x);
+    double py = fmin(fmax(ay + t * (by - ay), low_y), high_y);
+    return grid_row(grid, py) * grid->columns + grid_column(grid, px) == cell;
+}
+
+// Distance to the next pair tested: 1 without sampling, else geometric so
+// that every pair is tested with probability `share`, given
+// gap_scale = 1 / log(1 - share)
+static inline int pair_gap(Rng *rng, double gap_scale) {
+    if (gap_scale == 0.0) return 1;
+    double u = ((rng_next(rng) >> 11) + 1) * (1.0 / 9007199254740992.0); // (0, 1]
+    return 1 + (int)fmin(log(u) * gap_scale, (double)(INT32_MAX / 2));
+}
+
+long long metrics_crossings(const float *x, const float *y, int num_nodes, const Edge *edges, int num_edges,
+                           int *sampled) {
+    if (sampled != NULL) *sampled = 0;
+    if (num_edges < 2) return 0;
+
+    // About one cell per edge over the box of the endpoints, but no larger
+    // than the mean edge length, so short edges touch few cells, and no
+    // smaller than a fraction of it, so long ones are not in too many
+    double min_x = INFINITY, min_y = INFINITY, max_x = -INFINITY, max_y = -INFINITY, length = 0;
+    for (int e = 0; e < num_edges; e++) {
+        double ax = x[edges[e].from], ay = y[edges[e].from], bx = x[edges[e].to], by = y[edges[e].to];
+        min_x = fmin(min_x, fmin(ax, bx));
+        max_x = fmax(max_x, fmax(ax, bx));
+        min_y = fmin(min_y, fmin(ay, by));
+        max_y = fmax(max_y, fmax(ay, by));
+        length += hypot(bx - ax, by - ay);
+    }
+    if (!isfinite(min_x + max_x + min_y + max_y + length)) {
+        printf("metrics: positions are not finite, crossings not counted\n");
+        return -1;
+    }
+    double width = max_x - min_x, height = max_y - min_y;
+    double mean = length / num_edges;
+    double cell = fmin(mean, fmax(sqrt(width * height / num_edges), mean / CROSSING_SPLIT));
+    if (cell <= 0) cell = fmax(fmax(width, height), 1.0);
+    while ((width / cell + 1) * (height / cell + 1) > METRICS_MAX_CELLS) {
+        cell *= 1.5;
+    }
+    CrossingGrid grid = {min_x, min_y, cell, 1.0 / cell, (int)(width / cell) + 1, (int)(height / cell) + 1};
+    int num_cells = grid.columns * grid.rows;
+
+    int *cell_start = calloc((size_t)num_cells + 1, sizeof(int));
+    int *fill = malloc((size_t)num_cells * sizeof(int));
+    int *cell_of = malloc((size_t)num_nodes * sizeof(int));
+    if (cell_start == NULL || fill == NULL || cell_of == NULL) {
+        printf("metrics: out of memory for a %dx%d crossing grid\n", grid.columns, grid.rows);
+        free(cell_start);
+        free(fill);
+        free(cell_of);
+        return -1;
+    }
+    for (int e = 0; e < num_edges; e++) {
+        for (int k = 0; k < 2; k++) {
+            int v = k == 0 ? edges[e].from : edges[e].to;
+            cell_of[v] = grid_row(&grid, y[v]) * grid.columns + grid_column(&grid, x[v]);
+        }
+    }
+
+    // Two passes over the cells of every edge: count, then fill the buckets
+    size_t total = 0;
+    for (int e = 0; e < num_edges; e++) {
+        total += cover_edge(&grid, x, y, cell_of, num_nodes, &edges[e], e, cell_start + 1, NULL);
+    }
+    uint64_t *entries = total <= (size_t)INT32_MAX ? malloc(total * sizeof(uint64_t)) : NULL;
+    if (entries == NULL) {
+        printf("metrics: out of memory for %zu crossing grid entries\n", total);
+        free(cell_start);
+        free(fill);
+        free(cell_of);
+        return -1;
+    }
+    int most = 0;
+    double pairs = 0;
+    for (int c = 0; c < num_cells; c++) {
+        if (cell_start[c + 1] > most) most = cell_start[c + 1];
+        pairs += 0.5 * cell_start[c + 1] * (cell_start[c + 1] - 1.0);
+        cell_start[c + 1] += cell_start[c];
+        fill[c] = cell_start[c];
+    }
+    CrossingSegment *segments = malloc(((size_t)most + 1) * sizeof(CrossingSegment));
+    if (segments == NULL) {
+        printf("metrics: out of memory for %d edges in one cell\n", most);
+        free(entries);
+        free(cell_start);
+        free(fill);
+        free(cell_of);
+        return -1;
+    }
+    for (int e = 0; e < num_edges; e++) {
+        cover_edge(&grid, x, y, cell_of, num_nodes, &edges[e], e, fill, entries);
+    }
+
+    // Sorted by key, the edges meeting at a node in the cell form one run and
+    // are only tested against the edges after it
+    double share = pairs > METRICS_MAX_PAIR_TESTS ? METRICS_MAX_PAIR_TESTS / pairs : 1.0;
+    double gap_scale = share < 1.0 ? 1.0 / log1p(-share) : 0.0;
+    Rng rng;
+    rng_seed(&rng, (uint64_t)num_edges);
+    long long crossings = 0;
+    for (int c = 0; c < num_cells; c++) {
+        int start = cell_start[c], count = cell_start[c + 1] - start;
+        if (count < 2) continue;
+        uint64_t *cell_entries = entries + start;
+        qsort(cell_entries, (size_t)count, sizeof(uint64_t), compare_entries);
+        for (int i = 0; i < count; i++) {
+            const Edge *edge = &edges[(uint32_t)cell_entries[i]];
+            CrossingSegment segment = {x[edge->from], y[edge->from], x[edge->to], y[edge->to], edge->from, edge->to};
+            segments[i] = segment;
+        }
+        int run_end = 0;
+        for (int i = 0; i < count; i++) {
+            uint32_t key = (uint32_t)(cell_entries[i] >> 32);
+            if (i == run_end) {
+                while (run_end < count && (uint32_t)(cell_entries[run_end] >> 32) == key) run_end++;
+            }
+            int first = key == (uint32_t)num_nodes ? i + 1 : run_end;
+            for (int j = first - 1 + pair_gap(&rng, gap_scale); j < count; j += pair_gap(&rng, gap_scale)) {
+                crossings += crosses_in_cell(&grid, &segments[i], &segments[j], c);
+            }
+        }
+    }
+    if (share < 1.0) {
+        crossings = llround(crossings / share);
+        if (sampled != NULL) *sampled = 1;
+    }
+    free(segments);
+    free(entries);
+    free(cell_start);
+    free(fill);
+    free(cell_of);
+    return crossings;
+}
+
+// ---- Stress and edge lengths ----
+
+static inline double distance(const float *x, const float *y, const float *z, int i, int j) {
+    double dx = (double)x[i] - x[j], dy = (double)y[i] - y[j];
+    double dz = z != NULL ? (double)z[i] - z[j] : 0.0;
+    return sqrt(dx * dx + dy * dy + dz * dz);
+}
+
+double metrics_stress(const Graph *graph, const float *x, const float *y, const float *z, int pivots, uint64_t seed) {
+    int n = graph->num_nodes;
+    if (n < 2 || pivots <= 0) return 0.0;
+    int *dist = malloc((size_t)n * sizeof(int));
+    int *queue = malloc((size_t)n * sizeof(int));
+    if (dist == NULL || queue == NULL) {
+        printf("metrics: out of memory for stress over %d nodes\n", n);
+        free(dist);
+        free(queue);
+        return -1.0;
+    }
+
+    // With ratio r of drawn to hop distance per pair, the best scale s is the
+    // mean of r and the normalised stress sum (r - s)^2 / (pairs s^2)
+    Rng rng;
+    rng_seed(&rng, seed);
+    double sum = 0, sum_squares = 0;
+    long long pairs = 0;
+    for (int p = 0; p < pivots; p++) {
+        int source = (int)rng_below(&rng, (uint64_t)n);
+        memset(dist, -1, (size_t)n * sizeof(int));
+        int head = 0, tail = 0;
+        dist[source] = 0;
+        queue[tail++] = source;
+        while (head < tail) {
+            int v = queue[head++];
+            for (int k = graph->offsets[v]; k < graph->offsets[v + 1]; k++) {
+                int w = graph->adjacency[k];
+                if (dist[w] < 0) {
+                    dist[w] = dist[v] + 1;
+                    queue[tail++] = w;
+                }
+            }
+        }
+        for (int i = 1; i < tail; i++) {
+            int v = queue[i];
+            double r = distance(x, y, z, source, v) / dist[v];
+            sum += r;
+            sum_squares += r * r;
+        }
+        pairs += tail - 1;
+    }
+    free(dist);
+    free(queue);
+    if (pairs == 0 || sum <= 0) return 0.0;
+    double mean = sum / pairs;
+    double variance = sum_squares / pairs - mean * mean;
+    return variance > 0 ? variance / (mean * mean) : 0.0;
+}
+
+void metrics_edge_lengths(LayoutMetrics *metrics, const float *x, const float *y, const float *z, const Edge *edges,
+                          int num_edges) {
+    double sum = 0, sum_squares = 0, low = INFINITY, high = 0;
+    for (int e = 0; e < num_edges; e++) {
+        double length = distance(x, y, z, edges[e].from, edges[e].to);
+        sum += length;
+        sum_squares += length * length;
+        low = fmin(low, length);
+        high = fmax(high, length);
+    }
+    double mean = num_edges > 0 ? sum / num_edges : 0.0;
+    double variance = num_edges > 0 ? sum_squares / num_edges - mean * mean : 0.0;
+    metrics->edge_mean = mean;
+    metrics->edge_stddev = variance > 0 ? sqrt(variance) : 0.0;
+    metrics->edge_cv = mean > 0 ? metrics->edge_stddev / mean : 0.0;
+    metrics->edge_min = num_edges > 0 ? low : 0.0;
+    metrics->edge_max = high;
+}
+
+int metrics_measure(LayoutMetrics *metrics, const Graph *graph, const float *x, const float *y, const float *z,
+                    int pivots, uint64_t seed) {
+    double start = layout_seconds();
+    metrics->pivots = pivots;
+    metrics_edge_lengths(metrics, x, y, z, graph->edges, graph->num_edges);
+    metrics->crossings_sampled = 0;
+    metrics->crossings = z != NULL ? -1
+                                   : metrics_crossings(x, y, graph->num_nodes, graph->edges, graph->num_edges,
+                                                       &metrics->crossings_sampled);
+    metrics->stress = metrics_stress(graph, x, y, z, pivots, seed);
+    metrics->seconds = layout_seconds() - start;
+    return (z == NULL && metrics->crossings < 0) || metrics->stress < 0 ? -1 : 0;
+}
+
+static int improved(double previous, double current, float tolerance) {
+    return previous - current > tolerance * previous;
+}
+
+int metrics_settled(const LayoutMetrics *previous, const LayoutMetrics *current, float tolerance) {
+    return !improved((double)previous->crossings, (double)current->crossings, tolerance) &&
+           !improved(previous->stress, current->stress, tolerance);
+}
+
+void metrics_print(const LayoutMetrics *metrics) {
+    if (metrics->crossings >= 0) {
+        printf("Metrics: %s%lld crossings, ", metrics->crossings_sampled ? "about " : "", metrics->crossings);
+    } else {
+        printf("Metrics: ");
+    }
+    printf("stress %.4f over %d pivots, edge length %.1f +- %.1f (cv %.3f, %.1f to %.1f), %.1f ms\n",
+           metrics->stress, metrics->pivots, metrics->edge_mean, metrics->edge_stddev, metrics->edge_cv,
+           metrics->edge_min, metrics->edge_max, metrics->seconds * 1000.0);
+}
+
+// ---- Background monitor ----
+
+struct MetricsMonitor {
+    Graph graph;        // Borrows the arrays below
+    int *offsets, *adjacency;
+    Edge *edges;
+    int pivots;
+    uint64_t seed;
+
+    // Positions in graph order, written by the submitter while not pending
+    // and read by the worker while pending
+    float *x, *y, *z;
+    int iteration;
+    int pending;
+    int stopping;
+    int finished;
+    LayoutMetrics latest;
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t wake; // Positions submitted, or stopping
+    pthread_cond_t done; // A measurement finished
+};
+
+static void *monitor_main(void *arg) {
+    MetricsMonitor *monitor = arg;
+    profile_thread_name("metrics");
+    pthread_mutex_lock(&monitor->lock);
+    for (;;) {
+        while (!monitor->pending && !monitor->stopping) {
+            pthread_cond_wait(&monitor->wake, &monitor->lock);
+        }
+        if (monitor->stopping) break;
+        pthread_mutex_unlock(&monitor->lock);
+
+        LayoutMetrics metrics;
+        double start = layout_seconds();
+        metrics_measure(&metrics, &monitor->graph, monitor->x, monitor->y, monitor->z, monitor->pivots, monitor->seed);
+        metrics.iteration = monitor->iteration;
+        profile_record("metrics", start, layout_seconds());
+
+        pthread_mutex_lock(&monitor->lock);
+        monitor->latest = metrics;
+        monitor->finished++;
+        monitor->pending = 0;
+        pthread_cond_broadcast(&monitor->done);
+    }
+    pthread_mutex_unlock(&monitor->lock);
+    return NULL;
+}
+
+static void monitor_free(MetricsMonitor *monitor) {
+    free(monitor->offsets);
+    free(monitor->adjacency);
+    free(monitor->edges);
+    free(monitor->x);
+    free(monitor->y);
+    free(monitor->z);
+    free(monitor);
+}
+
+MetricsMonitor *metrics_monitor_create(const Graph *graph, int dimensions, int pivots, uint64_t seed) {
+    MetricsMonitor *monitor = calloc(1, sizeof(MetricsMonitor));
+    if (monitor == NULL) {
+        printf("metrics: out of memory\n");
+        return NULL;
+    }
+    int n = graph->num_nodes, m = graph->num_edges;
+    size_t positions = ((size_t)n + 1) * sizeof(float);
+    monitor->offsets = malloc(((size_t)n + 1) * sizeof(int));
+    monitor->adjacency = malloc((2 * (size_t)m + 1) * sizeof(int));
+    monitor->edges = malloc(((size_t)m + 1) * sizeof(Edge));
+    monitor->x = malloc(positions);
+    monitor->y = malloc(positions);
+    monitor->z = dimensions == 3 ? malloc(positions) : NULL;
+    if (monitor->offsets == NULL || monitor->adjacency == NULL || monitor->edges == NULL || monitor->x == NULL ||
+        monitor->y == NULL || (dimensions == 3 && monitor->z == NULL)) {
+        printf("metrics: out of memory for a copy of %d nodes and %d edges\n", n, m);
+        monitor_free(monitor);
+        return NULL;
+    }
+    memcpy(monitor->offsets, graph->offsets, ((size_t)n + 1) * sizeof(int));
+    memcpy(monitor->adjacency, graph->adjacency, 2 * (size_t)m * sizeof(int));
+    memcpy(monitor->edges, graph->edges, (size_t)m * sizeof(Edge));
+    Graph copy = {n, m, monitor->edges, monitor->offsets, monitor->adjacency, NULL, NULL, 1, 0};
+    monitor->graph = copy;
+    monitor->pivots = pivots;
+    monitor->seed = seed;
+
+    pthread_mutex_init(&monitor->lock, NULL);
+    pthread_cond_init(&monitor->wake, NULL);
+    pthread_cond_init(&monitor->done, NULL);
+    if (pthread_create(&monitor->thread, NULL, monitor_main, monitor) != 0) {
+        printf("metrics: cannot start the measuring thread\n");
+        pthread_mutex_destroy(&monitor->lock);
+        pthread_cond_destroy(&monitor->wake);
+        pthread_cond_destroy(&monitor->done);
+        monitor_free(monitor);
+        return NULL;
+    }
+    return monitor;
+}
+
+int metrics_monitor_submit(MetricsMonitor *monitor, int iteration, const Nodes *nodes, const int *current) {
+    pthread_mutex_lock(&monitor->lock);
+    int busy = monitor->pending;
+    pthread_mutex_unlock(&monitor->lock);
+    if (busy) return 0;
+
+    int n = monitor->graph.num_nodes;
+    if (current == NULL) {
+        memcpy(monitor->x, nodes->x, (size_t)n * sizeof(float));
+        memcpy(monitor->y, nodes->y, (size_t)n * sizeof(float));
+        if (monitor->z != NULL) memcpy(monitor->z, nodes->z, (size_t)n * sizeof(float));
+    } else {
+        for (int id = 0; id < n; id++) {
+            monitor->x[id] = nodes->x[current[id]];
+            monitor->y[id] = nodes->y[current[id]];
+            if (monitor->z != NULL) monitor->z[id] = nodes->z[current[id]];
+        }
+    }
+
+    pthread_mutex_lock(&monitor->lock);
+    monitor->iteration = iteration;
+    monitor->pending = 1;
+    pthread_cond_signal(&monitor->wake);
+    pthread_mutex_unlock(&monitor->lock);
+    return 1;
+}
+
+int metrics_monitor_latest(MetricsMonitor *monitor, LayoutMetrics *metrics) {
+    pthread_mutex_lock(&monitor->lock);
+    int finished = monitor->finished;
+    if (finished > 0) *metrics = monitor->latest;
+    pthread_mutex_unlock(&monitor->lock);
+    return finished;
+}
+
+void metrics_monitor_wait(MetricsMonitor *monitor) {
+    pthread_mutex_lock(&monitor->lock);
+    while (monitor->pending) {
+        pthread_cond_wait(&monitor->done, &monitor->lock);
+    }
+    pthread_mutex_unlock(&monitor->lock);
+}
+
+// A measurement still running is finished first; one not started yet is dropped
+void metrics_monitor_destroy(MetricsMonitor *monitor) {
+    if (monitor == NULL) return;
+    pthread_mutex_lock(&monitor->lock);
+    monitor->stopping = 1;
+    pthread_cond_signal(&monitor->wake);
+    pthread_mutex_unlock(&monitor->lock);
+    pthread_join(monitor->thread, NULL);
+    pthread_mutex_destroy(&monitor->lock);
+    pthread_cond_destroy(&monitor->wake);
+    pthread_cond_destroy(&monitor->done);
+    monitor_free(monitor);
+}
@@ -0,0 +1,71 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <stdint.h>
+
+#include "layout.h"
+#include "graph.h"
+
+#define METRICS_STRESS_PIVOTS 32           // BFS sources the stress is sampled from
+#define METRICS_MAX_CELLS (1 << 22)         // Crossing grid limit, cells grow beyond it
+#define METRICS_MAX_PAIR_TESTS (1ll << 26)  // Edge pairs sharing a cell tested at most, a sample beyond
+#define METRICS_QUALITY_TOLERANCE 0.01f     // Relative improvement below which a measurement counts as settled
+
+// Drawing quality of a layout, the things the force model is meant to give:
+// few crossings and edges of about equal length, with graph distances kept.
+typedef struct {
+    int iteration;         // Of the positions measured
+    long long crossings;   // Pairs of edges without a shared node that cross, -1 in 3D
+    int crossings_sampled; // Estimated from a sample of the edge pairs
+    double stress;         // Sampled normalised stress, 0 when drawn distances are proportional to hops
+    int pivots;            // Stress sources
+    double edge_mean, edge_stddev, edge_cv, edge_min, edge_max; // Edge lengths, cv = stddev / mean
+    double seconds;        // Spent measuring
+} LayoutMetrics;
+
+// Grid-bucketed crossing count. Each edge is put in the cells it passes
+// through; within a cell, edges are grouped by the node they share there, so
+// a hub's star costs nothing, and a crossing is counted only in the cell that
+// holds the intersection point. There are about as many cells as edges, each
+// a quarter to one mean edge length wide, which makes it near O(E + K) for
+// force-directed layouts, with a sort of each cell on top. A tangled layout,
+// say from random positions, has K close to E^2: past METRICS_MAX_PAIR_TESTS
+// every pair is tested with the same probability instead, the count scaled up
+// and *sampled set. Returns -1 if out of memory.
+long long metrics_crossings(const float *x, const float *y, int num_nodes, const Edge *edges, int num_edges,
+                           int *sampled);
+
+// Squared deviation of drawn distance over hop distance from its mean, over
+// the pairs of `pivots` random sources and every node they reach, relative to
+// the squared mean: scale free, comparable across iterations for one seed.
+// O(pivots (n + m)). Returns -1 if out of memory.
+double metrics_stress(const Graph *graph, const float *x, const float *y, const float *z, int pivots, uint64_t seed);
+
+void metrics_edge_lengths(LayoutMetrics *metrics, const float *x, const float *y, const float *z, const Edge *edges,
+                          int num_edges);
+
+// Everything above for positions in graph order; z is NULL in 2D
+int metrics_measure(LayoutMetrics *metrics, const Graph *graph, const float *x, const float *y, const float *z,
+                    int pivots, uint64_t seed);
+
+// 1 when `current` improved neither crossings nor stress by more than the
+// fraction `tolerance` of `previous`
+int metrics_settled(const LayoutMetrics *previous, const LayoutMetrics *current, float tolerance);
+void metrics_print(const LayoutMetrics *metrics);
+
+// Measures on a background thread. metrics_monitor_submit copies the positions
+// and returns at once; if the previous measurement is still running the
+// positions are dropped instead, so the layout never waits for it. The
+// monitor keeps its own copy of the graph.
+typedef struct MetricsMonitor MetricsMonitor;
+
+MetricsMonitor *metrics_monitor_create(const Graph *graph, int dimensions, int pivots, uint64_t seed);
+// `current` gives the index of each graph node in a reordered layout, NULL if
+// there is none. Returns 1 if the positions were taken.
+int metrics_monitor_submit(MetricsMonitor *monitor, int iteration, const Nodes *nodes, const int *current);
+// Copy the newest result; returns the number of measurements finished so far
+int metrics_monitor_latest(MetricsMonitor *monitor, LayoutMetrics *metrics);
+void metrics_monitor_wait(MetricsMonitor *monitor); // Until the submitted positions are measured
+void metrics_monitor_destroy(MetricsMonitor *monitor);
+
+#endif
@@ -0,0 +1,218 @@
+#include "multilevel.h"
+#include "cooling.h"
+#include "placement.h"
+#include "rng.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#define MULTILEVEL_JITTER 0.5f // Spread of a cluster's nodes around it, in average spacings of the finer level
+
+// Average distance between nodes spread evenly over the box
+static float node_spacing(int count) {
+    return sqrtf((float)BOX_WIDTH * BOX_HEIGHT / (float)(count > 0 ? count : 1));
+}
+
+// One coarsening step. Nodes are visited in random order and matched with
+// their lightest unmatched neighbour, so clusters stay balanced; a node left
+// without a partner joins its lightest neighbouring cluster, which keeps stars
+// and other hub-heavy graphs shrinking. cluster[v] receives the coarse node of
+// v, `weight` (nodes of the input graph per node) is replaced by the coarse
+// weights. Returns the coarse node count, or -1 on failure.
+static int coarsen(const Graph *fine, int *weight, int *cluster, Graph *coarse, Rng *rng) {
+    int n = fine->num_nodes;
+    int *order = malloc((size_t)n * sizeof(int));
+    int *coarse_weight = malloc((size_t)n * sizeof(int));
+    Edge *edges = malloc((size_t)(fine->num_edges > 0 ? fine->num_edges : 1) * sizeof(Edge));
+    if (order == NULL || coarse_weight == NULL || edges == NULL) {
+        printf("multilevel: out of memory (%d nodes)\n", n);
+        free(order);
+        free(coarse_weight);
+        free(edges);
+        return -1;
+    }
+
+    for (int i = 0; i < n; i++) {
+        order[i] = i;
+        cluster[i] = -1;
+    }
+    for (int i = n - 1; i > 0; i--) {
+        int j = (int)rng_below(rng, (uint64_t)i + 1);
+        int t = order[i];
+        order[i] = order[j];
+        order[j] = t;
+    }
+
+    int count = 0;
+    for (int i = 0; i < n; i++) {
+        int v = order[i];
+        if (cluster[v] >= 0) continue;
+        int best = -1;
+        for (int k = fine->offsets[v]; k < fine->offsets[v + 1]; k++) {
+            int w = fine->adjacency[k];
+            if (cluster[w] < 0 && (best < 0 || weight[w] < weight[best])) best = w;
+        }
+        if (best >= 0) {
+            cluster[v] = cluster[best] = count;
+            coarse_weight[count++] = weight[v] + weight[best];
+        }
+    }
+
+    // Every neighbour of a node left over was matched before it was visited
+    for (int v = 0; v < n; v++) {
+        if (cluster[v] >= 0) continue;
+        int best = -1;
+        for (int k = fine->offsets[v]; k < fine->offsets[v + 1]; k++) {
+            int c = cluster[fine->adjacency[k]];
+            if (c >= 0 && c < count && (best < 0 || coarse_weight[c] < coarse_weight[best])) best = c;
+        }
+        if (best < 0) {
+            best = count;
+            coarse_weight[count++] = 0;
+        }
+        cluster[v] = best;
+        coarse_weight[best] += weight[v];
+    }
+    memcpy(weight, coarse_weight, (size_t)count * sizeof(int));
+
+    // Edges between clusters; graph_build drops the duplicates
+    long m = 0;
+    for (int e = 0; e < fine->num_edges; e++) {
+        int a = cluster[fine->edges[e].from], b = cluster[fine->edges[e].to];
+        if (a != b) {
+            edges[m].from = a < b ? a : b;
+            edges[m].to = a < b ? b : a;
+            m++;
+        }
+    }
+    free(order);
+    free(coarse_weight);
+
+    memset(coarse, 0, sizeof(*coarse));
+    if (graph_build(coarse, edges, m, count) != 0) {
+        return -1;
+    }
+    return count;
+}
+
+// Nodes of the finer level start around their cluster, spread so the
+// pairwise kernels see no coincident pairs
+static void prolong(const Nodes *coarse, const int *cluster, Nodes *fine, Rng *rng) {
+    float spread = MULTILEVEL_JITTER * node_spacing(fine->count);
+    for (int i = 0; i < fine->count; i++) {
+        int c = cluster[i];
+        float x = coarse->x[c] + (rng_float(rng) * 2.0f - 1.0f) * spread;
+        float y = coarse->y[c] + (rng_float(rng) * 2.0f - 1.0f) * spread;
+        fine->x[i] = clamp(x, BOX_MARGIN, BOX_MARGIN + BOX_WIDTH);
+        fine->y[i] = clamp(y, BOX_MARGIN, BOX_MARGIN + BOX_HEIGHT);
+        fine->dx[i] = fine->dy[i] = 0;
+        fine->still[i] = 0;
+    }
+}
+
+// Adaptive cooling from `temperature` for at most `iterations`, stopping once converged
+static int refine(Nodes *nodes, const Graph *graph, const ForceSettings *settings, float temperature, int iterations) {
+    ForceSettings level = *settings;
+    if (graph->num_nodes <= AUTO_BARNES_HUT_NODES) level.repulsion = REPULSION_EXACT;
+    ForceWorkspace *workspace = NULL;
+    if (level.workspace == NULL) {
+        level.workspace = workspace = force_workspace_create();
+    }
+
+    Cooling cooling;
+    cooling_init(&cooling, SCHEDULE_ADAPTIVE, temperature, COOLING_FACTOR);
+    int done = 0;
+    while (done < iterations) {
+        ForceStats stats = calculate_forces(nodes, graph->edges, graph->num_edges, cooling.temperature, done, &level);
+        cooling_update(&cooling, &stats);
+        done++;
+        if (layout_converged(&stats, nodes->count, CONVERGENCE_TOLERANCE)) break;
+    }
+    force_workspace_destroy(workspace);
+    return done;
+}
+
+int multilevel_layout(Nodes *nodes, const Graph *graph, const ForceSettings *settings, uint64_t seed,
+                      MultilevelStats *stats) {
+    MultilevelStats local;
+    if (stats == NULL) stats = &local;
+    memset(stats, 0, sizeof(*stats));
+    double start = layout_seconds();
+
+    Rng rng;
+    rng_seed(&rng, seed);
+
+    // levels[0] is the input; cluster[l] maps nodes of level l to level l + 1
+    Graph coarse[MULTILEVEL_MAX_LEVELS];
+    const Graph *levels[MULTILEVEL_MAX_LEVELS];
+    int *cluster[MULTILEVEL_MAX_LEVELS];
+    int num_levels = 1;
+    levels[0] = graph;
+    int failed = 0;
+
+    int *weight = malloc((size_t)(graph->num_nodes > 0 ? graph->num_nodes : 1) * sizeof(int));
+    if (weight == NULL) {
+        printf("multilevel: out of memory (%d nodes)\n", graph->num_nodes);
+        return -1;
+    }
+    for (int i = 0; i < graph->num_nodes; i++) weight[i] = 1;
+
+    while (num_levels < MULTILEVEL_MAX_LEVELS && levels[num_levels - 1]->num_nodes > MULTILEVEL_COARSEST_NODES) {
+        const Graph *fine = levels[num_levels - 1];
+        int l = num_levels - 1;
+        cluster[l] = malloc((size_t)fine->num_nodes * sizeof(int));
+        int count = cluster[l] != NULL ? coarsen(fine, weight, cluster[l], &coarse[l], &rng) : -1;
+        if (count < 0) {
+            free(cluster[l]);
+            failed = 1;
+            break;
+        }
+        levels[num_levels++] = &coarse[l];
+        if (count > MULTILEVEL_MIN_SHRINK * fine->num_nodes) break;
+    }
+    free(weight);
+    stats->levels = num_levels;
+    stats->coarsest_nodes = levels[num_levels - 1]->num_nodes;
+    double coarsened = layout_seconds();
+    stats->coarsen_seconds = coarsened - start;
+
+    // Lay out the coarsest level, then prolong and refine down to the input
+    Nodes current = {0}, finer = {0};
+    if (!failed && num_levels > 1) {
+        failed = nodes_alloc(&current, levels[num_levels - 1]->num_nodes) != 0;
+    }
+    if (!failed) {
+        Nodes *top = num_levels > 1 ? &current : nodes;
+        initialize_nodes(top, (unsigned int)rng_next(&rng));
+        stats->iterations += refine(top, levels[num_levels - 1], settings, START_TEMPERATURE,
+                                    MULTILEVEL_COARSEST_ITERATIONS);
+    }
+    for (int l = num_levels - 2; l >= 0 && !failed; l--) {
+        Nodes *target = l == 0 ? nodes : &finer;
+        if (l > 0 && nodes_alloc(&finer, levels[l]->num_nodes) != 0) {
+            failed = 1;
+            break;
+        }
+        prolong(&current, cluster[l], target, &rng);
+        nodes_free(&current);
+
+        // Moves shrink with the spacing, coarse levels settle the large-scale shape
+        float temperature = clamp(node_spacing(levels[l]->num_nodes), PLACEMENT_REFINE_TEMPERATURE, START_TEMPERATURE);
+        stats->iterations += refine(target, levels[l], settings, temperature, MULTILEVEL_REFINE_ITERATIONS);
+        if (l > 0) {
+            current = finer;
+            memset(&finer, 0, sizeof(finer));
+        }
+    }
+    nodes_free(&current);
+    nodes_free(&finer);
+
+    for (int l = 0; l < num_levels - 1; l++) {
+        free(cluster[l]);
+        graph_free(&coarse[l]);
+    }
+    stats->layout_seconds = layout_seconds() - coarsened;
+    return failed ? -1 : 0;
+}
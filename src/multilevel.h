@@ -0,0 +1,35 @@
+#ifndef MULTILEVEL_H
+#define MULTILEVEL_H
+
+#include <stdint.h>
+
+#include "layout.h"
+#include "graph.h"
+
+#define MULTILEVEL_COARSEST_NODES 64      // Coarsening stops at this size
+#define MULTILEVEL_MIN_SHRINK 0.8f        // ... or when a level keeps more than this share of the nodes
+#define MULTILEVEL_MAX_LEVELS 40
+#define MULTILEVEL_COARSEST_ITERATIONS 300 // Full layout of the coarsest level
+#define MULTILEVEL_REFINE_ITERATIONS 40    // Short refinement of every finer level
+
+// Per-level detail of the last multilevel_layout call
+typedef struct {
+    int levels;          // Including the input graph
+    int coarsest_nodes;
+    int iterations;      // Force iterations summed over the levels
+    double coarsen_seconds;
+    double layout_seconds;
+} MultilevelStats;
+
+// Multilevel layout (Walshaw): the graph is coarsened level by level by a
+// randomized matching, unmatched nodes joining a matched neighbour, until it
+// is small or stops shrinking. The coarsest graph is laid out from random
+// positions, then each finer level starts from its cluster's position and is
+// refined for a few iterations with the same force model. Levels shrink
+// geometrically, so the total is about one refinement pass of the input.
+// `settings` picks the kernels, pool and repulsion mode for the large levels;
+// small ones always use the exact kernel. Returns -1 on failure.
+int multilevel_layout(Nodes *nodes, const Graph *graph, const ForceSettings *settings, uint64_t seed,
+                      MultilevelStats *stats);
+
+#endif
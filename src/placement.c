@@ -0,0 +1,317 @@
+#include "placement.h"
+#include "multilevel.h"
+#include "forces.h"
+#include "rng.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#define PLACEMENT_FILL 0.9f // Share of the box the structured placements span
+
+static const char *placement_names[PLACEMENT_COUNT] = {
+    "random", "bfs", "pivot-mds", "multilevel"
+};
+
+const char *placement_name(PlacementKind kind) {
+    return kind >= 0 && kind < PLACEMENT_COUNT ? placement_names[kind] : "unknown";
+}
+
+int placement_from_name(const char *name) {
+    for (int kind = 0; kind < PLACEMENT_COUNT; kind++) {
+        if (strcmp(name, placement_names[kind]) == 0) return kind;
+    }
+    return -1;
+}
+
+// Breadth-first search over the component of `source`. Nodes must start with
+// dist -1; the visited ones are left in queue[0 .. returned count) with their
+// distance (and parent, if given) set.
+static int bfs(const Graph *graph, int source, int *dist, int *parent, int *queue) {
+    int head = 0, tail = 0;
+    dist[source] = 0;
+    if (parent != NULL) parent[source] = -1;
+    queue[tail++] = source;
+    while (head < tail) {
+        int v = queue[head++];
+        for (int k = graph->offsets[v]; k < graph->offsets[v + 1]; k++) {
+            int w = graph->adjacency[k];
+            if (dist[w] < 0) {
+                dist[w] = dist[v] + 1;
+                if (parent != NULL) parent[w] = v;
+                queue[tail++] = w;
+            }
+        }
+    }
+    return tail;
+}
+
+static void reset_distances(int *dist, const int *queue, int count) {
+    for (int i = 0; i < count; i++) {
+        dist[queue[i]] = -1;
+    }
+}
+
+// Rings around a central node: each component is searched from the middle of
+// a pseudo-diameter (two sweeps find its ends), every BFS layer gets its own
+// ring and keeps the order it was discovered in, so subtrees stay together.
+// Later components continue on the rings further out.
+static int place_bfs(Nodes *nodes, const Graph *graph) {
+    int n = graph->num_nodes;
+    int *dist = malloc((size_t)n * sizeof(int));
+    int *parent = malloc((size_t)n * sizeof(int));
+    int *queue = malloc((size_t)n * sizeof(int));
+    int *layer = malloc((size_t)n * sizeof(int));
+    int *order = malloc((size_t)n * sizeof(int));
+    int *layer_size = calloc((size_t)n + 1, sizeof(int));
+    if (dist == NULL || parent == NULL || queue == NULL || layer == NULL || order == NULL || layer_size == NULL) {
+        printf("placement: out of memory (%d nodes)\n", n);
+        free(dist);
+        free(parent);
+        free(queue);
+        free(layer);
+        free(order);
+        free(layer_size);
+        return -1;
+    }
+    memset(dist, -1, (size_t)n * sizeof(int));
+    memset(layer, -1, (size_t)n * sizeof(int));
+
+    int placed = 0, base = 0;
+    for (int root = 0; root < n; root++) {
+        if (layer[root] >= 0) continue;
+
+        int count = bfs(graph, root, dist, NULL, queue);
+        int end = queue[count - 1];
+        reset_distances(dist, queue, count);
+        count = bfs(graph, end, dist, parent, queue);
+        int other_end = queue[count - 1];
+        int centre = other_end;
+        for (int steps = dist[other_end] / 2; steps > 0; steps--) {
+            centre = parent[centre];
+        }
+        reset_distances(dist, queue, count);
+
+        count = bfs(graph, centre, dist, NULL, queue);
+        int depth = 0;
+        for (int i = 0; i < count; i++) {
+            int v = queue[i];
+            layer[v] = base + dist[v];
+            layer_size[layer[v]]++;
+            order[placed++] = v;
+            if (dist[v] > depth) depth = dist[v];
+        }
+        reset_distances(dist, queue, count);
+        base += depth + 1;
+    }
+
+    // Ring radius grows linearly with the layer, the first layer is the centre
+    float centre_x = BOX_MARGIN + BOX_WIDTH * 0.5f, centre_y = BOX_MARGIN + BOX_HEIGHT * 0.5f;
+    float radius_x = BOX_WIDTH * 0.5f * PLACEMENT_FILL, radius_y = BOX_HEIGHT * 0.5f * PLACEMENT_FILL;
+    float step = base > 1 ? 1.0f / (float)(base - 1) : 0.0f;
+    int *rank = parent; // Reused: next free slot per layer
+    memset(rank, 0, (size_t)(base > 0 ? base : 1) * sizeof(int));
+    for (int i = 0; i < n; i++) {
+        int v = order[i];
+        int l = layer[v];
+        float angle = 6.2831853f * ((float)rank[l]++ + 0.5f) / (float)layer_size[l];
+        float r = l * step;
+        nodes->x[v] = centre_x + r * radius_x * cosf(angle);
+        nodes->y[v] = centre_y + r * radius_y * sinf(angle);
+    }
+
+    free(dist);
+    free(parent);
+    free(queue);
+    free(layer);
+    free(order);
+    free(layer_size);
+    return 0;
+}
+
+// Top eigenvector of the k x k symmetric matrix, orthogonal to `against` if given
+static void power_iteration(const double *matrix, int k, const double *against, double *vector) {
+    double *next = malloc((size_t)k * sizeof(double));
+    if (next == NULL) return;
+    for (int j = 0; j < k; j++) {
+        vector[j] = 1.0 + 0.1 * (double)j / k; // Not orthogonal to any eigenvector in practice
+    }
+    for (int step = 0; step < PLACEMENT_POWER_STEPS; step++) {
+        if (against != NULL) {
+            double dot = 0;
+            for (int j = 0; j < k; j++) dot += vector[j] * against[j];
+            for (int j = 0; j < k; j++) vector[j] -= dot * against[j];
+        }
+        double norm = 0;
+        for (int i = 0; i < k; i++) {
+            double sum = 0;
+            for (int j = 0; j < k; j++) sum += matrix[i * k + j] * vector[j];
+            next[i] = sum;
+            norm += sum * sum;
+        }
+        norm = sqrt(norm);
+        if (norm == 0) break;
+        for (int j = 0; j < k; j++) vector[j] = next[j] / norm;
+    }
+    free(next);
+}
+
+// Pivot MDS (Brandes and Pich): BFS distances from k pivots picked by max-min
+// distance, double centred, projected on the top two eigenvectors of C^T C.
+// O(k (n + m)) for the searches and O(n k^2) for the product.
+static int place_pivot_mds(Nodes *nodes, const Graph *graph, Rng *rng) {
+    int n = graph->num_nodes;
+    int k = n < PLACEMENT_PIVOTS ? n : PLACEMENT_PIVOTS;
+    float *c = malloc((size_t)n * k * sizeof(float));
+    int *dist = malloc((size_t)n * sizeof(int));
+    int *queue = malloc((size_t)n * sizeof(int));
+    int *nearest = malloc((size_t)n * sizeof(int)); // Distance to the closest pivot so far
+    double *column_mean = calloc((size_t)k, sizeof(double));
+    double *b = calloc((size_t)k * k, sizeof(double));
+    double *first = malloc((size_t)k * sizeof(double));
+    double *second = malloc((size_t)k * sizeof(double));
+    int ok = c != NULL && dist != NULL && queue != NULL && nearest != NULL && column_mean != NULL &&
+             b != NULL && first != NULL && second != NULL;
+    if (!ok) {
+        printf("placement: out of memory (%d nodes, %d pivots)\n", n, k);
+    }
+
+    int pivot = ok ? (int)rng_below(rng, (uint64_t)n) : 0;
+    for (int i = 0; ok && i < n; i++) nearest[i] = n;
+    for (int p = 0; ok && p < k; p++) {
+        memset(dist, -1, (size_t)n * sizeof(int));
+        int count = bfs(graph, pivot, dist, NULL, queue);
+        int unreachable = dist[queue[count - 1]] + 1; // Other components sit just past the farthest node
+        for (int i = 0; i < n; i++) {
+            int d = dist[i] >= 0 ? dist[i] : unreachable;
+            c[(size_t)i * k + p] = (float)d * (float)d;
+            if (d < nearest[i]) nearest[i] = d;
+        }
+        for (int i = 0; i < n; i++) {
+            if (nearest[i] > nearest[pivot]) pivot = i;
+        }
+    }
+
+    if (ok) {
+        // Double centring: -1/2 (d^2 - row mean - column mean + total mean)
+        double total_mean = 0;
+        for (int i = 0; i < n; i++) {
+            for (int p = 0; p < k; p++) column_mean[p] += c[(size_t)i * k + p];
+        }
+        for (int p = 0; p < k; p++) {
+            column_mean[p] /= n;
+            total_mean += column_mean[p] / k;
+        }
+        for (int i = 0; i < n; i++) {
+            float *row = c + (size_t)i * k;
+            double row_mean = 0;
+            for (int p = 0; p < k; p++) row_mean += row[p];
+            row_mean /= k;
+            for (int p = 0; p < k; p++) {
+                row[p] = (float)(-0.5 * (row[p] - row_mean - column_mean[p] + total_mean));
+            }
+        }
+
+        // B = C^T C, upper triangle then mirrored
+        for (int i = 0; i < n; i++) {
+            const float *row = c + (size_t)i * k;
+            for (int p = 0; p < k; p++) {
+                double value = row[p];
+                for (int q = p; q < k; q++) b[p * k + q] += value * row[q];
+            }
+        }
+        for (int p = 0; p < k; p++) {
+            for (int q = 0; q < p; q++) b[p * k + q] = b[q * k + p];
+        }
+        power_iteration(b, k, NULL, first);
+        power_iteration(b, k, first, second);
+
+        for (int i = 0; i < n; i++) {
+            const float *row = c + (size_t)i * k;
+            double x = 0, y = 0;
+            for (int p = 0; p < k; p++) {
+                x += row[p] * first[p];
+                y += row[p] * second[p];
+            }
+            nodes->x[i] = (float)x;
+            nodes->y[i] = (float)y;
+        }
+    }
+
+    free(c);
+    free(dist);
+    free(queue);
+    free(nearest);
+    free(column_mean);
+    free(b);
+    free(first);
+    free(second);
+    return ok ? 0 : -1;
+}
+
+// Scale uniformly into the middle of the box. Nodes with the same distances
+// land on the same spot and the pairwise kernels ignore coincident pairs, so
+// everything is spread by up to a quarter of the average spacing.
+static void fit_to_box(Nodes *nodes, Rng *rng) {
+    float min_x = INFINITY, min_y = INFINITY, max_x = -INFINITY, max_y = -INFINITY;
+    for (int i = 0; i < nodes->count; i++) {
+        min_x = fminf(min_x, nodes->x[i]);
+        max_x = fmaxf(max_x, nodes->x[i]);
+        min_y = fminf(min_y, nodes->y[i]);
+        max_y = fmaxf(max_y, nodes->y[i]);
+    }
+    float width = fmaxf(max_x - min_x, 1e-6f), height = fmaxf(max_y - min_y, 1e-6f);
+    float scale = fminf(BOX_WIDTH * PLACEMENT_FILL / width, BOX_HEIGHT * PLACEMENT_FILL / height);
+    float offset_x = BOX_MARGIN + (BOX_WIDTH - width * scale) * 0.5f;
+    float offset_y = BOX_MARGIN + (BOX_HEIGHT - height * scale) * 0.5f;
+    float spread = 0.25f * sqrtf((float)BOX_WIDTH * BOX_HEIGHT / (float)(nodes->count > 0 ? nodes->count : 1));
+    for (int i = 0; i < nodes->count; i++) {
+        float x = offset_x + (nodes->x[i] - min_x) * scale + (rng_float(rng) * 2.0f - 1.0f) * spread;
+        float y = offset_y + (nodes->y[i] - min_y) * scale + (rng_float(rng) * 2.0f - 1.0f) * spread;
+        nodes->x[i] = clamp(x, BOX_MARGIN, BOX_MARGIN + BOX_WIDTH);
+        nodes->y[i] = clamp(y, BOX_MARGIN, BOX_MARGIN + BOX_HEIGHT);
+    }
+}
+
+// Set starting positions, displacements and stillness cleared. The same
+// graph, kind and seed always give the same positions (for multilevel, with
+// the same thread count). `settings` runs the multilevel refinement, NULL for
+// one thread and automatic repulsion. The structured placements are 2D only;
+// 3D layouts keep the random positions and get -1.
+int place_nodes(Nodes *nodes, const Graph *graph, PlacementKind kind, uint64_t seed, const ForceSettings *settings) {
+    initialize_nodes(nodes, (unsigned int)seed);
+    if (kind == PLACEMENT_RANDOM || graph->num_nodes < 3) {
+        return 0;
+    }
+    if (nodes->dimensions != 2) {
+        return -1;
+    }
+
+    Rng rng;
+    rng_seed(&rng, seed);
+    int failed;
+    if (kind == PLACEMENT_MULTILEVEL) {
+        ForceSettings defaults = {graph->num_nodes > AUTO_BARNES_HUT_NODES ? REPULSION_BARNES_HUT : REPULSION_EXACT,
+                                  BARNES_HUT_THETA, force_kernels_select(NULL), NULL, NULL, 1, NULL};
+        failed = multilevel_layout(nodes, graph, settings != NULL ? settings : &defaults, seed, NULL);
+    } else if (kind == PLACEMENT_BFS) {
+        failed = place_bfs(nodes, graph);
+    } else {
+        failed = place_pivot_mds(nodes, graph, &rng);
+    }
+    if (failed) {
+        initialize_nodes(nodes, (unsigned int)seed);
+        return -1;
+    }
+    if (kind == PLACEMENT_PIVOT_MDS) {
+        fit_to_box(nodes, &rng);
+    }
+    return 0;
+}
+
+// Structured placements are close to their final shape already and only need
+// refining; a full start temperature would shake them back into a random one
+float placement_temperature(PlacementKind kind) {
+    return kind == PLACEMENT_RANDOM ? START_TEMPERATURE : PLACEMENT_REFINE_TEMPERATURE;
+}
@@ -0,0 +1,27 @@
+#ifndef PLACEMENT_H
+#define PLACEMENT_H
+
+#include <stdint.h>
+
+#include "layout.h"
+#include "graph.h"
+
+#define PLACEMENT_PIVOTS 32       // Pivot-MDS distance columns, fewer for small graphs
+#define PLACEMENT_POWER_STEPS 200 // Power iterations for each eigenvector
+#define PLACEMENT_REFINE_TEMPERATURE 5.0f // Start temperature after a structured placement
+
+// Starting positions for the force loop
+typedef enum {
+    PLACEMENT_RANDOM,    // Uniform in the box from a seeded generator
+    PLACEMENT_BFS,       // Breadth-first layers on rings around a central node
+    PLACEMENT_PIVOT_MDS, // Classical MDS of the graph distances to a few pivots
+    PLACEMENT_MULTILEVEL, // Coarsen, lay out the coarsest graph and refine back up, see multilevel.h
+    PLACEMENT_COUNT
+} PlacementKind;
+
+const char *placement_name(PlacementKind kind);
+int placement_from_name(const char *name); // -1 if unknown
+int place_nodes(Nodes *nodes, const Graph *graph, PlacementKind kind, uint64_t seed, const ForceSettings *settings);
+float placement_temperature(PlacementKind kind);
+
+#endif
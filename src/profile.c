@@ -0,0 +1,171 @@
+#include "profile.h"
+#include "layout.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <stdatomic.h>
+
+// Seqlock per slot: a reader keeps an event only if the slot's sequence is the
+// same before and after copying it, so overwritten slots are skipped
+typedef struct {
+    atomic_ulong sequence; // Event index + 1 once written, 0 while being written
+    _Atomic(const char *) name;
+    atomic_int thread;
+    _Atomic double begin, end;
+} ProfileSlot;
+
+typedef struct {
+    const char *name;
+    int thread;
+    double begin, end;
+} ProfileEvent;
+
+static ProfileSlot ring[PROFILE_RING_SIZE];
+static atomic_ulong ring_head;
+static atomic_int recording;
+
+static atomic_int num_threads;
+static _Thread_local int thread_id = -1;
+static _Atomic(const char *) thread_names[PROFILE_MAX_THREADS];
+
+void profile_enable(int enabled) {
+    atomic_store_explicit(&recording, enabled, memory_order_relaxed);
+}
+
+int profile_enabled(void) {
+    return atomic_load_explicit(&recording, memory_order_relaxed);
+}
+
+static int current_thread(void) {
+    if (thread_id < 0) {
+        thread_id = atomic_fetch_add_explicit(&num_threads, 1, memory_order_relaxed);
+    }
+    return thread_id;
+}
+
+// Name the calling thread in the trace
+void profile_thread_name(const char *name) {
+    int thread = current_thread();
+    if (thread < PROFILE_MAX_THREADS) {
+        atomic_store_explicit(&thread_names[thread], name, memory_order_release);
+    }
+}
+
+double profile_begin(void) {
+    return profile_enabled() ? layout_seconds() : 0.0;
+}
+
+void profile_end(const char *name, double begin) {
+    if (profile_enabled()) {
+        profile_record(name, begin, layout_seconds());
+    }
+}
+
+// Record a scope whose times were already taken with layout_seconds
+void profile_record(const char *name, double begin, double end) {
+    if (!profile_enabled()) {
+        return;
+    }
+    unsigned long index = atomic_fetch_add_explicit(&ring_head, 1, memory_order_relaxed);
+    ProfileSlot *slot = &ring[index & (PROFILE_RING_SIZE - 1)];
+
+    atomic_store_explicit(&slot->sequence, 0, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    atomic_store_explicit(&slot->name, name, memory_order_relaxed);
+    atomic_store_explicit(&slot->thread, current_thread(), memory_order_relaxed);
+    atomic_store_explicit(&slot->begin, begin, memory_order_relaxed);
+    atomic_store_explicit(&slot->end, end, memory_order_relaxed);
+    atomic_store_explicit(&slot->sequence, index + 1, memory_order_release);
+}
+
+// Copy event `index` out of the ring, 0 if it was overwritten or is unfinished
+static int read_event(unsigned long index, ProfileEvent *event) {
+    ProfileSlot *slot = &ring[index & (PROFILE_RING_SIZE - 1)];
+    if (atomic_load_explicit(&slot->sequence, memory_order_acquire) != index + 1) {
+        return 0;
+    }
+    event->name = atomic_load_explicit(&slot->name, memory_order_relaxed);
+    event->thread = atomic_load_explicit(&slot->thread, memory_order_relaxed);
+    event->begin = atomic_load_explicit(&slot->begin, memory_order_relaxed);
+    event->end = atomic_load_explicit(&slot->end, memory_order_relaxed);
+    atomic_thread_fence(memory_order_acquire);
+    return atomic_load_explicit(&slot->sequence, memory_order_relaxed) == index + 1;
+}
+
+static unsigned long oldest_event(unsigned long head) {
+    return head > PROFILE_RING_SIZE ? head - PROFILE_RING_SIZE : 0;
+}
+
+// Total time and count per scope name over the last `window` seconds.
+// Returns the number of names, at most max_stats, in order of first appearance.
+int profile_summarize(double window, ProfileStat stats[], int max_stats) {
+    unsigned long head = atomic_load_explicit(&ring_head, memory_order_acquire);
+    double since = layout_seconds() - window;
+    int num_stats = 0;
+
+    for (unsigned long index = oldest_event(head); index < head; index++) {
+        ProfileEvent event;
+        if (!read_event(index, &event) || event.end < since) {
+            continue;
+        }
+        int s = 0;
+        while (s < num_stats && stats[s].name != event.name && strcmp(stats[s].name, event.name) != 0) {
+            s++;
+        }
+        if (s == num_stats) {
+            if (num_stats == max_stats) continue;
+            stats[num_stats++] = (ProfileStat){event.name, 0.0, 0};
+        }
+        stats[s].seconds += event.end - event.begin;
+        stats[s].count++;
+    }
+    return num_stats;
+}
+
+// Write the events in the ring as Chrome trace_event JSON (chrome://tracing,
+// Perfetto). Returns the number of events written, -1 on failure.
+int profile_write_trace(const char *path) {
+    FILE *out = fopen(path, "w");
+    if (out == NULL) {
+        printf("Cannot open %s for writing\n", path);
+        return -1;
+    }
+
+    unsigned long head = atomic_load_explicit(&ring_head, memory_order_acquire);
+    double origin = 0.0;
+    for (unsigned long index = oldest_event(head); index < head; index++) {
+        ProfileEvent event;
+        if (read_event(index, &event) && (origin == 0.0 || event.begin < origin)) origin = event.begin;
+    }
+
+    fprintf(out, "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n");
+    int first = 1;
+    int threads = atomic_load_explicit(&num_threads, memory_order_relaxed);
+    for (int thread = 0; thread < threads && thread < PROFILE_MAX_THREADS; thread++) {
+        const char *name = atomic_load_explicit(&thread_names[thread], memory_order_acquire);
+        if (name == NULL) continue;
+        fprintf(out, "%s{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": %d, \"args\": {\"name\": \"%s\"}}",
+                first ? "" : ",\n", thread, name);
+        first = 0;
+    }
+    int written = 0;
+    for (unsigned long index = oldest_event(head); index < head; index++) {
+        ProfileEvent event;
+        if (!read_event(index, &event)) continue;
+        // Events are in completion order, trace viewers sort them by start
+        fprintf(out, "%s{\"name\": \"%s\", \"ph\": \"X\", \"pid\": 1, \"tid\": %d, \"ts\": %.3f, \"dur\": %.3f}",
+                first ? "" : ",\n", event.name, event.thread,
+                (event.begin - origin) * 1e6, (event.end - event.begin) * 1e6);
+        first = 0;
+        written++;
+    }
+    fprintf(out, "\n]}\n");
+
+    int failed = ferror(out);
+    failed |= fclose(out) != 0;
+    if (failed) {
+        printf("Error writing %s\n", path);
+        return -1;
+    }
+    return written;
+}
@@ -0,0 +1,34 @@
+#ifndef PROFILE_H
+#define PROFILE_H
+
+#define PROFILE_RING_SIZE 65536 // Events kept, a power of two; older ones are overwritten
+#define PROFILE_MAX_THREADS 32  // Threads that can be named in the trace
+
+// Timed scopes from any thread go into one lock-free ring buffer. Recording is
+// off until profile_enable(1), and then costs two clock reads and an atomic add.
+//
+//     double start = profile_begin();
+//     ...
+//     profile_end("repulsion", start);
+//
+// Names must be string literals or otherwise outlive the profile.
+
+// Totals for one scope name over a time window
+typedef struct {
+    const char *name;
+    double seconds;
+    int count;
+} ProfileStat;
+
+void profile_enable(int enabled);
+int profile_enabled(void);
+void profile_thread_name(const char *name);
+
+double profile_begin(void);
+void profile_end(const char *name, double begin);
+void profile_record(const char *name, double begin, double end);
+
+int profile_summarize(double window, ProfileStat stats[], int max_stats);
+int profile_write_trace(const char *path);
+
+#endif
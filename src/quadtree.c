@@ -0,0 +1,208 @@
+#include "quadtree.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+// Make room for `count` more cells, growing geometrically
+static void reserve_cells(QuadTree *tree, int count) {
+    if (tree->num_cells + count <= tree->cell_capacity) {
+        return;
+    }
+    int capacity = tree->cell_capacity ? tree->cell_capacity * 2 : 64;
+    QuadCell *cells = realloc(tree->cells, (size_t)capacity * sizeof(QuadCell));
+    if (cells == NULL) {
+        printf("quadtree: out of memory (%d cells)\n", capacity);
+        exit(1);
+    }
+    tree->cells = cells;
+    tree->cell_capacity = capacity;
+}
+
+// Grab four consecutive cells for the children of a cell, returns the first index
+static int allocate_children(QuadTree *tree, int parent) {
+    reserve_cells(tree, 4);
+
+    int first = tree->num_cells;
+    QuadCell *p = &tree->cells[parent];
+    float quarter = p->half * 0.5f;
+    for (int q = 0; q < 4; q++) {
+        QuadCell *c = &tree->cells[first + q];
+        c->cx = p->cx + ((q & 1) ? quarter : -quarter);
+        c->cy = p->cy + ((q & 2) ? quarter : -quarter);
+        c->half = quarter;
+        c->mass = 0;
+        c->com_x = 0;
+        c->com_y = 0;
+        c->child = -1;
+        c->first = -1;
+    }
+    tree->num_cells += 4;
+    return first;
+}
+
+static int quadrant(const QuadCell *c, float x, float y) {
+    return (x >= c->cx ? 1 : 0) | (y >= c->cy ? 2 : 0);
+}
+
+static void insert(QuadTree *tree, const float *xs, const float *ys, int index) {
+    int cell = 0;
+    float x = xs[index];
+    float y = ys[index];
+
+    for (int depth = 0; ; depth++) {
+        QuadCell *c = &tree->cells[cell];
+
+        if (c->child >= 0) { // Internal: descend
+            cell = c->child + quadrant(c, x, y);
+            continue;
+        }
+        if (c->first < 0 || depth >= QUADTREE_MAX_DEPTH) { // Empty leaf or depth limit: chain it
+            tree->next[index] = c->first;
+            c->first = index;
+            return;
+        }
+
+        // Occupied leaf above the depth limit holds exactly one node, split it
+        int occupant = c->first;
+        int child = allocate_children(tree, cell);
+        c = &tree->cells[cell]; // May have moved
+        c->child = child;
+        c->first = -1;
+
+        int q = quadrant(c, xs[occupant], ys[occupant]);
+        tree->next[occupant] = -1;
+        tree->cells[child + q].first = occupant;
+        cell = child + quadrant(c, x, y);
+    }
+}
+
+void quadtree_build(QuadTree *tree, const float *x, const float *y, int num_nodes) {
+    if (num_nodes > tree->node_capacity) {
+        int *next = realloc(tree->next, (size_t)num_nodes * sizeof(int));
+        if (next == NULL) {
+            printf("quadtree: out of memory (%d nodes)\n", num_nodes);
+            exit(1);
+        }
+        tree->next = next;
+        tree->node_capacity = num_nodes;
+    }
+
+    // Square root cell around all nodes
+    float min_x = 0, min_y = 0, max_x = 0, max_y = 0;
+    if (num_nodes > 0) {
+        min_x = max_x = x[0];
+        min_y = max_y = y[0];
+    }
+    for (int i = 1; i < num_nodes; i++) {
+        if (x[i] < min_x) min_x = x[i];
+        if (x[i] > max_x) max_x = x[i];
+        if (y[i] < min_y) min_y = y[i];
+        if (y[i] > max_y) max_y = y[i];
+    }
+    float half = 0.5f * ((max_x - min_x) > (max_y - min_y) ? (max_x - min_x) : (max_y - min_y));
+    half = half * 1.001f + 1.0f; // Keep points on the max edge inside
+
+    tree->num_cells = 0;
+    reserve_cells(tree, 1);
+    QuadCell *root = &tree->cells[0];
+    root->cx = 0.5f * (min_x + max_x);
+    root->cy = 0.5f * (min_y + max_y);
+    root->half = half;
+    root->mass = 0;
+    root->com_x = 0;
+    root->com_y = 0;
+    root->child = -1;
+    root->first = -1;
+    tree->num_cells = 1;
+
+    for (int i = 0; i < num_nodes; i++) {
+        insert(tree, x, y, i);
+    }
+
+    // Children always come after their parent, so a reverse sweep is a post-order pass
+    for (int cell = tree->num_cells - 1; cell >= 0; cell--) {
+        QuadCell *c = &tree->cells[cell];
+        float mass = 0, sx = 0, sy = 0;
+        if (c->child >= 0) {
+            for (int q = 0; q < 4; q++) {
+                const QuadCell *k = &tree->cells[c->child + q];
+                mass += k->mass;
+                sx += k->com_x * k->mass;
+                sy += k->com_y * k->mass;
+            }
+        } else {
+            for (int n = c->first; n >= 0; n = tree->next[n]) {
+                mass += 1.0f;
+                sx += x[n];
+                sy += y[n];
+            }
+        }
+        c->mass = mass;
+        if (mass > 0) {
+            c->com_x = sx / mass;
+            c->com_y = sy / mass;
+        }
+    }
+}
+
+// Repulsive displacement on node `index`; far cells are treated as one body at
+// their centre of mass when (cell width / distance) < theta
+void quadtree_repulsion(const QuadTree *tree, const float *x, const float *y, int index, float theta, float *fx, float *fy) {
+    int stack[QUADTREE_MAX_DEPTH * 3 + 4];
+    int top = 0;
+    float px = x[index];
+    float py = y[index];
+    float theta2 = theta * theta;
+    float sum_x = 0, sum_y = 0;
+
+    stack[top++] = 0;
+    while (top > 0) {
+        const QuadCell *c = &tree->cells[stack[--top]];
+        if (c->mass == 0) continue;
+
+        if (c->child < 0) {
+            for (int n = c->first; n >= 0; n = tree->next[n]) {
+                if (n == index) continue;
+                float dx = px - x[n];
+                float dy = py - y[n];
+                float d2 = dx * dx + dy * dy;
+                if (d2 > 0) {
+                    float f = 1000.0f / d2; // (dx / d) * (1000 / d)
+                    sum_x += dx * f;
+                    sum_y += dy * f;
+                }
+            }
+            continue;
+        }
+
+        float dx = px - c->com_x;
+        float dy = py - c->com_y;
+        float d2 = dx * dx + dy * dy;
+        float width = 2.0f * c->half;
+        int contains = px >= c->cx - c->half && px < c->cx + c->half &&
+                       py >= c->cy - c->half && py < c->cy + c->half;
+
+        if (!contains && d2 > 0 && width * width < theta2 * d2) {
+            float f = 1000.0f * c->mass / d2;
+            sum_x += dx * f;
+            sum_y += dy * f;
+        } else {
+            for (int q = 0; q < 4; q++) {
+                stack[top++] = c->child + q;
+            }
+        }
+    }
+
+    *fx = sum_x;
+    *fy = sum_y;
+}
+
+void quadtree_free(QuadTree *tree) {
+    free(tree->cells);
+    free(tree->next);
+    tree->cells = NULL;
+    tree->next = NULL;
+    tree->num_cells = 0;
+    tree->cell_capacity = 0;
+    tree->node_capacity = 0;
+}
@@ -0,0 +1,32 @@
+#ifndef QUADTREE_H
+#define QUADTREE_H
+
+#include "layout.h"
+
+#define QUADTREE_MAX_DEPTH 24 // Deeper cells just chain their nodes together
+
+// Quadtree cell; the four children of a cell are stored next to each other
+typedef struct {
+    float cx, cy;       // Centre of the cell
+    float half;         // Half of the cell's side length
+    float mass;         // Number of nodes inside the cell
+    float com_x, com_y; // Centre of mass
+    int child;          // Index of the first of four children, -1 for leaves
+    int first;          // First node of a leaf's chain, -1 if empty
+} QuadCell;
+
+// Barnes-Hut tree, rebuilt over the node positions on every iteration.
+// The buffers are kept between builds so rebuilding does not allocate.
+typedef struct {
+    QuadCell *cells;
+    int num_cells;
+    int cell_capacity;
+    int *next;          // Next node in the same leaf, -1 terminates
+    int node_capacity;
+} QuadTree;
+
+void quadtree_build(QuadTree *tree, const float *x, const float *y, int num_nodes);
+void quadtree_repulsion(const QuadTree *tree, const float *x, const float *y, int index, float theta, float *fx, float *fy);
+void quadtree_free(QuadTree *tree);
+
+#endif
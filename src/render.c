@@ -0,0 +1,389 @@
+#include "render.h"
+#include "profile.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+static const SDL_Color ink = {0x00, 0x00, 0x00, 0xFF}; // Nodes and edges are black
+
+ViewTransform view_transform(int cell_size, float grid_offset_x, float grid_offset_y) {
+    float scale = (float)cell_size / 50.0f;
+    ViewTransform view = {scale, grid_offset_x * (1.0f - scale), grid_offset_y * (1.0f - scale)};
+    return view;
+}
+
+int projection_update(Projection *projection, const float *x, const float *y, const float *z, int count) {
+    if (count > projection->capacity) {
+        int capacity = count + count / 2;
+        float *buffer = malloc((size_t)capacity * 2 * sizeof(float));
+        if (buffer == NULL) {
+            printf("Out of memory for the projection of %d nodes\n", count);
+            return -1;
+        }
+        free(projection->x);
+        projection->x = buffer;
+        projection->y = buffer + capacity;
+        projection->capacity = capacity;
+    }
+
+    const float cx = BOX_MARGIN + BOX_WIDTH * 0.5f, cy = BOX_MARGIN + BOX_HEIGHT * 0.5f, cz = BOX_MARGIN + BOX_DEPTH * 0.5f;
+    float cos_yaw = cosf(projection->yaw), sin_yaw = sinf(projection->yaw);
+    float cos_pitch = cosf(projection->pitch), sin_pitch = sinf(projection->pitch);
+    for (int i = 0; i < count; i++) {
+        float px = x[i] - cx, py = y[i] - cy, pz = z[i] - cz;
+        float depth = pz * cos_yaw - px * sin_yaw;
+        projection->x[i] = cx + px * cos_yaw + pz * sin_yaw;
+        projection->y[i] = cy + py * cos_pitch - depth * sin_pitch;
+    }
+    return 0;
+}
+
+void projection_free(Projection *projection) {
+    free(projection->x);
+    memset(projection, 0, sizeof(*projection));
+}
+
+// Filled disc of the given radius, the same pixels draw_circle used to plot.
+// White with alpha so the vertex colour tints it.
+static SDL_Texture *create_node_sprite(SDL_Renderer *renderer, int radius) {
+    int size = 2 * radius;
+    SDL_Surface *surface = SDL_CreateRGBSurfaceWithFormat(0, size, size, 32, SDL_PIXELFORMAT_RGBA32);
+    if (surface == NULL) {
+        return NULL;
+    }
+    for (int row = 0; row < size; row++) {
+        Uint8 *pixel = (Uint8 *)surface->pixels + row * surface->pitch;
+        int dy = row - radius + 1;
+        for (int column = 0; column < size; column++, pixel += 4) {
+            int dx = column - radius + 1;
+            pixel[0] = pixel[1] = pixel[2] = 0xFF;
+            pixel[3] = dx * dx + dy * dy <= radius * radius ? 0xFF : 0x00;
+        }
+    }
+    SDL_Texture *sprite = SDL_CreateTextureFromSurface(renderer, surface);
+    SDL_FreeSurface(surface);
+    if (sprite != NULL) {
+        SDL_SetTextureBlendMode(sprite, SDL_BLENDMODE_BLEND);
+    }
+    return sprite;
+}
+
+int graph_renderer_init(GraphRenderer *gr, SDL_Renderer *renderer, int node_radius, ThreadPool *pool) {
+    memset(gr, 0, sizeof(*gr));
+    gr->node_radius = node_radius;
+    gr->pool = pool;
+    gr->node_sprite = create_node_sprite(renderer, node_radius);
+    if (gr->node_sprite == NULL) {
+        printf("Cannot create the node sprite: %s\n", SDL_GetError());
+        return -1;
+    }
+    return 0;
+}
+
+static int reserve(GraphRenderer *gr, int num_quads) {
+    if (num_quads > gr->quad_capacity) {
+        SDL_Vertex *vertices = realloc(gr->vertices, (size_t)num_quads * 4 * sizeof(SDL_Vertex));
+        if (vertices == NULL) return -1;
+        gr->vertices = vertices;
+        int *indices = realloc(gr->indices, (size_t)num_quads * 6 * sizeof(int));
+        if (indices == NULL) return -1;
+        gr->indices = indices;
+
+        // Two triangles per quad of corners a, b, c, d: (a, b, c) and (c, b, d)
+        for (int q = gr->quad_capacity; q < num_quads; q++) {
+            int *index = indices + 6 * q;
+            index[0] = 4 * q;
+            index[1] = 4 * q + 1;
+            index[2] = 4 * q + 2;
+            index[3] = 4 * q + 2;
+            index[4] = 4 * q + 1;
+            index[5] = 4 * q + 3;
+        }
+        gr->quad_capacity = num_quads;
+    }
+    return 0;
+}
+
+static void set_vertex(SDL_Vertex *vertex, float x, float y, float u, float v) {
+    vertex->position.x = x;
+    vertex->position.y = y;
+    vertex->color = ink;
+    vertex->tex_coord.x = u;
+    vertex->tex_coord.y = v;
+}
+
+// Whole pixels, as the per-node int conversion did before
+static inline float to_screen(float world, float scale, float translate) {
+    return (float)(int)(world * scale + translate);
+}
+
+// Listed nodes whose circle fits inside the bounds, as one sprite batch
+static void draw_nodes(GraphRenderer *gr, SDL_Renderer *renderer, const float *x, const float *y,
+                       const int *nodes, int count, const ViewTransform *view, const SDL_Rect *bounds) {
+    float scale = view->scale, tx = view->translate_x, ty = view->translate_y;
+    float r = (float)gr->node_radius;
+    float left = bounds->x + r, right = bounds->x + bounds->w - 1 - r;
+    float top = bounds->y + r, bottom = bounds->y + bounds->h - 1 - r;
+
+    int quads = 0;
+    for (int k = 0; k < count; k++) {
+        float sx = to_screen(x[nodes[k]], scale, tx), sy = to_screen(y[nodes[k]], scale, ty);
+        if (sx < left || sx > right || sy < top || sy > bottom) {
+            continue; // Skip drawing the circle if it's outside the bounding box
+        }
+        float x0 = sx - r + 1, y0 = sy - r + 1;
+        SDL_Vertex *vertex = gr->vertices + 4 * quads++;
+        set_vertex(vertex + 0, x0, y0, 0, 0);
+        set_vertex(vertex + 1, x0 + 2 * r, y0, 1, 0);
+        set_vertex(vertex + 2, x0, y0 + 2 * r, 0, 1);
+        set_vertex(vertex + 3, x0 + 2 * r, y0 + 2 * r, 1, 1);
+    }
+    if (quads > 0) {
+        SDL_RenderGeometry(renderer, gr->node_sprite, gr->vertices, 4 * quads, gr->indices, 6 * quads);
+    }
+}
+
+// Listed edges as one pixel wide quads, widened across their minor axis and
+// cut to the bounds by the clip rect
+static void draw_edges(GraphRenderer *gr, SDL_Renderer *renderer, const float *x, const float *y, const Edge *edges,
+                       const int *visible, int count, const ViewTransform *view, const SDL_Rect *bounds) {
+    float scale = view->scale, tx = view->translate_x, ty = view->translate_y;
+
+    for (int k = 0; k < count; k++) {
+        Edge edge = edges[visible[k]];
+        float x1 = to_screen(x[edge.from], scale, tx), y1 = to_screen(y[edge.from], scale, ty);
+        float x2 = to_screen(x[edge.to], scale, tx), y2 = to_screen(y[edge.to], scale, ty);
+        float ox = 0.0f, oy = 0.5f;
+        float dx = x2 - x1, dy = y2 - y1;
+        if (dx * dx < dy * dy) {
+            ox = 0.5f;
+            oy = 0.0f;
+        }
+        SDL_Vertex *vertex = gr->vertices + 4 * k;
+        set_vertex(vertex + 0, x1 - ox, y1 - oy, 0, 0);
+        set_vertex(vertex + 1, x1 + ox, y1 + oy, 0, 0);
+        set_vertex(vertex + 2, x2 - ox, y2 - oy, 0, 0);
+        set_vertex(vertex + 3, x2 + ox, y2 + oy, 0, 0);
+    }
+    if (count > 0) {
+        SDL_RenderSetClipRect(renderer, bounds);
+        SDL_RenderGeometry(renderer, NULL, gr->vertices, 4 * count, gr->indices, 6 * count);
+        SDL_RenderSetClipRect(renderer, NULL);
+    }
+}
+
+// One density frame, shared by the threads of the pool. Each thread owns a
+// band of rows, so splatting needs no atomics and no reduction.
+typedef struct {
+    const GraphRenderer *gr;
+    const float *x, *y;
+    const Edge *edges;
+    const SpatialGrid *index;
+    ViewTransform view;
+    float origin_x, origin_y; // Screen position of density pixel (0, 0)
+    Uint32 *pixels;
+    int pitch;                // Bytes per texture row
+    float tone;               // 1 / log(1 + largest count)
+} DensityPass;
+
+static void band(const DensityPass *pass, int thread, int num_threads, int *begin, int *end) {
+    int height = pass->gr->density_height;
+    *begin = (int)((long long)height * thread / num_threads);
+    *end = (int)((long long)height * (thread + 1) / num_threads);
+}
+
+// Add 1 to every pixel the segment crosses within rows [row_begin, row_end).
+// Liang-Barsky clip to the band, then a DDA walk.
+static void splat_segment(unsigned int *density, int width, int row_begin, int row_end,
+                          float x1, float y1, float x2, float y2) {
+    float dx = x2 - x1, dy = y2 - y1;
+    float t0 = 0.0f, t1 = 1.0f;
+    float p[4] = {-dx, dx, -dy, dy};
+    float q[4] = {x1, (float)width - 0.001f - x1, y1 - (float)row_begin, (float)row_end - 0.001f - y1};
+    for (int k = 0; k < 4; k++) {
+        if (p[k] == 0.0f) {
+            if (q[k] < 0.0f) return;
+        } else {
+            float t = q[k] / p[k];
+            if (p[k] < 0.0f) {
+                if (t > t1) return;
+                if (t > t0) t0 = t;
+            } else {
+                if (t < t0) return;
+                if (t < t1) t1 = t;
+            }
+        }
+    }
+    float ax = x1 + t0 * dx, ay = y1 + t0 * dy;
+    float bx = x1 + t1 * dx, by = y1 + t1 * dy;
+    float span = fmaxf(fabsf(bx - ax), fabsf(by - ay));
+    int steps = (int)span + 1;
+    float sx = (bx - ax) / steps, sy = (by - ay) / steps;
+    for (int i = 0; i <= steps; i++) {
+        int px = (int)(ax + sx * i), py = (int)(ay + sy * i);
+        if (px >= 0 && px < width && py >= row_begin && py < row_end) {
+            density[(size_t)py * width + px]++;
+        }
+    }
+}
+
+static void splat_task(void *context, int thread, int num_threads) {
+    const DensityPass *pass = context;
+    const GraphRenderer *gr = pass->gr;
+    const SpatialGrid *index = pass->index;
+    int width = gr->density_width;
+    int row_begin, row_end;
+    band(pass, thread, num_threads, &row_begin, &row_end);
+    unsigned int *density = gr->density;
+    memset(density + (size_t)row_begin * width, 0, (size_t)(row_end - row_begin) * width * sizeof(unsigned int));
+
+    float scale = pass->view.scale;
+    float tx = pass->view.translate_x - pass->origin_x, ty = pass->view.translate_y - pass->origin_y;
+    for (int k = 0; k < index->num_visible_nodes; k++) {
+        int i = index->visible_nodes[k];
+        int px = (int)(pass->x[i] * scale + tx), py = (int)(pass->y[i] * scale + ty);
+        if (px >= 0 && px < width && py >= row_begin && py < row_end) {
+            density[(size_t)py * width + px] += LOD_NODE_WEIGHT;
+        }
+    }
+    for (int k = 0; k < index->num_visible_edges; k++) {
+        Edge edge = pass->edges[index->visible_edges[k]];
+        splat_segment(density, width, row_begin, row_end,
+                      pass->x[edge.from] * scale + tx, pass->y[edge.from] * scale + ty,
+                      pass->x[edge.to] * scale + tx, pass->y[edge.to] * scale + ty);
+    }
+
+    unsigned int largest = 0;
+    for (size_t p = (size_t)row_begin * width; p < (size_t)row_end * width; p++) {
+        if (density[p] > largest) largest = density[p];
+    }
+    gr->band_max[thread] = largest;
+}
+
+// Logarithmic tone map into black with alpha, so the grid shows through
+static void tone_map_task(void *context, int thread, int num_threads) {
+    const DensityPass *pass = context;
+    const GraphRenderer *gr = pass->gr;
+    int width = gr->density_width;
+    int row_begin, row_end;
+    band(pass, thread, num_threads, &row_begin, &row_end);
+    for (int row = row_begin; row < row_end; row++) {
+        const unsigned int *counts = gr->density + (size_t)row * width;
+        Uint32 *pixel = (Uint32 *)((Uint8 *)pass->pixels + (size_t)row * pass->pitch);
+        for (int column = 0; column < width; column++) {
+            float level = counts[column] > 0 ? logf(1.0f + (float)counts[column]) * pass->tone : 0.0f;
+            pixel[column] = (Uint32)(level * 255.0f + 0.5f) << 24;
+        }
+    }
+}
+
+static int reserve_density(GraphRenderer *gr, SDL_Renderer *renderer, int width, int height) {
+    if (gr->density_texture != NULL && gr->density_width == width && gr->density_height == height) {
+        return 0;
+    }
+    if (gr->density_texture != NULL) {
+        SDL_DestroyTexture(gr->density_texture);
+    }
+    free(gr->density);
+    free(gr->band_max);
+    gr->density = malloc((size_t)width * height * sizeof(unsigned int));
+    gr->band_max = malloc((size_t)threadpool_size(gr->pool) * sizeof(unsigned int));
+    gr->density_texture = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_STREAMING, width, height);
+    gr->density_width = width;
+    gr->density_height = height;
+    if (gr->density == NULL || gr->band_max == NULL || gr->density_texture == NULL) {
+        printf("Cannot create the density buffer: %s\n", SDL_GetError());
+        if (gr->density_texture != NULL) SDL_DestroyTexture(gr->density_texture);
+        gr->density_texture = NULL;
+        return -1;
+    }
+    SDL_SetTextureBlendMode(gr->density_texture, SDL_BLENDMODE_BLEND);
+    return 0;
+}
+
+// Splat the visible nodes and edges into per-pixel counts, tone-map them into
+// the streaming texture and draw it over the bounds
+static int draw_density(GraphRenderer *gr, SDL_Renderer *renderer, const float *x, const float *y, const Edge *edges,
+                        const ViewTransform *view, const SDL_Rect *bounds) {
+    if (reserve_density(gr, renderer, bounds->w, bounds->h) != 0) {
+        return -1;
+    }
+    DensityPass pass = {gr, x, y, edges, &gr->index, *view, (float)bounds->x, (float)bounds->y, NULL, 0, 0.0f};
+    threadpool_run(gr->pool, splat_task, &pass);
+
+    unsigned int largest = 0;
+    for (int t = 0; t < threadpool_size(gr->pool); t++) {
+        if (gr->band_max[t] > largest) largest = gr->band_max[t];
+    }
+    pass.tone = largest > 0 ? 1.0f / logf(1.0f + (float)largest) : 0.0f;
+
+    void *pixels;
+    if (SDL_LockTexture(gr->density_texture, NULL, &pixels, &pass.pitch) != 0) {
+        return -1;
+    }
+    pass.pixels = pixels;
+    threadpool_run(gr->pool, tone_map_task, &pass);
+    SDL_UnlockTexture(gr->density_texture);
+    SDL_RenderCopy(renderer, gr->density_texture, NULL, bounds);
+    return 0;
+}
+
+// Find what the bounds show, rebuilding the spatial index first if the nodes
+// moved, then submit the visible nodes and edges as one batch each
+void graph_renderer_draw(GraphRenderer *gr, SDL_Renderer *renderer, const float *x, const float *y, int num_nodes,
+                         const Edge *edges, int num_edges, int moved, const ViewTransform *view, const SDL_Rect *bounds) {
+    SpatialGrid *index = &gr->index;
+    if (moved || !gr->index_valid) {
+        double start = profile_begin();
+        gr->index_valid = spatial_build(index, x, y, num_nodes, edges, num_edges) == 0;
+        profile_end("index", start);
+        if (!gr->index_valid) return;
+    }
+
+    // The bounds in world space, one pixel wider for the rounding to whole pixels
+    float margin = 1.0f / view->scale;
+    float left = (bounds->x - view->translate_x) / view->scale - margin;
+    float right = (bounds->x + bounds->w - view->translate_x) / view->scale + margin;
+    float top = (bounds->y - view->translate_y) / view->scale - margin;
+    float bottom = (bounds->y + bounds->h - view->translate_y) / view->scale + margin;
+    spatial_query(index, x, y, edges, left, top, right, bottom);
+
+    // Switch level of detail with some hysteresis so it does not flicker
+    float density = (float)(index->num_visible_nodes + index->num_visible_edges) / ((float)bounds->w * bounds->h);
+    if (density > LOD_PRIMITIVES_PER_PIXEL) {
+        gr->density_mode = 1;
+    } else if (density < 0.5f * LOD_PRIMITIVES_PER_PIXEL) {
+        gr->density_mode = 0;
+    }
+    if (gr->density_mode) {
+        double start = profile_begin();
+        int drawn = draw_density(gr, renderer, x, y, edges, view, bounds);
+        profile_end("density", start);
+        if (drawn == 0) return;
+    }
+
+    int quads = index->num_visible_nodes > index->num_visible_edges ? index->num_visible_nodes : index->num_visible_edges;
+    if (reserve(gr, quads) != 0) {
+        printf("Out of memory for the render buffers\n");
+        return;
+    }
+    draw_nodes(gr, renderer, x, y, index->visible_nodes, index->num_visible_nodes, view, bounds);
+    draw_edges(gr, renderer, x, y, edges, index->visible_edges, index->num_visible_edges, view, bounds);
+}
+
+void graph_renderer_free(GraphRenderer *gr) {
+    if (gr->node_sprite != NULL) {
+        SDL_DestroyTexture(gr->node_sprite);
+    }
+    if (gr->density_texture != NULL) {
+        SDL_DestroyTexture(gr->density_texture);
+    }
+    free(gr->density);
+    free(gr->band_max);
+    spatial_free(&gr->index);
+    free(gr->vertices);
+    free(gr->indices);
+    memset(gr, 0, sizeof(*gr));
+}
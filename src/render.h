@@ -0,0 +1,65 @@
+#ifndef RENDER_H
+#define RENDER_H
+
+#include <SDL2/SDL.h>
+
+#include "layout.h"
+#include "spatial.h"
+#include "threadpool.h"
+
+// Level of detail: past this many visible nodes plus edges per pixel of the
+// bounds the graph is drawn as a density image, and below half of it again
+// node by node
+#define LOD_PRIMITIVES_PER_PIXEL 0.25f
+#define LOD_NODE_WEIGHT 4 // Density a node adds at its centre, an edge adds 1 per pixel
+
+// Grid zoom: screen = offset + (world - offset) * scale, folded into one
+// multiply-add per coordinate
+typedef struct {
+    float scale;
+    float translate_x, translate_y;
+} ViewTransform;
+
+// Orthographic view of a 3D layout: positions are turned about the centre of
+// the box by `yaw` (around the vertical axis), then `pitch`, and the depth is
+// dropped. The projected x/y are what the 2D drawing and picking work on.
+typedef struct {
+    float yaw, pitch; // Radians
+    float *x, *y;
+    int capacity;
+} Projection;
+
+// Batched node and edge drawing. Nodes are one circle sprite stamped with a
+// single SDL_RenderGeometry call, edges are one untextured geometry batch of
+// thin quads. Only what the spatial index finds in the view is transformed and
+// submitted. Vertex and index buffers are kept between frames.
+typedef struct {
+    SDL_Texture *node_sprite;
+    int node_radius;
+
+    SpatialGrid index;
+    int index_valid;
+
+    SDL_Vertex *vertices;
+    int *indices;               // Fixed quad pattern, 6 per quad
+    int quad_capacity;
+
+    // Density mode: per-pixel counts splatted by `pool`, tone-mapped into a
+    // streaming texture the size of the bounds
+    int density_mode;
+    ThreadPool *pool;
+    SDL_Texture *density_texture;
+    unsigned int *density;
+    unsigned int *band_max;     // Largest count per thread
+    int density_width, density_height;
+} GraphRenderer;
+
+ViewTransform view_transform(int cell_size, float grid_offset_x, float grid_offset_y);
+int projection_update(Projection *projection, const float *x, const float *y, const float *z, int count);
+void projection_free(Projection *projection);
+int graph_renderer_init(GraphRenderer *gr, SDL_Renderer *renderer, int node_radius, ThreadPool *pool);
+void graph_renderer_draw(GraphRenderer *gr, SDL_Renderer *renderer, const float *x, const float *y, int num_nodes,
+                         const Edge *edges, int num_edges, int moved, const ViewTransform *view, const SDL_Rect *bounds);
+void graph_renderer_free(GraphRenderer *gr);
+
+#endif
@@ -0,0 +1,300 @@
+#include "reorder.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#define SMALL_SORT 32 // Insertion sort below this many keys
+
+static const char *reorder_names[REORDER_COUNT] = {
+    "none", "rcm", "hilbert"
+};
+
+const char *reorder_name(ReorderKind kind) {
+    return kind >= 0 && kind < REORDER_COUNT ? reorder_names[kind] : "unknown";
+}
+
+int reorder_from_name(const char *name) {
+    for (int kind = 0; kind < REORDER_COUNT; kind++) {
+        if (strcmp(name, reorder_names[kind]) == 0) return kind;
+    }
+    return -1;
+}
+
+// Stable sort on the upper 32 bits of the keys, which carry the sort key over
+// a node id. Byte-wise LSD radix, skipping bytes that are the same everywhere.
+static void sort_keys(uint64_t *keys, uint64_t *scratch, int count) {
+    if (count <= SMALL_SORT) {
+        for (int i = 1; i < count; i++) {
+            uint64_t key = keys[i];
+            int j = i;
+            while (j > 0 && (keys[j - 1] >> 32) > (key >> 32)) {
+                keys[j] = keys[j - 1];
+                j--;
+            }
+            keys[j] = key;
+        }
+        return;
+    }
+    uint64_t *from = keys, *to = scratch;
+    for (int shift = 32; shift < 64; shift += 8) {
+        int histogram[257] = {0};
+        for (int i = 0; i < count; i++) {
+            histogram[((from[i] >> shift) & 255) + 1]++;
+        }
+        int trivial = 0;
+        for (int b = 1; b <= 256; b++) {
+            trivial |= histogram[b] == count;
+            histogram[b] += histogram[b - 1];
+        }
+        if (trivial) continue;
+        for (int i = 0; i < count; i++) {
+            to[histogram[(from[i] >> shift) & 255]++] = from[i];
+        }
+        uint64_t *swap = from;
+        from = to;
+        to = swap;
+    }
+    if (from != keys) {
+        memcpy(keys, from, (size_t)count * sizeof(uint64_t));
+    }
+}
+
+static int degree(const Graph *graph, int v) {
+    return graph->offsets[v + 1] - graph->offsets[v];
+}
+
+static uint64_t degree_key(const Graph *graph, int v) {
+    return (uint64_t)degree(graph, v) << 32 | (uint32_t)v;
+}
+
+// Breadth-first over the unplaced nodes reachable from `source`, using
+// queue as scratch; returns the least connected node of the last level, a
+// cheap stand-in for a node of maximum eccentricity
+static int peripheral_node(const Graph *graph, int source, const unsigned char *placed, int *mark, int stamp,
+                           int *queue) {
+    int head = 0, tail = 0, level_begin = 0;
+    queue[tail++] = source;
+    mark[source] = stamp;
+    while (head < tail) {
+        int level_end = tail;
+        level_begin = head;
+        while (head < level_end) {
+            int v = queue[head++];
+            for (int k = graph->offsets[v]; k < graph->offsets[v + 1]; k++) {
+                int u = graph->adjacency[k];
+                if (!placed[u] && mark[u] != stamp) {
+                    mark[u] = stamp;
+                    queue[tail++] = u;
+                }
+            }
+        }
+    }
+    int best = queue[level_begin];
+    for (int i = level_begin + 1; i < tail; i++) {
+        if (degree(graph, queue[i]) < degree(graph, best)) best = queue[i];
+    }
+    return best;
+}
+
+// Cuthill-McKee numbers each component breadth-first from a peripheral node,
+// visiting the neighbours of a node in increasing degree, which keeps the
+// ends of every edge within about one BFS level of each other; reversing the
+// whole sequence narrows the profile further
+int reorder_rcm(const Graph *graph, int *order) {
+    int n = graph->num_nodes;
+    uint64_t *keys = malloc((size_t)(n > 0 ? n : 1) * sizeof(uint64_t));
+    uint64_t *scratch = malloc((size_t)(n > 0 ? n : 1) * sizeof(uint64_t));
+    int *by_degree = malloc((size_t)(n > 0 ? n : 1) * sizeof(int));
+    int *mark = calloc((size_t)(n > 0 ? n : 1), sizeof(int));
+    unsigned char *placed = calloc((size_t)(n > 0 ? n : 1), 1);
+    if (keys == NULL || scratch == NULL || by_degree == NULL || mark == NULL || placed == NULL) {
+        printf("reorder: out of memory (%d nodes)\n", n);
+        free(keys);
+        free(scratch);
+        free(by_degree);
+        free(mark);
+        free(placed);
+        return -1;
+    }
+
+    // Components start from their least connected node
+    for (int v = 0; v < n; v++) {
+        keys[v] = degree_key(graph, v);
+    }
+    sort_keys(keys, scratch, n);
+    for (int v = 0; v < n; v++) {
+        by_degree[v] = (int)(uint32_t)keys[v];
+    }
+
+    int tail = 0, stamp = 0;
+    for (int c = 0; c < n; c++) {
+        if (placed[by_degree[c]]) continue;
+        int head = tail;
+        int start = peripheral_node(graph, by_degree[c], placed, mark, ++stamp, order + tail);
+        order[tail++] = start;
+        placed[start] = 1;
+        while (head < tail) {
+            int v = order[head++];
+            int first = tail;
+            for (int k = graph->offsets[v]; k < graph->offsets[v + 1]; k++) {
+                int u = graph->adjacency[k];
+                if (!placed[u]) {
+                    placed[u] = 1;
+                    keys[tail - first] = degree_key(graph, u);
+                    order[tail++] = u;
+                }
+            }
+            sort_keys(keys, scratch, tail - first);
+            for (int i = first; i < tail; i++) {
+                order[i] = (int)(uint32_t)keys[i - first];
+            }
+        }
+    }
+    for (int i = 0, j = n - 1; i < j; i++, j--) {
+        int swap = order[i];
+        order[i] = order[j];
+        order[j] = swap;
+    }
+
+    free(keys);
+    free(scratch);
+    free(by_degree);
+    free(mark);
+    free(placed);
+    return 0;
+}
+
+// Distance along the Hilbert curve of a cell of the 2^REORDER_HILBERT_BITS
+// square grid. Each level picks a quadrant and rotates the rest into its frame;
+// flipping all bits mirrors the lower ones, the only ones still read.
+static uint32_t hilbert_key(uint32_t x, uint32_t y) {
+    uint32_t d = 0;
+    for (uint32_t s = 1u << (REORDER_HILBERT_BITS - 1); s > 0; s >>= 1) {
+        uint32_t rx = (x & s) != 0, ry = (y & s) != 0;
+        d += s * s * ((3 * rx) ^ ry);
+        if (ry == 0) {
+            if (rx == 1) {
+                x = ~x;
+                y = ~y;
+            }
+            uint32_t swap = x;
+            x = y;
+            y = swap;
+        }
+    }
+    return d;
+}
+
+int reorder_hilbert(const float *x, const float *y, int count, int *order) {
+    uint64_t *keys = malloc((size_t)(count > 0 ? count : 1) * sizeof(uint64_t));
+    uint64_t *scratch = malloc((size_t)(count > 0 ? count : 1) * sizeof(uint64_t));
+    if (keys == NULL || scratch == NULL) {
+        printf("reorder: out of memory (%d nodes)\n", count);
+        free(keys);
+        free(scratch);
+        return -1;
+    }
+    float min_x = 0.0f, min_y = 0.0f, max_x = 0.0f, max_y = 0.0f;
+    for (int i = 0; i < count; i++) {
+        if (i == 0 || x[i] < min_x) min_x = x[i];
+        if (i == 0 || x[i] > max_x) max_x = x[i];
+        if (i == 0 || y[i] < min_y) min_y = y[i];
+        if (i == 0 || y[i] > max_y) max_y = y[i];
+    }
+    float extent = max_x - min_x > max_y - min_y ? max_x - min_x : max_y - min_y;
+    float cells = (float)((1u << REORDER_HILBERT_BITS) - 1);
+    float scale = extent > 0.0f ? cells / extent : 0.0f;
+    for (int i = 0; i < count; i++) {
+        uint32_t cx = (uint32_t)((x[i] - min_x) * scale);
+        uint32_t cy = (uint32_t)((y[i] - min_y) * scale);
+        keys[i] = (uint64_t)hilbert_key(cx, cy) << 32 | (uint32_t)i;
+    }
+    sort_keys(keys, scratch, count);
+    for (int i = 0; i < count; i++) {
+        order[i] = (int)(uint32_t)keys[i];
+    }
+    free(keys);
+    free(scratch);
+    return 0;
+}
+
+int reorder_init(Reordering *reordering, int count) {
+    memset(reordering, 0, sizeof(*reordering));
+    reordering->original = malloc((size_t)(count > 0 ? count : 1) * sizeof(int));
+    reordering->order = malloc((size_t)(count > 0 ? count : 1) * sizeof(int));
+    if (reordering->original == NULL || reordering->order == NULL) {
+        printf("reorder: out of memory (%d nodes)\n", count);
+        reorder_free(reordering);
+        return -1;
+    }
+    reordering->count = count;
+    for (int i = 0; i < count; i++) {
+        reordering->original[i] = i;
+    }
+    return 0;
+}
+
+// Renumber by reordering->order and carry the loaded ids along
+static int permute(Reordering *reordering, Graph *graph, Nodes *nodes) {
+    int *order = reordering->order;
+    if (graph_renumber(graph, order) != 0 || nodes_permute(nodes, order) != 0) {
+        return -1;
+    }
+    for (int i = 0; i < reordering->count; i++) {
+        order[i] = reordering->original[order[i]];
+    }
+    reordering->order = reordering->original;
+    reordering->original = order;
+    reordering->applied++;
+    return 0;
+}
+
+int reorder_apply(Reordering *reordering, ReorderKind kind, Graph *graph, Nodes *nodes) {
+    if (kind == REORDER_NONE) return 0;
+    double start = layout_seconds();
+    int result = kind == REORDER_RCM ? reorder_rcm(graph, reordering->order)
+                                     : reorder_hilbert(nodes->x, nodes->y, nodes->count, reordering->order);
+    if (result == 0) {
+        result = permute(reordering, graph, nodes);
+    }
+    reordering->seconds += layout_seconds() - start;
+    return result;
+}
+
+const int *reorder_current(Reordering *reordering) {
+    if (reordering->original == NULL) return NULL;
+    for (int i = 0; i < reordering->count; i++) {
+        reordering->order[reordering->original[i]] = i;
+    }
+    return reordering->order;
+}
+
+int reorder_restore(Reordering *reordering, Graph *graph, Nodes *nodes) {
+    if (reordering->original == NULL) return 0;
+    int identity = 1;
+    for (int i = 0; i < reordering->count && identity; i++) {
+        identity = reordering->original[i] == i;
+    }
+    if (identity) return 0;
+    reorder_current(reordering);
+    double start = layout_seconds();
+    int result = permute(reordering, graph, nodes);
+    reordering->seconds += layout_seconds() - start;
+    return result;
+}
+
+void reorder_free(Reordering *reordering) {
+    free(reordering->original);
+    free(reordering->order);
+    memset(reordering, 0, sizeof(*reordering));
+}
+
+double reorder_edge_span(const Graph *graph) {
+    double span = 0.0;
+    for (int e = 0; e < graph->num_edges; e++) {
+        span += graph->edges[e].to - graph->edges[e].from;
+    }
+    return graph->num_edges > 0 ? span / graph->num_edges : 0.0;
+}
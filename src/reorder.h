@@ -0,0 +1,48 @@
+#ifndef REORDER_H
+#define REORDER_H
+
+#include "layout.h"
+#include "graph.h"
+
+#define REORDER_HILBERT_BITS 16 // Hilbert curve resolution, 2^bits cells per axis
+#define REORDER_RESORT_EVERY 50 // Default iterations between Hilbert re-sorts of a reordered layout
+
+// Node numberings for memory locality. The force passes read positions by
+// node id, so ids that follow the graph or the layout turn the scattered
+// reads of the attraction pass and the Barnes-Hut walks into nearby ones.
+typedef enum {
+    REORDER_NONE,    // Ids as loaded
+    REORDER_RCM,     // Reverse Cuthill-McKee: breadth-first from a peripheral node, neighbours get close ids
+    REORDER_HILBERT, // Along a Hilbert curve through the positions (x and y only in 3D)
+    REORDER_COUNT
+} ReorderKind;
+
+// Where a renumbered graph and layout stand against the loaded ids
+typedef struct {
+    int count;
+    int *original; // Loaded id of each node
+    int *order;    // Scratch for the next permutation
+    int applied;   // Permutations since reorder_init
+    double seconds;
+} Reordering;
+
+const char *reorder_name(ReorderKind kind);
+int reorder_from_name(const char *name); // -1 if unknown
+
+// New order of the nodes, order[i] being the node to put at index i
+int reorder_rcm(const Graph *graph, int *order);
+int reorder_hilbert(const float *x, const float *y, int count, int *order);
+
+// Renumber the graph and the layout together and keep track of the loaded
+// ids; reorder_restore puts them back so output, edits and checkpoints see
+// the original numbering. REORDER_NONE only starts the tracking.
+int reorder_init(Reordering *reordering, int count);
+int reorder_apply(Reordering *reordering, ReorderKind kind, Graph *graph, Nodes *nodes);
+int reorder_restore(Reordering *reordering, Graph *graph, Nodes *nodes);
+const int *reorder_current(Reordering *reordering); // Index of each loaded id, NULL before reorder_init; valid until the next call
+void reorder_free(Reordering *reordering);
+
+// Mean id distance between the ends of an edge, lower is more local
+double reorder_edge_span(const Graph *graph);
+
+#endif
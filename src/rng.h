@@ -0,0 +1,34 @@
+#ifndef RNG_H
+#define RNG_H
+
+#include <stdint.h>
+
+// Small splitmix64 generator. Unlike rand() the state is explicit, so runs are
+// reproducible across platforms and the state can be saved and restored.
+typedef struct {
+    uint64_t state;
+} Rng;
+
+static inline void rng_seed(Rng *rng, uint64_t seed) {
+    rng->state = seed;
+}
+
+static inline uint64_t rng_next(Rng *rng) {
+    uint64_t z = (rng->state += 0x9E3779B97F4A7C15ull);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+    return z ^ (z >> 31);
+}
+
+// Integer in [0, bound), bound > 0. The modulo bias is negligible for the
+// bounds used here (well below 2^32).
+static inline uint64_t rng_below(Rng *rng, uint64_t bound) {
+    return rng_next(rng) % bound;
+}
+
+// Uniform float in [0, 1)
+static inline float rng_float(Rng *rng) {
+    return (float)(rng_next(rng) >> 40) * (1.0f / 16777216.0f);
+}
+
+#endif
@@ -0,0 +1,577 @@
+#include "simulation.h"
+#include "profile.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define RESTART_TEMPERATURE 50.0f // Temperature after "Generate Nodes" with random placement
+
+// Function to save the current node state
+static void save_node_state(Simulation *sim, int iteration) {
+    history_record(&sim->history, iteration, sim->nodes.x, sim->nodes.y, sim->nodes.z);
+}
+
+// Function to restore the node state from a specific iteration. Frames the
+// history no longer holds are recomputed from the nearest earlier one, which
+// repeats the original run as long as the settings are unchanged.
+static void restore_node_state(Simulation *sim, int iteration) {
+    int saved = history_restore(&sim->history, iteration, sim->nodes.x, sim->nodes.y, sim->nodes.z);
+    if (saved < 0) {
+        return;
+    }
+    // Stillness counters restart, so with freezing on the replay is approximate
+    memset(sim->nodes.still, 0, (size_t)sim->nodes.count);
+    for (int i = saved; i < iteration; i++) {
+        calculate_forces(&sim->nodes, sim->graph->edges, sim->graph->num_edges, sim->cooling_log[i].temperature, i, &sim->settings);
+    }
+    sim->cooling = sim->cooling_log[iteration];
+}
+
+// Make room in a snapshot slot for the current graph. The back slot belongs
+// to the simulation thread, so it can be reallocated freely.
+static int fit_snapshot(Snapshot *s, int num_nodes, int dimensions, int num_edges) {
+    if (num_nodes > s->node_capacity) {
+        int capacity = num_nodes + num_nodes / 2;
+        float *x = malloc((size_t)capacity * dimensions * sizeof(float));
+        if (x == NULL) return -1;
+        free(s->x);
+        s->x = x;
+        s->y = x + capacity;
+        s->z = dimensions == 3 ? x + 2 * (size_t)capacity : NULL;
+        s->node_capacity = capacity;
+    }
+    if (num_edges > s->edge_capacity) {
+        int capacity = num_edges + num_edges / 2;
+        Edge *edges = realloc(s->edges, (size_t)capacity * sizeof(Edge));
+        if (edges == NULL) return -1;
+        s->edges = edges;
+        s->edge_capacity = capacity;
+    }
+    return 0;
+}
+
+// Copy the positions into the back slot and hand it to the reader
+static void publish(Simulation *sim) {
+    TripleBuffer *tb = &sim->snapshots;
+    Snapshot *s = &tb->slots[tb->back];
+    if (fit_snapshot(s, sim->nodes.count, sim->nodes.dimensions, sim->graph->num_edges) != 0) {
+        printf("Out of memory for a snapshot of %d nodes\n", sim->nodes.count);
+        exit(1);
+    }
+    memcpy(s->x, sim->nodes.x, (size_t)sim->nodes.count * sizeof(float));
+    memcpy(s->y, sim->nodes.y, (size_t)sim->nodes.count * sizeof(float));
+    if (s->z != NULL) {
+        memcpy(s->z, sim->nodes.z, (size_t)sim->nodes.count * sizeof(float));
+    }
+    s->num_nodes = sim->nodes.count;
+    if (s->graph_version != sim->graph_version) {
+        memcpy(s->edges, sim->graph->edges, (size_t)sim->graph->num_edges * sizeof(Edge));
+        s->num_edges = sim->graph->num_edges;
+        s->graph_version = sim->graph_version;
+    }
+    s->iteration = sim->iteration;
+    s->playing = sim->playing;
+    s->temperature = sim->cooling.temperature;
+
+    int previous = atomic_exchange_explicit(&tb->middle, tb->back | SNAPSHOT_FRESH, memory_order_acq_rel);
+    tb->back = previous & ~SNAPSHOT_FRESH;
+    if (sim->published != NULL) {
+        sim->published(sim->published_context);
+    }
+}
+
+// Newest finished snapshot; if fresh is not NULL it is set when the snapshot
+// differs from the one returned by the previous call
+const Snapshot *simulation_snapshot(Simulation *sim, int *fresh) {
+    TripleBuffer *tb = &sim->snapshots;
+    int swapped = 0;
+    if (atomic_load_explicit(&tb->middle, memory_order_acquire) & SNAPSHOT_FRESH) {
+        int previous = atomic_exchange_explicit(&tb->middle, tb->front, memory_order_acq_rel);
+        tb->front = previous & ~SNAPSHOT_FRESH;
+        swapped = 1;
+    }
+    if (fresh != NULL) {
+        *fresh = swapped;
+    }
+    return &tb->slots[tb->front];
+}
+
+// Print the active repulsion kernel and, for Barnes-Hut, its error against the exact kernel
+static void report_repulsion(const Simulation *sim) {
+    if (sim->nodes.dimensions == 3) {
+        printf("Repulsion: exact, Barnes-Hut is 2D only\n");
+        return;
+    }
+    if (sim->settings.repulsion == REPULSION_EXACT) {
+        printf("Repulsion: exact\n");
+        return;
+    }
+    float error = barnes_hut_force_error(&sim->nodes, sim->settings.theta);
+    printf("Repulsion: Barnes-Hut, theta = %.1f, force error = %.3f%%\n", sim->settings.theta, error * 100.0f);
+}
+
+static void save_checkpoint(const Simulation *sim) {
+    double start = profile_begin();
+    if (checkpoint_write(sim->checkpoint_path, sim->graph, &sim->nodes, &sim->cooling, sim->iteration, sim->rng.state) == 0) {
+        printf("Checkpoint: %s at iteration %d\n", sim->checkpoint_path, sim->iteration);
+    }
+    profile_end("checkpoint", start);
+}
+
+static void step(Simulation *sim) {
+    double start = profile_begin();
+    sim->cooling_log[sim->iteration] = sim->cooling;
+    ForceStats stats = calculate_forces(&sim->nodes, sim->graph->edges, sim->graph->num_edges, sim->cooling.temperature,
+                                        sim->iteration, &sim->settings);
+    cooling_update(&sim->cooling, &stats);
+    sim->iteration += 1;
+    save_node_state(sim, sim->iteration); // Save the node state after each calculation
+    if (sim->iteration >= sim->max_iterations - 1) {
+        sim->playing = 0;
+    } else if (sim->playing && layout_converged(&stats, sim->nodes.count, CONVERGENCE_TOLERANCE)) {
+        printf("Converged after %d iterations\n", sim->iteration);
+        sim->playing = 0;
+    }
+    publish(sim);
+    profile_end("iteration", start);
+    if (sim->capture != NULL) {
+        capture_frame(sim->capture, sim->iteration, sim->nodes.x, sim->nodes.y, sim->nodes.count, sim->graph->edges,
+                      sim->graph->num_edges);
+    }
+    if (sim->checkpoint_every > 0 && sim->iteration % sim->checkpoint_every == 0) {
+        save_checkpoint(sim);
+    }
+}
+
+// Apply one graph edit, then relax the neighbourhood of the touched nodes at
+// low temperature. Positions saved for stepping back have the old node count,
+// so the history restarts at the current iteration.
+static void edit(Simulation *sim, const SimCommand *command) {
+    Graph *graph = sim->graph;
+    IncrementalStats stats;
+    int changed = 0;
+    if (command->type == SIM_ADD_NODE) {
+        int linked = command->node >= 0 && command->node < graph->num_nodes;
+        changed = incremental_add_node(&sim->incremental, graph, &sim->nodes, &command->node, linked, &sim->rng, &stats) >= 0;
+    } else if (command->type == SIM_REMOVE_NODE) {
+        changed = incremental_remove_node(&sim->incremental, graph, &sim->nodes, command->node, &stats) > 0;
+    } else if (graph_has_edge(graph, command->node, command->other)) {
+        changed = incremental_remove_edge(&sim->incremental, graph, &sim->nodes, command->node, command->other, &stats) > 0;
+    } else {
+        changed = incremental_add_edge(&sim->incremental, graph, &sim->nodes, command->node, command->other, &stats) > 0;
+    }
+    if (!changed) {
+        return;
+    }
+    printf("Edit: %d nodes, %d edges; relaxed %d nodes in %d iterations, %.2f ms\n",
+           graph->num_nodes, graph->num_edges, stats.active, stats.iterations, stats.seconds * 1000.0);
+    sim->graph_version++;
+
+    size_t budget = sim->history.budget;
+    history_free(&sim->history);
+    if (history_init(&sim->history, graph->num_nodes, sim->nodes.dimensions, budget) == 0) {
+        save_node_state(sim, sim->iteration);
+    }
+    sim->first_iteration = sim->iteration;
+    publish(sim);
+}
+
+static void execute(Simulation *sim, const SimCommand *command) {
+    switch (command->type) {
+        case SIM_TOGGLE_PLAY:
+            sim->playing = !sim->playing && sim->iteration < sim->max_iterations - 1;
+            publish(sim);
+            break;
+        case SIM_STEP_FORWARD:
+            for (int s = 0; s < (int)command->value && !sim->playing && sim->iteration < sim->max_iterations - 1; s++) {
+                step(sim);
+            }
+            break;
+        case SIM_STEP_BACK:
+            // Not past the start or the last edit
+            for (int s = 0; s < (int)command->value && !sim->playing && sim->iteration > sim->first_iteration; s++) {
+                sim->iteration -= 1;
+                restore_node_state(sim, sim->iteration);
+                publish(sim);
+            }
+            break;
+        case SIM_REGENERATE:
+            place_nodes(&sim->nodes, sim->graph, sim->placement, rng_next(&sim->rng), &sim->settings); // Generate new nodes
+            sim->iteration = 0;
+            sim->first_iteration = 0;
+            cooling_init(&sim->cooling, SCHEDULE_ADAPTIVE,
+                         sim->placement == PLACEMENT_RANDOM ? RESTART_TEMPERATURE : placement_temperature(sim->placement),
+                         COOLING_FACTOR);
+            sim->playing = 0; // Stop auto-play if active
+            history_clear(&sim->history);
+            save_node_state(sim, 0);
+            publish(sim);
+            break;
+        case SIM_TOGGLE_BARNES_HUT:
+            sim->settings.repulsion = sim->settings.repulsion == REPULSION_EXACT ? REPULSION_BARNES_HUT : REPULSION_EXACT;
+            report_repulsion(sim);
+            break;
+        case SIM_ADJUST_THETA:
+            sim->settings.theta = clamp(sim->settings.theta + command->value, 0.0f, 2.0f);
+            report_repulsion(sim);
+            break;
+        case SIM_SCALE_TEMPERATURE:
+            sim->cooling.temperature *= command->value;
+            printf("Temperature: %.2f\n", sim->cooling.temperature);
+            publish(sim);
+            break;
+        case SIM_ADD_NODE:
+        case SIM_REMOVE_NODE:
+        case SIM_TOGGLE_EDGE:
+            if (sim->nodes.dimensions == 3) {
+                printf("Graph edits are only supported in 2D\n");
+            } else {
+                edit(sim, command);
+            }
+            break;
+        case SIM_CHECKPOINT:
+            if (sim->checkpoint_path != NULL) {
+                save_checkpoint(sim);
+            }
+            break;
+        case SIM_QUIT:
+            break;
+    }
+}
+
+static int can_step(const Simulation *sim) {
+    return sim->playing && sim->iteration < sim->max_iterations - 1;
+}
+
+static void *simulation_main(void *arg) {
+    Simulation *sim = arg;
+    struct timespec next_step = {0, 0};
+    profile_thread_name("simulation");
+
+    for (;;) {
+        SimCommand command;
+        int have_command = 0;
+
+        // Sleep until there is a command, or a step is due
+        pthread_mutex_lock(&sim->lock);
+        while (sim->queue_count == 0 && !atomic_load(&sim->quitting)) {
+            if (!can_step(sim)) {
+                pthread_cond_wait(&sim->wake, &sim->lock);
+                continue;
+            }
+            if (sim->iterations_per_second > 0) {
+                struct timespec now;
+                clock_gettime(CLOCK_REALTIME, &now);
+                if (now.tv_sec < next_step.tv_sec || (now.tv_sec == next_step.tv_sec && now.tv_nsec < next_step.tv_nsec)) {
+                    pthread_cond_timedwait(&sim->wake, &sim->lock, &next_step);
+                    continue;
+                }
+            }
+            break;
+        }
+        if (atomic_load(&sim->quitting)) {
+            pthread_mutex_unlock(&sim->lock);
+            break;
+        }
+        if (sim->queue_count > 0) {
+            command = sim->queue[sim->queue_head];
+            sim->queue_head = (sim->queue_head + 1) % SIMULATION_QUEUE_SIZE;
+            sim->queue_count--;
+            have_command = 1;
+        }
+        pthread_mutex_unlock(&sim->lock);
+
+        if (have_command) {
+            if (command.type == SIM_QUIT) break;
+            execute(sim, &command);
+            continue;
+        }
+
+        step(sim);
+        if (sim->iterations_per_second > 0) {
+            clock_gettime(CLOCK_REALTIME, &next_step);
+            long nsec = next_step.tv_nsec + 1000000000L / sim->iterations_per_second;
+            next_step.tv_sec += nsec / 1000000000L;
+            next_step.tv_nsec = nsec % 1000000000L;
+        }
+    }
+    return NULL;
+}
+
+// Allocate the layout state, place the nodes or restore them from a
+// checkpoint and start the thread
+int simulation_start(Simulation *sim, Graph *graph, const ForceSettings *settings, const SimulationOptions *options) {
+    memset(sim, 0, sizeof(*sim));
+    atomic_init(&sim->quitting, 0);
+    const Checkpoint *resume = options->resume;
+    int dimensions = resume != NULL ? resume->dimensions : options->dimensions;
+    int max_iterations = options->max_iterations + (resume != NULL ? resume->iteration : 0);
+    sim->graph = graph;
+    sim->settings = *settings;
+    cooling_init(&sim->cooling, SCHEDULE_ADAPTIVE, placement_temperature(options->placement), COOLING_FACTOR);
+    sim->max_iterations = max_iterations;
+    sim->iterations_per_second = options->iterations_per_second;
+    sim->placement = options->placement;
+    sim->checkpoint_path = options->checkpoint_path;
+    sim->checkpoint_every = options->checkpoint_path != NULL ? options->checkpoint_every : 0;
+    sim->capture = options->capture;
+    sim->published = options->published;
+    sim->published_context = options->published_context;
+
+    int n = graph->num_nodes;
+    int allocated = resume != NULL ? checkpoint_restore(resume, &sim->nodes) : nodes_alloc_dimensions(&sim->nodes, n, dimensions);
+    if (allocated != 0) {
+        return -1;
+    }
+    int ok = history_init(&sim->history, n, dimensions, options->history_budget) == 0;
+    sim->cooling_log = malloc((size_t)(max_iterations > 0 ? max_iterations : 1) * sizeof(Cooling));
+    ok = ok && sim->cooling_log != NULL;
+    sim->settings.workspace = force_workspace_create();
+    ok = ok && sim->settings.workspace != NULL;
+    for (int i = 0; i < 3 && ok; i++) {
+        ok = fit_snapshot(&sim->snapshots.slots[i], n, dimensions, graph->num_edges) == 0;
+    }
+    if (!ok) {
+        printf("Out of memory for %d nodes\n", n);
+        simulation_stop(sim);
+        return -1;
+    }
+
+    sim->snapshots.front = 0;
+    atomic_init(&sim->snapshots.middle, 1);
+    sim->snapshots.back = 2;
+
+    sim->graph_version = 1;
+    if (resume != NULL) {
+        sim->cooling = resume->cooling;
+        sim->iteration = resume->iteration;
+        sim->first_iteration = sim->iteration; // Nothing before the checkpoint to step back to
+        sim->rng.state = resume->rng_state;
+    } else {
+        rng_seed(&sim->rng, options->seed);
+        place_nodes(&sim->nodes, graph, options->placement, options->seed, &sim->settings);
+    }
+    if (history_record(&sim->history, sim->iteration, sim->nodes.x, sim->nodes.y, sim->nodes.z) != 0) { // Save the initial state
+        simulation_stop(sim);
+        return -1;
+    }
+    publish(sim);
+    if (sim->capture != NULL) {
+        capture_frame(sim->capture, sim->iteration, sim->nodes.x, sim->nodes.y, n, graph->edges, graph->num_edges);
+    }
+
+    pthread_mutex_init(&sim->lock, NULL);
+    pthread_cond_init(&sim->wake, NULL);
+    if (pthread_create(&sim->thread, NULL, simulation_main, sim) != 0) {
+        printf("Cannot start the simulation thread\n");
+        pthread_mutex_destroy(&sim->lock);
+        pthread_cond_destroy(&sim->wake);
+        simulation_stop(sim);
+        return -1;
+    }
+    sim->running = 1;
+    return 0;
+}
+
+// Bring the graph and positions up to date with the stream and publish them
+static int remote_update(Simulation *sim) {
+    StreamClient *remote = &sim->remote;
+    if (remote->graph_changed) {
+        Edge *edges = malloc(((size_t)remote->num_edges + 1) * sizeof(Edge));
+        if (edges == NULL) {
+            printf("Out of memory for %d edges\n", remote->num_edges);
+            return -1;
+        }
+        memcpy(edges, remote->edges, (size_t)remote->num_edges * sizeof(Edge));
+        graph_free(sim->graph);
+        nodes_free(&sim->nodes);
+        if (graph_build(sim->graph, edges, remote->num_edges, remote->num_nodes) != 0 ||
+            nodes_alloc_dimensions(&sim->nodes, remote->num_nodes, remote->dimensions) != 0) {
+            return -1;
+        }
+        sim->graph_version++;
+        remote->graph_changed = 0;
+    }
+    size_t n = (size_t)remote->num_nodes;
+    float *axes[3] = {sim->nodes.x, sim->nodes.y, sim->nodes.z};
+    for (int a = 0; a < remote->dimensions; a++) {
+        memcpy(axes[a], remote->positions + a * n, n * sizeof(float));
+    }
+    sim->iteration = remote->iteration;
+    sim->playing = (remote->flags & STREAM_PLAYING) != 0;
+    sim->cooling.temperature = remote->temperature;
+    publish(sim);
+    if (sim->capture != NULL) {
+        capture_frame(sim->capture, sim->iteration, sim->nodes.x, sim->nodes.y, sim->nodes.count, sim->graph->edges,
+                      sim->graph->num_edges);
+    }
+    return 0;
+}
+
+static void *remote_main(void *arg) {
+    Simulation *sim = arg;
+    profile_thread_name("stream");
+    for (;;) {
+        int frames = stream_receive(&sim->remote, -1);
+        if (frames < 0 || (frames > 0 && remote_update(sim) != 0)) break;
+        // Mean latency shows in the HUD, and every frame counts as an iteration
+        double now = profile_begin();
+        if (frames > 0) {
+            profile_record("latency", now - sim->remote.latency, now);
+        }
+        for (int f = 0; f < frames; f++) {
+            profile_record("iteration", now, now);
+        }
+    }
+    if (!atomic_load(&sim->closing)) {
+        printf("The stream server closed the connection\n");
+    }
+    return NULL;
+}
+
+int simulation_connect(Simulation *sim, const char *address, Graph *graph, const SimulationOptions *options) {
+    memset(sim, 0, sizeof(*sim));
+    sim->graph = graph;
+    sim->capture = options->capture;
+    sim->published = options->published;
+    sim->published_context = options->published_context;
+    sim->is_remote = 1;
+    atomic_init(&sim->closing, 0);
+    sim->snapshots.front = 0;
+    atomic_init(&sim->snapshots.middle, 1);
+    sim->snapshots.back = 2;
+    if (stream_connect(&sim->remote, address) != 0) {
+        return -1;
+    }
+
+    // Wait for the first frame, so the viewer starts with a layout
+    while (sim->remote.frames == 0) {
+        if (stream_receive(&sim->remote, -1) < 0) {
+            printf("The stream ended before the first frame\n");
+            simulation_stop(sim);
+            return -1;
+        }
+    }
+    if (remote_update(sim) != 0) {
+        simulation_stop(sim);
+        return -1;
+    }
+    printf("Following %s: %d nodes, %d edges at iteration %d\n", address, sim->graph->num_nodes, sim->graph->num_edges,
+           sim->iteration);
+
+    pthread_mutex_init(&sim->lock, NULL);
+    pthread_cond_init(&sim->wake, NULL);
+    if (pthread_create(&sim->thread, NULL, remote_main, sim) != 0) {
+        printf("Cannot start the stream thread\n");
+        pthread_mutex_destroy(&sim->lock);
+        pthread_cond_destroy(&sim->wake);
+        simulation_stop(sim);
+        return -1;
+    }
+    sim->running = 1;
+    return 0;
+}
+
+// Commands for a remote simulation go straight to the server. They are sent
+// from the UI thread, which owns the front snapshot.
+static void remote_send(Simulation *sim, const SimCommand *command) {
+    const Snapshot *shown = &sim->snapshots.slots[sim->snapshots.front];
+    StreamControl control = {STREAM_STEP, 1, 0.0f, STREAM_ADD_NODE, command->node, command->other};
+    switch (command->type) {
+        case SIM_TOGGLE_PLAY:
+            control.type = shown->playing ? STREAM_PAUSE : STREAM_PLAY;
+            break;
+        case SIM_STEP_FORWARD:
+            control.iterations = (int)command->value;
+            break;
+        case SIM_SCALE_TEMPERATURE:
+            control.type = STREAM_TEMPERATURE;
+            control.temperature = shown->temperature * command->value;
+            break;
+        case SIM_ADD_NODE:
+        case SIM_REMOVE_NODE:
+        case SIM_TOGGLE_EDGE:
+            control.type = STREAM_EDIT;
+            control.edit = command->type == SIM_ADD_NODE ? STREAM_ADD_NODE
+                         : command->type == SIM_REMOVE_NODE ? STREAM_REMOVE_NODE : STREAM_TOGGLE_EDGE;
+            break;
+        default:
+            printf("Not available when following a stream\n");
+            return;
+    }
+    stream_send_control(&sim->remote, &control); // A closed stream is reported by the thread
+}
+
+static void enqueue(Simulation *sim, const SimCommand *command) {
+    if (sim->is_remote) {
+        remote_send(sim, command);
+        return;
+    }
+    pthread_mutex_lock(&sim->lock);
+    SimCommand *last = sim->queue_count > 0
+                     ? &sim->queue[(sim->queue_head + sim->queue_count - 1) % SIMULATION_QUEUE_SIZE] : NULL;
+    int dropped = 0;
+    if (last != NULL && last->type == command->type &&
+        (command->type == SIM_STEP_FORWARD || command->type == SIM_STEP_BACK)) {
+        last->value += command->value; // Key repeat outpacing the steps
+    } else if (sim->queue_count < SIMULATION_QUEUE_SIZE) {
+        sim->queue[(sim->queue_head + sim->queue_count) % SIMULATION_QUEUE_SIZE] = *command;
+        sim->queue_count++;
+        pthread_cond_signal(&sim->wake);
+    } else {
+        dropped = 1;
+    }
+    pthread_mutex_unlock(&sim->lock);
+    if (dropped) {
+        printf("The simulation is busy, %d commands are waiting; command dropped\n", SIMULATION_QUEUE_SIZE);
+    }
+}
+
+void simulation_send(Simulation *sim, SimCommandType type, float value) {
+    SimCommand command = {type, value, -1, -1};
+    enqueue(sim, &command);
+}
+
+// Queue a graph edit; node ids refer to the graph as of the newest snapshot
+void simulation_send_edit(Simulation *sim, SimCommandType type, int node, int other) {
+    SimCommand command = {type, 0.0f, node, other};
+    enqueue(sim, &command);
+}
+
+// Stop the thread if it runs and free everything
+void simulation_stop(Simulation *sim) {
+    if (sim->running) {
+        if (sim->is_remote) {
+            atomic_store(&sim->closing, 1);
+            stream_interrupt(&sim->remote);
+        } else {
+            // Not through the queue, which may be full
+            pthread_mutex_lock(&sim->lock);
+            atomic_store(&sim->quitting, 1);
+            pthread_cond_signal(&sim->wake);
+            pthread_mutex_unlock(&sim->lock);
+        }
+        pthread_join(sim->thread, NULL);
+        pthread_mutex_destroy(&sim->lock);
+        pthread_cond_destroy(&sim->wake);
+        sim->running = 0;
+    }
+    for (int i = 0; i < 3; i++) {
+        free(sim->snapshots.slots[i].x);
+        free(sim->snapshots.slots[i].edges);
+        memset(&sim->snapshots.slots[i], 0, sizeof(Snapshot));
+    }
+    incremental_free(&sim->incremental);
+    history_free(&sim->history);
+    free(sim->cooling_log);
+    sim->cooling_log = NULL;
+    force_workspace_destroy(sim->settings.workspace);
+    sim->settings.workspace = NULL;
+    nodes_free(&sim->nodes);
+    if (sim->is_remote) {
+        stream_client_print_stats(&sim->remote);
+        stream_disconnect(&sim->remote);
+    }
+}
@@ -0,0 +1,137 @@
+#ifndef SIMULATION_H
+#define SIMULATION_H
+
+#include <pthread.h>
+#include <stdatomic.h>
+
+#include "layout.h"
+#include "graph.h"
+#include "history.h"
+#include "cooling.h"
+#include "incremental.h"
+#include "placement.h"
+#include "checkpoint.h"
+#include "capture.h"
+#include "stream.h"
+
+#define SIMULATION_QUEUE_SIZE 64 // Pending commands, further sends are dropped and reported
+#define SNAPSHOT_FRESH 4         // Set on TripleBuffer.middle when it holds unread data
+
+// Requests from the UI, executed in order on the simulation thread
+typedef enum {
+    SIM_TOGGLE_PLAY,
+    SIM_STEP_FORWARD, // value: iterations; sent again before it runs, the counts add up
+    SIM_STEP_BACK,    // value: iterations, as above
+    SIM_REGENERATE,
+    SIM_TOGGLE_BARNES_HUT,
+    SIM_ADJUST_THETA, // value: change of the opening angle
+    SIM_SCALE_TEMPERATURE, // value: factor
+    SIM_ADD_NODE,     // node: neighbour of the new node, -1 for none
+    SIM_REMOVE_NODE,  // node
+    SIM_TOGGLE_EDGE,  // node, other: add the edge, or remove it if present
+    SIM_CHECKPOINT,   // Save the state to SimulationOptions.checkpoint_path
+    SIM_QUIT
+} SimCommandType;
+
+typedef struct {
+    SimCommandType type;
+    float value;
+    int node, other; // Graph edits
+} SimCommand;
+
+// Node positions as of one finished iteration, with the graph they belong to.
+// Edges are copied only into slots that hold an older graph version.
+typedef struct {
+    float *x, *y, *z; // z only for 3D layouts
+    int num_nodes;
+    int node_capacity;
+    Edge *edges;
+    int num_edges;
+    int edge_capacity;
+    unsigned int graph_version;
+    int iteration;
+    int playing;
+    float temperature;
+} Snapshot;
+
+// Lock-free single producer, single consumer triple buffer. The writer fills
+// slots[back] and swaps it into `middle`; the reader swaps `middle` with its
+// `front` slot when SNAPSHOT_FRESH is set. Neither side ever waits.
+typedef struct {
+    Snapshot slots[3];
+    atomic_int middle;
+    int back;  // Simulation thread only
+    int front; // Render thread only
+} TripleBuffer;
+
+// How a simulation starts. With `resume` set the graph must be the
+// checkpoint's, and the positions, cooling and iteration continue from it;
+// placement and seed are then only used for "Generate Nodes".
+typedef struct {
+    int max_iterations;        // Counted from the checkpoint when resuming
+    int iterations_per_second; // Pacing while playing, 0 runs flat out
+    size_t history_budget;     // Bytes kept for stepping back
+    PlacementKind placement;
+    uint64_t seed;
+    int dimensions;
+    const Checkpoint *resume;    // NULL for a fresh layout
+    const char *checkpoint_path; // Written by SIM_CHECKPOINT and every checkpoint_every iterations
+    int checkpoint_every;        // 0 for on request only
+    Capture *capture;            // Every iteration is rendered into it when set; owned by the caller
+    void (*published)(void *context); // Called on the simulation thread after every new snapshot, may be NULL
+    void *published_context;
+} SimulationOptions;
+
+// Layout running on its own thread. Once started, the thread owns the graph:
+// edits go through simulation_send_edit and the UI reads edges from snapshots.
+// A connected simulation is a thin client instead: its thread decodes a
+// layout stream into the same snapshots, and commands go to the server.
+typedef struct {
+    Graph *graph;
+    unsigned int graph_version; // Bumped by every edit
+    Nodes nodes;
+    ForceSettings settings;
+    Cooling cooling;
+    Cooling *cooling_log; // Scheduler state before each iteration, for replays
+    int iteration;
+    int max_iterations;
+    int playing;
+    int iterations_per_second; // Pacing while playing, 0 runs flat out
+    PlacementKind placement;   // Starting positions, also for "Generate Nodes"
+
+    History history; // Saved states for stepping back
+    int first_iteration; // Oldest iteration stepping back can reach, edits reset it
+    IncrementalLayout incremental;
+    Rng rng; // Seeds for "Generate Nodes", spots for new nodes without neighbours
+    const char *checkpoint_path;
+    int checkpoint_every;
+    Capture *capture;
+    void (*published)(void *context);
+    void *published_context;
+
+    TripleBuffer snapshots;
+
+    StreamClient remote;
+    int is_remote;
+    atomic_int closing;   // Set before a remote simulation is stopped
+    atomic_int quitting;  // Set by simulation_stop, the thread exits whatever is queued
+
+    pthread_t thread;
+    int running;          // Thread started
+    pthread_mutex_t lock; // Guards the command queue
+    pthread_cond_t wake;
+    SimCommand queue[SIMULATION_QUEUE_SIZE];
+    int queue_head;
+    int queue_count;
+} Simulation;
+
+int simulation_start(Simulation *sim, Graph *graph, const ForceSettings *settings, const SimulationOptions *options);
+// Follow a stream server at address instead; graph receives the streamed
+// graph. Only the capture and published options are used.
+int simulation_connect(Simulation *sim, const char *address, Graph *graph, const SimulationOptions *options);
+void simulation_send(Simulation *sim, SimCommandType type, float value);
+void simulation_send_edit(Simulation *sim, SimCommandType type, int node, int other);
+const Snapshot *simulation_snapshot(Simulation *sim, int *fresh);
+void simulation_stop(Simulation *sim);
+
+#endif
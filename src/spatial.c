@@ -0,0 +1,198 @@
+#include "spatial.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+static int grow(int **array, size_t count) {
+    int *grown = realloc(*array, (count > 0 ? count : 1) * sizeof(int));
+    if (grown == NULL) return -1;
+    *array = grown;
+    return 0;
+}
+
+static int reserve(SpatialGrid *grid, int num_cells, int num_nodes, int num_edges) {
+    if (num_cells > grid->cell_capacity) {
+        if (grow(&grid->node_start, (size_t)num_cells + 1) != 0 ||
+            grow(&grid->edge_start, (size_t)num_cells + 1) != 0) return -1;
+        grid->cell_capacity = num_cells;
+    }
+    if (num_nodes > grid->node_capacity) {
+        if (grow(&grid->nodes, (size_t)num_nodes) != 0 ||
+            grow(&grid->cell_of, (size_t)num_nodes) != 0 ||
+            grow(&grid->visible_nodes, (size_t)num_nodes) != 0) return -1;
+        grid->node_capacity = num_nodes;
+    }
+    if (num_edges > grid->edge_capacity) {
+        if (grow(&grid->edges, (size_t)num_edges) != 0 ||
+            grow(&grid->long_edges, (size_t)num_edges) != 0 ||
+            grow(&grid->visible_edges, (size_t)num_edges) != 0) return -1;
+        grid->edge_capacity = num_edges;
+    }
+    return 0;
+}
+
+static int clamp_cell(float value, int count) {
+    if (!(value >= 0.0f)) return 0; // Also catches NaN
+    return value >= (float)count ? count - 1 : (int)value;
+}
+
+// Bucket the nodes and edges for the current positions
+int spatial_build(SpatialGrid *grid, const float *x, const float *y, int num_nodes, const Edge *edges, int num_edges) {
+    float min_x = INFINITY, min_y = INFINITY, max_x = -INFINITY, max_y = -INFINITY;
+    for (int i = 0; i < num_nodes; i++) {
+        if (x[i] < min_x) min_x = x[i];
+        if (x[i] > max_x) max_x = x[i];
+        if (y[i] < min_y) min_y = y[i];
+        if (y[i] > max_y) max_y = y[i];
+    }
+    if (num_nodes == 0 || !(max_x >= min_x) || !(max_y >= min_y)) {
+        min_x = min_y = 0.0f;
+        max_x = max_y = 1.0f;
+    }
+
+    // Square cells sized for SPATIAL_NODES_PER_CELL nodes on average
+    float width = fmaxf(max_x - min_x, 1e-3f), height = fmaxf(max_y - min_y, 1e-3f);
+    int target = num_nodes / SPATIAL_NODES_PER_CELL;
+    if (target < 1) target = 1;
+    if (target > SPATIAL_MAX_CELLS) target = SPATIAL_MAX_CELLS;
+    float cell = sqrtf(width * height / (float)target);
+    cell = fmaxf(cell, fmaxf(width, height) / (float)SPATIAL_MAX_CELLS);
+    int columns, rows;
+    for (;;) {
+        columns = (int)(width / cell) + 1;
+        rows = (int)(height / cell) + 1;
+        if ((long)columns * rows <= SPATIAL_MAX_CELLS) break;
+        cell *= 1.25f;
+    }
+    int num_cells = columns * rows;
+    if (reserve(grid, num_cells, num_nodes, num_edges) != 0) {
+        printf("spatial: out of memory (%d nodes, %d edges)\n", num_nodes, num_edges);
+        return -1;
+    }
+    grid->min_x = min_x;
+    grid->min_y = min_y;
+    grid->inverse_cell = 1.0f / cell;
+    grid->columns = columns;
+    grid->rows = rows;
+
+    // Counting sort of the nodes by cell
+    int *node_start = grid->node_start;
+    memset(node_start, 0, ((size_t)num_cells + 1) * sizeof(int));
+    for (int i = 0; i < num_nodes; i++) {
+        int cx = clamp_cell((x[i] - min_x) * grid->inverse_cell, columns);
+        int cy = clamp_cell((y[i] - min_y) * grid->inverse_cell, rows);
+        grid->cell_of[i] = cy * columns + cx;
+        node_start[grid->cell_of[i] + 1]++;
+    }
+    for (int c = 0; c < num_cells; c++) {
+        node_start[c + 1] += node_start[c];
+    }
+    for (int i = 0; i < num_nodes; i++) {
+        grid->nodes[node_start[grid->cell_of[i]]++] = i;
+    }
+    for (int c = num_cells; c > 0; c--) {
+        node_start[c] = node_start[c - 1];
+    }
+    node_start[0] = 0;
+
+    // Short edges by the cell of their first node, long edges apart
+    int *edge_start = grid->edge_start;
+    memset(edge_start, 0, ((size_t)num_cells + 1) * sizeof(int));
+    grid->num_long_edges = 0;
+    for (int e = 0; e < num_edges; e++) {
+        int from = grid->cell_of[edges[e].from], to = grid->cell_of[edges[e].to];
+        if (abs(from % columns - to % columns) <= SPATIAL_EDGE_REACH && abs(from / columns - to / columns) <= SPATIAL_EDGE_REACH) {
+            edge_start[from + 1]++;
+        } else {
+            grid->long_edges[grid->num_long_edges++] = e;
+        }
+    }
+    for (int c = 0; c < num_cells; c++) {
+        edge_start[c + 1] += edge_start[c];
+    }
+    for (int e = 0; e < num_edges; e++) {
+        int from = grid->cell_of[edges[e].from], to = grid->cell_of[edges[e].to];
+        if (abs(from % columns - to % columns) <= SPATIAL_EDGE_REACH && abs(from / columns - to / columns) <= SPATIAL_EDGE_REACH) {
+            grid->edges[edge_start[from]++] = e;
+        }
+    }
+    for (int c = num_cells; c > 0; c--) {
+        edge_start[c] = edge_start[c - 1];
+    }
+    edge_start[0] = 0;
+    return 0;
+}
+
+static int edge_overlaps(const float *x, const float *y, Edge edge, float left, float top, float right, float bottom) {
+    float x1 = x[edge.from], y1 = y[edge.from], x2 = x[edge.to], y2 = y[edge.to];
+    return !((x1 < left && x2 < left) || (x1 > right && x2 > right) ||
+             (y1 < top && y2 < top) || (y1 > bottom && y2 > bottom));
+}
+
+// Nodes inside the world rectangle, and edges whose bounding box overlaps it,
+// into visible_nodes / visible_edges. Positions must be the ones last built.
+void spatial_query(SpatialGrid *grid, const float *x, const float *y, const Edge *edges,
+                   float left, float top, float right, float bottom) {
+    grid->num_visible_nodes = 0;
+    grid->num_visible_edges = 0;
+    if (grid->columns == 0) return;
+
+    float s = grid->inverse_cell;
+    int c0 = clamp_cell((left - grid->min_x) * s, grid->columns), c1 = clamp_cell((right - grid->min_x) * s, grid->columns);
+    int r0 = clamp_cell((top - grid->min_y) * s, grid->rows), r1 = clamp_cell((bottom - grid->min_y) * s, grid->rows);
+    if (right < grid->min_x || bottom < grid->min_y ||
+        left > grid->min_x + grid->columns / s || top > grid->min_y + grid->rows / s) {
+        c1 = c0 - 1; // Empty range, long edges can still cross the view
+    }
+
+    for (int row = r0; row <= r1; row++) {
+        for (int column = c0; column <= c1; column++) {
+            int cell = row * grid->columns + column;
+            for (int k = grid->node_start[cell]; k < grid->node_start[cell + 1]; k++) {
+                int i = grid->nodes[k];
+                if (x[i] >= left && x[i] <= right && y[i] >= top && y[i] <= bottom) {
+                    grid->visible_nodes[grid->num_visible_nodes++] = i;
+                }
+            }
+        }
+    }
+
+    // A short edge that reaches the view starts at most SPATIAL_EDGE_REACH cells outside it
+    if (c1 >= c0) {
+        int e_c0 = c0 - SPATIAL_EDGE_REACH < 0 ? 0 : c0 - SPATIAL_EDGE_REACH;
+        int e_c1 = c1 + SPATIAL_EDGE_REACH >= grid->columns ? grid->columns - 1 : c1 + SPATIAL_EDGE_REACH;
+        int e_r0 = r0 - SPATIAL_EDGE_REACH < 0 ? 0 : r0 - SPATIAL_EDGE_REACH;
+        int e_r1 = r1 + SPATIAL_EDGE_REACH >= grid->rows ? grid->rows - 1 : r1 + SPATIAL_EDGE_REACH;
+        for (int row = e_r0; row <= e_r1; row++) {
+            for (int column = e_c0; column <= e_c1; column++) {
+                int cell = row * grid->columns + column;
+                for (int k = grid->edge_start[cell]; k < grid->edge_start[cell + 1]; k++) {
+                    int e = grid->edges[k];
+                    if (edge_overlaps(x, y, edges[e], left, top, right, bottom)) {
+                        grid->visible_edges[grid->num_visible_edges++] = e;
+                    }
+                }
+            }
+        }
+    }
+    for (int k = 0; k < grid->num_long_edges; k++) {
+        int e = grid->long_edges[k];
+        if (edge_overlaps(x, y, edges[e], left, top, right, bottom)) {
+            grid->visible_edges[grid->num_visible_edges++] = e;
+        }
+    }
+}
+
+void spatial_free(SpatialGrid *grid) {
+    free(grid->node_start);
+    free(grid->nodes);
+    free(grid->edge_start);
+    free(grid->edges);
+    free(grid->long_edges);
+    free(grid->cell_of);
+    free(grid->visible_nodes);
+    free(grid->visible_edges);
+    memset(grid, 0, sizeof(*grid));
+}
@@ -0,0 +1,42 @@
+#ifndef SPATIAL_H
+#define SPATIAL_H
+
+#include "layout.h"
+
+#define SPATIAL_NODES_PER_CELL 4 // Average occupancy the cell size is chosen for
+#define SPATIAL_EDGE_REACH 4     // Edges spanning at most this many cells per axis are "short"
+#define SPATIAL_MAX_CELLS (1 << 22)
+
+// Uniform grid over node positions for rectangle queries. Nodes are bucketed by
+// cell. A short edge is bucketed by the cell of its `from` node, so it can only
+// touch cells within SPATIAL_EDGE_REACH of that one; long edges are kept in a
+// separate list and tested one by one. Rebuilt whenever the positions change,
+// all arrays are reused between builds.
+typedef struct {
+    float min_x, min_y;
+    float inverse_cell; // Cells per world unit
+    int columns, rows;
+
+    int *node_start;    // columns * rows + 1 offsets into `nodes`
+    int *nodes;
+    int *edge_start;    // columns * rows + 1 offsets into `edges`
+    int *edges;
+    int *long_edges;
+    int num_long_edges;
+    int *cell_of;       // Cell of each node
+
+    // Result of the last query
+    int *visible_nodes;
+    int num_visible_nodes;
+    int *visible_edges;
+    int num_visible_edges;
+
+    int cell_capacity, node_capacity, edge_capacity;
+} SpatialGrid;
+
+int spatial_build(SpatialGrid *grid, const float *x, const float *y, int num_nodes, const Edge *edges, int num_edges);
+void spatial_query(SpatialGrid *grid, const float *x, const float *y, const Edge *edges,
+                   float left, float top, float right, float bottom);
+void spatial_free(SpatialGrid *grid);
+
+#endif
@@ -0,0 +1,711 @@
+#include "stream.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include <netdb.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+
+#define DELTA_LIMIT (32767.0f * STREAM_QUANTUM)
+#define DEFAULT_HOST "127.0.0.1"
+#define RECEIVE_CHUNK (64 * 1024)
+
+#ifdef MSG_NOSIGNAL
+#define SEND_FLAGS MSG_NOSIGNAL
+#else
+#define SEND_FLAGS 0 // SO_NOSIGPIPE is set on the socket instead
+#endif
+
+// Messages are copied as they are in memory, which matches the wire format
+// on little-endian hosts only
+static int little_endian(void) {
+    uint16_t probe = 1;
+    unsigned char first;
+    memcpy(&first, &probe, 1);
+    return first == 1;
+}
+
+static double wall_seconds(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_REALTIME, &now);
+    return (double)now.tv_sec + (double)now.tv_nsec * 1e-9;
+}
+
+static size_t control_size(StreamMessage type) {
+    switch (type) {
+        case STREAM_STEP: return sizeof(int32_t);
+        case STREAM_TEMPERATURE: return sizeof(float);
+        case STREAM_EDIT: return 3 * sizeof(int32_t);
+        default: return 0;
+    }
+}
+
+static void socket_options(int fd) {
+    int on = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on)); // Fails harmlessly on Unix sockets
+#ifdef SO_NOSIGPIPE
+    setsockopt(fd, SOL_SOCKET, SO_NOSIGPIPE, &on, sizeof(on));
+#endif
+}
+
+// 1 when nothing accepts connections on a unix socket: its server is gone,
+// and the file may be replaced. A live server keeps its socket.
+static int socket_stale(const struct sockaddr_un *local) {
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) return 0;
+    int stale = connect(fd, (const struct sockaddr *)local, sizeof(*local)) != 0 && errno == ECONNREFUSED;
+    close(fd);
+    return stale;
+}
+
+// Listening or connected socket for "unix:PATH" or "[HOST:]PORT"
+static int open_socket(const char *address, int listening, char *unix_path, size_t unix_path_size) {
+    if (!little_endian()) {
+        printf("stream: only little-endian hosts are supported\n");
+        return -1;
+    }
+    if (strncmp(address, "unix:", 5) == 0) {
+        struct sockaddr_un local;
+        memset(&local, 0, sizeof(local));
+        local.sun_family = AF_UNIX;
+        const char *path = address + 5;
+        if (strlen(path) == 0 || strlen(path) >= sizeof(local.sun_path) ||
+            (listening && strlen(path) >= unix_path_size)) {
+            printf("stream: bad socket path \"%s\"\n", path);
+            return -1;
+        }
+        strcpy(local.sun_path, path);
+        int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (fd < 0) {
+            printf("stream: cannot create a socket: %s\n", strerror(errno));
+            return -1;
+        }
+        struct stat existing;
+        if (listening && stat(path, &existing) == 0 && S_ISSOCK(existing.st_mode) && socket_stale(&local)) {
+            unlink(path); // Left behind by a server that did not exit cleanly
+        }
+        int result = listening ? bind(fd, (struct sockaddr *)&local, sizeof(local)) : connect(fd, (struct sockaddr *)&local, sizeof(local));
+        if (result != 0 || (listening && listen(fd, STREAM_MAX_CLIENTS) != 0)) {
+            printf("stream: cannot %s %s: %s\n", listening ? "listen on" : "connect to", path, strerror(errno));
+            close(fd);
+            return -1;
+        }
+        if (listening) {
+            strcpy(unix_path, path);
+        }
+        socket_options(fd);
+        return fd;
+    }
+
+    char host[256];
+    const char *port = strrchr(address, ':');
+    if (port == NULL) {
+        strcpy(host, DEFAULT_HOST);
+        port = address;
+    } else if ((size_t)(port - address) < sizeof(host)) {
+        memcpy(host, address, (size_t)(port - address));
+        host[port - address] = '\0';
+        port++;
+        if (host[0] == '\0') strcpy(host, DEFAULT_HOST);
+    } else {
+        printf("stream: bad address \"%s\"\n", address);
+        return -1;
+    }
+
+    struct addrinfo hints, *found;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    hints.ai_flags = listening ? AI_PASSIVE : 0;
+    int error = getaddrinfo(host, port, &hints, &found);
+    if (error != 0) {
+        printf("stream: cannot resolve \"%s\": %s\n", address, gai_strerror(error));
+        return -1;
+    }
+    int fd = -1;
+    for (struct addrinfo *a = found; a != NULL && fd < 0; a = a->ai_next) {
+        fd = socket(a->ai_family, a->ai_socktype, a->ai_protocol);
+        if (fd < 0) continue;
+        int on = 1;
+        setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+        int result = listening ? bind(fd, a->ai_addr, a->ai_addrlen) : connect(fd, a->ai_addr, a->ai_addrlen);
+        if (result != 0 || (listening && listen(fd, STREAM_MAX_CLIENTS) != 0)) {
+            close(fd);
+            fd = -1;
+        }
+    }
+    if (fd < 0) {
+        printf("stream: cannot %s %s: %s\n", listening ? "listen on" : "connect to", address, strerror(errno));
+    } else {
+        socket_options(fd);
+    }
+    freeaddrinfo(found);
+    return fd;
+}
+
+static int set_nonblocking(int fd) {
+    int flags = fcntl(fd, F_GETFL, 0);
+    return flags < 0 ? -1 : fcntl(fd, F_SETFL, flags | O_NONBLOCK);
+}
+
+// Write everything or fail, for blocking sockets
+static int send_all(int fd, const void *data, size_t size) {
+    const unsigned char *bytes = data;
+    while (size > 0) {
+        ssize_t written = send(fd, bytes, size, SEND_FLAGS);
+        if (written < 0) {
+            if (errno == EINTR) continue;
+            return -1;
+        }
+        bytes += written;
+        size -= (size_t)written;
+    }
+    return 0;
+}
+
+// --- Server ---
+
+static size_t pending(const StreamPeer *peer) {
+    return peer->out_used - peer->out_start;
+}
+
+static int queue(StreamPeer *peer, const void *data, size_t size) {
+    if (peer->out_start > 0) {
+        memmove(peer->out, peer->out + peer->out_start, pending(peer));
+        peer->out_used -= peer->out_start;
+        peer->out_start = 0;
+    }
+    if (peer->out_used + size > peer->out_capacity) {
+        size_t capacity = peer->out_capacity > 0 ? peer->out_capacity : RECEIVE_CHUNK;
+        while (capacity < peer->out_used + size) capacity *= 2;
+        unsigned char *out = realloc(peer->out, capacity);
+        if (out == NULL) {
+            printf("stream: out of memory for %zu bytes\n", capacity);
+            return -1;
+        }
+        peer->out = out;
+        peer->out_capacity = capacity;
+    }
+    memcpy(peer->out + peer->out_used, data, size);
+    peer->out_used += size;
+    return 0;
+}
+
+static int queue_header(StreamPeer *peer, StreamMessage type, size_t size) {
+    StreamHeader header = {(uint32_t)size, (uint32_t)type};
+    return queue(peer, &header, sizeof(header));
+}
+
+// Write as much as the socket takes without blocking
+static int flush(StreamPeer *peer) {
+    while (pending(peer) > 0) {
+        ssize_t written = send(peer->fd, peer->out + peer->out_start, pending(peer), SEND_FLAGS);
+        if (written < 0) {
+            if (errno == EINTR) continue;
+            return errno == EAGAIN || errno == EWOULDBLOCK ? 0 : -1;
+        }
+        peer->out_start += (size_t)written;
+    }
+    peer->out_start = peer->out_used = 0;
+    return 0;
+}
+
+static void drop_peer(StreamServer *server, int index) {
+    StreamPeer *peer = &server->peers[index];
+    close(peer->fd);
+    free(peer->sent);
+    free(peer->out);
+    server->peers[index] = server->peers[--server->num_peers];
+    printf("stream: client left, %d connected\n", server->num_peers);
+}
+
+int stream_listen(StreamServer *server, const char *address, float threshold) {
+    memset(server, 0, sizeof(*server));
+    server->threshold = threshold;
+    server->listen_fd = open_socket(address, 1, server->unix_path, sizeof(server->unix_path));
+    if (server->listen_fd < 0) {
+        return -1;
+    }
+    if (set_nonblocking(server->listen_fd) != 0) {
+        stream_close(server);
+        return -1;
+    }
+    return 0;
+}
+
+static void accept_peers(StreamServer *server) {
+    for (;;) {
+        int fd = accept(server->listen_fd, NULL, NULL);
+        if (fd < 0) return;
+        if (server->num_peers == STREAM_MAX_CLIENTS || set_nonblocking(fd) != 0) {
+            printf("stream: refused a client, %d connected\n", server->num_peers);
+            close(fd);
+            continue;
+        }
+        socket_options(fd);
+        StreamPeer *peer = &server->peers[server->num_peers++];
+        memset(peer, 0, sizeof(*peer));
+        peer->fd = fd;
+        peer->stale = 1;
+        printf("stream: client joined, %d connected\n", server->num_peers);
+    }
+}
+
+// Parse the complete control messages read so far. Returns -1 for a message
+// no client should send.
+static int read_controls(StreamPeer *peer, StreamControl *controls, int max_controls, int *num_controls) {
+    for (;;) {
+        ssize_t got = recv(peer->fd, peer->in + peer->in_used, sizeof(peer->in) - peer->in_used, 0);
+        if (got == 0) return -1;
+        if (got < 0) {
+            if (errno == EINTR) continue;
+            if (errno == EAGAIN || errno == EWOULDBLOCK) break;
+            return -1;
+        }
+        peer->in_used += (size_t)got;
+
+        size_t offset = 0;
+        while (peer->in_used - offset >= sizeof(StreamHeader)) {
+            StreamHeader header;
+            memcpy(&header, peer->in + offset, sizeof(header));
+            if (header.type < STREAM_PLAY || header.type >= STREAM_MESSAGE_COUNT ||
+                header.size != control_size((StreamMessage)header.type)) {
+                printf("stream: bad control message %u of %u bytes\n", header.type, header.size);
+                return -1;
+            }
+            if (peer->in_used - offset < sizeof(header) + header.size) break;
+            const unsigned char *payload = peer->in + offset + sizeof(header);
+            StreamControl control = {(StreamMessage)header.type, 0, 0.0f, STREAM_ADD_NODE, -1, -1};
+            int32_t values[3];
+            memcpy(values, payload, header.size);
+            if (control.type == STREAM_STEP) {
+                control.iterations = values[0];
+            } else if (control.type == STREAM_TEMPERATURE) {
+                memcpy(&control.temperature, payload, sizeof(float));
+            } else if (control.type == STREAM_EDIT) {
+                if (values[0] < 0 || values[0] >= STREAM_EDIT_COUNT) {
+                    printf("stream: bad edit %d\n", values[0]);
+                    return -1;
+                }
+                control.edit = (StreamEdit)values[0];
+                control.node = values[1];
+                control.other = values[2];
+            }
+            if (*num_controls < max_controls) {
+                controls[(*num_controls)++] = control;
+            }
+            offset += sizeof(header) + header.size;
+        }
+        memmove(peer->in, peer->in + offset, peer->in_used - offset);
+        peer->in_used -= offset;
+    }
+    return 0;
+}
+
+int stream_poll(StreamServer *server, int timeout_ms, StreamControl *controls, int max_controls) {
+    struct pollfd fds[1 + STREAM_MAX_CLIENTS];
+    int num_peers = server->num_peers;
+    fds[0].fd = server->listen_fd;
+    fds[0].events = POLLIN;
+    for (int i = 0; i < num_peers; i++) {
+        fds[1 + i].fd = server->peers[i].fd;
+        fds[1 + i].events = POLLIN | (pending(&server->peers[i]) > 0 ? POLLOUT : 0);
+    }
+    int ready = poll(fds, (nfds_t)(1 + num_peers), timeout_ms);
+    if (ready < 0) {
+        if (errno == EINTR) return 0;
+        printf("stream: poll failed: %s\n", strerror(errno));
+        return -1;
+    }
+
+    // Backwards, so dropping a peer only moves one that is already done
+    int num_controls = 0;
+    for (int i = num_peers - 1; i >= 0; i--) {
+        StreamPeer *peer = &server->peers[i];
+        int failed = 0;
+        if (fds[1 + i].revents & POLLOUT) {
+            failed = flush(peer) != 0;
+        }
+        if (!failed && (fds[1 + i].revents & (POLLIN | POLLHUP | POLLERR))) {
+            failed = read_controls(peer, controls, max_controls, &num_controls) != 0;
+        }
+        if (failed) {
+            drop_peer(server, i);
+        }
+    }
+    if (fds[0].revents & POLLIN) {
+        accept_peers(server);
+    }
+    return num_controls;
+}
+
+int stream_wants_frame(const StreamServer *server) {
+    for (int i = 0; i < server->num_peers; i++) {
+        if (server->peers[i].stale && pending(&server->peers[i]) == 0) return 1;
+    }
+    return 0;
+}
+
+static int queue_graph(StreamPeer *peer, const Graph *graph, int dimensions) {
+    StreamGraphInfo info = {STREAM_VERSION, graph->num_nodes, graph->num_edges, dimensions};
+    size_t edge_bytes = (size_t)graph->num_edges * sizeof(Edge);
+    return queue_header(peer, STREAM_GRAPH, sizeof(info) + edge_bytes) != 0 || queue(peer, &info, sizeof(info)) != 0 ||
+           queue(peer, graph->edges, edge_bytes) != 0 ? -1 : 0;
+}
+
+static int queue_keyframe(StreamPeer *peer, const Nodes *nodes, StreamFrameInfo *info) {
+    const float *axes[3] = {nodes->x, nodes->y, nodes->z};
+    size_t n = (size_t)nodes->count;
+    info->count = nodes->count;
+    if (queue_header(peer, STREAM_KEYFRAME, sizeof(*info) + (size_t)nodes->dimensions * n * sizeof(float)) != 0 ||
+        queue(peer, info, sizeof(*info)) != 0) {
+        return -1;
+    }
+    for (int a = 0; a < nodes->dimensions; a++) {
+        if (queue(peer, axes[a], n * sizeof(float)) != 0) return -1;
+        memcpy(peer->sent + a * n, axes[a], n * sizeof(float));
+    }
+    peer->since_keyframe = 0;
+    return 0;
+}
+
+// Delta against what the peer decoded last; 0 when a keyframe is needed instead
+static int queue_delta(StreamServer *server, StreamPeer *peer, const Nodes *nodes, StreamFrameInfo *info) {
+    const float *axes[3] = {nodes->x, nodes->y, nodes->z};
+    int n = nodes->count, dimensions = nodes->dimensions;
+    int count = 0;
+    for (int i = 0; i < n; i++) {
+        float moved = 0.0f;
+        for (int a = 0; a < dimensions; a++) {
+            moved = fmaxf(moved, fabsf(axes[a][i] - peer->sent[(size_t)a * n + i]));
+        }
+        if (moved > DELTA_LIMIT) return 0;
+        if (moved > server->threshold) {
+            server->ids[count++] = (uint32_t)i;
+        }
+    }
+    for (int a = 0; a < dimensions; a++) {
+        float *sent = peer->sent + (size_t)a * n;
+        int16_t *steps = server->steps + (size_t)a * count;
+        for (int k = 0; k < count; k++) {
+            int i = (int)server->ids[k];
+            steps[k] = (int16_t)lrintf((axes[a][i] - sent[i]) / STREAM_QUANTUM);
+            sent[i] += (float)steps[k] * STREAM_QUANTUM;
+        }
+    }
+    info->count = count;
+    size_t id_bytes = (size_t)count * sizeof(uint32_t), step_bytes = (size_t)dimensions * count * sizeof(int16_t);
+    if (queue_header(peer, STREAM_DELTA, sizeof(*info) + id_bytes + step_bytes) != 0 ||
+        queue(peer, info, sizeof(*info)) != 0 || queue(peer, server->ids, id_bytes) != 0 ||
+        queue(peer, server->steps, step_bytes) != 0) {
+        return -1;
+    }
+    peer->since_keyframe++;
+    return count > 0 ? count : 1;
+}
+
+// Queue the frame for every client that has read the previous one and write
+// as much of it as the sockets take. Returns -1 when out of memory.
+int stream_publish(StreamServer *server, const Graph *graph, unsigned int graph_version, const Nodes *nodes,
+                   int iteration, unsigned int flags, float temperature, StreamFrameStats *frame) {
+    double start = layout_seconds();
+    size_t n = (size_t)nodes->count, floats = n * (size_t)nodes->dimensions;
+    StreamFrameStats stats = {0, 0, 0, 0, 0.0};
+    if (n > server->scratch_capacity) {
+        uint32_t *ids = realloc(server->ids, n * sizeof(uint32_t));
+        if (ids != NULL) server->ids = ids;
+        int16_t *steps = realloc(server->steps, 3 * n * sizeof(int16_t));
+        if (steps != NULL) server->steps = steps;
+        if (ids == NULL || steps == NULL) {
+            printf("stream: out of memory for %zu nodes\n", n);
+            return -1;
+        }
+        server->scratch_capacity = n;
+    }
+    size_t keyframe_bytes = sizeof(StreamHeader) + sizeof(StreamFrameInfo) + floats * sizeof(float);
+
+    for (int p = server->num_peers - 1; p >= 0; p--) {
+        StreamPeer *peer = &server->peers[p];
+        if (pending(peer) > 0 && flush(peer) != 0) {
+            drop_peer(server, p);
+            continue;
+        }
+        if (pending(peer) > 0) {
+            peer->stale = 1;
+            server->stats.skipped++;
+            continue;
+        }
+        size_t before = peer->out_used;
+        size_t full_bytes = keyframe_bytes;
+        int keyframe = peer->graph_version != graph_version || peer->since_keyframe >= STREAM_KEYFRAME_INTERVAL - 1;
+        if (peer->graph_version != graph_version) {
+            if (floats > peer->sent_capacity) {
+                float *sent = realloc(peer->sent, floats * sizeof(float));
+                if (sent == NULL) {
+                    printf("stream: out of memory for %zu nodes\n", n);
+                    return -1;
+                }
+                peer->sent = sent;
+                peer->sent_capacity = floats;
+            }
+            if (queue_graph(peer, graph, nodes->dimensions) != 0) return -1;
+            peer->graph_version = graph_version;
+            full_bytes += peer->out_used - before;
+        }
+
+        StreamFrameInfo info = {iteration, flags, temperature, 0, wall_seconds()};
+        int sent = keyframe ? 0 : queue_delta(server, peer, nodes, &info);
+        if (sent < 0) return -1;
+        if (sent == 0) {
+            if (queue_keyframe(peer, nodes, &info) != 0) return -1;
+            stats.keyframes++;
+        } else {
+            stats.nodes += info.count;
+        }
+        stats.clients++;
+        stats.bytes += peer->out_used - before;
+        server->stats.full_bytes += (long long)full_bytes;
+        peer->stale = 0;
+        if (flush(peer) != 0) {
+            drop_peer(server, p);
+        }
+    }
+
+    stats.seconds = layout_seconds() - start;
+    server->stats.frames++;
+    server->stats.keyframes += stats.keyframes;
+    server->stats.deltas += stats.clients - stats.keyframes;
+    server->stats.nodes += stats.nodes;
+    server->stats.bytes += (long long)stats.bytes;
+    server->stats.encode_seconds += stats.seconds;
+    if (frame != NULL) {
+        *frame = stats;
+    }
+    return 0;
+}
+
+void stream_close(StreamServer *server) {
+    while (server->num_peers > 0) {
+        drop_peer(server, server->num_peers - 1);
+    }
+    if (server->listen_fd >= 0) {
+        close(server->listen_fd);
+    }
+    if (server->unix_path[0] != '\0') {
+        unlink(server->unix_path);
+    }
+    free(server->ids);
+    free(server->steps);
+    memset(server, 0, sizeof(*server));
+    server->listen_fd = -1;
+}
+
+void stream_print_stats(const StreamStats *stats, int num_nodes) {
+    long long messages = stats->keyframes + stats->deltas;
+    printf("Stream: %lld frames, %lld keyframes and %lld deltas sent, %lld skipped by slow clients\n",
+           stats->frames, stats->keyframes, stats->deltas, stats->skipped);
+    if (messages > 0) {
+        printf("Stream: %.1f KB per frame and client, %.1f%% of full frames; %.1f of %d nodes per delta, "
+               "%.3f ms encoding per frame\n",
+               stats->bytes / 1024.0 / messages, stats->full_bytes > 0 ? 100.0 * stats->bytes / stats->full_bytes : 0.0,
+               stats->deltas > 0 ? (double)stats->nodes / stats->deltas : 0.0, num_nodes,
+               stats->encode_seconds * 1000.0 / stats->frames);
+    }
+}
+
+// --- Client ---
+
+int stream_connect(StreamClient *client, const char *address) {
+    memset(client, 0, sizeof(*client));
+    client->fd = open_socket(address, 0, NULL, 0);
+    return client->fd < 0 ? -1 : 0;
+}
+
+static int decode_graph(StreamClient *client, const unsigned char *payload, size_t size) {
+    StreamGraphInfo info;
+    if (size < sizeof(info)) return -1;
+    memcpy(&info, payload, sizeof(info));
+    if (info.version != STREAM_VERSION) {
+        printf("stream: server speaks version %u, this client %d\n", info.version, STREAM_VERSION);
+        return -1;
+    }
+    if (info.num_nodes < 0 || info.num_edges < 0 || (info.dimensions != 2 && info.dimensions != 3) ||
+        size != sizeof(info) + (size_t)info.num_edges * sizeof(Edge)) {
+        return -1;
+    }
+    Edge *edges = malloc(((size_t)info.num_edges + 1) * sizeof(Edge));
+    float *positions = malloc(((size_t)info.num_nodes * info.dimensions + 1) * sizeof(float));
+    if (edges == NULL || positions == NULL) {
+        printf("stream: out of memory for %d nodes\n", info.num_nodes);
+        free(edges);
+        free(positions);
+        return -1;
+    }
+    memcpy(edges, payload + sizeof(info), (size_t)info.num_edges * sizeof(Edge));
+    for (int e = 0; e < info.num_edges; e++) {
+        if (edges[e].from < 0 || edges[e].to < 0 || edges[e].from >= info.num_nodes || edges[e].to >= info.num_nodes) {
+            free(edges);
+            free(positions);
+            return -1;
+        }
+    }
+    memset(positions, 0, ((size_t)info.num_nodes * info.dimensions + 1) * sizeof(float));
+    free(client->edges);
+    free(client->positions);
+    client->edges = edges;
+    client->num_edges = info.num_edges;
+    client->positions = positions;
+    client->num_nodes = info.num_nodes;
+    client->dimensions = info.dimensions;
+    client->graph_changed = 1;
+    return 0;
+}
+
+static int decode_frame(StreamClient *client, StreamMessage type, const unsigned char *payload, size_t size) {
+    StreamFrameInfo info;
+    if (size < sizeof(info)) return -1;
+    memcpy(&info, payload, sizeof(info));
+    payload += sizeof(info);
+    size_t n = (size_t)client->num_nodes, count = info.count >= 0 ? (size_t)info.count : 0;
+    int dimensions = client->dimensions;
+    if (type == STREAM_KEYFRAME) {
+        if (info.count != client->num_nodes || size != sizeof(info) + (size_t)dimensions * n * sizeof(float)) return -1;
+        memcpy(client->positions, payload, (size_t)dimensions * n * sizeof(float));
+        client->keyframes++;
+    } else {
+        if (info.count < 0 || size != sizeof(info) + count * (sizeof(uint32_t) + (size_t)dimensions * sizeof(int16_t))) {
+            return -1;
+        }
+        const unsigned char *steps = payload + count * sizeof(uint32_t);
+        for (size_t k = 0; k < count; k++) {
+            uint32_t id;
+            memcpy(&id, payload + k * sizeof(uint32_t), sizeof(id));
+            if (id >= n) return -1;
+            for (int a = 0; a < dimensions; a++) {
+                int16_t step;
+                memcpy(&step, steps + ((size_t)a * count + k) * sizeof(int16_t), sizeof(step));
+                client->positions[(size_t)a * n + id] += (float)step * STREAM_QUANTUM;
+            }
+        }
+    }
+    client->iteration = info.iteration;
+    client->flags = info.flags;
+    client->temperature = info.temperature;
+    client->latency = wall_seconds() - info.sent;
+    client->latency_sum += client->latency;
+    if (client->latency > client->latency_max) client->latency_max = client->latency;
+    client->frames++;
+    return 0;
+}
+
+int stream_receive(StreamClient *client, int timeout_ms) {
+    struct pollfd fd = {client->fd, POLLIN, 0};
+    int ready = poll(&fd, 1, timeout_ms);
+    if (ready < 0) return errno == EINTR ? 0 : -1;
+    if (ready == 0) return 0;
+
+    if (client->in_capacity - client->in_used < RECEIVE_CHUNK) {
+        size_t capacity = client->in_capacity > 0 ? client->in_capacity * 2 : 4 * RECEIVE_CHUNK;
+        unsigned char *in = realloc(client->in, capacity);
+        if (in == NULL) {
+            printf("stream: out of memory for %zu bytes\n", capacity);
+            return -1;
+        }
+        client->in = in;
+        client->in_capacity = capacity;
+    }
+    ssize_t got = recv(client->fd, client->in + client->in_used, client->in_capacity - client->in_used, 0);
+    if (got <= 0) {
+        return got < 0 && errno == EINTR ? 0 : -1;
+    }
+    client->in_used += (size_t)got;
+    client->bytes += got;
+
+    int frames = 0;
+    size_t offset = 0;
+    while (client->in_used - offset >= sizeof(StreamHeader)) {
+        StreamHeader header;
+        memcpy(&header, client->in + offset, sizeof(header));
+        if (header.size > STREAM_MAX_MESSAGE || header.type > STREAM_DELTA ||
+            (header.type != STREAM_GRAPH && client->positions == NULL)) {
+            printf("stream: bad message %u of %u bytes\n", header.type, header.size);
+            return -1;
+        }
+        if (client->in_used - offset < sizeof(header) + header.size) {
+            // Room for all of a large message once it is moved to the front below
+            size_t needed = sizeof(header) + header.size;
+            if (needed > client->in_capacity) {
+                unsigned char *in = realloc(client->in, needed + RECEIVE_CHUNK);
+                if (in == NULL) {
+                    printf("stream: out of memory for %zu bytes\n", needed);
+                    return -1;
+                }
+                client->in = in;
+                client->in_capacity = needed + RECEIVE_CHUNK;
+            }
+            break;
+        }
+        const unsigned char *payload = client->in + offset + sizeof(header);
+        int result = header.type == STREAM_GRAPH ? decode_graph(client, payload, header.size)
+                                                 : decode_frame(client, (StreamMessage)header.type, payload, header.size);
+        if (result != 0) {
+            printf("stream: corrupt message %u of %u bytes\n", header.type, header.size);
+            return -1;
+        }
+        frames += header.type != STREAM_GRAPH;
+        offset += sizeof(header) + header.size;
+    }
+    memmove(client->in, client->in + offset, client->in_used - offset);
+    client->in_used -= offset;
+    return frames;
+}
+
+int stream_send_control(StreamClient *client, const StreamControl *control) {
+    unsigned char message[sizeof(StreamHeader) + 3 * sizeof(int32_t)];
+    StreamHeader header = {(uint32_t)control_size(control->type), (uint32_t)control->type};
+    int32_t values[3] = {0, 0, 0};
+    if (control->type == STREAM_STEP) {
+        values[0] = control->iterations;
+    } else if (control->type == STREAM_TEMPERATURE) {
+        memcpy(values, &control->temperature, sizeof(float));
+    } else if (control->type == STREAM_EDIT) {
+        values[0] = control->edit;
+        values[1] = control->node;
+        values[2] = control->other;
+    }
+    memcpy(message, &header, sizeof(header));
+    memcpy(message + sizeof(header), values, header.size);
+    return send_all(client->fd, message, sizeof(header) + header.size);
+}
+
+void stream_interrupt(StreamClient *client) {
+    shutdown(client->fd, SHUT_RDWR);
+}
+
+void stream_disconnect(StreamClient *client) {
+    if (client->fd >= 0) {
+        close(client->fd);
+    }
+    free(client->in);
+    free(client->edges);
+    free(client->positions);
+    memset(client, 0, sizeof(*client));
+    client->fd = -1;
+}
+
+void stream_client_print_stats(const StreamClient *client) {
+    if (client->frames == 0) return;
+    printf("Stream: %lld frames, %lld keyframes, %.1f KB per frame, latency %.2f ms mean, %.2f ms max\n",
+           client->frames, client->keyframes, client->bytes / 1024.0 / client->frames,
+           client->latency_sum * 1000.0 / client->frames, client->latency_max * 1000.0);
+}
@@ -0,0 +1,180 @@
+#ifndef STREAM_H
+#define STREAM_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "layout.h"
+#include "graph.h"
+#include "history.h"
+
+#define STREAM_VERSION 1
+#define STREAM_QUANTUM HISTORY_QUANTUM    // Delta resolution in pixels, int16 covers +-512
+#define STREAM_DEFAULT_THRESHOLD 0.25f    // Pixels a node must move before it is sent again
+#define STREAM_KEYFRAME_INTERVAL 64       // Frames to one client between keyframes
+#define STREAM_MAX_CLIENTS 8              // Further connections are refused
+#define STREAM_MAX_CONTROLS 64            // Control messages returned by one stream_poll, more are dropped
+#define STREAM_MAX_MESSAGE (1u << 30)     // Larger sizes mean a broken stream
+
+// Messages are a StreamHeader and `size` bytes of payload, little-endian.
+//
+// Server to client, after a STREAM_GRAPH for every graph the client has not seen:
+//   STREAM_GRAPH     StreamGraphInfo, then num_edges Edge pairs
+//   STREAM_KEYFRAME  StreamFrameInfo, then count floats per axis (count = all nodes)
+//   STREAM_DELTA     StreamFrameInfo, then count uint32 node ids and count int16
+//                    steps of STREAM_QUANTUM per axis, for the nodes that moved
+// Deltas are against the positions the client decoded from the previous
+// frame, so quantization errors never accumulate; a node that moves less than
+// the threshold is left out until its drift exceeds it.
+//
+// Client to server:
+//   STREAM_PLAY, STREAM_PAUSE, STREAM_QUIT  no payload
+//   STREAM_STEP         int32 iterations
+//   STREAM_TEMPERATURE  float
+//   STREAM_EDIT         int32 StreamEdit, node, other
+typedef enum {
+    STREAM_GRAPH,
+    STREAM_KEYFRAME,
+    STREAM_DELTA,
+    STREAM_PLAY,
+    STREAM_PAUSE,
+    STREAM_STEP,
+    STREAM_TEMPERATURE,
+    STREAM_EDIT,
+    STREAM_QUIT,
+    STREAM_MESSAGE_COUNT
+} StreamMessage;
+
+typedef enum {
+    STREAM_ADD_NODE,    // Linked to node unless it is -1
+    STREAM_REMOVE_NODE,
+    STREAM_ADD_EDGE,
+    STREAM_REMOVE_EDGE,
+    STREAM_TOGGLE_EDGE, // Add the edge, or remove it if present
+    STREAM_EDIT_COUNT
+} StreamEdit;
+
+#define STREAM_PLAYING 1u   // StreamFrameInfo.flags: the layout is running
+#define STREAM_CONVERGED 2u // It stopped by itself
+
+typedef struct {
+    uint32_t size; // Payload bytes after the header
+    uint32_t type;
+} StreamHeader;
+
+typedef struct {
+    uint32_t version; // STREAM_VERSION
+    int32_t num_nodes;
+    int32_t num_edges;
+    int32_t dimensions;
+} StreamGraphInfo;
+
+typedef struct {
+    int32_t iteration;
+    uint32_t flags;
+    float temperature;
+    int32_t count;  // Nodes that follow
+    double sent;    // Wall clock seconds when the server queued it, for latency on the same host
+} StreamFrameInfo;
+
+typedef struct {
+    StreamMessage type;
+    int iterations;    // STREAM_STEP
+    float temperature; // STREAM_TEMPERATURE
+    StreamEdit edit;   // STREAM_EDIT
+    int node, other;
+} StreamControl;
+
+// Server totals over all clients
+typedef struct {
+    long long frames;     // stream_publish calls
+    long long keyframes;  // Messages queued, one per client and frame
+    long long deltas;
+    long long skipped;    // Frames a client missed because it had not read the previous one
+    long long nodes;      // Node updates in deltas
+    long long bytes;      // Queued, headers and graphs included
+    long long full_bytes; // What sending every frame as a keyframe would have queued
+    double encode_seconds;
+} StreamStats;
+
+// One stream_publish call
+typedef struct {
+    int clients;   // Sent to
+    int keyframes;
+    int nodes;     // Updates in deltas
+    size_t bytes;
+    double seconds;
+} StreamFrameStats;
+
+// A connected client as the server sees it
+typedef struct {
+    int fd;
+    float *sent;              // Positions as the client decoded them, axis after axis
+    size_t sent_capacity;     // Floats
+    unsigned int graph_version; // Graph the client has, 0 for none
+    int since_keyframe;
+    int stale;                // Missed a frame, or has none yet
+    unsigned char *out;       // out[out_start .. out_used) is still to be written
+    size_t out_start, out_used, out_capacity;
+    unsigned char in[256];    // Partial control message
+    size_t in_used;
+} StreamPeer;
+
+// Listens on "unix:PATH" or "[HOST:]PORT" (HOST defaults to 127.0.0.1) and
+// sends every client each published frame, unless it has not read the
+// previous one yet: a slow client then gets fewer, larger deltas and never
+// holds up the layout.
+typedef struct {
+    int listen_fd;
+    char unix_path[108];      // Removed on close, empty for TCP
+    StreamPeer peers[STREAM_MAX_CLIENTS];
+    int num_peers;
+    float threshold;
+    uint32_t *ids;            // Delta scratch
+    int16_t *steps;
+    size_t scratch_capacity;  // Nodes
+    StreamStats stats;
+} StreamServer;
+
+int stream_listen(StreamServer *server, const char *address, float threshold);
+// Accept clients, write queued frames and read control messages, waiting up
+// to timeout_ms (-1 for no limit) for something to happen. Returns the
+// number of controls, -1 on error; interrupted by a signal it returns 0.
+int stream_poll(StreamServer *server, int timeout_ms, StreamControl *controls, int max_controls);
+int stream_wants_frame(const StreamServer *server); // A client joined or caught up since its last frame
+int stream_publish(StreamServer *server, const Graph *graph, unsigned int graph_version, const Nodes *nodes,
+                   int iteration, unsigned int flags, float temperature, StreamFrameStats *frame);
+void stream_close(StreamServer *server);
+void stream_print_stats(const StreamStats *stats, int num_nodes);
+
+// Receiving end: the newest graph and positions as decoded from the stream
+typedef struct {
+    int fd;
+    unsigned char *in;
+    size_t in_used, in_capacity;
+
+    int num_nodes;
+    int dimensions;
+    Edge *edges;
+    int num_edges;
+    int graph_changed;  // Set by every STREAM_GRAPH, cleared by the caller
+    float *positions;   // num_nodes per axis
+    int iteration;
+    unsigned int flags;
+    float temperature;
+    double latency;     // Seconds from queueing to decoding the newest frame
+
+    long long frames, keyframes, bytes;
+    double latency_sum, latency_max;
+} StreamClient;
+
+int stream_connect(StreamClient *client, const char *address);
+// Decode whatever arrives within timeout_ms (-1 for no limit). Returns the
+// number of frames decoded, -1 once the stream is closed or broken.
+int stream_receive(StreamClient *client, int timeout_ms);
+int stream_send_control(StreamClient *client, const StreamControl *control);
+void stream_interrupt(StreamClient *client); // Wake a stream_receive blocked on another thread
+void stream_disconnect(StreamClient *client);
+void stream_client_print_stats(const StreamClient *client);
+
+#endif
@@ -0,0 +1,139 @@
+#include "threadpool.h"
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+struct ThreadPool {
+    int num_threads;
+    pthread_t *workers;   // num_threads - 1 workers
+    pthread_mutex_t lock;
+    pthread_cond_t start; // Signalled when a new task is posted
+    pthread_cond_t done;  // Signalled when the last worker finishes
+    ThreadTask task;
+    void *context;
+    unsigned long generation; // Bumped for every posted task
+    int pending;              // Workers still running the current task
+    int quit;
+};
+
+typedef struct {
+    ThreadPool *pool;
+    int thread;
+} WorkerStart;
+
+static void *worker_main(void *arg) {
+    WorkerStart start = *(WorkerStart *)arg;
+    free(arg);
+    ThreadPool *pool = start.pool;
+    unsigned long seen = 0;
+
+    pthread_mutex_lock(&pool->lock);
+    for (;;) {
+        while (!pool->quit && pool->generation == seen) {
+            pthread_cond_wait(&pool->start, &pool->lock);
+        }
+        if (pool->quit) break;
+        seen = pool->generation;
+        ThreadTask task = pool->task;
+        void *context = pool->context;
+        pthread_mutex_unlock(&pool->lock);
+
+        task(context, start.thread, pool->num_threads);
+
+        pthread_mutex_lock(&pool->lock);
+        if (--pool->pending == 0) {
+            pthread_cond_signal(&pool->done);
+        }
+    }
+    pthread_mutex_unlock(&pool->lock);
+    return NULL;
+}
+
+// Create a pool of num_threads threads including the caller, 0 for one per core
+ThreadPool *threadpool_create(int num_threads) {
+    if (num_threads <= 0) {
+        num_threads = threadpool_default_threads();
+    }
+
+    ThreadPool *pool = calloc(1, sizeof(ThreadPool));
+    if (pool == NULL) {
+        return NULL;
+    }
+    pool->num_threads = 1;
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->start, NULL);
+    pthread_cond_init(&pool->done, NULL);
+
+    pool->workers = calloc((size_t)num_threads, sizeof(pthread_t));
+    if (pool->workers == NULL) {
+        threadpool_destroy(pool);
+        return NULL;
+    }
+    for (int t = 1; t < num_threads; t++) {
+        WorkerStart *start = malloc(sizeof(WorkerStart));
+        if (start == NULL) break;
+        start->pool = pool;
+        start->thread = t;
+        if (pthread_create(&pool->workers[t - 1], NULL, worker_main, start) != 0) {
+            printf("threadpool: could only start %d of %d threads\n", t, num_threads);
+            free(start);
+            break;
+        }
+        pool->num_threads = t + 1;
+    }
+    return pool;
+}
+
+// Run task on every thread and wait for all of them to return
+void threadpool_run(ThreadPool *pool, ThreadTask task, void *context) {
+    if (pool == NULL || pool->num_threads == 1) {
+        task(context, 0, 1);
+        return;
+    }
+
+    pthread_mutex_lock(&pool->lock);
+    pool->task = task;
+    pool->context = context;
+    pool->pending = pool->num_threads - 1;
+    pool->generation++;
+    pthread_cond_broadcast(&pool->start);
+    pthread_mutex_unlock(&pool->lock);
+
+    task(context, 0, pool->num_threads);
+
+    pthread_mutex_lock(&pool->lock);
+    while (pool->pending > 0) {
+        pthread_cond_wait(&pool->done, &pool->lock);
+    }
+    pthread_mutex_unlock(&pool->lock);
+}
+
+int threadpool_size(const ThreadPool *pool) {
+    return pool != NULL ? pool->num_threads : 1;
+}
+
+void threadpool_destroy(ThreadPool *pool) {
+    if (pool == NULL) {
+        return;
+    }
+    pthread_mutex_lock(&pool->lock);
+    pool->quit = 1;
+    pthread_cond_broadcast(&pool->start);
+    pthread_mutex_unlock(&pool->lock);
+
+    for (int t = 1; t < pool->num_threads; t++) {
+        pthread_join(pool->workers[t - 1], NULL);
+    }
+    pthread_mutex_destroy(&pool->lock);
+    pthread_cond_destroy(&pool->start);
+    pthread_cond_destroy(&pool->done);
+    free(pool->workers);
+    free(pool);
+}
+
+int threadpool_default_threads(void) {
+    long cores = sysconf(_SC_NPROCESSORS_ONLN);
+    return cores > 0 ? (int)cores : 1;
+}
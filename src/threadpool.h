@@ -0,0 +1,17 @@
+#ifndef THREADPOOL_H
+#define THREADPOOL_H
+
+// Work function run once on every thread of the pool; thread is 0..num_threads-1
+typedef void (*ThreadTask)(void *context, int thread, int num_threads);
+
+// Persistent pool of workers. The calling thread takes part as thread 0, so a
+// pool of one thread runs everything inline.
+typedef struct ThreadPool ThreadPool;
+
+ThreadPool *threadpool_create(int num_threads);
+void threadpool_run(ThreadPool *pool, ThreadTask task, void *context);
+int threadpool_size(const ThreadPool *pool);
+void threadpool_destroy(ThreadPool *pool);
+int threadpool_default_threads(void);
+
+#endif